@@ -0,0 +1,198 @@
+/*
+ * XUDK - Hosted microbenchmark suite
+ * Throughput and latency of the boot-path primitives on the hosted backend,
+ * so regressions show up on a CI box instead of on the rack.
+ *
+ * Build: compile every .c in XUDK/CORE, XUDK/SWR, XUDK/BENCH and XUDK/HOST (except
+ * HOST/main.c) with -std=c11 -O2 -fshort-wchar -fno-builtin, with the
+ * directory holding XUDK on the include path as xudk/, and link -lpthread.
+ *
+ *   xbench [--csv] [--filter SUBSTRING] [--time SECONDS]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define BENCH_DISK_SIZE  (256ULL * 1024 * 1024)
+
+volatile u64 xudk_bench_sink;
+
+u64 xudk_bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+void xudk_bench_run(xudk_bench *b, const char *group, const char *name, u64 bytes_per_op,
+                    xudk_bench_fn fn, void *arg) {
+    char full_name[128];
+    u64 budget = (u64)(b->min_time * 1e9);
+    u64 iterations = 1, total_iterations = 0, total_ns = 0, best_ns = ~0ULL;
+    double ns_per_op;
+
+    snprintf(full_name, sizeof(full_name), "%s/%s", group, name);
+    if (b->filter && !strstr(full_name, b->filter)) {
+        return;
+    }
+
+    // Warm up and find a batch size that takes about 1/10 of the budget
+    for (;;) {
+        u64 start = xudk_bench_now();
+        fn(arg, iterations);
+        u64 elapsed = xudk_bench_now() - start;
+        if (elapsed >= budget / 10 || iterations >= (1ULL << 40)) {
+            break;
+        }
+        iterations = elapsed ? iterations * 2 + iterations * (budget / 10) / (elapsed * 2) : iterations * 16;
+    }
+
+    // Measure whole batches until the budget is spent; keep the best batch too
+    while (total_ns < budget) {
+        u64 start = xudk_bench_now();
+        fn(arg, iterations);
+        u64 elapsed = xudk_bench_now() - start;
+        total_ns += elapsed;
+        total_iterations += iterations;
+        if (elapsed / iterations < best_ns) {
+            best_ns = elapsed / iterations;
+        }
+    }
+
+    ns_per_op = (double)total_ns / (double)total_iterations;
+    if (b->csv) {
+        printf("%s,%s,%llu,%.2f,%llu,%.3f\n", group, name, (unsigned long long)bytes_per_op, ns_per_op,
+               (unsigned long long)best_ns, bytes_per_op ? (double)bytes_per_op / ns_per_op : 0.0);
+    } else if (bytes_per_op) {
+        printf("%-10s %-34s %12.1f ns/op %9.3f GB/s\n", group, name, ns_per_op, (double)bytes_per_op / ns_per_op);
+    } else {
+        printf("%-10s %-34s %12.1f ns/op\n", group, name, ns_per_op);
+    }
+    fflush(stdout);
+}
+
+static int write_file(const char *path, usize size) {
+    u8 *data = malloc(size);
+    FILE *f = fopen(path, "wb");
+    int ok = data && f;
+
+    if (ok) {
+        for (usize i = 0; i < size; i++) {
+            data[i] = (u8)(i * 131 + (i >> 12));
+        }
+        ok = fwrite(data, 1, size, f) == size;
+    }
+    if (f) {
+        fclose(f);
+    }
+    free(data);
+    return ok;
+}
+
+static int make_scratch(char *dir, char *disk) {
+    char path[512];
+    int fd;
+
+    if (!mkdtemp(dir)) {
+        return 0;
+    }
+    snprintf(disk, 512, "%s/disk.img", dir);
+    fd = open(disk, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)BENCH_DISK_SIZE) != 0) {
+        return 0;
+    }
+    close(fd);
+
+    snprintf(path, sizeof(path), "%s/small.bin", dir);
+    if (!write_file(path, 64 * 1024)) {
+        return 0;
+    }
+    snprintf(path, sizeof(path), "%s/initrd.img", dir);
+    if (!write_file(path, 32 * 1024 * 1024)) {
+        return 0;
+    }
+    snprintf(path, sizeof(path), "%s/initrd100.img", dir);
+    return write_file(path, XUDK_BENCH_INITRD_SIZE);
+}
+
+static void remove_scratch(const char *dir) {
+    static const char *files[] = { "disk.img", "small.bin", "initrd.img", "initrd100.img", "splash.bmp", "splash.qoi", "splash.png" };
+    char path[512];
+
+    for (usize i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+        unlink(path);
+    }
+    rmdir(dir);
+}
+
+int main(int argc, char **argv) {
+    char dir[512] = "/tmp/xbench.XXXXXX", disk[512];
+    const char *disks[1] = { disk };
+    xudk_host_config config;
+    xudk_bench b;
+    xudk_ctx ctx;
+    status s;
+
+    memset(&b, 0, sizeof(b));
+    b.min_time = 0.25;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--csv")) {
+            b.csv = true;
+        } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            b.filter = argv[++i];
+        } else if (!strcmp(argv[i], "--time") && i + 1 < argc) {
+            b.min_time = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--csv] [--filter SUBSTRING] [--time SECONDS]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (!make_scratch(dir, disk)) {
+        fprintf(stderr, "xbench: cannot create scratch files in /tmp\n");
+        remove_scratch(dir);
+        return 1;
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.esp_root = dir;
+    config.disk_images = disks;
+    config.disk_count = 1;
+    config.fb_width = 1920;
+    config.fb_height = 1080;
+
+    s = xudk_init(&ctx, null, &config);
+    if (xudk_error(s)) {
+        fprintf(stderr, "xbench: xudk_init failed: 0x%llx\n", (unsigned long long)s);
+        remove_scratch(dir);
+        return 1;
+    }
+    b.ctx = &ctx;
+    b.scratch_dir = dir;
+    b.disk_image = disk;
+
+    if (b.csv) {
+        printf("group,case,bytes_per_op,ns_per_op,best_ns_per_op,gb_per_s\n");
+    }
+    xudk_bench_memory(&b);
+    xudk_bench_storage(&b);
+    xudk_bench_storage_queued(&b);
+    xudk_bench_storage_cache(&b);
+    xudk_bench_files(&b);
+    xudk_bench_fat32(&b);
+    xudk_bench_graphics(&b);
+    xudk_bench_images(&b);
+    xudk_bench_gpu(&b);
+
+    xudk_cleanup(&ctx);
+    remove_scratch(dir);
+    return 0;
+}
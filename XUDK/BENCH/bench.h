@@ -0,0 +1,47 @@
+/*
+ * XUDK - Hosted microbenchmark harness
+ */
+
+#ifndef XUDK_BENCH_H
+#define XUDK_BENCH_H
+
+#include "xudk/HOST/host.h"
+
+// Benchmark session shared by every group
+typedef struct {
+    xudk_ctx*       ctx;
+    const char*     scratch_dir;    // Temporary directory served as the ESP
+    const char*     disk_image;     // Scratch disk image, exposed as disk 0
+    const char*     filter;         // Only run cases whose "group/name" contains this
+    double          min_time;       // Seconds spent measuring each case
+    bool            csv;
+} xudk_bench;
+
+// initrd100.img, on the ESP and on a FAT32 volume on the scratch disk
+#define XUDK_BENCH_INITRD_SIZE  (100 * 1024 * 1024)
+
+// One measured operation; called `iterations` times back to back
+typedef void (*xudk_bench_fn)(void *arg, u64 iterations);
+
+// Measure fn and print ns/op plus throughput when bytes_per_op is non-zero
+void   xudk_bench_run(xudk_bench *b, const char *group, const char *name, u64 bytes_per_op,
+                      xudk_bench_fn fn, void *arg);
+
+// Monotonic time in nanoseconds
+u64    xudk_bench_now(void);
+
+// Keep a result alive so the measured work is not optimized out
+extern volatile u64 xudk_bench_sink;
+
+// Benchmark groups
+void   xudk_bench_memory(xudk_bench *b);
+void   xudk_bench_storage(xudk_bench *b);
+void   xudk_bench_storage_queued(xudk_bench *b);
+void   xudk_bench_storage_cache(xudk_bench *b);
+void   xudk_bench_files(xudk_bench *b);
+void   xudk_bench_fat32(xudk_bench *b);
+void   xudk_bench_graphics(xudk_bench *b);
+void   xudk_bench_images(xudk_bench *b);
+void   xudk_bench_gpu(xudk_bench *b);
+
+#endif // XUDK_BENCH_H
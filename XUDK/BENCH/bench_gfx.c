@@ -0,0 +1,289 @@
+/*
+ * XUDK - Benchmarks: framebuffer drawing and blits
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "xudk/CORE/core.h"
+
+#define GFX_BATCH   1024
+
+typedef struct {
+    xudk_ctx*   ctx;
+    u32*        image;
+    u32         width;
+    u32         height;
+    u32         screen_width;
+    u32         screen_height;
+    const xudk_pixel_impl* kernels;
+    xudk_point* points;
+    xudk_fill_rect* rects;
+    u32         count;
+    xudk_font*  font;
+    xudk_text_run* runs;
+} gfx_case;
+
+#define LOG_LINES   80
+#define LOG_COLUMNS 120
+
+static void run_copy_buffer(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        c->ctx->graphics.copy_buffer(c->ctx, c->image, 0, 0, c->width, c->height);
+    }
+}
+
+static void run_draw_rectangle(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        c->ctx->graphics.draw_rectangle(c->ctx, (u32)iterations % (c->screen_width - c->width), 16,
+                                        c->width, c->height, 0xFF2060A0);
+    }
+}
+
+static void run_draw_pixel(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        c->ctx->graphics.draw_pixel(c->ctx, (u32)iterations % c->screen_width,
+                                    (u32)(iterations >> 8) % c->screen_height, (u32)iterations);
+    }
+}
+
+static void run_draw_text(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        c->ctx->graphics.draw_text(c->ctx, 8, 8, L"Booting Linux 6.8.0-xudk (initrd 42 MB) ...", 0xFFFFFFFF);
+    }
+}
+
+static void run_fill_row(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        c->kernels->fill(c->image, (u32)iterations | 0xFF000000u, c->width);
+    }
+}
+
+static void run_blend_row(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        c->kernels->blend(c->image, 0xFF2060A0, 0x80, c->width);
+    }
+}
+
+// The same scattered points drawn one call each and as one batch
+static void run_points_single(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        for (u32 i = 0; i < GFX_BATCH; i++) {
+            c->ctx->graphics.draw_pixel(c->ctx, c->points[i].x, c->points[i].y, c->points[i].color);
+        }
+    }
+}
+
+static void run_points_batch(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        c->ctx->graphics.plot_points(c->ctx, c->points, GFX_BATCH);
+    }
+}
+
+static void run_rects_single(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        for (u32 i = 0; i < c->count; i++) {
+            const xudk_fill_rect *r = &c->rects[i];
+            c->ctx->graphics.draw_rectangle(c->ctx, r->x, r->y, r->width, r->height, r->color);
+        }
+    }
+}
+
+// c->count rects per call; their alpha decides fill or blend
+static void run_rects_batch(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        c->ctx->graphics.fill_rects(c->ctx, c->rects, c->count);
+    }
+}
+
+// A screen of log lines, one draw_text call per line
+static void run_log_draw_text(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        for (u32 i = 0; i < LOG_LINES; i++) {
+            c->ctx->graphics.draw_text(c->ctx, c->runs[i].x, c->runs[i].y, c->runs[i].text, c->runs[i].color);
+        }
+    }
+}
+
+static void run_log_runs(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        c->ctx->graphics.draw_text_runs(c->ctx, c->font, c->runs, LOG_LINES);
+    }
+}
+
+// Boot menu keypress: un-highlight one entry and highlight the next, then
+// present (a no-op while the back buffer is off)
+static void run_menu_keypress(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        u32 row = (u32)iterations % 16, next = (row + 1) % 16;
+        c->ctx->graphics.draw_rectangle(c->ctx, 100, 100 + row * 28, 600, 24, 0xFF202020);
+        c->ctx->graphics.draw_text(c->ctx, 108, 108 + row * 28, L"Linux 6.8.0-xudk", 0xFFC0C0C0);
+        c->ctx->graphics.draw_rectangle(c->ctx, 100, 100 + next * 28, 600, 24, 0xFF2060A0);
+        c->ctx->graphics.draw_text(c->ctx, 108, 108 + next * 28, L"Linux 6.8.0-xudk", 0xFFFFFFFF);
+        c->ctx->graphics.present(c->ctx);
+    }
+}
+
+static void run_present_full(void *arg, u64 iterations) {
+    gfx_case *c = arg;
+    while (iterations--) {
+        c->ctx->graphics.invalidate(c->ctx, 0, 0, c->screen_width, c->screen_height);
+        c->ctx->graphics.present(c->ctx);
+    }
+}
+
+static void bench_batches(xudk_bench *b, gfx_case *c) {
+    u32 features = xudk_cpu_features();
+    const xudk_pixel_impl *impls;
+    usize impl_count;
+    char name[64];
+
+    impls = xudk_pixel_impls(&impl_count);
+    c->width = c->screen_width;
+    for (usize k = 0; k < impl_count; k++) {
+        if ((impls[k].features & features) != impls[k].features) {
+            continue;
+        }
+        c->kernels = &impls[k];
+        snprintf(name, sizeof(name), "fill row %u %s", c->width, c->kernels->name);
+        xudk_bench_run(b, "graphics", name, (u64)c->width * 4, run_fill_row, c);
+        snprintf(name, sizeof(name), "blend row %u %s", c->width, c->kernels->name);
+        xudk_bench_run(b, "graphics", name, (u64)c->width * 4, run_blend_row, c);
+    }
+
+    c->points = malloc(GFX_BATCH * sizeof(xudk_point));
+    c->rects = malloc(GFX_BATCH * sizeof(xudk_fill_rect));
+    if (!c->points || !c->rects) {
+        free(c->points);
+        free(c->rects);
+        return;
+    }
+    for (u32 i = 0; i < GFX_BATCH; i++) {
+        u32 hash = i * 2654435761u;
+        c->points[i].x = hash % c->screen_width;
+        c->points[i].y = (hash >> 12) % c->screen_height;
+        c->points[i].color = 0xFF000000u | hash;
+        c->rects[i].x = (i % 16) * 40;
+        c->rects[i].y = (i / 16 % 16) * 28;
+        c->rects[i].width = 36;
+        c->rects[i].height = 24;
+        c->rects[i].color = 0xFF2060A0;
+    }
+    xudk_bench_run(b, "graphics", "1024 points draw_pixel", 0, run_points_single, c);
+    xudk_bench_run(b, "graphics", "1024 points plot_points", 0, run_points_batch, c);
+    c->count = 256;
+    xudk_bench_run(b, "graphics", "256 rects draw_rectangle", 256 * 36 * 24 * 4, run_rects_single, c);
+    xudk_bench_run(b, "graphics", "256 rects fill_rects", 256 * 36 * 24 * 4, run_rects_batch, c);
+    for (u32 i = 0; i < GFX_BATCH; i++) {
+        c->rects[i].color = 0x802060A0;
+    }
+    xudk_bench_run(b, "graphics", "256 rects fill_rects blended", 256 * 36 * 24 * 4, run_rects_batch, c);
+
+    free(c->points);
+    free(c->rects);
+}
+
+static void bench_text(xudk_bench *b, gfx_case *c) {
+    static wchar lines[LOG_LINES][LOG_COLUMNS + 1];
+    xudk_text_run runs[LOG_LINES];
+
+    for (u32 i = 0; i < LOG_LINES; i++) {
+        for (u32 j = 0; j < LOG_COLUMNS; j++) {
+            lines[i][j] = (wchar)(0x21 + (i * 7 + j * 13) % 94);
+        }
+        lines[i][LOG_COLUMNS] = 0;
+        runs[i].x = 0;
+        runs[i].y = i * XUDK_FONT_LINE;
+        runs[i].text = lines[i];
+        runs[i].color = 0xFFC0C0C0;
+    }
+    c->runs = runs;
+    c->font = null;
+    xudk_bench_run(b, "graphics", "log screen 9600 chars draw_text", 0, run_log_draw_text, c);
+    xudk_bench_run(b, "graphics", "log screen 9600 chars runs", 0, run_log_runs, c);
+    for (u32 i = 0; i < LOG_LINES; i++) {
+        runs[i].color = 0xC0C0C0C0;
+    }
+    xudk_bench_run(b, "graphics", "log screen 9600 chars runs blended", 0, run_log_runs, c);
+
+    // Half the lines at twice the size, hard and smooth
+    for (u32 i = 0; i < LOG_LINES; i++) {
+        runs[i].y = (i / 2) * XUDK_FONT_LINE * 2;
+        runs[i].x = (i % 2) * (c->screen_width / 2);
+        runs[i].color = 0xFFC0C0C0;
+        lines[i][c->screen_width / 2 / (XUDK_FONT_ADVANCE * 2)] = 0;
+    }
+    for (u32 flags = 0; flags <= XUDK_FONT_SMOOTH; flags++) {
+        if (xudk_ok(xudk_font_create(c->ctx, 2, flags, &c->font))) {
+            xudk_bench_run(b, "graphics", flags ? "log screen 2x smooth runs" : "log screen 2x runs", 0,
+                           run_log_runs, c);
+            xudk_font_destroy(c->ctx, c->font);
+        }
+    }
+    c->font = null;
+}
+
+void xudk_bench_graphics(xudk_bench *b) {
+    xudk_graphics_mode *modes;
+    usize mode_count;
+    gfx_case c;
+
+    if (xudk_error(b->ctx->graphics.get_modes(b->ctx, &modes, &mode_count))) {
+        return;
+    }
+    c.ctx = b->ctx;
+    c.screen_width = modes[0].horizontal_resolution;
+    c.screen_height = modes[0].vertical_resolution;
+    b->ctx->memory.free(b->ctx, modes);
+
+    c.image = malloc((usize)c.screen_width * c.screen_height * sizeof(u32));
+    if (!c.image) {
+        return;
+    }
+    for (usize i = 0; i < (usize)c.screen_width * c.screen_height; i++) {
+        c.image[i] = 0xFF000000u | (u32)(i * 2654435761u >> 8);
+    }
+
+    c.width = c.screen_width;
+    c.height = c.screen_height;
+    xudk_bench_run(b, "graphics", "copy_buffer full screen", (u64)c.width * c.height * 4, run_copy_buffer, &c);
+    c.width = 256;
+    c.height = 256;
+    xudk_bench_run(b, "graphics", "copy_buffer 256x256", (u64)c.width * c.height * 4, run_copy_buffer, &c);
+    c.width = 64;
+    c.height = 64;
+    xudk_bench_run(b, "graphics", "draw_rectangle 64x64", (u64)c.width * c.height * 4, run_draw_rectangle, &c);
+    c.width = 600;
+    c.height = 24;
+    xudk_bench_run(b, "graphics", "draw_rectangle 600x24", (u64)c.width * c.height * 4, run_draw_rectangle, &c);
+    xudk_bench_run(b, "graphics", "draw_pixel", 4, run_draw_pixel, &c);
+    xudk_bench_run(b, "graphics", "draw_text 43 chars", 0, run_draw_text, &c);
+    bench_batches(b, &c);
+    bench_text(b, &c);
+    xudk_bench_run(b, "graphics", "menu keypress direct", 0, run_menu_keypress, &c);
+
+    if (xudk_ok(b->ctx->graphics.enable_back_buffer(b->ctx, true))) {
+        xudk_bench_run(b, "graphics", "menu keypress back buffer", 0, run_menu_keypress, &c);
+        xudk_bench_run(b, "graphics", "present full screen", (u64)c.screen_width * c.screen_height * 4,
+                       run_present_full, &c);
+        b->ctx->graphics.enable_back_buffer(b->ctx, false);
+    }
+
+    free(c.image);
+}
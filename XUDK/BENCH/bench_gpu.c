@@ -0,0 +1,536 @@
+/*
+ * XUDK - Benchmarks: GPU layers on the software rasterizer
+ * A boot menu frame, drawn the way a loader would: a 1920x1080 background
+ * uploaded through the upload queue, menu entries whose vertices come from
+ * the frame ring each frame, descriptor sets from the descriptor pool, then
+ * present_to_screen. At 60 fps the budget is 16.7 ms a frame. The same frame
+ * runs again under the state tracker and the profiler, and the pool, ring,
+ * upload queue and descriptor pool also get cases of their own.
+ *
+ * Each case checks what it measures as it goes and prints FAILED with the
+ * status after its time when the layer gets something wrong.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "xudk/CORE/core.h"
+
+#define POOL_OVERSIZE   20000000        // Over a default block, not a power of two
+#define MENU_WIDTH      1920
+#define MENU_HEIGHT     1080
+#define MENU_ENTRIES    8
+#define MENU_VERTICES   (MENU_ENTRIES * 6)
+#define MENU_COLOR      0xFF303848u
+#define MENU_HIGHLIGHT  0xFF2060A0u
+#define RING_PUSHES     64              // Ring pushes per ring frame
+#define PROFILER_LATENCY 8              // Frames the profiler may take to report one
+
+typedef struct {
+    xudk_ctx*       ctx;
+    xudk_gpu_pool*  pool;
+    u64             size;
+    status          failed;
+} pool_case;
+
+// Vertex layout of the basic shaders
+typedef struct {
+    float           position[3];
+    float           texcoord[2];
+    u32             color;
+} menu_vertex;
+
+typedef struct {
+    xudk_ctx*                   ctx;
+    xudk_gpu_texture            target;
+    xudk_gpu_texture            background;
+    xudk_gpu_texture            white;
+    xudk_gpu_texture*           targets[1];
+    xudk_gpu_render_pass        render_pass;
+    xudk_gpu_shader             vertex_shader;
+    xudk_gpu_shader             fragment_shader;
+    xudk_gpu_pipeline           background_pipeline;
+    xudk_gpu_pipeline           menu_pipeline;
+    xudk_gpu_descriptor_layout  layout;
+    xudk_gpu_descriptor_pool*   descriptors;
+    xudk_gpu_ring               ring;
+    xudk_gpu_upload_queue*      uploads;
+    xudk_gpu_cmd_buffer         cmd_buffer;
+    u32*                        pixels;         // Background, also the upload case's source
+    u32                         frame;
+    bool                        layered;        // Tracker and profiler are open
+    handle                      first_set;
+    status                      failed;
+} menu_case;
+
+static bool selected(xudk_bench *b, const char *name) {
+    char full_name[128];
+
+    snprintf(full_name, sizeof(full_name), "gpu/%s", name);
+    return !b->filter || strstr(full_name, b->filter);
+}
+
+static void report_failure(xudk_bench *b, const char *name, status s) {
+    printf(b->csv ? "gpu,%s,FAILED 0x%llx\n" : "%-10s %-34s FAILED 0x%llx\n", "gpu", name, (unsigned long long)s);
+    fflush(stdout);
+}
+
+// Runs a case, then says so when it failed at any point
+static void run_checked(xudk_bench *b, const char *name, u64 bytes_per_op, xudk_bench_fn fn, void *arg,
+                        status *failed) {
+    if (!selected(b, name)) {
+        return;
+    }
+    *failed = XUDK_OK;
+    xudk_bench_run(b, "gpu", name, bytes_per_op, fn, arg);
+    if (xudk_error(*failed)) {
+        report_failure(b, name, *failed);
+    }
+}
+
+// =============================================================================
+// POOL
+// =============================================================================
+
+static void run_pool_alloc(void *arg, u64 iterations) {
+    pool_case *c = arg;
+    xudk_gpu_allocation a;
+
+    while (iterations--) {
+        status s = xudk_gpu_pool_alloc(c->ctx, c->pool, c->size, 256, XUDK_GPU_ALLOC_HOST_VISIBLE, &a);
+        if (xudk_error(s)) {
+            c->failed = s;
+            return;
+        }
+        if (a.size < c->size || a.offset % 256 || !a.mapped) {
+            c->failed = XUDK_ERROR;
+        } else {
+            ((u8*)a.mapped)[c->size - 1] = (u8)iterations;
+        }
+        s = xudk_gpu_pool_free(c->ctx, c->pool, &a);
+        if (xudk_error(s) || xudk_error(c->failed)) {
+            c->failed = xudk_error(s) ? s : c->failed;
+            return;
+        }
+    }
+}
+
+// =============================================================================
+// BOOT MENU FRAME
+// =============================================================================
+
+static u32 background_pixel(u32 x, u32 y) {
+    return 0xFF000000u | ((x * 255 / (MENU_WIDTH - 1)) << 16) | ((y * 255 / (MENU_HEIGHT - 1)) << 8) | 0x40;
+}
+
+// Entry i spans x -0.4..0.4, and 0.12 of clip space down from 0.6 - 0.15 i
+static float entry_top(u32 entry) {
+    return 0.6f - 0.15f * (float)entry;
+}
+
+static void menu_quad(menu_vertex *v, u32 entry, u32 color) {
+    static const float corners[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+
+    for (u32 i = 0; i < 6; i++) {
+        v[i].position[0] = -0.4f + 0.8f * corners[i][0];
+        v[i].position[1] = entry_top(entry) - 0.12f * corners[i][1];
+        v[i].position[2] = 0.0f;
+        v[i].texcoord[0] = 0.5f;
+        v[i].texcoord[1] = 0.5f;
+        v[i].color = color;
+    }
+}
+
+static bool near_pixel(u32 a, u32 b) {
+    for (u32 shift = 0; shift < 24; shift += 8) {
+        i32 d = (i32)((a >> shift) & 0xFF) - (i32)((b >> shift) & 0xFF);
+        if (d > 2 || d < -2) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A background pixel above the menu and the middle of the highlighted entry
+static status check_screen(menu_case *m, u32 highlight) {
+    xudk_ctx *ctx = m->ctx;
+    xudk_graphics_mode mode;
+    const u32 *screen;
+    addr base;
+    usize size;
+    u32 y = (u32)((1.0f - (entry_top(highlight) - 0.06f)) * 0.5f * MENU_HEIGHT);
+
+    if (xudk_error(ctx->graphics.get_mode(ctx, &mode)) || xudk_error(ctx->graphics.get_framebuffer(ctx, &base, &size)) ||
+        mode.horizontal_resolution < MENU_WIDTH || mode.vertical_resolution < MENU_HEIGHT) {
+        return XUDK_OK;
+    }
+    screen = (const u32*)(usize)base;
+    if (!near_pixel(screen[(usize)40 * mode.pixels_per_scanline + 100],
+                    xudk_color_to_pixel(background_pixel(100, 40), mode.pixel_format)) ||
+        !near_pixel(screen[(usize)y * mode.pixels_per_scanline + MENU_WIDTH / 2],
+                    xudk_color_to_pixel(MENU_HIGHLIGHT, mode.pixel_format))) {
+        return XUDK_ERROR;
+    }
+    return XUDK_OK;
+}
+
+static status draw_menu(menu_case *m) {
+    xudk_ctx *ctx = m->ctx;
+    xudk_gpu_cmd_buffer *cb = &m->cmd_buffer;
+    xudk_gpu_descriptor_write write = { 0, 0, null, 0, null };
+    handle background_set, menu_set;
+    u32 highlight = m->frame++ % MENU_ENTRIES;
+    xudk_gpu_slice vertices;
+    status s;
+
+    s = xudk_gpu_ring_begin_frame(ctx, &m->ring);
+    if (xudk_ok(s)) {
+        s = xudk_gpu_descriptor_pool_begin_frame(ctx, m->descriptors);
+    }
+    if (xudk_ok(s)) {
+        s = xudk_gpu_ring_alloc(&m->ring, MENU_VERTICES * sizeof(menu_vertex), 16, &vertices);
+    }
+    if (xudk_ok(s)) {
+        for (u32 i = 0; i < MENU_ENTRIES; i++) {
+            menu_quad((menu_vertex*)vertices.data + i * 6, i, i == highlight ? MENU_HIGHLIGHT : MENU_COLOR);
+        }
+        write.texture = &m->background;
+        s = xudk_gpu_descriptor_pool_get(ctx, m->descriptors, &m->layout, 1, &write, &background_set);
+    }
+    if (xudk_ok(s)) {
+        write.texture = &m->white;
+        s = xudk_gpu_descriptor_pool_get(ctx, m->descriptors, &m->layout, 1, &write, &menu_set);
+    }
+    if (xudk_ok(s)) {
+        s = ctx->gpu.begin_recording(ctx, cb);
+    }
+    if (xudk_ok(s) && m->layered) {
+        s = xudk_gpu_profile_begin(ctx, cb, "menu");
+        if (xudk_ok(s)) {
+            s = xudk_gpu_use_texture(ctx, cb, &m->background, XUDK_STATE_SHADER_READ);
+        }
+    }
+    if (xudk_ok(s)) {
+        s = ctx->gpu.begin_render_pass(ctx, cb, &m->render_pass);
+    }
+    if (xudk_ok(s)) {
+        ctx->gpu.set_viewport(ctx, cb, 0, 0, MENU_WIDTH, MENU_HEIGHT);
+        ctx->gpu.bind_pipeline(ctx, cb, &m->background_pipeline);
+        ctx->gpu.bind_descriptor_set(ctx, cb, 0, background_set);
+        s = xudk_gpu_draw_fullscreen_quad(ctx, cb);
+    }
+    if (xudk_ok(s)) {
+        ctx->gpu.bind_pipeline(ctx, cb, &m->menu_pipeline);
+        ctx->gpu.bind_vertex_buffers(ctx, cb, 0, 1, &vertices.buffer, &vertices.offset);
+        ctx->gpu.bind_descriptor_set(ctx, cb, 0, menu_set);
+        s = ctx->gpu.draw(ctx, cb, MENU_VERTICES, 1, 0, 0);
+    }
+    if (xudk_ok(s)) {
+        s = ctx->gpu.end_render_pass(ctx, cb);
+    }
+    if (xudk_ok(s) && m->layered) {
+        s = xudk_gpu_profile_end(ctx, cb);
+        if (xudk_ok(s)) {
+            s = xudk_gpu_use_texture(ctx, cb, &m->target, XUDK_STATE_PRESENT);
+        }
+    }
+    if (xudk_ok(s)) {
+        s = ctx->gpu.end_recording(ctx, cb);
+    }
+    if (xudk_ok(s)) {
+        s = ctx->gpu.submit_command_buffer(ctx, cb);
+    }
+    if (m->ring.in_frame) {
+        status e = xudk_gpu_ring_end_frame(ctx, &m->ring, cb);
+        s = xudk_ok(s) ? e : s;
+    }
+    if (xudk_ok(s)) {
+        s = ctx->gpu.present_to_screen(ctx, &m->target);
+    }
+    return xudk_ok(s) ? check_screen(m, highlight) : s;
+}
+
+static void run_menu_frame(void *arg, u64 iterations) {
+    menu_case *m = arg;
+
+    while (iterations-- && xudk_ok(m->failed)) {
+        if (m->layered) {
+            m->failed = xudk_gpu_profiler_begin_frame(m->ctx);
+        }
+        if (xudk_ok(m->failed)) {
+            m->failed = draw_menu(m);
+        }
+        if (xudk_ok(m->failed) && m->layered) {
+            m->failed = xudk_gpu_profiler_end_frame(m->ctx);
+        }
+    }
+}
+
+// The menu frame under the tracker and, opened after it, the profiler. The
+// profiler must hand back timings within a few more frames, and the tracker
+// must refuse to close before the profiler has.
+static void run_layered_frames(xudk_bench *b, menu_case *m) {
+    const char *name = "boot menu frame tracked+profiled";
+    const xudk_gpu_profile_scope *scopes;
+    u32 count = 0;
+    status s;
+
+    if (!selected(b, name)) {
+        return;
+    }
+    s = xudk_gpu_state_tracking_open(m->ctx);
+    if (xudk_ok(s)) {
+        s = xudk_gpu_profiler_open(m->ctx, 16, false);
+        if (xudk_error(s)) {
+            xudk_gpu_state_tracking_close(m->ctx);
+        }
+    }
+    if (xudk_error(s)) {
+        report_failure(b, name, s);
+        return;
+    }
+    m->layered = true;
+    run_checked(b, name, 0, run_menu_frame, m, &m->failed);
+    for (u32 i = 0; i < PROFILER_LATENCY && xudk_ok(s) && !count; i++) {
+        run_menu_frame(m, 1);
+        s = xudk_gpu_profiler_get_scopes(m->ctx, &scopes, &count);
+    }
+    m->layered = false;
+    if (xudk_ok(s) && !count) {
+        s = XUDK_NOT_READY;
+    }
+    if (xudk_ok(s) && xudk_gpu_state_tracking_close(m->ctx) != XUDK_ACCESS_DENIED) {
+        s = XUDK_ERROR;
+    }
+    if (xudk_ok(s)) {
+        s = xudk_gpu_profiler_close(m->ctx);
+    }
+    if (xudk_ok(s)) {
+        s = xudk_gpu_state_tracking_close(m->ctx);
+    }
+    xudk_gpu_profiler_close(m->ctx);
+    xudk_gpu_state_tracking_close(m->ctx);
+    if (xudk_error(s) && xudk_ok(m->failed)) {
+        report_failure(b, name, s);
+    }
+}
+
+static status menu_create(xudk_ctx *ctx, menu_case *m) {
+    xudk_gpu_descriptor_binding binding = { 0, XUDK_DESCRIPTOR_TEXTURE, 1 };
+    u32 white = 0xFFFFFFFFu;
+    u64 fence;
+    status s;
+
+    xudk_memset(m, 0, sizeof(*m));
+    m->ctx = ctx;
+    m->targets[0] = &m->target;
+    m->render_pass.color_targets = m->targets;
+    m->render_pass.color_target_count = 1;
+    m->render_pass.width = MENU_WIDTH;
+    m->render_pass.height = MENU_HEIGHT;
+    m->render_pass.clear_color = true;
+    m->render_pass.clear_color_value[3] = 1.0f;
+    m->pixels = malloc((usize)MENU_WIDTH * MENU_HEIGHT * sizeof(u32));
+    if (!m->pixels) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    for (u32 y = 0; y < MENU_HEIGHT; y++) {
+        for (u32 x = 0; x < MENU_WIDTH; x++) {
+            m->pixels[(usize)y * MENU_WIDTH + x] = background_pixel(x, y);
+        }
+    }
+
+    s = ctx->gpu.create_render_target(ctx, MENU_WIDTH, MENU_HEIGHT, XUDK_FORMAT_B8G8R8A8_UNORM, 1, &m->target);
+    if (xudk_ok(s)) {
+        s = ctx->gpu.create_texture(ctx, MENU_WIDTH, MENU_HEIGHT, 1, XUDK_FORMAT_B8G8R8A8_UNORM, 1, 1, &m->background);
+    }
+    if (xudk_ok(s)) {
+        s = ctx->gpu.create_texture(ctx, 1, 1, 1, XUDK_FORMAT_B8G8R8A8_UNORM, 1, 1, &m->white);
+    }
+    if (xudk_ok(s)) {
+        s = xudk_gpu_upload_queue_create(ctx, 1024 * 1024, &m->uploads);
+    }
+    if (xudk_ok(s)) {
+        s = xudk_gpu_upload_texture(ctx, m->uploads, &m->background, 0, 0, m->pixels,
+                                    (u64)MENU_WIDTH * MENU_HEIGHT * sizeof(u32));
+    }
+    if (xudk_ok(s)) {
+        s = xudk_gpu_upload_texture(ctx, m->uploads, &m->white, 0, 0, &white, sizeof(white));
+    }
+    if (xudk_ok(s)) {
+        s = xudk_gpu_upload_queue_submit(ctx, m->uploads, &fence);
+    }
+    if (xudk_ok(s)) {
+        s = xudk_gpu_upload_queue_wait(ctx, m->uploads, fence);
+    }
+    if (xudk_ok(s)) {
+        s = ctx->gpu.compile_shader(ctx, XUDK_SHADER_VERTEX, xudk_basic_vertex_shader_source, "main",
+                                    &m->vertex_shader);
+    }
+    if (xudk_ok(s)) {
+        s = ctx->gpu.compile_shader(ctx, XUDK_SHADER_FRAGMENT, xudk_basic_fragment_shader_source, "main",
+                                    &m->fragment_shader);
+    }
+    if (xudk_ok(s)) {
+        s = xudk_gpu_create_fullscreen_pipeline(ctx, &m->fragment_shader, &m->background_pipeline);
+    }
+    if (xudk_ok(s)) {
+        s = xudk_gpu_create_simple_pipeline(ctx, &m->vertex_shader, &m->fragment_shader, XUDK_TOPOLOGY_TRIANGLES,
+                                            &m->menu_pipeline);
+    }
+    if (xudk_ok(s)) {
+        s = ctx->gpu.create_descriptor_layout(ctx, &binding, 1, &m->layout);
+    }
+    if (xudk_ok(s)) {
+        s = xudk_gpu_descriptor_pool_create(ctx, 2, &m->descriptors);
+    }
+    if (xudk_ok(s)) {
+        s = xudk_gpu_ring_create(ctx, 64 * 1024, 2, &m->ring);
+    }
+    if (xudk_ok(s)) {
+        s = ctx->gpu.create_command_buffer(ctx, false, &m->cmd_buffer);
+    }
+    return s;
+}
+
+// Whatever a failed menu_create got to is still zeroed
+static void menu_destroy(xudk_ctx *ctx, menu_case *m) {
+    if (m->cmd_buffer.cmd_buffer_handle) {
+        ctx->gpu.destroy_command_buffer(ctx, &m->cmd_buffer);
+    }
+    if (m->ring.mapped) {
+        xudk_gpu_ring_destroy(ctx, &m->ring);
+    }
+    if (m->descriptors) {
+        xudk_gpu_descriptor_pool_destroy(ctx, m->descriptors);
+    }
+    if (m->layout.layout_handle) {
+        ctx->gpu.destroy_descriptor_layout(ctx, &m->layout);
+    }
+    if (m->menu_pipeline.pipeline_handle) {
+        ctx->gpu.destroy_pipeline(ctx, &m->menu_pipeline);
+    }
+    if (m->background_pipeline.pipeline_handle) {
+        ctx->gpu.destroy_pipeline(ctx, &m->background_pipeline);
+    }
+    if (m->fragment_shader.shader_handle) {
+        ctx->gpu.destroy_shader(ctx, &m->fragment_shader);
+    }
+    if (m->vertex_shader.shader_handle) {
+        ctx->gpu.destroy_shader(ctx, &m->vertex_shader);
+    }
+    if (m->uploads) {
+        xudk_gpu_upload_queue_destroy(ctx, m->uploads);
+    }
+    if (m->white.texture_handle) {
+        ctx->gpu.destroy_texture(ctx, &m->white);
+    }
+    if (m->background.texture_handle) {
+        ctx->gpu.destroy_texture(ctx, &m->background);
+    }
+    if (m->target.texture_handle) {
+        ctx->gpu.destroy_texture(ctx, &m->target);
+    }
+    free(m->pixels);
+}
+
+// =============================================================================
+// RING, UPLOAD QUEUE AND DESCRIPTOR POOL
+// =============================================================================
+
+static void run_ring_push(void *arg, u64 iterations) {
+    menu_case *m = arg;
+    xudk_gpu_slice slice;
+    u8 data[64];
+    status s = XUDK_OK;
+
+    xudk_memset(data, 0x5A, sizeof(data));
+    while (iterations && xudk_ok(s)) {
+        s = xudk_gpu_ring_begin_frame(m->ctx, &m->ring);
+        for (u32 i = 0; i < RING_PUSHES && iterations && xudk_ok(s); i++, iterations--) {
+            s = xudk_gpu_ring_push(&m->ring, data, sizeof(data), 16, &slice);
+            if (xudk_ok(s) && (slice.offset % 16 || slice.size < sizeof(data) || ((u8*)slice.data)[63] != 0x5A)) {
+                s = XUDK_ERROR;
+            }
+        }
+        if (m->ring.in_frame) {
+            xudk_gpu_ring_end_frame(m->ctx, &m->ring, null);
+        }
+    }
+    m->failed = xudk_ok(m->failed) ? s : m->failed;
+}
+
+// The whole background again, through staging in pieces, then a wait for it
+static void run_upload_texture(void *arg, u64 iterations) {
+    menu_case *m = arg;
+    u64 fence;
+    status s = XUDK_OK;
+
+    while (iterations-- && xudk_ok(s)) {
+        s = xudk_gpu_upload_texture(m->ctx, m->uploads, &m->background, 0, 0, m->pixels,
+                                    (u64)MENU_WIDTH * MENU_HEIGHT * sizeof(u32));
+        if (xudk_ok(s)) {
+            s = xudk_gpu_upload_queue_submit(m->ctx, m->uploads, &fence);
+        }
+        if (xudk_ok(s)) {
+            s = xudk_gpu_upload_queue_wait(m->ctx, m->uploads, fence);
+        }
+    }
+    m->failed = xudk_ok(m->failed) ? s : m->failed;
+}
+
+// The same binding every time, so every get after the first is a hit
+static void run_descriptor_get(void *arg, u64 iterations) {
+    menu_case *m = arg;
+    xudk_gpu_descriptor_write write = { 0, 0, null, 0, &m->background };
+    handle set;
+    status s = XUDK_OK;
+
+    while (iterations-- && xudk_ok(s)) {
+        s = xudk_gpu_descriptor_pool_get(m->ctx, m->descriptors, &m->layout, 1, &write, &set);
+        if (xudk_ok(s) && !m->first_set) {
+            m->first_set = set;
+        }
+        if (xudk_ok(s) && set != m->first_set) {
+            s = XUDK_ERROR;
+        }
+    }
+    m->failed = xudk_ok(m->failed) ? s : m->failed;
+}
+
+void xudk_bench_gpu(xudk_bench *b) {
+    pool_case p;
+    menu_case m;
+    status s;
+
+    if (xudk_error(xudk_gpu_auto_init(b->ctx))) {
+        return;
+    }
+
+    xudk_memset(&p, 0, sizeof(p));
+    p.ctx = b->ctx;
+    if (xudk_ok(xudk_gpu_pool_create(b->ctx, 0, &p.pool))) {
+        p.size = 256;
+        run_checked(b, "pool alloc+free 256B", 0, run_pool_alloc, &p, &p.failed);
+        p.size = POOL_OVERSIZE;
+        run_checked(b, "pool alloc+free 20M dedicated", 0, run_pool_alloc, &p, &p.failed);
+        xudk_gpu_pool_destroy(b->ctx, p.pool);
+    }
+
+    s = menu_create(b->ctx, &m);
+    if (xudk_ok(s)) {
+        run_checked(b, "boot menu frame 1920x1080", 0, run_menu_frame, &m, &m.failed);
+        run_layered_frames(b, &m);
+        run_checked(b, "ring push 64B", 64, run_ring_push, &m, &m.failed);
+        run_checked(b, "upload queue 1920x1080 texture", (u64)MENU_WIDTH * MENU_HEIGHT * sizeof(u32),
+                    run_upload_texture, &m, &m.failed);
+        run_checked(b, "descriptor pool get cached", 0, run_descriptor_get, &m, &m.failed);
+    } else if (selected(b, "boot menu frame 1920x1080")) {
+        report_failure(b, "boot menu frame 1920x1080", s);
+    }
+    menu_destroy(b->ctx, &m);
+}
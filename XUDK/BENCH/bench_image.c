@@ -0,0 +1,465 @@
+/*
+ * XUDK - Benchmarks: splash screen decoding (BMP, QOI, PNG)
+ * The scratch images are encoded here from one synthetic 1920x1080 splash:
+ * BMP raw, QOI as specified, PNG with Sub filters and a fixed-Huffman deflate
+ * stream, which exercises the same inflate paths as zlib output. The same
+ * splash, cropped to 1024x1024, is then BCn compressed and decompressed.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "xudk/CORE/core.h"
+
+#define SPLASH_WIDTH    1920
+#define SPLASH_HEIGHT   1080
+#define BCN_SIZE        1024
+
+typedef struct {
+    xudk_ctx*       ctx;
+    const wchar*    path;
+    xudk_surface    target;
+} image_case;
+
+typedef struct {
+    xudk_ctx*               ctx;
+    const xudk_bcn_impl*    kernels;
+    xudk_texture_format     format;
+    u32                     pixels[16];
+    u32                     palette[16];
+    u8*                     image;          // R8G8B8A8
+    u8*                     blocks;
+} bcn_case;
+
+typedef struct {
+    u8*             data;
+    usize           size;
+    u64             bits;
+    u32             bit_count;
+} bit_writer;
+
+// Gradient sky, a few flat panels and a noisy band, roughly like a vendor logo screen
+static u32 splash_pixel(u32 x, u32 y) {
+    u32 r = x * 255 / SPLASH_WIDTH, g = y * 255 / SPLASH_HEIGHT, b = 0x60;
+
+    if (x > 760 && x < 1160 && y > 340 && y < 740) {
+        r = 0xE0;
+        g = 0x30;
+        b = 0x30;
+    }
+    if (y > 900 && y < 940) {
+        u32 noise = (x * 2654435761u) ^ (y * 40503u);
+        r = (noise >> 8) & 0xFF;
+        g = (noise >> 16) & 0xFF;
+        b = noise >> 24;
+    }
+    return 0xFF000000u | (r << 16) | (g << 8) | b;
+}
+
+static void put_bits(bit_writer *w, u32 value, u32 count) {
+    w->bits |= (u64)value << w->bit_count;
+    w->bit_count += count;
+    while (w->bit_count >= 8) {
+        w->data[w->size++] = (u8)w->bits;
+        w->bits >>= 8;
+        w->bit_count -= 8;
+    }
+}
+
+// Fixed-Huffman codes go out most significant bit first
+static void put_code(bit_writer *w, u32 code, u32 length) {
+    u32 reversed = 0;
+    for (u32 i = 0; i < length; i++) {
+        reversed |= ((code >> i) & 1) << (length - 1 - i);
+    }
+    put_bits(w, reversed, length);
+}
+
+static void put_literal(bit_writer *w, u32 symbol) {
+    if (symbol < 144) {
+        put_code(w, 0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        put_code(w, 0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        put_code(w, symbol - 256, 7);
+    } else {
+        put_code(w, 0xC0 + symbol - 280, 8);
+    }
+}
+
+static void put_match(bit_writer *w, u32 length, u32 distance) {
+    static const u16 length_base[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    static const u16 distance_base[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+    };
+    u32 l = 28, d = 29;
+
+    while (length_base[l] > length) {
+        l--;
+    }
+    while (distance_base[d] > distance) {
+        d--;
+    }
+    put_literal(w, 257 + l);
+    put_bits(w, length - length_base[l], l < 8 || l == 28 ? 0 : (l - 4) / 4);
+    put_code(w, d, 5);
+    put_bits(w, distance - distance_base[d], d < 4 ? 0 : (d - 2) / 2);
+}
+
+// Greedy matches against the previous pixel and the previous scanline
+static usize deflate_fixed(const u8 *raw, usize size, usize stride, u8 *out) {
+    const usize distances[3] = { 3, 6, stride };
+    bit_writer w = { out, 0, 0, 0 };
+    u32 a = 1, b = 0;
+
+    out[w.size++] = 0x78;
+    out[w.size++] = 0x01;
+    put_bits(&w, 1, 1);
+    put_bits(&w, 1, 2);
+    for (usize i = 0; i < size;) {
+        usize best = 0, best_distance = 0;
+        for (u32 k = 0; k < 3; k++) {
+            usize d = distances[k], n = 0;
+            if (d > i || d > 32768) {
+                continue;
+            }
+            while (n < 258 && i + n < size && raw[i + n] == raw[i + n - d]) {
+                n++;
+            }
+            if (n > best) {
+                best = n;
+                best_distance = d;
+            }
+        }
+        if (best >= 3) {
+            put_match(&w, (u32)best, (u32)best_distance);
+            i += best;
+        } else {
+            put_literal(&w, raw[i++]);
+        }
+    }
+    put_literal(&w, 256);
+    put_bits(&w, 0, 7);
+
+    for (usize i = 0; i < size; i++) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    for (u32 i = 0; i < 4; i++) {
+        out[w.size++] = (u8)((((b << 16) | a) >> (24 - i * 8)) & 0xFF);
+    }
+    return w.size;
+}
+
+static void put_be32(u8 *p, u32 v) {
+    p[0] = (u8)(v >> 24);
+    p[1] = (u8)(v >> 16);
+    p[2] = (u8)(v >> 8);
+    p[3] = (u8)v;
+}
+
+static void write_chunk(FILE *f, const char *type, const u8 *data, u32 size) {
+    u8 header[8], crc[4];
+    u32 c = xudk_crc32_update(0, type, 4);
+
+    put_be32(header, size);
+    xudk_memcpy(header + 4, type, 4);
+    put_be32(crc, xudk_crc32_update(c, data, size));
+    fwrite(header, 1, 8, f);
+    fwrite(data, 1, size, f);
+    fwrite(crc, 1, 4, f);
+}
+
+static int write_png(const char *path) {
+    static const u8 signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    usize stride = SPLASH_WIDTH * 3 + 1, raw_size = stride * SPLASH_HEIGHT;
+    u8 *raw = malloc(raw_size), *z = malloc(raw_size * 2 + 64), ihdr[13] = { 0 };
+    FILE *f = fopen(path, "wb");
+    usize z_size;
+    int ok = raw && z && f;
+
+    if (ok) {
+        for (u32 y = 0; y < SPLASH_HEIGHT; y++) {
+            u8 *line = raw + y * stride;
+            line[0] = 1;    // Sub
+            for (u32 x = 0; x < SPLASH_WIDTH; x++) {
+                u32 p = splash_pixel(x, y), q = x ? splash_pixel(x - 1, y) : 0;
+                line[1 + x * 3] = (u8)((p >> 16) - (q >> 16));
+                line[2 + x * 3] = (u8)((p >> 8) - (q >> 8));
+                line[3 + x * 3] = (u8)(p - q);
+            }
+        }
+        z_size = deflate_fixed(raw, raw_size, stride, z);
+        put_be32(ihdr, SPLASH_WIDTH);
+        put_be32(ihdr + 4, SPLASH_HEIGHT);
+        ihdr[8] = 8;
+        ihdr[9] = 2;
+        fwrite(signature, 1, 8, f);
+        write_chunk(f, "IHDR", ihdr, 13);
+        for (usize i = 0; i < z_size; i += 65536) {
+            write_chunk(f, "IDAT", z + i, (u32)(z_size - i < 65536 ? z_size - i : 65536));
+        }
+        write_chunk(f, "IEND", null, 0);
+    }
+    if (f) {
+        fclose(f);
+    }
+    free(raw);
+    free(z);
+    return ok;
+}
+
+static int write_qoi(const char *path) {
+    u8 *out = malloc((usize)SPLASH_WIDTH * SPLASH_HEIGHT * 5 + 32);
+    u32 index[64] = { 0 }, prev = 0xFF000000u, run = 0;
+    usize n = 14;
+    FILE *f = fopen(path, "wb");
+    int ok = out && f;
+
+    if (ok) {
+        xudk_memcpy(out, "qoif", 4);
+        put_be32(out + 4, SPLASH_WIDTH);
+        put_be32(out + 8, SPLASH_HEIGHT);
+        out[12] = 3;
+        out[13] = 0;
+        for (u32 i = 0; i < SPLASH_WIDTH * SPLASH_HEIGHT; i++) {
+            u32 p = splash_pixel(i % SPLASH_WIDTH, i / SPLASH_WIDTH);
+            u32 r = (p >> 16) & 0xFF, g = (p >> 8) & 0xFF, b = p & 0xFF, h = (r * 3 + g * 5 + b * 7 + 255 * 11) & 63;
+            i32 dr = (i32)r - (i32)((prev >> 16) & 0xFF), dg = (i32)g - (i32)((prev >> 8) & 0xFF);
+            i32 db = (i32)b - (i32)(prev & 0xFF);
+
+            if (p == prev) {
+                if (++run == 62) {
+                    out[n++] = (u8)(0xC0 | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run) {
+                out[n++] = (u8)(0xC0 | (run - 1));
+                run = 0;
+            }
+            if (index[h] == p) {
+                out[n++] = (u8)h;
+            } else if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                out[n++] = (u8)(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+            } else if (dg >= -32 && dg <= 31 && dr - dg >= -8 && dr - dg <= 7 && db - dg >= -8 && db - dg <= 7) {
+                out[n++] = (u8)(0x80 | (dg + 32));
+                out[n++] = (u8)(((dr - dg + 8) << 4) | (db - dg + 8));
+            } else {
+                out[n++] = 0xFE;
+                out[n++] = (u8)r;
+                out[n++] = (u8)g;
+                out[n++] = (u8)b;
+            }
+            index[h] = p;
+            prev = p;
+        }
+        if (run) {
+            out[n++] = (u8)(0xC0 | (run - 1));
+        }
+        xudk_memset(out + n, 0, 7);
+        out[n + 7] = 1;
+        ok = fwrite(out, 1, n + 8, f) == n + 8;
+    }
+    if (f) {
+        fclose(f);
+    }
+    free(out);
+    return ok;
+}
+
+static int write_bmp(const char *path) {
+    u32 stride = SPLASH_WIDTH * 3, size = 54 + stride * SPLASH_HEIGHT;
+    u8 header[54] = { 'B', 'M' }, *row = malloc(stride);
+    FILE *f = fopen(path, "wb");
+    int ok = row && f;
+
+    if (ok) {
+        header[2] = (u8)size;
+        header[3] = (u8)(size >> 8);
+        header[4] = (u8)(size >> 16);
+        header[5] = (u8)(size >> 24);
+        header[10] = 54;
+        header[14] = 40;
+        header[18] = (u8)SPLASH_WIDTH;
+        header[19] = (u8)(SPLASH_WIDTH >> 8);
+        header[22] = (u8)SPLASH_HEIGHT;
+        header[23] = (u8)(SPLASH_HEIGHT >> 8);
+        header[26] = 1;
+        header[28] = 24;
+        fwrite(header, 1, 54, f);
+        for (u32 y = SPLASH_HEIGHT; y-- > 0;) {
+            for (u32 x = 0; x < SPLASH_WIDTH; x++) {
+                u32 p = splash_pixel(x, y);
+                row[x * 3] = (u8)p;
+                row[x * 3 + 1] = (u8)(p >> 8);
+                row[x * 3 + 2] = (u8)(p >> 16);
+            }
+            fwrite(row, 1, stride, f);
+        }
+    }
+    if (f) {
+        fclose(f);
+    }
+    free(row);
+    return ok;
+}
+
+static void run_decode(void *arg, u64 iterations) {
+    image_case *c = arg;
+    while (iterations--) {
+        xudk_image *image;
+        if (xudk_ok(xudk_image_open(c->ctx, c->path, &image, null))) {
+            xudk_image_decode(image, &c->target, 0, 0, 0);
+            xudk_image_close(image);
+        }
+    }
+}
+
+static void run_load_bitmap(void *arg, u64 iterations) {
+    image_case *c = arg;
+    while (iterations--) {
+        c->ctx->graphics.load_bitmap(c->ctx, c->path, 0, 0);
+    }
+}
+
+// Reading the whole file first, as the loaders used to, before any decoding
+static void run_load_whole(void *arg, u64 iterations) {
+    image_case *c = arg;
+    while (iterations--) {
+        void *data;
+        usize size;
+        if (xudk_ok(c->ctx->filesystem.load_file_to_memory(c->ctx, c->path, &data, &size))) {
+            xudk_bench_sink += size;
+            c->ctx->memory.free(c->ctx, data);
+        }
+    }
+}
+
+static void run_bcn_select(void *arg, u64 iterations) {
+    bcn_case *c = arg;
+    u8 indices[16];
+    while (iterations--) {
+        xudk_bench_sink += c->kernels->select(c->pixels, c->palette, 16, ~0u, indices);
+    }
+}
+
+static void run_bcn_compress(void *arg, u64 iterations) {
+    bcn_case *c = arg;
+    while (iterations--) {
+        xudk_gpu_compress_texture(c->ctx, c->format, c->image, BCN_SIZE, BCN_SIZE, c->blocks);
+    }
+}
+
+static void run_bcn_decompress(void *arg, u64 iterations) {
+    bcn_case *c = arg;
+    while (iterations--) {
+        xudk_gpu_decompress_texture(c->ctx, c->format, c->blocks, BCN_SIZE, BCN_SIZE, c->image);
+    }
+}
+
+static void bench_bcn(xudk_bench *b) {
+    static const struct {
+        const char*             name;
+        xudk_texture_format     format;
+    } formats[] = {
+        { "bc1", XUDK_FORMAT_BC1_UNORM },
+        { "bc3", XUDK_FORMAT_BC3_UNORM },
+        { "bc4", XUDK_FORMAT_BC4_UNORM },
+        { "bc5", XUDK_FORMAT_BC5_UNORM },
+        { "bc7", XUDK_FORMAT_BC7_UNORM },
+    };
+    u32 features = xudk_cpu_features();
+    const xudk_bcn_impl *impls;
+    usize impl_count;
+    bcn_case c;
+    char name[64];
+
+    c.ctx = b->ctx;
+    for (u32 i = 0; i < 16; i++) {
+        c.pixels[i] = splash_pixel(i * 97, i * 31);
+        c.palette[i] = splash_pixel(i * 120, 500);
+    }
+    impls = xudk_bcn_impls(&impl_count);
+    for (usize k = 0; k < impl_count; k++) {
+        if ((impls[k].features & features) != impls[k].features) {
+            continue;
+        }
+        c.kernels = &impls[k];
+        snprintf(name, sizeof(name), "bcn select 16x16 %s", c.kernels->name);
+        xudk_bench_run(b, "images", name, 0, run_bcn_select, &c);
+    }
+
+    c.image = malloc((usize)BCN_SIZE * BCN_SIZE * 4);
+    c.blocks = malloc((usize)BCN_SIZE * BCN_SIZE);
+    if (!c.image || !c.blocks) {
+        free(c.image);
+        free(c.blocks);
+        return;
+    }
+    for (usize i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        c.format = formats[i].format;
+        for (u32 y = 0; y < BCN_SIZE; y++) {
+            for (u32 x = 0; x < BCN_SIZE; x++) {
+                u32 p = splash_pixel(x + 400, y);
+                *(u32*)(c.image + ((usize)y * BCN_SIZE + x) * 4) =
+                    (p & 0xFF00FF00u) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+            }
+        }
+        snprintf(name, sizeof(name), "compress %ux%u %s", BCN_SIZE, BCN_SIZE, formats[i].name);
+        xudk_bench_run(b, "images", name, (u64)BCN_SIZE * BCN_SIZE * 4, run_bcn_compress, &c);
+        snprintf(name, sizeof(name), "decompress %ux%u %s", BCN_SIZE, BCN_SIZE, formats[i].name);
+        xudk_bench_run(b, "images", name, (u64)BCN_SIZE * BCN_SIZE * 4, run_bcn_decompress, &c);
+    }
+    free(c.image);
+    free(c.blocks);
+}
+
+void xudk_bench_images(xudk_bench *b) {
+    static const struct {
+        const char*     file;
+        const wchar*    path;
+        int             (*write)(const char *path);
+    } formats[] = {
+        { "splash.bmp", L"\\splash.bmp", write_bmp },
+        { "splash.qoi", L"\\splash.qoi", write_qoi },
+        { "splash.png", L"\\splash.png", write_png },
+    };
+    const u64 bytes = (u64)SPLASH_WIDTH * SPLASH_HEIGHT * 4;
+    image_case c;
+    char path[512], name[64];
+
+    c.ctx = b->ctx;
+    c.target.width = SPLASH_WIDTH;
+    c.target.height = SPLASH_HEIGHT;
+    c.target.stride = SPLASH_WIDTH;
+    c.target.pixel_format = XUDK_PIXEL_BGRX;
+    c.target.pixels = malloc(bytes);
+    if (!c.target.pixels) {
+        return;
+    }
+
+    for (usize i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", b->scratch_dir, formats[i].file);
+        if (!formats[i].write(path)) {
+            continue;
+        }
+        c.path = formats[i].path;
+        snprintf(name, sizeof(name), "read whole %s", formats[i].file);
+        xudk_bench_run(b, "images", name, 0, run_load_whole, &c);
+        snprintf(name, sizeof(name), "decode %s", formats[i].file);
+        xudk_bench_run(b, "images", name, bytes, run_decode, &c);
+        snprintf(name, sizeof(name), "load_bitmap %s", formats[i].file);
+        xudk_bench_run(b, "images", name, bytes, run_load_bitmap, &c);
+    }
+    free(c.target.pixels);
+    bench_bcn(b);
+}
@@ -0,0 +1,405 @@
+/*
+ * XUDK - Benchmarks: sector I/O and file loading
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+typedef struct {
+    xudk_ctx*   ctx;
+    u8*         buffer;
+    u32         sectors;
+    u64         lba;
+    u64         disk_sectors;
+    bool        random;
+} sector_case;
+
+typedef struct {
+    xudk_ctx*       ctx;
+    const wchar*    path;
+} file_case;
+
+typedef struct {
+    xudk_ctx*           ctx;
+    xudk_fat32_volume*  volume;
+    const wchar*        path;
+    usize               read_size;      // Per fat32_read; 0 loads the file whole
+    u8*                 buffer;         // The whole file, for reads in pieces
+} fat32_case;
+
+#define QUEUED_MAX_DEPTH    32
+#define STREAM_SIZE         (32 * 1024 * 1024)
+#define STREAM_READ         (1024 * 1024)
+
+// Requests of one size kept `depth` deep, each with its own buffer
+typedef struct {
+    sector_case     sectors;
+    xudk_io_queue*  queue;
+    u32             depth;
+    u32             sector_size;
+    xudk_io_request requests[QUEUED_MAX_DEPTH];
+    xudk_io_segment segments[QUEUED_MAX_DEPTH];
+} queued_case;
+
+typedef struct {
+    xudk_ctx*       ctx;
+    xudk_io_queue*  queue;
+    u64             sectors;        // STREAM_SIZE of them
+    u8*             buffer;         // STREAM_READ bytes
+} stream_case;
+
+#define CACHE_BUDGET        (4 * 1024 * 1024)
+#define CACHE_HOT_SECTORS   2048        // Span of the metadata-style reads
+
+typedef struct {
+    xudk_ctx*       ctx;
+    bool            cached;         // Flush the write-back cache in each run
+} format_case;
+
+static u64 next_lba(sector_case *c) {
+    u64 lba = c->lba;
+    if (c->random) {
+        c->lba = (c->lba * 6364136223846793005ULL + 1442695040888963407ULL);
+        lba = (c->lba >> 16) % (c->disk_sectors - c->sectors);
+    } else {
+        c->lba += c->sectors;
+        if (c->lba + c->sectors > c->disk_sectors) {
+            c->lba = 0;
+        }
+    }
+    return lba;
+}
+
+static void run_read_sectors(void *arg, u64 iterations) {
+    sector_case *c = arg;
+    while (iterations--) {
+        c->ctx->storage.read_sectors(c->ctx, 0, next_lba(c), c->sectors, c->buffer);
+    }
+}
+
+static void run_write_sectors(void *arg, u64 iterations) {
+    sector_case *c = arg;
+    while (iterations--) {
+        c->ctx->storage.write_sectors(c->ctx, 0, next_lba(c), c->sectors, c->buffer);
+    }
+}
+
+static void run_read_queued(void *arg, u64 iterations) {
+    queued_case *c = arg;
+    xudk_ctx *ctx = c->sectors.ctx;
+
+    for (u64 i = 0; i < iterations; i++) {
+        u32 slot = (u32)(i % c->depth);
+        xudk_io_request *request = &c->requests[slot];
+
+        if (i >= c->depth) {
+            xudk_io_wait(ctx, c->queue, request);
+        }
+        xudk_memset(request, 0, sizeof(*request));
+        c->segments[slot].buffer = c->sectors.buffer + (usize)slot * c->sectors.sectors * c->sector_size;
+        c->segments[slot].sectors = c->sectors.sectors;
+        request->lba = next_lba(&c->sectors);
+        request->segments = &c->segments[slot];
+        request->segment_count = 1;
+        xudk_io_submit(ctx, c->queue, request);
+    }
+    xudk_io_wait(ctx, c->queue, null);
+}
+
+static void run_read_stream(void *arg, u64 iterations) {
+    stream_case *c = arg;
+
+    while (iterations--) {
+        xudk_io_stream *stream;
+        usize read;
+
+        if (xudk_error(xudk_io_stream_open(c->ctx, c->queue, 0, c->sectors, 0, &stream))) {
+            return;
+        }
+        do {
+            xudk_io_stream_read(c->ctx, stream, c->buffer, STREAM_READ, &read);
+            xudk_bench_sink += c->buffer[0];
+        } while (read == STREAM_READ);
+        xudk_io_stream_close(c->ctx, stream);
+    }
+}
+
+static void run_format(void *arg, u64 iterations) {
+    format_case *c = arg;
+    while (iterations--) {
+        c->ctx->storage.format_disk(c->ctx, 0, L"FAT32");
+        if (c->cached) {
+            xudk_storage_cache_flush(c->ctx);
+        }
+    }
+}
+
+static void run_load_file(void *arg, u64 iterations) {
+    file_case *c = arg;
+    while (iterations--) {
+        void *data;
+        usize size;
+        if (xudk_ok(c->ctx->filesystem.load_file_to_memory(c->ctx, c->path, &data, &size))) {
+            xudk_bench_sink += size;
+            c->ctx->memory.free(c->ctx, data);
+        }
+    }
+}
+
+static void run_fat32_load_file(void *arg, u64 iterations) {
+    fat32_case *c = arg;
+    while (iterations--) {
+        void *data;
+        usize size;
+        if (c->read_size) {
+            xudk_fat32_file *file;
+            if (xudk_ok(xudk_fat32_open(c->ctx, c->volume, c->path, &file))) {
+                for (u8 *at = c->buffer; xudk_ok(xudk_fat32_read(c->ctx, file, at, c->read_size, &size)) && size;) {
+                    at += size;
+                }
+                xudk_fat32_close(c->ctx, file);
+            }
+        } else if (xudk_ok(xudk_fat32_load_file(c->ctx, c->volume, c->path, &data, &size))) {
+            xudk_bench_sink += size;
+            c->ctx->memory.free(c->ctx, data);
+        }
+    }
+}
+
+static void put32(u8 *p, u32 v) {
+    p[0] = (u8)v;
+    p[1] = (u8)(v >> 8);
+    p[2] = (u8)(v >> 16);
+    p[3] = (u8)(v >> 24);
+}
+
+// Formats disk 0 and writes the initrd to its root in one run of clusters
+// from 3 on, the layout a freshly written ESP gives a file
+static status make_fat32_disk(xudk_ctx *ctx) {
+    usize chunk = 1024 * 1024;
+    u32 bps, spc, reserved, fats, fat_size, clusters, first_fat, last_fat;
+    u8 *buffer = null;
+    u64 data_lba;
+    status s;
+
+    s = ctx->storage.format_disk(ctx, 0, L"FAT32");
+    buffer = xudk_ok(s) ? malloc(chunk) : null;
+    if (!buffer) {
+        return xudk_error(s) ? s : XUDK_OUT_OF_MEMORY;
+    }
+    s = ctx->storage.read_sectors(ctx, 0, 0, 1, buffer);
+    bps = buffer[11] | (buffer[12] << 8);
+    spc = buffer[13];
+    reserved = buffer[14] | (buffer[15] << 8);
+    fats = buffer[16];
+    fat_size = buffer[36] | (buffer[37] << 8) | (buffer[38] << 16) | ((u32)buffer[39] << 24);
+    data_lba = reserved + (u64)fats * fat_size;
+    clusters = (u32)((XUDK_BENCH_INITRD_SIZE + (u64)bps * spc - 1) / ((u64)bps * spc));
+
+    // The chain, in both FATs, a chunk of FAT sectors at a time
+    first_fat = 3 * 4 / bps;
+    last_fat = (3 + clusters) * 4 / bps;
+    for (u32 sector = first_fat; xudk_ok(s) && sector <= last_fat; sector += (u32)(chunk / bps)) {
+        u32 count = last_fat - sector + 1 < chunk / bps ? last_fat - sector + 1 : (u32)(chunk / bps);
+
+        s = ctx->storage.read_sectors(ctx, 0, reserved + sector, count, buffer);
+        for (u32 i = 0; xudk_ok(s) && i < count * bps / 4; i++) {
+            u32 cluster = (sector * bps) / 4 + i;
+            if (cluster >= 3 && cluster < 3 + clusters) {
+                put32(buffer + i * 4, cluster + 1 < 3 + clusters ? cluster + 1 : 0x0FFFFFFF);
+            }
+        }
+        for (u32 f = 0; xudk_ok(s) && f < fats; f++) {
+            s = ctx->storage.write_sectors(ctx, 0, reserved + f * fat_size + sector, count, buffer);
+        }
+    }
+
+    // Its entry in the root directory, cluster 2
+    if (xudk_ok(s)) {
+        xudk_memset(buffer, 0, bps);
+        xudk_memcpy(buffer, "INITRD  IMG", 11);
+        buffer[11] = 0x20;
+        put32(buffer + 26, 3);
+        put32(buffer + 28, XUDK_BENCH_INITRD_SIZE);
+        s = ctx->storage.write_sectors(ctx, 0, data_lba, 1, buffer);
+    }
+
+    // Contents as bench.c writes them to the ESP
+    for (usize at = 0; xudk_ok(s) && at < XUDK_BENCH_INITRD_SIZE; at += chunk) {
+        for (usize i = 0; i < chunk; i++) {
+            buffer[i] = (u8)((at + i) * 131 + ((at + i) >> 12));
+        }
+        s = ctx->storage.write_sectors(ctx, 0, data_lba + spc + at / bps, (u32)(chunk / bps), buffer);
+    }
+    free(buffer);
+    return s;
+}
+
+void xudk_bench_storage(xudk_bench *b) {
+    static const u32 counts[] = { 1, 8, 128, 2048 };
+    xudk_disk_info info;
+    sector_case c;
+    char name[64];
+
+    if (xudk_error(b->ctx->storage.get_disk_info(b->ctx, 0, &info))) {
+        return;
+    }
+    c.ctx = b->ctx;
+    c.disk_sectors = info.total_sectors;
+    c.buffer = malloc((usize)counts[3] * info.sector_size);
+    if (!c.buffer) {
+        return;
+    }
+    xudk_memset(c.buffer, 0x5A, (usize)counts[3] * info.sector_size);
+
+    for (usize i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        u64 bytes = (u64)counts[i] * info.sector_size;
+        c.sectors = counts[i];
+
+        c.lba = 0;
+        c.random = false;
+        snprintf(name, sizeof(name), "write seq %u sectors", counts[i]);
+        xudk_bench_run(b, "storage", name, bytes, run_write_sectors, &c);
+        c.lba = 0;
+        snprintf(name, sizeof(name), "read seq %u sectors", counts[i]);
+        xudk_bench_run(b, "storage", name, bytes, run_read_sectors, &c);
+        c.lba = 1;
+        c.random = true;
+        snprintf(name, sizeof(name), "read random %u sectors", counts[i]);
+        xudk_bench_run(b, "storage", name, bytes, run_read_sectors, &c);
+    }
+    free(c.buffer);
+}
+
+// Queue depth against the same reads issued one at a time above
+void xudk_bench_storage_queued(xudk_bench *b) {
+    static const u32 counts[] = { 8, 256 };
+    static const u32 depths[] = { 1, 4, 16, 32 };
+    xudk_disk_info info;
+    queued_case q;
+    stream_case st;
+    char name[64];
+
+    if (xudk_error(b->ctx->storage.get_disk_info(b->ctx, 0, &info))) {
+        return;
+    }
+    xudk_memset(&q, 0, sizeof(q));
+    q.sectors.ctx = b->ctx;
+    q.sectors.disk_sectors = info.total_sectors;
+    q.sector_size = info.sector_size;
+    q.sectors.buffer = malloc((usize)QUEUED_MAX_DEPTH * counts[1] * info.sector_size);
+    if (!q.sectors.buffer) {
+        return;
+    }
+    for (usize d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+        if (xudk_error(xudk_io_queue_create(b->ctx, 0, depths[d], 0, &q.queue))) {
+            break;
+        }
+        q.depth = depths[d];
+        for (usize i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+            q.sectors.sectors = counts[i];
+            q.sectors.lba = 0;
+            q.sectors.random = false;
+            snprintf(name, sizeof(name), "queued read seq %u sectors QD%u", counts[i], depths[d]);
+            xudk_bench_run(b, "storage", name, (u64)counts[i] * info.sector_size, run_read_queued, &q);
+            q.sectors.lba = 1;
+            q.sectors.random = true;
+            snprintf(name, sizeof(name), "queued read random %u sectors QD%u", counts[i], depths[d]);
+            xudk_bench_run(b, "storage", name, (u64)counts[i] * info.sector_size, run_read_queued, &q);
+        }
+        xudk_io_queue_destroy(b->ctx, q.queue);
+    }
+    free(q.sectors.buffer);
+
+    st.ctx = b->ctx;
+    st.sectors = STREAM_SIZE / info.sector_size;
+    st.buffer = malloc(STREAM_READ);
+    for (usize d = 0; st.buffer && d < sizeof(depths) / sizeof(depths[0]); d++) {
+        if (xudk_error(xudk_io_queue_create(b->ctx, 0, depths[d], 0, &st.queue))) {
+            break;
+        }
+        snprintf(name, sizeof(name), "stream read 32M QD%u", depths[d]);
+        xudk_bench_run(b, "storage", name, STREAM_SIZE, run_read_stream, &st);
+        xudk_io_queue_destroy(b->ctx, st.queue);
+    }
+    free(st.buffer);
+}
+
+// Small IO of the kind partitioning and formatting do, through the block cache
+// and without it. The cached runs include writing the dirty blocks back.
+void xudk_bench_storage_cache(xudk_bench *b) {
+    xudk_disk_info info;
+    sector_case c;
+    format_case f;
+
+    if (xudk_error(b->ctx->storage.get_disk_info(b->ctx, 0, &info))) {
+        return;
+    }
+    c.ctx = b->ctx;
+    c.disk_sectors = CACHE_HOT_SECTORS;
+    c.sectors = 1;
+    c.random = true;
+    c.buffer = malloc(info.sector_size);
+    f.ctx = b->ctx;
+    if (!c.buffer) {
+        return;
+    }
+    f.cached = false;
+    xudk_bench_run(b, "storage", "format_disk FAT32", 0, run_format, &f);
+    c.lba = 1;
+    xudk_bench_run(b, "storage", "read random 1 sector in 1M", info.sector_size, run_read_sectors, &c);
+
+    if (xudk_ok(xudk_storage_cache_open(b->ctx, CACHE_BUDGET, true))) {
+        f.cached = true;
+        xudk_bench_run(b, "storage", "format_disk FAT32 write-back cache", 0, run_format, &f);
+        c.lba = 1;
+        xudk_bench_run(b, "storage", "read random 1 sector in 1M cached", info.sector_size, run_read_sectors, &c);
+        xudk_storage_cache_close(b->ctx);
+    }
+    free(c.buffer);
+}
+
+void xudk_bench_files(xudk_bench *b) {
+    file_case c;
+
+    c.ctx = b->ctx;
+    c.path = L"\\small.bin";
+    xudk_bench_run(b, "files", "load_file_to_memory 64K", 64 * 1024, run_load_file, &c);
+    c.path = L"\\initrd.img";
+    xudk_bench_run(b, "files", "load_file_to_memory 32M", 32 * 1024 * 1024, run_load_file, &c);
+    c.path = L"\\initrd100.img";
+    xudk_bench_run(b, "files", "load_file_to_memory 100M", XUDK_BENCH_INITRD_SIZE, run_load_file, &c);
+}
+
+// The same initrd read natively off a FAT32 disk, against the firmware's file
+// system above. Reading it a cluster at a time is what a driver walking the
+// chain does. Filtered out, the disk is left as it is.
+void xudk_bench_fat32(xudk_bench *b) {
+    fat32_case c;
+    u8 boot[512];
+
+    if (b->filter && !strstr("files/fat32 load_file 100M", b->filter) &&
+        !strstr("files/fat32 read 100M by cluster", b->filter)) {
+        return;
+    }
+    c.ctx = b->ctx;
+    c.path = L"\\initrd.img";
+    c.read_size = 0;
+    c.buffer = malloc(XUDK_BENCH_INITRD_SIZE);
+    if (!c.buffer || xudk_error(make_fat32_disk(b->ctx)) || xudk_error(xudk_fat32_mount(b->ctx, 0, &c.volume))) {
+        free(c.buffer);
+        return;
+    }
+    xudk_bench_run(b, "files", "fat32 load_file 100M", XUDK_BENCH_INITRD_SIZE, run_fat32_load_file, &c);
+    if (xudk_ok(b->ctx->storage.read_sectors(b->ctx, 0, 0, 1, boot))) {
+        c.read_size = (usize)boot[13] * (boot[11] | (boot[12] << 8));
+        xudk_bench_run(b, "files", "fat32 read 100M by cluster", XUDK_BENCH_INITRD_SIZE, run_fat32_load_file, &c);
+    }
+    xudk_fat32_unmount(b->ctx, c.volume);
+    free(c.buffer);
+}
@@ -0,0 +1,251 @@
+/*
+ * XUDK - Benchmarks: memory, checksum and allocator primitives
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "xudk/CORE/core.h"
+
+typedef struct {
+    u8*                     src;
+    u8*                     dst;
+    usize                   size;
+    const xudk_mem_impl*    impl;
+} mem_case;
+
+static void run_memcpy(void *arg, u64 iterations) {
+    mem_case *c = arg;
+    while (iterations--) {
+        c->impl->copy(c->dst, c->src, c->size);
+    }
+    xudk_bench_sink += c->dst[c->size - 1];
+}
+
+static void run_memset(void *arg, u64 iterations) {
+    mem_case *c = arg;
+    while (iterations--) {
+        c->impl->set(c->dst, (u8)iterations, c->size);
+    }
+    xudk_bench_sink += c->dst[0];
+}
+
+static void run_memstream(void *arg, u64 iterations) {
+    mem_case *c = arg;
+    while (iterations--) {
+        c->impl->stream(c->dst, c->src, c->size);
+    }
+    xudk_bench_sink += c->dst[c->size - 1];
+}
+
+// dst holds a copy of src, so every call scans the whole buffer
+static void run_memcmp(void *arg, u64 iterations) {
+    mem_case *c = arg;
+    while (iterations--) {
+        xudk_bench_sink += (u64)c->impl->compare(c->dst, c->src, c->size);
+    }
+}
+
+typedef struct {
+    const u8*                   data;
+    usize                       size;
+    const xudk_crc32_impl*      crc32;
+    const xudk_hash64_impl*     hash64;
+} checksum_case;
+
+static void run_crc32(void *arg, u64 iterations) {
+    checksum_case *c = arg;
+    while (iterations--) {
+        xudk_bench_sink += c->crc32->update(0, c->data, c->size);
+    }
+}
+
+static void run_hash64(void *arg, u64 iterations) {
+    checksum_case *c = arg;
+    while (iterations--) {
+        xudk_bench_sink += c->hash64->hash(c->data, c->size);
+    }
+}
+
+// xudk_hash64 before it became XXH3, kept as the baseline
+static u64 hash64_fnv1a(const void *data, usize size) {
+    const u8 *p = data;
+    u64 hash = 0xCBF29CE484222325ULL;
+
+    while (size--) {
+        hash ^= *p++;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// Image-loading pattern: the streaming API fed in 64 KiB reads
+static void run_hash64_stream(void *arg, u64 iterations) {
+    checksum_case *c = arg;
+    xudk_hash64_state state;
+
+    while (iterations--) {
+        xudk_hash64_init(&state);
+        for (usize offset = 0; offset < c->size; offset += 64 * 1024) {
+            usize chunk = c->size - offset < 64 * 1024 ? c->size - offset : 64 * 1024;
+            xudk_hash64_update(&state, c->data + offset, chunk);
+        }
+        xudk_bench_sink += xudk_hash64_final(&state);
+    }
+}
+
+static void bench_checksums(xudk_bench *b, const u8 *data) {
+    static const usize sizes[] = { 64, 4096, 256 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024 };
+    static const xudk_hash64_impl fnv1a = { "fnv1a", 0, hash64_fnv1a };
+    u32 features = xudk_cpu_features();
+    const xudk_crc32_impl *crc32;
+    const xudk_hash64_impl *hash64;
+    usize crc32_count, hash64_count;
+    checksum_case c;
+    char name[64];
+
+    crc32 = xudk_crc32_impls(&crc32_count);
+    hash64 = xudk_hash64_impls(&hash64_count);
+    c.data = data;
+    for (usize i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        c.size = sizes[i];
+        for (usize k = 0; k < crc32_count; k++) {
+            if ((crc32[k].features & features) == crc32[k].features) {
+                c.crc32 = &crc32[k];
+                snprintf(name, sizeof(name), "crc32 %zu %s", c.size, c.crc32->name);
+                xudk_bench_run(b, "checksum", name, c.size, run_crc32, &c);
+            }
+        }
+        c.hash64 = &fnv1a;
+        snprintf(name, sizeof(name), "hash64 %zu %s", c.size, c.hash64->name);
+        xudk_bench_run(b, "checksum", name, c.size, run_hash64, &c);
+        for (usize k = 0; k < hash64_count; k++) {
+            if ((hash64[k].features & features) == hash64[k].features) {
+                c.hash64 = &hash64[k];
+                snprintf(name, sizeof(name), "hash64 %zu %s", c.size, c.hash64->name);
+                xudk_bench_run(b, "checksum", name, c.size, run_hash64, &c);
+            }
+        }
+        snprintf(name, sizeof(name), "hash64 %zu stream", c.size);
+        xudk_bench_run(b, "checksum", name, c.size, run_hash64_stream, &c);
+    }
+}
+
+// Allocation phase: a few thousand short-lived strings, then release them all
+#define ALLOC_PHASE_COUNT   4096
+
+typedef struct {
+    xudk_ctx*       ctx;
+    xudk_arena*     arena;
+    void**          ptrs;
+} alloc_case;
+
+static usize alloc_phase_size(usize i) {
+    return 16 + (i * 40503u >> 4) % 96;
+}
+
+static void run_alloc_free(void *arg, u64 iterations) {
+    alloc_case *c = arg;
+    while (iterations--) {
+        for (usize i = 0; i < ALLOC_PHASE_COUNT; i++) {
+            c->ptrs[i] = c->ctx->memory.alloc(c->ctx, alloc_phase_size(i));
+        }
+        for (usize i = 0; i < ALLOC_PHASE_COUNT; i++) {
+            c->ctx->memory.free(c->ctx, c->ptrs[i]);
+        }
+    }
+}
+
+// Host libc, the baseline for the slab allocator behind memory.alloc
+static void run_alloc_libc(void *arg, u64 iterations) {
+    alloc_case *c = arg;
+    while (iterations--) {
+        for (usize i = 0; i < ALLOC_PHASE_COUNT; i++) {
+            c->ptrs[i] = malloc(alloc_phase_size(i));
+        }
+        for (usize i = 0; i < ALLOC_PHASE_COUNT; i++) {
+            free(c->ptrs[i]);
+        }
+    }
+}
+
+static void run_alloc_arena(void *arg, u64 iterations) {
+    alloc_case *c = arg;
+    while (iterations--) {
+        for (usize i = 0; i < ALLOC_PHASE_COUNT; i++) {
+            c->ptrs[i] = c->ctx->memory.arena_alloc(c->ctx, c->arena, alloc_phase_size(i), 0);
+        }
+        c->ctx->memory.arena_reset(c->ctx, c->arena);
+    }
+}
+
+static void bench_allocators(xudk_bench *b) {
+    alloc_case c;
+
+    c.ctx = b->ctx;
+    c.ptrs = malloc(ALLOC_PHASE_COUNT * sizeof(void*));
+    if (!c.ptrs || xudk_error(c.ctx->memory.arena_create(c.ctx, 0, &c.arena))) {
+        free(c.ptrs);
+        return;
+    }
+    xudk_bench_run(b, "alloc", "phase 4096 libc malloc/free", 0, run_alloc_libc, &c);
+    xudk_bench_run(b, "alloc", "phase 4096 alloc/free", 0, run_alloc_free, &c);
+    xudk_bench_run(b, "alloc", "phase 4096 arena", 0, run_alloc_arena, &c);
+    c.ctx->memory.arena_destroy(c.ctx, c.arena);
+    free(c.ptrs);
+}
+
+// Size buckets from struct copies up to initrd-sized moves; the last two
+// are above XUDK_MEM_STREAM_THRESHOLD and use non-temporal stores
+static const usize mem_sizes[] = {
+    16, 64, 256, 1024, 4096, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024
+};
+
+#define MEM_MAX_SIZE    (64 * 1024 * 1024)
+
+void xudk_bench_memory(xudk_bench *b) {
+    u32 features = xudk_cpu_features();
+    const xudk_mem_impl *impls;
+    usize impl_count;
+    mem_case c;
+    char name[64];
+
+    c.src = malloc(MEM_MAX_SIZE);
+    c.dst = malloc(MEM_MAX_SIZE);
+    if (!c.src || !c.dst) {
+        free(c.src);
+        free(c.dst);
+        return;
+    }
+    for (usize i = 0; i < MEM_MAX_SIZE; i++) {
+        c.src[i] = (u8)(i * 7);
+    }
+
+    impls = xudk_mem_impls(&impl_count);
+    for (usize i = 0; i < sizeof(mem_sizes) / sizeof(mem_sizes[0]); i++) {
+        c.size = mem_sizes[i];
+        for (usize k = 0; k < impl_count; k++) {
+            if ((impls[k].features & features) != impls[k].features) {
+                continue;
+            }
+            c.impl = &impls[k];
+            snprintf(name, sizeof(name), "memcpy %zu %s", c.size, c.impl->name);
+            xudk_bench_run(b, "memory", name, c.size, run_memcpy, &c);
+            snprintf(name, sizeof(name), "memstream %zu %s", c.size, c.impl->name);
+            xudk_bench_run(b, "memory", name, c.size, run_memstream, &c);
+            snprintf(name, sizeof(name), "memset %zu %s", c.size, c.impl->name);
+            xudk_bench_run(b, "memory", name, c.size, run_memset, &c);
+            c.impl->copy(c.dst, c.src, c.size);
+            snprintf(name, sizeof(name), "memcmp %zu %s", c.size, c.impl->name);
+            xudk_bench_run(b, "memory", name, c.size, run_memcmp, &c);
+        }
+    }
+    bench_checksums(b, c.src);
+    bench_allocators(b);
+
+    free(c.src);
+    free(c.dst);
+}
@@ -5,6 +5,7 @@ typedef struct {
     status (*mount_volume)(xudk_ctx *ctx, handle device, xudk_volume_info *info);
     status (*unmount_volume)(xudk_ctx *ctx, handle volume);
     status (*open_file)(xudk_ctx *ctx, const wchar *path, handle *file);
+    status (*create_file)(xudk_ctx *ctx, const wchar *path, handle *file);  // Create or truncate
     status (*close_file)(xudk_ctx *ctx, handle file);
     status (*read_file)(xudk_ctx *ctx, handle file, void *buffer, usize size, usize *read);
     status (*write_file)(xudk_ctx *ctx, handle file, const void *buffer, usize size, usize *written);
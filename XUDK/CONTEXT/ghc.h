@@ -10,6 +10,19 @@ typedef struct {
     status (*draw_text)(xudk_ctx *ctx, u32 x, u32 y, const wchar *text, u32 color);
     status (*load_bitmap)(xudk_ctx *ctx, const wchar *path, u32 x, u32 y);
     status (*copy_buffer)(xudk_ctx *ctx, const void *buffer, u32 x, u32 y, u32 width, u32 height);
+    status (*get_mode)(xudk_ctx *ctx, xudk_graphics_mode *mode);  // Current mode
+
+    // Batched drawing, one call per list; entries are clipped and may blend
+    status (*fill_spans)(xudk_ctx *ctx, const xudk_span *spans, usize count);
+    status (*fill_rects)(xudk_ctx *ctx, const xudk_fill_rect *rects, usize count);
+    status (*plot_points)(xudk_ctx *ctx, const xudk_point *points, usize count);
+    status (*draw_text_runs)(xudk_ctx *ctx, const xudk_font *font, const xudk_text_run *runs, usize count);
+
+    // Back buffer: while enabled, drawing (and get_framebuffer memory) is in system RAM
+    // and present copies only the damaged regions to the screen
+    status (*enable_back_buffer)(xudk_ctx *ctx, bool enable);
+    status (*invalidate)(xudk_ctx *ctx, u32 x, u32 y, u32 width, u32 height);  // After writing pixels directly
+    status (*present)(xudk_ctx *ctx);
 } xudk_graphics;
 
 // GPU Management - Hardware Accelerated Graphics
@@ -61,6 +74,10 @@ typedef struct {
     status (*end_recording)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer);
     status (*submit_command_buffer)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer);
     status (*wait_for_completion)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer);
+    status (*execute_commands)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 count,
+                              xudk_gpu_cmd_buffer **secondaries);  // Replay recorded secondaries from a primary
+    status (*submit_and_signal)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_fence *fence,
+                               u64 value);  // Fence reaches value once the work is done, failed or not
     
     // Render Pass Management
     status (*begin_render_pass)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_render_pass *render_pass);
@@ -82,14 +99,47 @@ typedef struct {
     // Compute Commands
     status (*dispatch)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 group_count_x, u32 group_count_y, u32 group_count_z);
     
+    // Transfer Commands (outside render passes, on graphics or compute command buffers)
+    status (*copy_buffer)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_buffer *src, u64 src_offset,
+                         xudk_gpu_buffer *dst, u64 dst_offset, u64 size);
+    status (*copy_buffer_to_texture)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_buffer *src,
+                                    u64 src_offset, u64 size, xudk_gpu_texture *texture, u32 mip_level,
+                                    u32 array_slice);  // Source laid out as for upload_texture_data
+    
     // Resource Binding
     status (*bind_descriptor_set)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 set_index, 
                                  handle descriptor_set);
+    status (*create_descriptor_layout)(xudk_ctx *ctx, const xudk_gpu_descriptor_binding *bindings, u32 count,
+                                      xudk_gpu_descriptor_layout *layout);
+    status (*destroy_descriptor_layout)(xudk_ctx *ctx, xudk_gpu_descriptor_layout *layout);
+    status (*create_descriptor_set)(xudk_ctx *ctx, xudk_gpu_descriptor_layout *layout,
+                                   handle *descriptor_set);  // Every binding starts empty
+    status (*update_descriptor_set)(xudk_ctx *ctx, handle descriptor_set, u32 count,
+                                   const xudk_gpu_descriptor_write *writes);
+    status (*destroy_descriptor_set)(xudk_ctx *ctx, handle descriptor_set);
     status (*push_constants)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 offset, u32 size, const void *data);
     
     // Synchronization
-    status (*insert_barrier)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer);
+    status (*insert_barrier)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer);  // Full pipeline flush
+    status (*resource_barrier)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 count,
+                              const xudk_gpu_barrier *barriers);  // Only what these transitions need
     status (*wait_idle)(xudk_ctx *ctx);
+    status (*create_fence)(xudk_ctx *ctx, u64 initial_value, xudk_gpu_fence *fence);
+    status (*destroy_fence)(xudk_ctx *ctx, xudk_gpu_fence *fence);
+    status (*get_fence_value)(xudk_ctx *ctx, xudk_gpu_fence *fence, u64 *value);  // Never blocks
+    status (*wait_fence)(xudk_ctx *ctx, xudk_gpu_fence *fence, u64 value);        // Until it reaches value
+    
+    // Queries
+    status (*create_query_pool)(xudk_ctx *ctx, xudk_query_type type, u32 count, xudk_gpu_query_pool *pool);
+    status (*destroy_query_pool)(xudk_ctx *ctx, xudk_gpu_query_pool *pool);
+    status (*reset_queries)(xudk_ctx *ctx, xudk_gpu_query_pool *pool, u32 first,
+                           u32 count);  // From the CPU, once no submitted work uses them
+    status (*write_timestamp)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_query_pool *pool,
+                             u32 index);  // Once all earlier work has finished
+    status (*begin_query)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_query_pool *pool, u32 index);
+    status (*end_query)(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_query_pool *pool, u32 index);
+    status (*get_query_results)(xudk_ctx *ctx, xudk_gpu_query_pool *pool, u32 first, u32 count,
+                               void *results);  // u64 ticks or xudk_gpu_pipeline_statistics each; XUDK_NOT_READY until all are written
     
     // Utility Functions
     status (*present_to_screen)(xudk_ctx *ctx, xudk_gpu_texture *texture);
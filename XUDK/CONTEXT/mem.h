@@ -11,4 +11,15 @@ typedef struct {
     status (*set_virtual_map)(xudk_ctx *ctx, xudk_mem_map *map);
     u64    (*get_total_memory)(xudk_ctx *ctx);
     u64    (*get_free_memory)(xudk_ctx *ctx);
+
+    // Arenas: O(1) alloc, mark/rollback and reset; chunk_size 0 = 64 KiB
+    status (*arena_create)(xudk_ctx *ctx, usize chunk_size, xudk_arena **arena);
+    void*  (*arena_alloc)(xudk_ctx *ctx, xudk_arena *arena, usize size, usize alignment);
+    xudk_arena_mark (*arena_mark)(xudk_ctx *ctx, xudk_arena *arena);
+    void   (*arena_rollback)(xudk_ctx *ctx, xudk_arena *arena, xudk_arena_mark mark);
+    void   (*arena_reset)(xudk_ctx *ctx, xudk_arena *arena);  // Keeps the chunks for reuse
+    void   (*arena_destroy)(xudk_ctx *ctx, xudk_arena *arena);
+
+    // Slab allocator counters for alloc/free
+    void   (*get_stats)(xudk_ctx *ctx, xudk_mem_stats *stats);
 } xudk_memory;
\ No newline at end of file
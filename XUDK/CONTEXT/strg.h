@@ -8,4 +8,12 @@ typedef struct {
     status (*get_disk_info)(xudk_ctx *ctx, u32 disk_id, xudk_disk_info *info);
     status (*format_disk)(xudk_ctx *ctx, u32 disk_id, const wchar *filesystem);
     status (*create_partition)(xudk_ctx *ctx, u32 disk_id, u64 start, u64 size, u8 type);
+
+    // Queued transfers (Block IO 2): the call returns once the transfer is queued, and any
+    // number may be in flight. complete_io reports XUDK_NOT_READY while it is, unless
+    // `wait`; then the transfer's status, after which the token is free again. Every
+    // queued transfer must be completed, and its buffer left alone until then.
+    status (*read_sectors_async)(xudk_ctx *ctx, u32 disk_id, u64 lba, u32 count, void *buffer, xudk_io_token *token);
+    status (*write_sectors_async)(xudk_ctx *ctx, u32 disk_id, u64 lba, u32 count, const void *buffer, xudk_io_token *token);
+    status (*complete_io)(xudk_ctx *ctx, xudk_io_token *token, bool wait);
 } xudk_storage;
\ No newline at end of file
@@ -12,4 +12,15 @@ typedef struct {
     status (*set_variable)(xudk_ctx *ctx, const wchar *name, const wchar *vendor, const void *data, usize size);
     status (*enable_interrupt)(xudk_ctx *ctx, u32 vector);
     status (*disable_interrupt)(xudk_ctx *ctx, u32 vector);
+    status (*run_on_all_processors)(xudk_ctx *ctx, void (*procedure)(void *argument), void *argument);  // Caller included, blocks until all return
+
+    // Timer events. set_timer fires `nanoseconds` from now, then every `nanoseconds` when periodic
+    // (firings missed while not waiting count once); 0 cancels, and any firing not yet waited for is
+    // dropped. wait_for_timer halts the processor until the timer fires, XUDK_OK, or with
+    // `key_wakes` a key is pressed first, XUDK_NOT_READY; the key stays to be read. Waiting on a
+    // timer that is not set, without `key_wakes`, returns XUDK_NOT_READY at once.
+    status (*create_timer)(xudk_ctx *ctx, handle *timer);
+    status (*set_timer)(xudk_ctx *ctx, handle timer, u64 nanoseconds, bool periodic);
+    status (*wait_for_timer)(xudk_ctx *ctx, handle timer, bool key_wakes);
+    status (*close_timer)(xudk_ctx *ctx, handle timer);
 } xudk_system;
@@ -0,0 +1,159 @@
+/*
+ * XUDK - Arena allocator
+ * Bump allocation out of page-granular chunks from memory.alloc_type. Only the
+ * current chunk and offset describe the fill level, so mark, rollback and
+ * reset are O(1); chunks past the current one stay linked and get reused.
+ */
+
+#include "core.h"
+
+#define ARENA_PAGE_SIZE         4096
+#define ARENA_DEFAULT_CHUNK     (64 * 1024)
+#define ARENA_DEFAULT_ALIGN     16
+
+struct xudk_arena_chunk {
+    xudk_arena_chunk*   next;
+    usize               size;       // Whole chunk, header included
+};
+
+#define ARENA_HEADER_SIZE       ((sizeof(xudk_arena_chunk) + 15) & ~(usize)15)
+#define ARENA_FIRST_OFFSET      (ARENA_HEADER_SIZE + ((sizeof(xudk_arena) + 15) & ~(usize)15))
+
+static xudk_arena_chunk* arena_new_chunk(xudk_ctx *ctx, xudk_arena *arena, usize size) {
+    xudk_arena_chunk *chunk;
+
+    size = (usize)xudk_align_up(size, ARENA_PAGE_SIZE);
+    chunk = ctx->memory.alloc_type(ctx, size, XUDK_MEM_LOADER_DATA);
+    if (!chunk) {
+        return null;
+    }
+    chunk->next = null;
+    chunk->size = size;
+    if (arena) {
+        arena->reserved += size;
+    }
+    return chunk;
+}
+
+static status arena_create(xudk_ctx *ctx, usize chunk_size, xudk_arena **arena) {
+    xudk_arena_chunk *chunk;
+    xudk_arena *a;
+
+    if (!arena || chunk_size > (usize)-ARENA_PAGE_SIZE) {
+        return XUDK_INVALID_PARAM;
+    }
+    chunk_size = (usize)xudk_align_up(chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK, ARENA_PAGE_SIZE);
+    chunk = arena_new_chunk(ctx, null, chunk_size);
+    if (!chunk) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+
+    a = (xudk_arena*)((u8*)chunk + ARENA_HEADER_SIZE);
+    a->first = chunk;
+    a->current = chunk;
+    a->offset = ARENA_FIRST_OFFSET;
+    a->chunk_size = chunk_size;
+    a->reserved = chunk->size;
+    *arena = a;
+    return XUDK_OK;
+}
+
+static usize arena_fit(const xudk_arena_chunk *chunk, usize offset, usize size, usize alignment) {
+    usize start = (usize)xudk_align_up((usize)chunk + offset, alignment) - (usize)chunk;
+    return start <= chunk->size && size <= chunk->size - start ? start : 0;
+}
+
+// Slow path: move on to the next chunk that fits, or link a new one after current
+static void* arena_grow(xudk_ctx *ctx, xudk_arena *arena, usize size, usize alignment) {
+    xudk_arena_chunk *chunk = arena->current->next;
+    usize start = chunk ? arena_fit(chunk, ARENA_HEADER_SIZE, size, alignment) : 0;
+
+    if (!start) {
+        usize need = ARENA_HEADER_SIZE + alignment + size;
+        if (need < size) {
+            return null;
+        }
+        chunk = arena_new_chunk(ctx, arena, need > arena->chunk_size ? need : arena->chunk_size);
+        if (!chunk) {
+            return null;
+        }
+        chunk->next = arena->current->next;
+        arena->current->next = chunk;
+        start = arena_fit(chunk, ARENA_HEADER_SIZE, size, alignment);
+    }
+    arena->current = chunk;
+    arena->offset = start + size;
+    return (u8*)chunk + start;
+}
+
+static void* arena_alloc(xudk_ctx *ctx, xudk_arena *arena, usize size, usize alignment) {
+    usize start;
+
+    if (!arena || (alignment & (alignment - 1))) {
+        return null;
+    }
+    if (alignment < ARENA_DEFAULT_ALIGN) {
+        alignment = ARENA_DEFAULT_ALIGN;
+    }
+    start = arena_fit(arena->current, arena->offset, size, alignment);
+    if (!start) {
+        return arena_grow(ctx, arena, size, alignment);
+    }
+    arena->offset = start + size;
+    return (u8*)arena->current + start;
+}
+
+static xudk_arena_mark arena_mark(xudk_ctx *ctx, xudk_arena *arena) {
+    xudk_arena_mark mark;
+
+    (void)ctx;
+    mark.chunk = arena->current;
+    mark.offset = arena->offset;
+    return mark;
+}
+
+static void arena_rollback(xudk_ctx *ctx, xudk_arena *arena, xudk_arena_mark mark) {
+    (void)ctx;
+    if (mark.chunk) {
+        arena->current = mark.chunk;
+        arena->offset = mark.offset;
+    }
+}
+
+static void arena_reset(xudk_ctx *ctx, xudk_arena *arena) {
+    (void)ctx;
+    arena->current = arena->first;
+    arena->offset = ARENA_FIRST_OFFSET;
+}
+
+static void arena_destroy(xudk_ctx *ctx, xudk_arena *arena) {
+    xudk_arena_chunk *chunk, *next;
+
+    if (!arena) {
+        return;
+    }
+    // The arena lives in the first chunk, so that one goes last
+    for (chunk = arena->first->next; chunk; chunk = next) {
+        next = chunk->next;
+        ctx->memory.free(ctx, chunk);
+    }
+    ctx->memory.free(ctx, arena->first);
+}
+
+wchar* xudk_arena_strdup(xudk_ctx *ctx, xudk_arena *arena, const wchar *src) {
+    usize size = (xudk_strlen(src) + 1) * sizeof(wchar);
+    wchar *dst = arena_alloc(ctx, arena, size, sizeof(wchar));
+    if (dst) {
+        xudk_memcpy(dst, src, size);
+    }
+    return dst;
+}
+
+void xudk_arena_install(xudk_memory *memory) {
+    memory->arena_create = arena_create;
+    memory->arena_alloc = arena_alloc;
+    memory->arena_mark = arena_mark;
+    memory->arena_rollback = arena_rollback;
+    memory->arena_reset = arena_reset;
+    memory->arena_destroy = arena_destroy;
+}
@@ -0,0 +1,1008 @@
+/*
+ * XUDK - BCn block compression
+ * BC1-BC5 and BC7 encoding for asset preparation, and decoding for backends
+ * that cannot sample compressed textures. Every 4x4 block stands alone, so
+ * both directions hand out block rows to all processors. The encoder spends
+ * its time matching 16 pixels against candidate palettes; that kernel has
+ * SSE2 and AVX2 versions.
+ */
+
+#include "core.h"
+
+#if XUDK_X86
+#include <immintrin.h>
+#endif
+
+#define BCN_PARALLEL_BLOCKS     1024    // Smaller images are coded on the caller alone
+#define BCN_REFINE_PASSES       2
+
+// BC7 modes as laid out in the bitstream
+typedef struct {
+    u8              subsets;
+    u8              partition_bits;
+    u8              rotation_bits;
+    u8              selector_bits;
+    u8              color_bits;
+    u8              alpha_bits;
+    u8              endpoint_pbits;
+    u8              shared_pbits;
+    u8              index_bits;
+    u8              index2_bits;
+} bc7_mode;
+
+static const bc7_mode bc7_modes[8] = {
+    { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+    { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+    { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+    { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+    { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+    { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+    { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+    { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+// Subset of each pixel: one bit per pixel for two subsets, two bits for three
+static const u16 bc7_partitions2[64] = {
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+    0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+    0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+    0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+    0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+    0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+static const u32 bc7_partitions3[64] = {
+    0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+    0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+    0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+    0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+    0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+    0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+    0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+    0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+};
+
+// Pixel whose index drops its top bit, for the second and third subsets
+static const u8 bc7_anchors2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+     6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+};
+
+static const u8 bc7_anchors3[2][64] = {
+    {
+         3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+         3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+         8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+         3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+    },
+    {
+        15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+        15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+        15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+        15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+    },
+};
+
+// Interpolation weights out of 64 for 2-, 3- and 4-bit indices
+static const u8 bc7_weights2[4] = { 0, 21, 43, 64 };
+static const u8 bc7_weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const u8 bc7_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+typedef struct {
+    const xudk_bcn_impl*    kernels;
+    xudk_texture_format     format;
+    bool                    encode;
+    const u8*               src;
+    u8*                     dst;
+    u32                     width;
+    u32                     height;
+    u32                     blocks_x;
+    u32                     blocks_y;
+    u32                     block_size;
+    u32                     next;           // Next block row to hand out
+} bcn_job;
+
+// =============================================================================
+// PALETTE MATCHING
+// =============================================================================
+
+// Per pixel, the nearest palette entry over the channels in `mask`; returns
+// the summed squared error. Ties go to the lower index in every version.
+static u32 select_scalar(const u32 *pixels, const u32 *palette, u32 palette_count, u32 mask, u8 *indices) {
+    u32 total = 0;
+
+    for (u32 i = 0; i < 16; i++) {
+        u32 p = pixels[i] & mask, best = ~0u, best_index = 0;
+
+        for (u32 k = 0; k < palette_count; k++) {
+            u32 q = palette[k] & mask, d = 0;
+            for (u32 c = 0; c < 32; c += 8) {
+                i32 e = (i32)((p >> c) & 0xFF) - (i32)((q >> c) & 0xFF);
+                d += (u32)(e * e);
+            }
+            if (d < best) {
+                best = d;
+                best_index = k;
+            }
+        }
+        indices[i] = (u8)best_index;
+        total += best;
+    }
+    return total;
+}
+
+#if XUDK_X86
+
+// Squared distance of four pixels to one palette entry, as 32-bit lanes
+static XUDK_TARGET("sse2") __m128i distance4_sse2(__m128i p, __m128i q) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(p, zero), _mm_unpacklo_epi8(q, zero));
+    __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(p, zero), _mm_unpackhi_epi8(q, zero));
+    __m128 l = _mm_castsi128_ps(_mm_madd_epi16(lo, lo));
+    __m128 h = _mm_castsi128_ps(_mm_madd_epi16(hi, hi));
+
+    return _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(l, h, _MM_SHUFFLE(2, 0, 2, 0))),
+                         _mm_castps_si128(_mm_shuffle_ps(l, h, _MM_SHUFFLE(3, 1, 3, 1))));
+}
+
+static XUDK_TARGET("sse2") u32 select_sse2(const u32 *pixels, const u32 *palette, u32 palette_count,
+                                           u32 mask, u8 *indices) {
+    __m128i m = _mm_set1_epi32((int)mask);
+    __m128i px[4], best[4], index[4], sum;
+
+    for (u32 j = 0; j < 4; j++) {
+        px[j] = _mm_and_si128(_mm_loadu_si128((const __m128i*)(pixels + j * 4)), m);
+        best[j] = _mm_set1_epi32(0x7FFFFFFF);
+        index[j] = _mm_setzero_si128();
+    }
+    for (u32 k = 0; k < palette_count; k++) {
+        __m128i q = _mm_set1_epi32((int)(palette[k] & mask));
+        __m128i kv = _mm_set1_epi32((int)k);
+
+        for (u32 j = 0; j < 4; j++) {
+            __m128i d = distance4_sse2(px[j], q);
+            __m128i lt = _mm_cmplt_epi32(d, best[j]);
+            best[j] = _mm_or_si128(_mm_and_si128(lt, d), _mm_andnot_si128(lt, best[j]));
+            index[j] = _mm_or_si128(_mm_and_si128(lt, kv), _mm_andnot_si128(lt, index[j]));
+        }
+    }
+    _mm_storeu_si128((__m128i*)indices, _mm_packus_epi16(_mm_packs_epi32(index[0], index[1]),
+                                                          _mm_packs_epi32(index[2], index[3])));
+    sum = _mm_add_epi32(_mm_add_epi32(best[0], best[1]), _mm_add_epi32(best[2], best[3]));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (u32)_mm_cvtsi128_si32(sum);
+}
+
+// Same as the SSE2 version, eight pixels per register; the unpacks stay within
+// each 128-bit lane, so the lanes come out in pixel order
+static XUDK_TARGET("avx2") __m256i distance8_avx2(__m256i p, __m256i q) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i lo = _mm256_sub_epi16(_mm256_unpacklo_epi8(p, zero), _mm256_unpacklo_epi8(q, zero));
+    __m256i hi = _mm256_sub_epi16(_mm256_unpackhi_epi8(p, zero), _mm256_unpackhi_epi8(q, zero));
+    __m256 l = _mm256_castsi256_ps(_mm256_madd_epi16(lo, lo));
+    __m256 h = _mm256_castsi256_ps(_mm256_madd_epi16(hi, hi));
+
+    return _mm256_add_epi32(_mm256_castps_si256(_mm256_shuffle_ps(l, h, _MM_SHUFFLE(2, 0, 2, 0))),
+                            _mm256_castps_si256(_mm256_shuffle_ps(l, h, _MM_SHUFFLE(3, 1, 3, 1))));
+}
+
+static XUDK_TARGET("avx2") u32 select_avx2(const u32 *pixels, const u32 *palette, u32 palette_count,
+                                           u32 mask, u8 *indices) {
+    __m256i m = _mm256_set1_epi32((int)mask);
+    __m256i p0 = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)pixels), m);
+    __m256i p1 = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(pixels + 8)), m);
+    __m256i best0 = _mm256_set1_epi32(0x7FFFFFFF), best1 = best0;
+    __m256i index0 = _mm256_setzero_si256(), index1 = index0;
+    __m128i sum;
+
+    for (u32 k = 0; k < palette_count; k++) {
+        __m256i q = _mm256_set1_epi32((int)(palette[k] & mask));
+        __m256i kv = _mm256_set1_epi32((int)k);
+        __m256i d0 = distance8_avx2(p0, q), d1 = distance8_avx2(p1, q);
+        __m256i lt0 = _mm256_cmpgt_epi32(best0, d0), lt1 = _mm256_cmpgt_epi32(best1, d1);
+
+        best0 = _mm256_blendv_epi8(best0, d0, lt0);
+        best1 = _mm256_blendv_epi8(best1, d1, lt1);
+        index0 = _mm256_blendv_epi8(index0, kv, lt0);
+        index1 = _mm256_blendv_epi8(index1, kv, lt1);
+    }
+    _mm_storeu_si128((__m128i*)indices,
+                     _mm_packus_epi16(_mm_packs_epi32(_mm256_castsi256_si128(index0), _mm256_extracti128_si256(index0, 1)),
+                                      _mm_packs_epi32(_mm256_castsi256_si128(index1), _mm256_extracti128_si256(index1, 1))));
+    best0 = _mm256_add_epi32(best0, best1);
+    sum = _mm_add_epi32(_mm256_castsi256_si128(best0), _mm256_extracti128_si256(best0, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (u32)_mm_cvtsi128_si32(sum);
+}
+
+#endif
+
+// =============================================================================
+// ENDPOINT FITTING
+// =============================================================================
+
+static u32 channel(u32 pixel, u32 c) {
+    return (pixel >> (c * 8)) & 0xFF;
+}
+
+static float clamp255(float v) {
+    return v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v);
+}
+
+// Mean and dominant direction of the pixels set in `active`, over the first
+// `channels` channels, then the extremes of their projections onto it
+static void fit_axis(const u32 *px, u32 active, u32 channels, float lo[4], float hi[4]) {
+    float mean[4] = { 0 }, axis[4] = { 1, 1, 1, 1 }, cov[4][4] = { { 0 } };
+    float n = 0, axis_len = 0, t_min = 0, t_max = 0;
+    u32 widest = 0;
+
+    for (u32 i = 0; i < 16; i++) {
+        if (active & (1u << i)) {
+            for (u32 c = 0; c < channels; c++) {
+                mean[c] += (float)channel(px[i], c);
+            }
+            n++;
+        }
+    }
+    for (u32 c = 0; c < channels; c++) {
+        mean[c] /= n;
+    }
+    for (u32 i = 0; i < 16; i++) {
+        if (active & (1u << i)) {
+            for (u32 a = 0; a < channels; a++) {
+                float da = (float)channel(px[i], a) - mean[a];
+                for (u32 b = 0; b < channels; b++) {
+                    cov[a][b] += da * ((float)channel(px[i], b) - mean[b]);
+                }
+            }
+        }
+    }
+
+    // Power iteration from the column of the widest channel, rescaled by the
+    // largest component so no sqrt is needed
+    for (u32 c = 1; c < channels; c++) {
+        if (cov[c][c] > cov[widest][widest]) {
+            widest = c;
+        }
+    }
+    if (cov[widest][widest] > 0.0f) {
+        for (u32 a = 0; a < channels; a++) {
+            axis[a] = cov[a][widest];
+        }
+    }
+    for (u32 iter = 0; iter < 8; iter++) {
+        float next[4] = { 0 }, scale = 0;
+        for (u32 a = 0; a < channels; a++) {
+            for (u32 b = 0; b < channels; b++) {
+                next[a] += cov[a][b] * axis[b];
+            }
+            if (next[a] > scale || -next[a] > scale) {
+                scale = next[a] > 0 ? next[a] : -next[a];
+            }
+        }
+        if (scale == 0.0f) {
+            break;
+        }
+        for (u32 a = 0; a < channels; a++) {
+            axis[a] = next[a] / scale;
+        }
+    }
+    for (u32 c = 0; c < channels; c++) {
+        axis_len += axis[c] * axis[c];
+    }
+
+    for (u32 i = 0, first = 1; i < 16; i++) {
+        float t = 0;
+        if (!(active & (1u << i))) {
+            continue;
+        }
+        for (u32 c = 0; c < channels; c++) {
+            t += ((float)channel(px[i], c) - mean[c]) * axis[c];
+        }
+        if (first || t < t_min) {
+            t_min = t;
+        }
+        if (first || t > t_max) {
+            t_max = t;
+        }
+        first = 0;
+    }
+    if (axis_len > 0.0f) {
+        t_min /= axis_len;
+        t_max /= axis_len;
+    }
+    for (u32 c = 0; c < 4; c++) {
+        lo[c] = c < channels ? clamp255(mean[c] + axis[c] * t_min) : 255.0f;
+        hi[c] = c < channels ? clamp255(mean[c] + axis[c] * t_max) : 255.0f;
+    }
+}
+
+// Least-squares endpoints for fixed indices; weights[i] is the share of `b`.
+// Leaves the endpoints alone when every pixel sits on one weight.
+static void refine_endpoints(const u32 *px, u32 active, u32 channels, const u8 *indices,
+                             const float *weights, float a[4], float b[4]) {
+    float aa = 0, bb = 0, ab = 0, ax[4] = { 0 }, bx[4] = { 0 }, det;
+
+    for (u32 i = 0; i < 16; i++) {
+        float w = weights[indices[i]], iw = 1.0f - w;
+        if (!(active & (1u << i))) {
+            continue;
+        }
+        aa += iw * iw;
+        bb += w * w;
+        ab += iw * w;
+        for (u32 c = 0; c < channels; c++) {
+            ax[c] += iw * (float)channel(px[i], c);
+            bx[c] += w * (float)channel(px[i], c);
+        }
+    }
+    det = aa * bb - ab * ab;
+    if (det < 1e-4f) {
+        return;
+    }
+    for (u32 c = 0; c < channels; c++) {
+        a[c] = clamp255((ax[c] * bb - bx[c] * ab) / det);
+        b[c] = clamp255((bx[c] * aa - ax[c] * ab) / det);
+    }
+}
+
+// =============================================================================
+// BC1 COLOR AND BC4 CHANNEL BLOCKS
+// =============================================================================
+
+static u16 pack565(const float c[4]) {
+    u32 r = (u32)(c[0] * 31.0f / 255.0f + 0.5f);
+    u32 g = (u32)(c[1] * 63.0f / 255.0f + 0.5f);
+    u32 b = (u32)(c[2] * 31.0f / 255.0f + 0.5f);
+    return (u16)((r << 11) | (g << 5) | b);
+}
+
+static u32 unpack565(u32 c) {
+    u32 r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    return ((r << 3) | (r >> 2)) | (((g << 2) | (g >> 4)) << 8) | (((b << 3) | (b >> 2)) << 16) | 0xFF000000u;
+}
+
+// (a * wa + b * wb) / sum per channel
+static u32 mix(u32 a, u32 b, u32 wa, u32 wb) {
+    u32 out = 0;
+    for (u32 c = 0; c < 4; c++) {
+        out |= ((channel(a, c) * wa + channel(b, c) * wb) / (wa + wb)) << (c * 8);
+    }
+    return out;
+}
+
+// Four colors when c0 > c1 or when the format has no punch-through alpha
+static void color_palette(u32 c0, u32 c1, bool four, u32 palette[4]) {
+    palette[0] = unpack565(c0);
+    palette[1] = unpack565(c1);
+    if (four || c0 > c1) {
+        palette[2] = mix(palette[0], palette[1], 2, 1);
+        palette[3] = mix(palette[0], palette[1], 1, 2);
+    } else {
+        palette[2] = mix(palette[0], palette[1], 1, 1);
+        palette[3] = 0;
+    }
+}
+
+// `opaque` marks the pixels to fit; BC1 switches to three colors plus
+// transparent black when some are missing
+static void encode_color(const xudk_bcn_impl *kernels, const u32 *px, u32 opaque, bool punch_through, u8 *out) {
+    static const float weights4[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    static const float weights3[3] = { 0.0f, 1.0f, 0.5f };
+    bool three = punch_through && opaque != 0xFFFF;
+    u32 fit[16], palette[4], best_error = ~0u, bits = 0, filler = 0;
+    u8 indices[16], best_indices[16];
+    u16 best0 = 0, best1 = 0;
+    float e0[4], e1[4];
+
+    if (!opaque) {
+        out[0] = out[1] = out[2] = out[3] = 0;
+        out[4] = out[5] = out[6] = out[7] = 0xFF;
+        return;
+    }
+    // Transparent pixels stand in as a copy of an opaque one while matching
+    for (u32 i = 0; i < 16; i++) {
+        if (opaque & (1u << i)) {
+            filler = px[i];
+            break;
+        }
+    }
+    for (u32 i = 0; i < 16; i++) {
+        fit[i] = opaque & (1u << i) ? px[i] : filler;
+    }
+
+    fit_axis(px, opaque, 3, e1, e0);
+    for (u32 pass = 0; pass <= BCN_REFINE_PASSES; pass++) {
+        u16 c0 = pack565(e0), c1 = pack565(e1);
+        u32 error;
+
+        if (three ? c0 > c1 : c0 < c1) {
+            u16 t = c0;
+            c0 = c1;
+            c1 = t;
+            for (u32 c = 0; c < 4; c++) {
+                float f = e0[c];
+                e0[c] = e1[c];
+                e1[c] = f;
+            }
+        }
+        color_palette(c0, c1, !three, palette);
+        if (c0 == c1) {
+            // A single color; BC1 would read c0 == c1 as three-color mode
+            xudk_memset(indices, 0, sizeof(indices));
+            error = kernels->select(fit, palette, 1, 0x00FFFFFFu, indices);
+        } else {
+            error = kernels->select(fit, palette, three ? 3 : 4, 0x00FFFFFFu, indices);
+        }
+        if (error < best_error) {
+            best_error = error;
+            best0 = c0;
+            best1 = c1;
+            xudk_memcpy(best_indices, indices, sizeof(indices));
+        }
+        if (!error || c0 == c1) {
+            break;
+        }
+        refine_endpoints(px, opaque, 3, indices, three ? weights3 : weights4, e0, e1);
+    }
+
+    for (u32 i = 0; i < 16; i++) {
+        bits |= (u32)(opaque & (1u << i) ? best_indices[i] : 3) << (i * 2);
+    }
+    out[0] = (u8)best0;
+    out[1] = (u8)(best0 >> 8);
+    out[2] = (u8)best1;
+    out[3] = (u8)(best1 >> 8);
+    out[4] = (u8)bits;
+    out[5] = (u8)(bits >> 8);
+    out[6] = (u8)(bits >> 16);
+    out[7] = (u8)(bits >> 24);
+}
+
+static void decode_color(const u8 *in, bool four, u32 *px) {
+    u32 c0 = in[0] | ((u32)in[1] << 8), c1 = in[2] | ((u32)in[3] << 8);
+    u32 bits = in[4] | ((u32)in[5] << 8) | ((u32)in[6] << 16) | ((u32)in[7] << 24);
+    u32 palette[4];
+
+    color_palette(c0, c1, four, palette);
+    for (u32 i = 0; i < 16; i++) {
+        px[i] = palette[(bits >> (i * 2)) & 3];
+    }
+}
+
+// Eight levels when e0 > e1, otherwise six plus exact 0 and 255
+static void channel_palette(u32 e0, u32 e1, u32 palette[8]) {
+    palette[0] = e0;
+    palette[1] = e1;
+    if (e0 > e1) {
+        for (u32 i = 1; i < 7; i++) {
+            palette[i + 1] = ((7 - i) * e0 + i * e1 + 3) / 7;
+        }
+    } else {
+        for (u32 i = 1; i < 5; i++) {
+            palette[i + 1] = ((5 - i) * e0 + i * e1 + 2) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// One channel of the block, values in the low byte of `v`
+static void encode_channel(const xudk_bcn_impl *kernels, const u32 *v, u8 *out) {
+    u32 lo = 255, hi = 0, inner_lo = 255, inner_hi = 0, palette[8], error;
+    u8 indices[16], best_indices[16];
+    u32 best0, best1;
+    u64 bits = 0;
+
+    for (u32 i = 0; i < 16; i++) {
+        lo = v[i] < lo ? v[i] : lo;
+        hi = v[i] > hi ? v[i] : hi;
+        if (v[i] && v[i] != 255) {
+            inner_lo = v[i] < inner_lo ? v[i] : inner_lo;
+            inner_hi = v[i] > inner_hi ? v[i] : inner_hi;
+        }
+    }
+
+    best0 = hi;
+    best1 = lo;
+    channel_palette(best0, best1, palette);
+    error = kernels->select(v, palette, 8, 0xFF, best_indices);
+    if (error && (lo == 0 || hi == 255)) {
+        u32 error6;
+        if (inner_lo > inner_hi) {
+            inner_lo = inner_hi = 0;
+        }
+        channel_palette(inner_lo, inner_hi, palette);
+        error6 = kernels->select(v, palette, 8, 0xFF, indices);
+        if (error6 < error) {
+            best0 = inner_lo;
+            best1 = inner_hi;
+            xudk_memcpy(best_indices, indices, sizeof(indices));
+        }
+    }
+
+    for (u32 i = 0; i < 16; i++) {
+        bits |= (u64)best_indices[i] << (i * 3);
+    }
+    out[0] = (u8)best0;
+    out[1] = (u8)best1;
+    for (u32 i = 0; i < 6; i++) {
+        out[2 + i] = (u8)(bits >> (i * 8));
+    }
+}
+
+static void decode_channel(const u8 *in, u8 *v, u32 stride) {
+    u32 palette[8];
+    u64 bits = 0;
+
+    channel_palette(in[0], in[1], palette);
+    for (u32 i = 0; i < 6; i++) {
+        bits |= (u64)in[2 + i] << (i * 8);
+    }
+    for (u32 i = 0; i < 16; i++) {
+        v[i * stride] = (u8)palette[(bits >> (i * 3)) & 7];
+    }
+}
+
+// =============================================================================
+// BC7
+// =============================================================================
+
+// 128 bits, least significant first; the spare word lets a field straddle
+// the halves without a bounds check
+typedef struct {
+    u64             bits[3];
+    u32             pos;
+} bc7_stream;
+
+static void bc7_put(bc7_stream *s, u32 value, u32 count) {
+    u32 shift = s->pos & 63;
+
+    s->bits[s->pos >> 6] |= (u64)value << shift;
+    if (shift + count > 64) {
+        s->bits[(s->pos >> 6) + 1] |= (u64)value >> (64 - shift);
+    }
+    s->pos += count;
+}
+
+static u32 bc7_get(bc7_stream *s, u32 count) {
+    u32 shift = s->pos & 63;
+    u64 value = s->bits[s->pos >> 6] >> shift;
+
+    if (shift) {
+        value |= s->bits[(s->pos >> 6) + 1] << (64 - shift);
+    }
+    s->pos += count;
+    return (u32)(value & ((1ull << count) - 1));
+}
+
+static u32 bc7_interpolate(u32 a, u32 b, u32 weight) {
+    return ((64 - weight) * a + weight * b + 32) >> 6;
+}
+
+static void bc7_mode6_palette(const u32 e[2][4], u32 palette[16]) {
+    for (u32 k = 0; k < 16; k++) {
+        palette[k] = 0;
+        for (u32 c = 0; c < 4; c++) {
+            palette[k] |= bc7_interpolate(e[0][c], e[1][c], bc7_weights4[k]) << (c * 8);
+        }
+    }
+}
+
+// Mode 6 only: one subset, 7-bit RGBA endpoints with a p-bit each and
+// 4-bit indices. Both p-bit choices are tried per endpoint pair.
+static void encode_bc7(const xudk_bcn_impl *kernels, const u32 *px, u8 *out) {
+    float weights[16], f[2][4];
+    u32 q[2][4], best_q[2][4] = { { 0 } }, e[2][4], palette[16], best_error = ~0u, best_p = 0;
+    u8 indices[16], best_indices[16] = { 0 };
+    bc7_stream s = { { 0, 0, 0 }, 0 };
+
+    for (u32 k = 0; k < 16; k++) {
+        weights[k] = bc7_weights4[k] / 64.0f;
+    }
+    fit_axis(px, 0xFFFF, 4, f[0], f[1]);
+
+    for (u32 pass = 0; pass <= BCN_REFINE_PASSES; pass++) {
+        u32 pass_error = ~0u;
+        for (u32 p = 0; p < 4; p++) {
+            u32 error;
+            for (u32 j = 0; j < 2; j++) {
+                u32 pbit = (p >> j) & 1;
+                for (u32 c = 0; c < 4; c++) {
+                    float v = (f[j][c] - (float)pbit) * 0.5f + 0.5f;
+                    q[j][c] = v < 0.0f ? 0 : (v > 127.0f ? 127 : (u32)v);
+                    e[j][c] = (q[j][c] << 1) | pbit;
+                }
+            }
+            bc7_mode6_palette((const u32(*)[4])e, palette);
+            error = kernels->select(px, palette, 16, ~0u, indices);
+            if (error < pass_error) {
+                pass_error = error;
+            }
+            if (error < best_error) {
+                best_error = error;
+                best_p = p;
+                xudk_memcpy(best_q, q, sizeof(q));
+                xudk_memcpy(best_indices, indices, sizeof(indices));
+            }
+        }
+        if (!best_error) {
+            break;
+        }
+        refine_endpoints(px, 0xFFFF, 4, best_indices, weights, f[0], f[1]);
+    }
+
+    // The first pixel's index is stored without its top bit
+    if (best_indices[0] & 8) {
+        for (u32 c = 0; c < 4; c++) {
+            u32 t = best_q[0][c];
+            best_q[0][c] = best_q[1][c];
+            best_q[1][c] = t;
+        }
+        best_p = ((best_p & 1) << 1) | (best_p >> 1);
+        for (u32 i = 0; i < 16; i++) {
+            best_indices[i] = (u8)(15 - best_indices[i]);
+        }
+    }
+
+    bc7_put(&s, 1u << 6, 7);
+    for (u32 c = 0; c < 4; c++) {
+        bc7_put(&s, best_q[0][c], 7);
+        bc7_put(&s, best_q[1][c], 7);
+    }
+    bc7_put(&s, best_p & 1, 1);
+    bc7_put(&s, best_p >> 1, 1);
+    bc7_put(&s, best_indices[0], 3);
+    for (u32 i = 1; i < 16; i++) {
+        bc7_put(&s, best_indices[i], 4);
+    }
+    for (u32 i = 0; i < 16; i++) {
+        out[i] = (u8)(s.bits[i >> 3] >> ((i & 7) * 8));
+    }
+}
+
+static u32 bc7_subset(u32 subsets, u32 partition, u32 i) {
+    if (subsets == 2) {
+        return (bc7_partitions2[partition] >> i) & 1;
+    }
+    if (subsets == 3) {
+        return (bc7_partitions3[partition] >> (i * 2)) & 3;
+    }
+    return 0;
+}
+
+static bool bc7_is_anchor(u32 subsets, u32 partition, u32 i) {
+    if (i == 0) {
+        return true;
+    }
+    if (subsets == 2) {
+        return i == bc7_anchors2[partition];
+    }
+    if (subsets == 3) {
+        return i == bc7_anchors3[0][partition] || i == bc7_anchors3[1][partition];
+    }
+    return false;
+}
+
+static void bc7_read_indices(bc7_stream *s, u32 subsets, u32 partition, u32 bits, u8 *indices) {
+    for (u32 i = 0; i < 16; i++) {
+        indices[i] = (u8)bc7_get(s, bc7_is_anchor(subsets, partition, i) ? bits - 1 : bits);
+    }
+}
+
+static const u8* bc7_weights(u32 bits) {
+    return bits == 2 ? bc7_weights2 : (bits == 3 ? bc7_weights3 : bc7_weights4);
+}
+
+// All eight modes; reserved mode bytes decode to transparent black
+static void decode_bc7(const u8 *in, u32 *px) {
+    bc7_stream s = { { 0, 0, 0 }, 0 };
+    u32 e[6][4], mode = 0, partition, rotation, selector, color_bits, alpha_bits;
+    u8 color_index[16], alpha_index[16];
+    const bc7_mode *m;
+
+    for (u32 i = 0; i < 16; i++) {
+        s.bits[i >> 3] |= (u64)in[i] << ((i & 7) * 8);
+    }
+    while (mode < 8 && !bc7_get(&s, 1)) {
+        mode++;
+    }
+    if (mode == 8) {
+        xudk_memset(px, 0, 16 * sizeof(u32));
+        return;
+    }
+    m = &bc7_modes[mode];
+    partition = bc7_get(&s, m->partition_bits);
+    rotation = bc7_get(&s, m->rotation_bits);
+    selector = bc7_get(&s, m->selector_bits);
+
+    for (u32 c = 0; c < 4; c++) {
+        u32 bits = c < 3 ? m->color_bits : m->alpha_bits;
+        for (u32 j = 0; j < m->subsets * 2u; j++) {
+            e[j][c] = bits ? bc7_get(&s, bits) : 255;
+        }
+    }
+
+    // Endpoints gain their p-bit, then are widened to 8 bits by replicating the top bits
+    color_bits = m->color_bits;
+    alpha_bits = m->alpha_bits;
+    if (m->endpoint_pbits || m->shared_pbits) {
+        u32 pbits[6];
+        for (u32 j = 0; j < m->subsets * 2u; j++) {
+            pbits[j] = m->shared_pbits ? (j & 1 ? pbits[j - 1] : bc7_get(&s, 1)) : bc7_get(&s, 1);
+        }
+        for (u32 j = 0; j < m->subsets * 2u; j++) {
+            for (u32 c = 0; c < 4; c++) {
+                if (c < 3 || alpha_bits) {
+                    e[j][c] = (e[j][c] << 1) | pbits[j];
+                }
+            }
+        }
+        color_bits++;
+        alpha_bits += alpha_bits ? 1 : 0;
+    }
+    for (u32 j = 0; j < m->subsets * 2u; j++) {
+        for (u32 c = 0; c < 4; c++) {
+            u32 bits = c < 3 ? color_bits : alpha_bits;
+            if (bits && bits < 8) {
+                e[j][c] = (e[j][c] << (8 - bits)) | (e[j][c] >> (2 * bits - 8));
+            }
+        }
+    }
+
+    bc7_read_indices(&s, m->subsets, partition, m->index_bits, color_index);
+    if (m->index2_bits) {
+        bc7_read_indices(&s, 1, 0, m->index2_bits, alpha_index);
+    } else {
+        xudk_memcpy(alpha_index, color_index, sizeof(alpha_index));
+    }
+
+    for (u32 i = 0; i < 16; i++) {
+        u32 subset = bc7_subset(m->subsets, partition, i);
+        const u32 *a = e[subset * 2], *b = e[subset * 2 + 1];
+        u32 ci = color_index[i], ai = alpha_index[i], cb = m->index_bits, ab = m->index2_bits ? m->index2_bits : cb;
+        u32 rgba[4], t;
+
+        if (selector) {
+            t = ci; ci = ai; ai = t;
+            t = cb; cb = ab; ab = t;
+        }
+        for (u32 c = 0; c < 3; c++) {
+            rgba[c] = bc7_interpolate(a[c], b[c], bc7_weights(cb)[ci]);
+        }
+        rgba[3] = bc7_interpolate(a[3], b[3], bc7_weights(ab)[ai]);
+        if (rotation) {
+            t = rgba[3];
+            rgba[3] = rgba[rotation - 1];
+            rgba[rotation - 1] = t;
+        }
+        px[i] = rgba[0] | (rgba[1] << 8) | (rgba[2] << 16) | (rgba[3] << 24);
+    }
+}
+
+// =============================================================================
+// IMAGES
+// =============================================================================
+
+static u32 block_size(xudk_texture_format format) {
+    switch (format) {
+    case XUDK_FORMAT_BC1_UNORM:
+    case XUDK_FORMAT_BC4_UNORM:
+        return 8;
+    case XUDK_FORMAT_BC2_UNORM:
+    case XUDK_FORMAT_BC3_UNORM:
+    case XUDK_FORMAT_BC5_UNORM:
+    case XUDK_FORMAT_BC6H_UF16:
+    case XUDK_FORMAT_BC7_UNORM:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+// Pixels past the right and bottom edges repeat the last column and row
+static void load_block(const bcn_job *job, u32 bx, u32 by, u32 *px) {
+    for (u32 y = 0; y < 4; y++) {
+        u32 sy = by * 4 + y < job->height ? by * 4 + y : job->height - 1;
+        for (u32 x = 0; x < 4; x++) {
+            u32 sx = bx * 4 + x < job->width ? bx * 4 + x : job->width - 1;
+            px[y * 4 + x] = *(const xudk_unaligned_u32*)(job->src + ((usize)sy * job->width + sx) * 4);
+        }
+    }
+}
+
+static void store_block(const bcn_job *job, u32 bx, u32 by, const u32 *px) {
+    for (u32 y = 0; y < 4 && by * 4 + y < job->height; y++) {
+        u8 *row = job->dst + ((usize)(by * 4 + y) * job->width + bx * 4) * 4;
+        u32 count = job->width - bx * 4 < 4 ? job->width - bx * 4 : 4;
+        xudk_memcpy(row, px + y * 4, count * sizeof(u32));
+    }
+}
+
+static void encode_block(const bcn_job *job, const u32 *px, u8 *out) {
+    u32 v[16], opaque = 0;
+    u64 alpha = 0;
+
+    switch (job->format) {
+    case XUDK_FORMAT_BC1_UNORM:
+        for (u32 i = 0; i < 16; i++) {
+            opaque |= (px[i] >> 31) << i;
+        }
+        encode_color(job->kernels, px, opaque, true, out);
+        break;
+    case XUDK_FORMAT_BC2_UNORM:
+        for (u32 i = 0; i < 16; i++) {
+            alpha |= (u64)((channel(px[i], 3) * 15 + 127) / 255) << (i * 4);
+        }
+        for (u32 i = 0; i < 8; i++) {
+            out[i] = (u8)(alpha >> (i * 8));
+        }
+        encode_color(job->kernels, px, 0xFFFF, false, out + 8);
+        break;
+    case XUDK_FORMAT_BC3_UNORM:
+        for (u32 i = 0; i < 16; i++) {
+            v[i] = channel(px[i], 3);
+        }
+        encode_channel(job->kernels, v, out);
+        encode_color(job->kernels, px, 0xFFFF, false, out + 8);
+        break;
+    case XUDK_FORMAT_BC4_UNORM:
+    case XUDK_FORMAT_BC5_UNORM:
+        for (u32 c = 0; c < (job->format == XUDK_FORMAT_BC5_UNORM ? 2u : 1u); c++) {
+            for (u32 i = 0; i < 16; i++) {
+                v[i] = channel(px[i], c);
+            }
+            encode_channel(job->kernels, v, out + c * 8);
+        }
+        break;
+    default:
+        encode_bc7(job->kernels, px, out);
+        break;
+    }
+}
+
+// BC4 and BC5 decode to (r, 0, 0, 1) and (r, g, 0, 1), as GPUs sample them
+static void decode_block(const bcn_job *job, const u8 *in, u32 *px) {
+    switch (job->format) {
+    case XUDK_FORMAT_BC1_UNORM:
+        decode_color(in, false, px);
+        break;
+    case XUDK_FORMAT_BC2_UNORM:
+        decode_color(in + 8, true, px);
+        for (u32 i = 0; i < 16; i++) {
+            px[i] = (px[i] & 0x00FFFFFFu) | ((u32)((in[i >> 1] >> ((i & 1) * 4)) & 15) * 17 << 24);
+        }
+        break;
+    case XUDK_FORMAT_BC3_UNORM:
+        decode_color(in + 8, true, px);
+        decode_channel(in, (u8*)px + 3, 4);
+        break;
+    case XUDK_FORMAT_BC4_UNORM:
+    case XUDK_FORMAT_BC5_UNORM:
+        for (u32 i = 0; i < 16; i++) {
+            px[i] = 0xFF000000u;
+        }
+        decode_channel(in, (u8*)px, 4);
+        if (job->format == XUDK_FORMAT_BC5_UNORM) {
+            decode_channel(in + 8, (u8*)px + 1, 4);
+        }
+        break;
+    default:
+        decode_bc7(in, px);
+        break;
+    }
+}
+
+static void bcn_worker(void *arg) {
+    bcn_job *job = arg;
+    u32 by;
+
+    while ((by = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->blocks_y) {
+        for (u32 bx = 0; bx < job->blocks_x; bx++) {
+            usize block = ((usize)by * job->blocks_x + bx) * job->block_size;
+            u32 px[16];
+
+            if (job->encode) {
+                load_block(job, bx, by, px);
+                encode_block(job, px, job->dst + block);
+            } else {
+                decode_block(job, job->src + block, px);
+                store_block(job, bx, by, px);
+            }
+        }
+    }
+}
+
+static status bcn_run(xudk_ctx *ctx, bcn_job *job) {
+    if (!job->src || !job->dst || !job->width || !job->height) {
+        return XUDK_INVALID_PARAM;
+    }
+    job->block_size = block_size(job->format);
+    if (!job->block_size) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (job->format == XUDK_FORMAT_BC6H_UF16) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    job->kernels = xudk_bcn_kernels();
+    job->blocks_x = (job->width + 3) / 4;
+    job->blocks_y = (job->height + 3) / 4;
+    job->next = 0;
+
+    // Workers drain the shared row counter, so whatever is left runs here
+    if ((u64)job->blocks_x * job->blocks_y >= BCN_PARALLEL_BLOCKS && ctx && ctx->system.run_on_all_processors) {
+        ctx->system.run_on_all_processors(ctx, bcn_worker, job);
+    }
+    bcn_worker(job);
+    return XUDK_OK;
+}
+
+usize xudk_gpu_compressed_size(xudk_texture_format format, u32 width, u32 height) {
+    return (usize)block_size(format) * ((width + 3) / 4) * ((height + 3) / 4);
+}
+
+status xudk_gpu_compress_texture(xudk_ctx *ctx, xudk_texture_format format, const void *pixels,
+                                 u32 width, u32 height, void *blocks) {
+    bcn_job job;
+
+    xudk_memset(&job, 0, sizeof(job));
+    job.format = format;
+    job.encode = true;
+    job.src = pixels;
+    job.dst = blocks;
+    job.width = width;
+    job.height = height;
+    return bcn_run(ctx, &job);
+}
+
+status xudk_gpu_decompress_texture(xudk_ctx *ctx, xudk_texture_format format, const void *blocks,
+                                   u32 width, u32 height, void *pixels) {
+    bcn_job job;
+
+    xudk_memset(&job, 0, sizeof(job));
+    job.format = format;
+    job.src = blocks;
+    job.dst = pixels;
+    job.width = width;
+    job.height = height;
+    return bcn_run(ctx, &job);
+}
+
+// =============================================================================
+// DISPATCH
+// =============================================================================
+
+static const xudk_bcn_impl bcn_impls[] = {
+    { "scalar", 0, select_scalar },
+#if XUDK_X86
+    { "sse2", XUDK_CPU_SSE2, select_sse2 },
+    { "avx2", XUDK_CPU_SSE2 | XUDK_CPU_AVX2, select_avx2 },
+#endif
+};
+
+static const xudk_bcn_impl *bcn_active = &bcn_impls[0];
+
+const xudk_bcn_impl* xudk_bcn_impls(usize *count) {
+    *count = sizeof(bcn_impls) / sizeof(bcn_impls[0]);
+    return bcn_impls;
+}
+
+const xudk_bcn_impl* xudk_bcn_kernels(void) {
+    return bcn_active;
+}
+
+void xudk_bcn_init(void) {
+    u32 features = xudk_cpu_features();
+
+    for (usize i = 0; i < sizeof(bcn_impls) / sizeof(bcn_impls[0]); i++) {
+        if ((bcn_impls[i].features & features) == bcn_impls[i].features) {
+            bcn_active = &bcn_impls[i];
+        }
+    }
+}
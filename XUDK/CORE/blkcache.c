@@ -0,0 +1,515 @@
+/*
+ * XUDK - Storage block cache
+ * While open, storage.read_sectors and write_sectors go through a cache of
+ * CACHE_BLOCK_SIZE blocks, hash-indexed by disk and block and evicted by
+ * CLOCK. Misses are read in runs of whole blocks. In write-back mode writes
+ * stay in the cache until it is flushed or they are evicted; either way a
+ * dirty block goes out with the dirty blocks next to it as one sequential
+ * write. Transfers of CACHE_RUN_BLOCKS or more bypass the cache, and queued
+ * transfers flush what they overlap first, so both stay coherent with it.
+ */
+
+#include "core.h"
+
+#define CACHE_BLOCK_SIZE    4096
+#define CACHE_RUN_BLOCKS    64          // Longest device transfer the cache makes
+#define CACHE_MAX_DISKS     32
+#define CACHE_MIN_BLOCKS    16
+
+typedef struct {
+    u64             block;
+    u32             disk_id;
+    u32             next;               // Next entry of the bucket, index + 1
+    u32             sectors;            // Short for a disk's last block
+    bool            used;
+    bool            dirty;
+    bool            referenced;         // Since the clock hand last passed
+} cache_entry;
+
+typedef struct {
+    bool            known;
+    bool            cacheable;
+    bool            read_only;          // Writes go straight through to fail there
+    u32             block_sectors;
+    u64             total_sectors;
+} cache_disk;
+
+typedef struct {
+    xudk_storage    backend;            // Entries the cache replaced
+    bool            write_back;
+    u8*             data;               // entry_count blocks
+    cache_entry*    entries;
+    u32             entry_count;
+    u32*            buckets;            // Heads, index + 1; a power of two of them
+    u32             bucket_count;
+    u32             hand;
+    u8*             read_run;           // CACHE_RUN_BLOCKS blocks each; the flush one is
+    u8*             write_run;          // separate so a flush can happen mid-read
+    cache_disk      disks[CACHE_MAX_DISKS];
+    xudk_storage_cache_stats stats;
+} block_cache;
+
+static block_cache* cache_of(xudk_ctx *ctx) {
+    return ctx->storage_cache;
+}
+
+// =============================================================================
+// INDEX
+// =============================================================================
+
+static u32 bucket_of(const block_cache *cache, u32 disk_id, u64 block) {
+    u64 h = (block ^ ((u64)disk_id << 56)) * 0x9E3779B97F4A7C15ULL;
+    return (u32)(h >> 32) & (cache->bucket_count - 1);
+}
+
+static cache_entry* lookup(block_cache *cache, u32 disk_id, u64 block) {
+    for (u32 i = cache->buckets[bucket_of(cache, disk_id, block)]; i; i = cache->entries[i - 1].next) {
+        cache_entry *e = &cache->entries[i - 1];
+
+        if (e->block == block && e->disk_id == disk_id) {
+            return e;
+        }
+    }
+    return null;
+}
+
+static void unlink_entry(block_cache *cache, cache_entry *e) {
+    u32 *link = &cache->buckets[bucket_of(cache, e->disk_id, e->block)];
+    u32 index = (u32)(e - cache->entries) + 1;
+
+    while (*link != index) {
+        link = &cache->entries[*link - 1].next;
+    }
+    *link = e->next;
+    e->used = false;
+}
+
+static u8* block_data(block_cache *cache, const cache_entry *e) {
+    return cache->data + (usize)(e - cache->entries) * CACHE_BLOCK_SIZE;
+}
+
+static cache_disk* disk_of(xudk_ctx *ctx, block_cache *cache, u32 disk_id) {
+    cache_disk *disk;
+    xudk_disk_info info;
+
+    if (disk_id >= CACHE_MAX_DISKS) {
+        return null;
+    }
+    disk = &cache->disks[disk_id];
+    if (!disk->known && xudk_ok(cache->backend.get_disk_info(ctx, disk_id, &info))) {
+        disk->known = true;
+        disk->cacheable = info.sector_size && info.sector_size <= CACHE_BLOCK_SIZE &&
+                          CACHE_BLOCK_SIZE % info.sector_size == 0;
+        disk->block_sectors = disk->cacheable ? CACHE_BLOCK_SIZE / info.sector_size : 0;
+        disk->total_sectors = info.total_sectors;
+        // An empty write reports write protection, as WriteBlocks() checks it first
+        disk->read_only = cache->backend.write_sectors(ctx, disk_id, 0, 0, cache->write_run) == XUDK_WRITE_PROTECTED;
+    }
+    return disk->known && disk->cacheable ? disk : null;
+}
+
+// =============================================================================
+// FLUSH AND EVICTION
+// =============================================================================
+
+// Writes `e` with the dirty blocks on either side of it as one transfer
+static status flush_around(xudk_ctx *ctx, block_cache *cache, cache_entry *e) {
+    cache_disk *disk = &cache->disks[e->disk_id];
+    u32 sector_size = CACHE_BLOCK_SIZE / disk->block_sectors;
+    u64 first = e->block, last = e->block;
+    u64 sectors = 0;
+    cache_entry *n;
+    status s;
+
+    while (first > 0 && last - first + 1 < CACHE_RUN_BLOCKS &&
+           (n = lookup(cache, e->disk_id, first - 1)) && n->dirty) {
+        first--;
+    }
+    while (last - first + 1 < CACHE_RUN_BLOCKS && (n = lookup(cache, e->disk_id, last + 1)) && n->dirty) {
+        last++;
+    }
+    for (u64 b = first; b <= last; b++) {
+        n = lookup(cache, e->disk_id, b);
+        xudk_memcpy(cache->write_run + (usize)(b - first) * CACHE_BLOCK_SIZE, block_data(cache, n),
+                    (usize)n->sectors * sector_size);
+        sectors += n->sectors;
+    }
+    s = cache->backend.write_sectors(ctx, e->disk_id, first * disk->block_sectors, (u32)sectors, cache->write_run);
+    if (xudk_error(s)) {
+        return s;
+    }
+    for (u64 b = first; b <= last; b++) {
+        lookup(cache, e->disk_id, b)->dirty = false;
+    }
+    cache->stats.dirty_blocks -= (u32)(last - first + 1);
+    cache->stats.flushed_blocks += last - first + 1;
+    cache->stats.device_writes++;
+    return XUDK_OK;
+}
+
+// A free entry, evicting with the clock hand when there is none
+static status take_entry(xudk_ctx *ctx, block_cache *cache, cache_entry **entry) {
+    for (u32 step = 0; step < cache->entry_count * 2 + 1; step++) {
+        cache_entry *e = &cache->entries[cache->hand];
+
+        cache->hand = (cache->hand + 1) % cache->entry_count;
+        if (e->used && e->referenced) {
+            e->referenced = false;
+            continue;
+        }
+        if (e->used) {
+            if (e->dirty) {
+                status s = flush_around(ctx, cache, e);
+                if (xudk_error(s)) {
+                    return s;
+                }
+            }
+            unlink_entry(cache, e);
+            cache->stats.cached_blocks--;
+            cache->stats.evictions++;
+        }
+        *entry = e;
+        return XUDK_OK;
+    }
+    return XUDK_ERROR;
+}
+
+static status insert(xudk_ctx *ctx, block_cache *cache, u32 disk_id, u64 block, u32 sectors, const u8 *data,
+                     bool dirty) {
+    u32 *head = &cache->buckets[bucket_of(cache, disk_id, block)];
+    cache_entry *e;
+    status s = take_entry(ctx, cache, &e);
+
+    if (xudk_error(s)) {
+        return s;
+    }
+    e->block = block;
+    e->disk_id = disk_id;
+    e->sectors = sectors;
+    e->used = true;
+    e->dirty = dirty;
+    e->referenced = true;
+    e->next = *head;
+    *head = (u32)(e - cache->entries) + 1;
+    xudk_memcpy(block_data(cache, e), data, (usize)sectors * (CACHE_BLOCK_SIZE / cache->disks[disk_id].block_sectors));
+    cache->stats.cached_blocks++;
+    cache->stats.dirty_blocks += dirty;
+    return XUDK_OK;
+}
+
+// Flushes the dirty blocks in a sector range, and drops them all when asked
+static status sync_range(xudk_ctx *ctx, block_cache *cache, cache_disk *disk, u32 disk_id, u64 lba, u32 count,
+                         bool drop) {
+    u64 end = (lba + count + disk->block_sectors - 1) / disk->block_sectors;
+
+    if (!cache->stats.dirty_blocks && !drop) {
+        return XUDK_OK;
+    }
+    for (u64 b = lba / disk->block_sectors; b < end; b++) {
+        cache_entry *e = lookup(cache, disk_id, b);
+
+        if (e && e->dirty) {
+            status s = flush_around(ctx, cache, e);
+            if (xudk_error(s)) {
+                return s;
+            }
+        }
+        if (e && drop) {
+            unlink_entry(cache, e);
+            cache->stats.cached_blocks--;
+        }
+    }
+    return XUDK_OK;
+}
+
+// =============================================================================
+// STORAGE ENTRIES
+// =============================================================================
+
+// Copies between a transfer's buffer and the part of block `b` it covers
+static void overlap(const cache_disk *disk, u64 lba, u32 count, u64 b, usize *at, usize *offset, usize *size) {
+    u32 sector_size = CACHE_BLOCK_SIZE / disk->block_sectors;
+    u64 first = b * disk->block_sectors > lba ? b * disk->block_sectors : lba;
+    u64 last = (b + 1) * disk->block_sectors < lba + count ? (b + 1) * disk->block_sectors : lba + count;
+
+    *at = (usize)(first - lba) * sector_size;
+    *offset = (usize)(first - b * disk->block_sectors) * sector_size;
+    *size = (usize)(last - first) * sector_size;
+}
+
+static u32 block_sectors_at(const cache_disk *disk, u64 b) {
+    u64 left = disk->total_sectors - b * disk->block_sectors;
+    return left < disk->block_sectors ? (u32)left : disk->block_sectors;
+}
+
+static status cache_read_sectors(xudk_ctx *ctx, u32 disk_id, u64 lba, u32 count, void *buffer) {
+    block_cache *cache = cache_of(ctx);
+    cache_disk *disk = disk_of(ctx, cache, disk_id);
+    usize at, offset, size;
+    u64 b, end;
+    status s;
+
+    if (!disk || !buffer || lba + count > disk->total_sectors || lba + count < lba) {
+        return cache->backend.read_sectors(ctx, disk_id, lba, count, buffer);
+    }
+    end = (lba + count + disk->block_sectors - 1) / disk->block_sectors;
+
+    // Long reads go straight to the buffer, then take the newer dirty blocks
+    if (count >= CACHE_RUN_BLOCKS * disk->block_sectors) {
+        s = cache->backend.read_sectors(ctx, disk_id, lba, count, buffer);
+        cache->stats.device_reads++;
+        for (b = lba / disk->block_sectors; xudk_ok(s) && cache->stats.dirty_blocks && b < end; b++) {
+            cache_entry *e = lookup(cache, disk_id, b);
+
+            if (e && e->dirty) {
+                overlap(disk, lba, count, b, &at, &offset, &size);
+                xudk_memcpy((u8*)buffer + at, block_data(cache, e) + offset, size);
+            }
+        }
+        return s;
+    }
+
+    for (b = lba / disk->block_sectors; b < end;) {
+        cache_entry *e = lookup(cache, disk_id, b);
+        u64 run_end = b, run_sectors = 0;
+
+        if (e) {
+            overlap(disk, lba, count, b, &at, &offset, &size);
+            xudk_memcpy((u8*)buffer + at, block_data(cache, e) + offset, size);
+            e->referenced = true;
+            cache->stats.hits++;
+            b++;
+            continue;
+        }
+
+        // Misses are read in whole blocks, as many in a row as the run holds
+        while (run_end < end && run_end - b < CACHE_RUN_BLOCKS && (run_end == b || !lookup(cache, disk_id, run_end))) {
+            run_sectors += block_sectors_at(disk, run_end);
+            run_end++;
+        }
+        s = cache->backend.read_sectors(ctx, disk_id, b * disk->block_sectors, (u32)run_sectors, cache->read_run);
+        if (xudk_error(s)) {
+            return s;
+        }
+        cache->stats.device_reads++;
+        cache->stats.misses += run_end - b;
+        for (u8 *data = cache->read_run; b < run_end; b++, data += CACHE_BLOCK_SIZE) {
+            overlap(disk, lba, count, b, &at, &offset, &size);
+            xudk_memcpy((u8*)buffer + at, data + offset, size);
+            // Caching is best effort: a failed eviction leaves the block uncached
+            insert(ctx, cache, disk_id, b, block_sectors_at(disk, b), data, false);
+        }
+    }
+    return XUDK_OK;
+}
+
+static status cache_write_sectors(xudk_ctx *ctx, u32 disk_id, u64 lba, u32 count, const void *buffer) {
+    block_cache *cache = cache_of(ctx);
+    cache_disk *disk = disk_of(ctx, cache, disk_id);
+    usize at, offset, size;
+    u64 b, end;
+    status s;
+
+    if (!disk || !buffer || lba + count > disk->total_sectors || lba + count < lba) {
+        return cache->backend.write_sectors(ctx, disk_id, lba, count, buffer);
+    }
+    end = (lba + count + disk->block_sectors - 1) / disk->block_sectors;
+
+    // Written through: cached copies are updated, and clean where fully rewritten
+    if (!cache->write_back || disk->read_only || count >= CACHE_RUN_BLOCKS * disk->block_sectors) {
+        s = cache->backend.write_sectors(ctx, disk_id, lba, count, buffer);
+        if (xudk_error(s)) {
+            return s;
+        }
+        cache->stats.device_writes++;
+        for (b = lba / disk->block_sectors; cache->stats.cached_blocks && b < end; b++) {
+            cache_entry *e = lookup(cache, disk_id, b);
+
+            if (e) {
+                overlap(disk, lba, count, b, &at, &offset, &size);
+                xudk_memcpy(block_data(cache, e) + offset, (const u8*)buffer + at, size);
+                if (e->dirty && offset == 0 && size == (usize)e->sectors * (CACHE_BLOCK_SIZE / disk->block_sectors)) {
+                    e->dirty = false;
+                    cache->stats.dirty_blocks--;
+                }
+            }
+        }
+        return XUDK_OK;
+    }
+
+    for (b = lba / disk->block_sectors; b < end; b++) {
+        cache_entry *e = lookup(cache, disk_id, b);
+        u32 sectors = block_sectors_at(disk, b);
+
+        overlap(disk, lba, count, b, &at, &offset, &size);
+        if (e) {
+            xudk_memcpy(block_data(cache, e) + offset, (const u8*)buffer + at, size);
+            cache->stats.dirty_blocks += !e->dirty;
+            e->dirty = true;
+            e->referenced = true;
+            cache->stats.hits++;
+            continue;
+        }
+        // A block only partly written is read in first
+        if (size != (usize)sectors * (CACHE_BLOCK_SIZE / disk->block_sectors)) {
+            s = cache->backend.read_sectors(ctx, disk_id, b * disk->block_sectors, sectors, cache->read_run);
+            if (xudk_error(s)) {
+                return s;
+            }
+            cache->stats.device_reads++;
+        }
+        xudk_memcpy(cache->read_run + offset, (const u8*)buffer + at, size);
+        cache->stats.misses++;
+        s = insert(ctx, cache, disk_id, b, sectors, cache->read_run, true);
+        if (xudk_error(s)) {
+            // No room: this block goes out now
+            s = cache->backend.write_sectors(ctx, disk_id, b * disk->block_sectors, sectors, cache->read_run);
+            if (xudk_error(s)) {
+                return s;
+            }
+            cache->stats.device_writes++;
+        }
+    }
+    return XUDK_OK;
+}
+
+static status cache_read_sectors_async(xudk_ctx *ctx, u32 disk_id, u64 lba, u32 count, void *buffer,
+                                       xudk_io_token *token) {
+    block_cache *cache = cache_of(ctx);
+    cache_disk *disk = disk_of(ctx, cache, disk_id);
+
+    if (disk && lba + count <= disk->total_sectors && lba + count >= lba) {
+        status s = sync_range(ctx, cache, disk, disk_id, lba, count, false);
+        if (xudk_error(s)) {
+            return s;
+        }
+    }
+    return cache->backend.read_sectors_async(ctx, disk_id, lba, count, buffer, token);
+}
+
+static status cache_write_sectors_async(xudk_ctx *ctx, u32 disk_id, u64 lba, u32 count, const void *buffer,
+                                        xudk_io_token *token) {
+    block_cache *cache = cache_of(ctx);
+    cache_disk *disk = disk_of(ctx, cache, disk_id);
+
+    if (disk && lba + count <= disk->total_sectors && lba + count >= lba) {
+        status s = sync_range(ctx, cache, disk, disk_id, lba, count, true);
+        if (xudk_error(s)) {
+            return s;
+        }
+    }
+    return cache->backend.write_sectors_async(ctx, disk_id, lba, count, buffer, token);
+}
+
+// =============================================================================
+// PUBLIC API
+// =============================================================================
+
+status xudk_storage_cache_open(xudk_ctx *ctx, usize budget, bool write_back) {
+    block_cache *cache;
+    u32 entry_count = (u32)(budget / (CACHE_BLOCK_SIZE + sizeof(cache_entry)));
+    u32 bucket_count = 16;
+
+    if (cache_of(ctx) || entry_count < CACHE_MIN_BLOCKS) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!ctx->storage.read_sectors || !ctx->storage.write_sectors || !ctx->storage.get_disk_info) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    while (bucket_count < entry_count) {
+        bucket_count *= 2;
+    }
+    cache = ctx->memory.alloc(ctx, sizeof(*cache));
+    if (!cache) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(cache, 0, sizeof(*cache));
+    cache->data = ctx->memory.alloc(ctx, (usize)entry_count * CACHE_BLOCK_SIZE);
+    cache->entries = ctx->memory.alloc(ctx, entry_count * sizeof(cache_entry));
+    cache->buckets = ctx->memory.alloc(ctx, bucket_count * sizeof(u32));
+    cache->read_run = ctx->memory.alloc(ctx, CACHE_RUN_BLOCKS * CACHE_BLOCK_SIZE);
+    cache->write_run = ctx->memory.alloc(ctx, CACHE_RUN_BLOCKS * CACHE_BLOCK_SIZE);
+    if (!cache->data || !cache->entries || !cache->buckets || !cache->read_run || !cache->write_run) {
+        cache->entry_count = 0;
+        ctx->storage_cache = cache;
+        return xudk_storage_cache_close(ctx), XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(cache->entries, 0, entry_count * sizeof(cache_entry));
+    xudk_memset(cache->buckets, 0, bucket_count * sizeof(u32));
+    cache->entry_count = entry_count;
+    cache->bucket_count = bucket_count;
+    cache->write_back = write_back;
+    cache->stats.capacity_blocks = entry_count;
+    cache->backend = ctx->storage;
+
+    ctx->storage_cache = cache;
+    ctx->storage.read_sectors = cache_read_sectors;
+    ctx->storage.write_sectors = cache_write_sectors;
+    if (ctx->storage.read_sectors_async && ctx->storage.write_sectors_async) {
+        ctx->storage.read_sectors_async = cache_read_sectors_async;
+        ctx->storage.write_sectors_async = cache_write_sectors_async;
+    }
+    return XUDK_OK;
+}
+
+// Writes every dirty block, in runs of neighbours
+status xudk_storage_cache_flush(xudk_ctx *ctx) {
+    block_cache *cache = cache_of(ctx);
+
+    if (!cache) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (u32 i = 0; i < cache->entry_count && cache->stats.dirty_blocks; i++) {
+        cache_entry *e = &cache->entries[i];
+
+        if (e->used && e->dirty) {
+            status s = flush_around(ctx, cache, e);
+            if (xudk_error(s)) {
+                return s;
+            }
+        }
+    }
+    return XUDK_OK;
+}
+
+// Flushes first; the cache closes even when that fails, losing what it held
+status xudk_storage_cache_close(xudk_ctx *ctx) {
+    block_cache *cache = cache_of(ctx);
+    status s = XUDK_OK;
+
+    if (!cache) {
+        return XUDK_OK;
+    }
+    if (cache->entry_count) {
+        s = xudk_storage_cache_flush(ctx);
+        ctx->storage = cache->backend;
+    }
+    if (cache->data) {
+        ctx->memory.free(ctx, cache->data);
+    }
+    if (cache->entries) {
+        ctx->memory.free(ctx, cache->entries);
+    }
+    if (cache->buckets) {
+        ctx->memory.free(ctx, cache->buckets);
+    }
+    if (cache->read_run) {
+        ctx->memory.free(ctx, cache->read_run);
+    }
+    if (cache->write_run) {
+        ctx->memory.free(ctx, cache->write_run);
+    }
+    ctx->storage_cache = null;
+    ctx->memory.free(ctx, cache);
+    return s;
+}
+
+status xudk_storage_cache_get_stats(xudk_ctx *ctx, xudk_storage_cache_stats *stats) {
+    block_cache *cache = cache_of(ctx);
+
+    if (!cache || !stats) {
+        return XUDK_INVALID_PARAM;
+    }
+    *stats = cache->stats;
+    return XUDK_OK;
+}
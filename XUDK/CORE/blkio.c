@@ -0,0 +1,423 @@
+/*
+ * XUDK - Queued block IO
+ * Requests wait in submission order and go to the disk as transfers of at
+ * most max_transfer sectors, up to `depth` of them in flight, so one large
+ * read keeps as many queue slots busy as many small ones do. Transfers
+ * complete in any order; a request is done when its last one is, and its
+ * callback runs from the next xudk_io_poll or xudk_io_wait. Without
+ * storage.read_sectors_async (Block IO rather than Block IO 2) each
+ * transfer runs to completion as it is issued.
+ * xudk_io_stream keeps a window of chunk reads in flight ahead of a reader
+ * going front to back through a run of sectors.
+ */
+
+#include "core.h"
+
+#define IO_MAX_DEPTH            64
+#define IO_DEFAULT_TRANSFER     (1024 * 1024)       // Bytes per transfer when not given
+#define IO_STREAM_WINDOW        (8 * 1024 * 1024)   // Bytes read ahead when not given
+#define IO_STREAM_MAX_CHUNKS    16
+
+typedef struct {
+    xudk_io_token       token;
+    xudk_io_request*    request;        // null while the slot is free
+} io_slot;
+
+struct xudk_io_queue {
+    u32                 disk_id;
+    u32                 sector_size;
+    u64                 total_sectors;
+    u32                 depth;
+    u32                 max_transfer;   // Sectors
+    bool                async;
+    io_slot             slots[IO_MAX_DEPTH];
+    u32                 in_flight;
+    xudk_io_request*    head;           // Not fully issued, oldest first
+    xudk_io_request*    tail;
+    xudk_io_request*    done_head;      // Done, callback not yet run
+    xudk_io_request*    done_tail;
+};
+
+typedef struct {
+    xudk_io_request     request;
+    xudk_io_segment     segment;
+    u8*                 buffer;
+} io_chunk;
+
+struct xudk_io_stream {
+    xudk_io_queue*      queue;
+    u64                 next_lba;       // First sector not yet requested
+    u64                 end_lba;
+    io_chunk            chunks[IO_STREAM_MAX_CHUNKS];
+    u32                 chunk_count;
+    u32                 chunk_sectors;
+    u32                 front;          // Chunk being read from
+    usize               offset;         // Bytes of it already read
+    u32                 pending;        // Chunks requested and not yet read, from front on
+};
+
+// =============================================================================
+// QUEUE
+// =============================================================================
+
+static bool issued_all(const xudk_io_request *request) {
+    return request->segment == request->segment_count || xudk_error(request->failure);
+}
+
+static void finish(xudk_io_queue *queue, xudk_io_request *request) {
+    request->next = null;
+    if (queue->done_tail) {
+        queue->done_tail->next = request;
+    } else {
+        queue->done_head = request;
+    }
+    queue->done_tail = request;
+}
+
+// Runs the callbacks of finished requests; they may submit more
+static u32 deliver(xudk_ctx *ctx, xudk_io_queue *queue) {
+    u32 count = 0;
+
+    while (queue->done_head) {
+        xudk_io_request *request = queue->done_head;
+
+        queue->done_head = request->next;
+        if (!queue->done_head) {
+            queue->done_tail = null;
+        }
+        request->next = null;
+        request->result = request->failure;
+        if (request->callback) {
+            request->callback(ctx, request);
+        }
+        count++;
+    }
+    return count;
+}
+
+static io_slot* free_slot(xudk_io_queue *queue) {
+    for (u32 i = 0; i < queue->depth; i++) {
+        if (!queue->slots[i].request) {
+            return &queue->slots[i];
+        }
+    }
+    return null;
+}
+
+// Hands transfers to the disk while there are free slots
+static void issue(xudk_ctx *ctx, xudk_io_queue *queue) {
+    while (queue->head && queue->in_flight < queue->depth) {
+        xudk_io_request *request = queue->head;
+        const xudk_io_segment *segment;
+        u32 count;
+        u8 *buffer;
+        status s;
+
+        if (issued_all(request)) {
+            queue->head = request->next;
+            if (!queue->head) {
+                queue->tail = null;
+            }
+            if (!request->in_flight) {
+                finish(queue, request);
+            }
+            continue;
+        }
+        segment = &request->segments[request->segment];
+        count = segment->sectors - request->segment_offset;
+        count = count < queue->max_transfer ? count : queue->max_transfer;
+        buffer = (u8*)segment->buffer + (usize)request->segment_offset * queue->sector_size;
+
+        if (count && queue->async) {
+            io_slot *slot = free_slot(queue);
+
+            s = request->write
+                ? ctx->storage.write_sectors_async(ctx, queue->disk_id, request->next_lba, count, buffer, &slot->token)
+                : ctx->storage.read_sectors_async(ctx, queue->disk_id, request->next_lba, count, buffer, &slot->token);
+            if (xudk_ok(s)) {
+                slot->request = request;
+                request->in_flight++;
+                queue->in_flight++;
+            }
+        } else if (count) {
+            s = request->write
+                ? ctx->storage.write_sectors(ctx, queue->disk_id, request->next_lba, count, buffer)
+                : ctx->storage.read_sectors(ctx, queue->disk_id, request->next_lba, count, buffer);
+        } else {
+            s = XUDK_OK;
+        }
+        if (xudk_error(s)) {
+            request->failure = s;
+            continue;
+        }
+        request->next_lba += count;
+        request->segment_offset += count;
+        if (request->segment_offset == segment->sectors) {
+            request->segment++;
+            request->segment_offset = 0;
+        }
+    }
+}
+
+// False while the slot's transfer is still in flight and `wait` is not set
+static bool reap(xudk_ctx *ctx, xudk_io_queue *queue, io_slot *slot, bool wait) {
+    xudk_io_request *request = slot->request;
+    status s = ctx->storage.complete_io(ctx, &slot->token, wait);
+
+    if (s == XUDK_NOT_READY) {
+        return false;
+    }
+    slot->request = null;
+    queue->in_flight--;
+    request->in_flight--;
+    if (xudk_error(s) && xudk_ok(request->failure)) {
+        request->failure = s;
+    }
+    // One still at the head is finished by issue() as it moves past it
+    if (!request->in_flight && issued_all(request) && request != queue->head) {
+        finish(queue, request);
+    }
+    return true;
+}
+
+static void reap_all(xudk_ctx *ctx, xudk_io_queue *queue) {
+    for (u32 i = 0; i < queue->depth && queue->in_flight; i++) {
+        if (queue->slots[i].request) {
+            reap(ctx, queue, &queue->slots[i], false);
+        }
+    }
+}
+
+status xudk_io_queue_create(xudk_ctx *ctx, u32 disk_id, u32 depth, u32 max_transfer, xudk_io_queue **queue) {
+    xudk_disk_info info;
+    xudk_io_queue *q;
+    status s;
+
+    if (!queue || !depth || depth > IO_MAX_DEPTH) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = ctx->storage.get_disk_info(ctx, disk_id, &info);
+    if (xudk_error(s)) {
+        return s;
+    }
+    if (!info.sector_size) {
+        return XUDK_DEVICE_ERROR;
+    }
+    q = ctx->memory.alloc(ctx, sizeof(*q));
+    if (!q) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(q, 0, sizeof(*q));
+    q->disk_id = disk_id;
+    q->sector_size = info.sector_size;
+    q->total_sectors = info.total_sectors;
+    q->depth = depth;
+    q->max_transfer = max_transfer ? max_transfer : IO_DEFAULT_TRANSFER / info.sector_size;
+    q->max_transfer = q->max_transfer ? q->max_transfer : 1;
+    q->async = ctx->storage.read_sectors_async && ctx->storage.write_sectors_async && ctx->storage.complete_io;
+    *queue = q;
+    return XUDK_OK;
+}
+
+// Everything submitted completes first, callbacks included
+status xudk_io_queue_destroy(xudk_ctx *ctx, xudk_io_queue *queue) {
+    if (!queue) {
+        return XUDK_INVALID_PARAM;
+    }
+    xudk_io_wait(ctx, queue, null);
+    ctx->memory.free(ctx, queue);
+    return XUDK_OK;
+}
+
+status xudk_io_submit(xudk_ctx *ctx, xudk_io_queue *queue, xudk_io_request *request) {
+    u64 sectors = 0;
+
+    if (!queue || !request || !request->segments || !request->segment_count) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (u32 i = 0; i < request->segment_count; i++) {
+        if (!request->segments[i].buffer) {
+            return XUDK_INVALID_PARAM;
+        }
+        sectors += request->segments[i].sectors;
+    }
+    if (request->lba > queue->total_sectors || sectors > queue->total_sectors - request->lba) {
+        return XUDK_INVALID_PARAM;
+    }
+    request->result = XUDK_NOT_READY;
+    request->next = null;
+    request->next_lba = request->lba;
+    request->segment = 0;
+    request->segment_offset = 0;
+    request->in_flight = 0;
+    request->failure = XUDK_OK;
+    if (queue->tail) {
+        queue->tail->next = request;
+    } else {
+        queue->head = request;
+    }
+    queue->tail = request;
+    issue(ctx, queue);
+    return XUDK_OK;
+}
+
+// Collects finished transfers, issues queued ones and runs the callbacks of
+// finished requests, without blocking
+status xudk_io_poll(xudk_ctx *ctx, xudk_io_queue *queue, u32 *completed) {
+    u32 count;
+
+    if (!queue) {
+        return XUDK_INVALID_PARAM;
+    }
+    reap_all(ctx, queue);
+    issue(ctx, queue);
+    count = deliver(ctx, queue);
+    if (completed) {
+        *completed = count;
+    }
+    return XUDK_OK;
+}
+
+// Blocks until `request` is done and returns its result; a null request
+// waits for everything submitted
+status xudk_io_wait(xudk_ctx *ctx, xudk_io_queue *queue, xudk_io_request *request) {
+    if (!queue) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (;;) {
+        io_slot *slot = null;
+
+        xudk_io_poll(ctx, queue, null);
+        if (request ? request->result != XUDK_NOT_READY
+                    : !queue->head && !queue->in_flight && !queue->done_head) {
+            return request ? request->result : XUDK_OK;
+        }
+        // Block on one of the request's own transfers where it has one
+        for (u32 i = 0; i < queue->depth; i++) {
+            if (queue->slots[i].request && (!slot || queue->slots[i].request == request)) {
+                slot = &queue->slots[i];
+                if (slot->request == request) {
+                    break;
+                }
+            }
+        }
+        if (slot) {
+            reap(ctx, queue, slot, true);
+        }
+    }
+}
+
+// =============================================================================
+// READAHEAD
+// =============================================================================
+
+static void request_chunk(xudk_ctx *ctx, xudk_io_stream *stream, io_chunk *chunk) {
+    u64 left = stream->end_lba - stream->next_lba;
+
+    xudk_memset(&chunk->request, 0, sizeof(chunk->request));
+    chunk->segment.buffer = chunk->buffer;
+    chunk->segment.sectors = left < stream->chunk_sectors ? (u32)left : stream->chunk_sectors;
+    chunk->request.lba = stream->next_lba;
+    chunk->request.segments = &chunk->segment;
+    chunk->request.segment_count = 1;
+    // Cannot fail: the range was checked at open
+    xudk_io_submit(ctx, stream->queue, &chunk->request);
+    stream->next_lba += chunk->segment.sectors;
+    stream->pending++;
+}
+
+// `window` bytes, 0 for the default, are kept in flight in up to the queue's
+// depth of chunks
+status xudk_io_stream_open(xudk_ctx *ctx, xudk_io_queue *queue, u64 lba, u64 sectors, usize window,
+                           xudk_io_stream **stream) {
+    xudk_io_stream *st;
+    u32 chunk_count;
+
+    if (!queue || !stream || lba > queue->total_sectors || sectors > queue->total_sectors - lba) {
+        return XUDK_INVALID_PARAM;
+    }
+    window = window ? window : IO_STREAM_WINDOW;
+    chunk_count = queue->depth < IO_STREAM_MAX_CHUNKS ? queue->depth : IO_STREAM_MAX_CHUNKS;
+    chunk_count = chunk_count < 2 ? 2 : chunk_count;    // One read from while the next fills
+
+    st = ctx->memory.alloc(ctx, sizeof(*st));
+    if (!st) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(st, 0, sizeof(*st));
+    st->queue = queue;
+    st->next_lba = lba;
+    st->end_lba = lba + sectors;
+    st->chunk_count = chunk_count;
+    st->chunk_sectors = (u32)(window / queue->sector_size / chunk_count);
+    st->chunk_sectors = st->chunk_sectors ? st->chunk_sectors : 1;
+    for (u32 i = 0; i < chunk_count; i++) {
+        st->chunks[i].buffer = ctx->memory.alloc(ctx, (usize)st->chunk_sectors * queue->sector_size);
+        if (!st->chunks[i].buffer) {
+            xudk_io_stream_close(ctx, st);
+            return XUDK_OUT_OF_MEMORY;
+        }
+    }
+    for (u32 i = 0; i < chunk_count && st->next_lba < st->end_lba; i++) {
+        request_chunk(ctx, st, &st->chunks[i]);
+    }
+    *stream = st;
+    return XUDK_OK;
+}
+
+// Reads on from where the last read stopped; `read` falls short of `size`
+// only at the end of the stream
+status xudk_io_stream_read(xudk_ctx *ctx, xudk_io_stream *stream, void *buffer, usize size, usize *read) {
+    usize done = 0;
+    status s;
+
+    if (!stream || (!buffer && size)) {
+        return XUDK_INVALID_PARAM;
+    }
+    while (done < size && stream->pending) {
+        io_chunk *chunk = &stream->chunks[stream->front];
+        usize available, n;
+
+        s = xudk_io_wait(ctx, stream->queue, &chunk->request);
+        if (xudk_error(s)) {
+            if (read) {
+                *read = done;
+            }
+            return s;
+        }
+        available = (usize)chunk->segment.sectors * stream->queue->sector_size - stream->offset;
+        n = size - done < available ? size - done : available;
+        xudk_memcpy((u8*)buffer + done, chunk->buffer + stream->offset, n);
+        done += n;
+        stream->offset += n;
+        if (n == available) {
+            stream->offset = 0;
+            stream->pending--;
+            stream->front = (stream->front + 1) % stream->chunk_count;
+            if (stream->next_lba < stream->end_lba) {
+                request_chunk(ctx, stream, chunk);
+            }
+        }
+    }
+    if (read) {
+        *read = done;
+    }
+    return XUDK_OK;
+}
+
+// Reads still in flight finish first
+status xudk_io_stream_close(xudk_ctx *ctx, xudk_io_stream *stream) {
+    if (!stream) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (u32 i = 0; i < stream->pending; i++) {
+        xudk_io_wait(ctx, stream->queue, &stream->chunks[(stream->front + i) % stream->chunk_count].request);
+    }
+    for (u32 i = 0; i < stream->chunk_count; i++) {
+        if (stream->chunks[i].buffer) {
+            ctx->memory.free(ctx, stream->chunks[i].buffer);
+        }
+    }
+    ctx->memory.free(ctx, stream);
+    return XUDK_OK;
+}
@@ -0,0 +1,147 @@
+/*
+ * XUDK - Monotonic clock
+ * The processor's cycle counter, when it runs at one rate whatever the power
+ * state, scaled to nanoseconds. The rate is measured over a short firmware
+ * stall on first use, then again against get_time as the clock runs: each
+ * tick of the firmware clock is located between two reads of it, and two
+ * ticks far enough apart give a rate whose error is the width of those
+ * brackets over the distance between them. A better rate takes over from the
+ * current value, so the clock never steps back. One that disagrees with the
+ * current rate by more than their errors allow means the firmware clock was
+ * set in between, and measuring starts again from there. UEFI clocks often tick once
+ * a second, so the rate settles over the first minutes of reading it.
+ * Without such a counter the firmware clock is read directly, held from
+ * running backwards across set_time.
+ * The state is the machine's, not the context's; read it from the BSP.
+ */
+
+#include "core.h"
+
+#define CLOCK_STALL_US      2000        // First measurement
+#define CLOCK_POLL_NS       1000000     // get_time is read at most this often
+#define CLOCK_PRECISION     1000        // Brackets must be this much narrower than the span they measure
+#define CLOCK_STALL_ERROR   0.5         // The stall is accepted as timed within a factor of 2
+#define CLOCK_AGREEMENT     4           // Rates further apart than this many errors disagree
+
+typedef struct {
+    bool            started;
+    bool            refining;           // get_time is there to measure against
+    u64             cycles_per_second;  // 0 when the firmware clock is read instead
+    u64             base_cycles;        // The current rate runs from here
+    u64             base_ns;
+    u64             last_ns;            // Firmware clock only: last value returned
+    u64             poll_cycles;        // Counter at the last get_time
+    u64             poll_ns;
+    u64             firmware;           // Firmware nanoseconds read then
+    u64             tick_cycles;        // Best located firmware tick so far, 0 before one
+    u64             tick_firmware;
+    u64             tick_bracket;       // Cycles between the reads around it
+    double          error;              // Relative error of the rate in use
+    double          bound;              // How far off the rate in use may actually be
+    u64             offset;             // Firmware clock only: set_time steps taken back out
+} monotonic_clock;
+
+static monotonic_clock clock_state;
+
+static bool firmware_ns(xudk_ctx *ctx, u64 *ns) {
+    xudk_time_info now;
+
+    if (!ctx->system.get_time || xudk_error(ctx->system.get_time(ctx, &now))) {
+        return false;
+    }
+    *ns = now.timestamp * 1000000000ULL + now.nanosecond;
+    return true;
+}
+
+static u64 cycles_to_ns(u64 cycles, u64 cycles_per_second) {
+    return cycles / cycles_per_second * 1000000000ULL + cycles % cycles_per_second * 1000000000ULL / cycles_per_second;
+}
+
+// A firmware clock fine enough to time the stall measures it better than the
+// stall's nominal length, which a hosted sleep overshoots. Each counter read
+// comes just before a firmware read, so both see the same call latency.
+static void start(xudk_ctx *ctx, monotonic_clock *clock) {
+    u64 begin = xudk_cpu_cycles(), before = 0, after = 0, elapsed = CLOCK_STALL_US * 1000ULL;
+    bool timed;
+
+    xudk_memset(clock, 0, sizeof(*clock));
+    clock->started = true;
+    if (!(xudk_cpu_features() & XUDK_CPU_INVARIANT_TSC) || !begin || !ctx->system.delay) {
+        return;
+    }
+    begin = xudk_cpu_cycles();
+    timed = firmware_ns(ctx, &before);
+    ctx->system.delay(ctx, CLOCK_STALL_US);
+    clock->base_cycles = xudk_cpu_cycles();
+    if (timed && firmware_ns(ctx, &after) && after - before >= elapsed / 2 && after - before <= elapsed * 2) {
+        elapsed = after - before;
+    }
+    clock->cycles_per_second = (u64)((double)(clock->base_cycles - begin) * 1e9 / (double)elapsed);
+    clock->poll_cycles = clock->base_cycles;
+    clock->error = 1.0 / CLOCK_PRECISION;   // What a refined rate has to beat
+    clock->bound = CLOCK_STALL_ERROR;
+    clock->refining = timed;
+    clock->firmware = after;
+}
+
+// A changed firmware reading means it ticked since the previous one
+static void refine(xudk_ctx *ctx, monotonic_clock *clock, u64 cycles, u64 ns) {
+    u64 firmware, bracket, span, rate;
+    double error, off;
+
+    clock->poll_ns = ns;
+    if (!firmware_ns(ctx, &firmware) || firmware == clock->firmware) {
+        clock->poll_cycles = cycles;
+        return;
+    }
+    bracket = cycles - clock->poll_cycles;
+    clock->poll_cycles = cycles;
+    clock->firmware = firmware;
+    if (clock->tick_cycles && firmware > clock->tick_firmware) {
+        span = cycles - clock->tick_cycles;
+        error = (double)(bracket + clock->tick_bracket) / (double)span;
+        rate = (u64)((double)span * 1e9 / (double)(firmware - clock->tick_firmware));
+        off = (double)rate / (double)clock->cycles_per_second - 1.0;
+        if (off > CLOCK_AGREEMENT * (error + clock->bound) || -off > CLOCK_AGREEMENT * (error + clock->bound)) {
+            clock->tick_cycles = 0;     // Stepped: the tick taken below starts over
+        } else if (error < clock->error) {
+            clock->base_ns = ns;
+            clock->base_cycles = cycles;
+            clock->cycles_per_second = rate;
+            clock->error = error;
+            clock->bound = error;
+        }
+    }
+    // Halving the bracket is worth the distance lost, and can only happen so often
+    if (!clock->tick_cycles || bracket < clock->tick_bracket / 2 || firmware < clock->tick_firmware) {
+        clock->tick_cycles = cycles;
+        clock->tick_firmware = firmware;
+        clock->tick_bracket = bracket;
+    }
+}
+
+u64 xudk_time_ns(xudk_ctx *ctx) {
+    monotonic_clock *clock = &clock_state;
+    u64 cycles, ns, firmware;
+
+    if (!clock->started) {
+        start(ctx, clock);
+    }
+    if (!clock->cycles_per_second) {
+        if (!firmware_ns(ctx, &firmware)) {
+            return clock->last_ns;
+        }
+        if (firmware + clock->offset < clock->last_ns) {
+            clock->offset = clock->last_ns - firmware;
+        }
+        clock->last_ns = firmware + clock->offset;
+        return clock->last_ns;
+    }
+
+    cycles = xudk_cpu_cycles();
+    ns = clock->base_ns + cycles_to_ns(cycles - clock->base_cycles, clock->cycles_per_second);
+    if (clock->refining && ns - clock->poll_ns >= CLOCK_POLL_NS) {
+        refine(ctx, clock, cycles, ns);
+    }
+    return ns;
+}
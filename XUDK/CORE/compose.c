@@ -0,0 +1,446 @@
+/*
+ * XUDK - Back buffer compositor for xudk_graphics
+ * While enabled, the draw entries render into a system-RAM copy of the screen
+ * and record damaged rectangles. present() merges the damage and copies just
+ * those regions to the framebuffer with non-temporal stores, so VRAM is only
+ * written in whole rows of finished pixels. Without a mapped framebuffer each
+ * region goes to the backend's copy_buffer as one packed call.
+ */
+
+#include "core.h"
+
+#define COMPOSE_MAX_RECTS   16
+#define COMPOSE_MERGE_SLACK (64 * 64)   // Wasted pixels accepted to merge two rects
+
+// Half-open pixel rectangle
+typedef struct {
+    u32             x0, y0, x1, y1;
+} compose_rect;
+
+typedef struct {
+    xudk_graphics   backend;        // Entries the compositor replaced
+    xudk_surface    back;           // Back buffer in system RAM
+    xudk_surface    front;          // Framebuffer, pixels null when it is not mapped
+    compose_rect    damage[COMPOSE_MAX_RECTS];
+    u32             damage_count;
+    u32*            staging;        // A region packed for copy_buffer
+    usize           staging_pixels;
+} compose_state;
+
+static compose_state* compose_of(xudk_ctx *ctx) {
+    return ctx->graphics_compositor;
+}
+
+// =============================================================================
+// DAMAGE
+// =============================================================================
+
+static u64 rect_area(const compose_rect *r) {
+    return (u64)(r->x1 - r->x0) * (r->y1 - r->y0);
+}
+
+static compose_rect rect_union(const compose_rect *a, const compose_rect *b) {
+    compose_rect u;
+    u.x0 = a->x0 < b->x0 ? a->x0 : b->x0;
+    u.y0 = a->y0 < b->y0 ? a->y0 : b->y0;
+    u.x1 = a->x1 > b->x1 ? a->x1 : b->x1;
+    u.y1 = a->y1 > b->y1 ? a->y1 : b->y1;
+    return u;
+}
+
+// Pixels the union of a and b covers beyond a and b themselves (overlap counts as negative)
+static i64 merge_waste(const compose_rect *a, const compose_rect *b) {
+    compose_rect u = rect_union(a, b);
+    return (i64)rect_area(&u) - (i64)rect_area(a) - (i64)rect_area(b);
+}
+
+static void damage_add(compose_state *c, u32 x, u32 y, u32 width, u32 height) {
+    compose_rect r;
+    u32 best = 0;
+    i64 best_waste = 0;
+
+    if (x >= c->back.width || y >= c->back.height || !width || !height) {
+        return;
+    }
+    r.x0 = x;
+    r.y0 = y;
+    r.x1 = width < c->back.width - x ? x + width : c->back.width;
+    r.y1 = height < c->back.height - y ? y + height : c->back.height;
+
+    for (u32 i = 0; i < c->damage_count; i++) {
+        i64 waste = merge_waste(&c->damage[i], &r);
+        if (i == 0 || waste < best_waste) {
+            best = i;
+            best_waste = waste;
+        }
+    }
+    if (c->damage_count && (best_waste <= COMPOSE_MERGE_SLACK || c->damage_count == COMPOSE_MAX_RECTS)) {
+        c->damage[best] = rect_union(&c->damage[best], &r);
+        return;
+    }
+    c->damage[c->damage_count++] = r;
+}
+
+// Merging can make rects overlap others. Overlapping rects cheap to merge are
+// folded; others stay apart, and the pixels they share are copied twice.
+static void damage_coalesce(compose_state *c) {
+    bool merged = true;
+
+    while (merged) {
+        merged = false;
+        for (u32 i = 0; i < c->damage_count; i++) {
+            for (u32 j = i + 1; j < c->damage_count; j++) {
+                if (merge_waste(&c->damage[i], &c->damage[j]) <= COMPOSE_MERGE_SLACK) {
+                    c->damage[i] = rect_union(&c->damage[i], &c->damage[j]);
+                    c->damage[j--] = c->damage[--c->damage_count];
+                    merged = true;
+                }
+            }
+        }
+    }
+}
+
+// One damage rect around a whole batch; a batch is usually one widget or effect
+static void damage_extend(compose_rect *bounds, u32 x, u32 y, u32 width, u32 height) {
+    compose_rect r;
+
+    if (!width || !height) {
+        return;
+    }
+    r.x0 = x;
+    r.y0 = y;
+    r.x1 = width < 0xFFFFFFFFu - x ? x + width : 0xFFFFFFFFu;
+    r.y1 = height < 0xFFFFFFFFu - y ? y + height : 0xFFFFFFFFu;
+    *bounds = bounds->x1 ? rect_union(bounds, &r) : r;
+}
+
+static void damage_add_bounds(compose_state *c, const compose_rect *bounds) {
+    if (bounds->x1) {
+        damage_add(c, bounds->x0, bounds->y0, bounds->x1 - bounds->x0, bounds->y1 - bounds->y0);
+    }
+}
+
+// =============================================================================
+// DRAWING INTO THE BACK BUFFER
+// =============================================================================
+
+static status compose_get_framebuffer(xudk_ctx *ctx, addr *base, usize *size) {
+    compose_state *c = compose_of(ctx);
+
+    if (!base || !size) {
+        return XUDK_INVALID_PARAM;
+    }
+    *base = (addr)(usize)c->back.pixels;
+    *size = (usize)c->back.stride * c->back.height * sizeof(u32);
+    return XUDK_OK;
+}
+
+static status compose_draw_pixel(xudk_ctx *ctx, u32 x, u32 y, u32 color) {
+    compose_state *c = compose_of(ctx);
+    status s = xudk_surface_pixel(&c->back, x, y, color);
+
+    if (xudk_ok(s)) {
+        damage_add(c, x, y, 1, 1);
+    }
+    return s;
+}
+
+static status compose_draw_rectangle(xudk_ctx *ctx, u32 x, u32 y, u32 width, u32 height, u32 color) {
+    compose_state *c = compose_of(ctx);
+    status s = xudk_surface_fill(&c->back, x, y, width, height, color);
+
+    if (xudk_ok(s)) {
+        damage_add(c, x, y, width, height);
+    }
+    return s;
+}
+
+static status compose_draw_text(xudk_ctx *ctx, u32 x, u32 y, const wchar *text, u32 color) {
+    compose_state *c = compose_of(ctx);
+    status s = xudk_surface_text(&c->back, x, y, text, color);
+    u32 width, height;
+
+    if (xudk_ok(s)) {
+        xudk_text_measure(null, text, &width, &height);
+        damage_add(c, x, y, width, height);
+    }
+    return s;
+}
+
+static status compose_load_bitmap(xudk_ctx *ctx, const wchar *path, u32 x, u32 y) {
+    compose_state *c = compose_of(ctx);
+    u32 width = 0, height = 0;
+    status s = xudk_surface_load_image(ctx, &c->back, path, x, y, &width, &height);
+
+    damage_add(c, x, y, width, height);    // A failed decode may still have drawn rows
+    return s;
+}
+
+static status compose_copy_buffer(xudk_ctx *ctx, const void *buffer, u32 x, u32 y, u32 width, u32 height) {
+    compose_state *c = compose_of(ctx);
+    status s = xudk_surface_copy(&c->back, buffer, x, y, width, height);
+
+    if (xudk_ok(s)) {
+        damage_add(c, x, y, width, height);
+    }
+    return s;
+}
+
+static status compose_fill_spans(xudk_ctx *ctx, const xudk_span *spans, usize count) {
+    compose_state *c = compose_of(ctx);
+    status s = xudk_surface_fill_spans(&c->back, spans, count);
+    compose_rect bounds = { 0 };
+
+    if (xudk_ok(s)) {
+        for (usize i = 0; i < count; i++) {
+            damage_extend(&bounds, spans[i].x, spans[i].y, spans[i].length, 1);
+        }
+        damage_add_bounds(c, &bounds);
+    }
+    return s;
+}
+
+static status compose_fill_rects(xudk_ctx *ctx, const xudk_fill_rect *rects, usize count) {
+    compose_state *c = compose_of(ctx);
+    status s = xudk_surface_fill_rects(&c->back, rects, count);
+    compose_rect bounds = { 0 };
+
+    if (xudk_ok(s)) {
+        for (usize i = 0; i < count; i++) {
+            damage_extend(&bounds, rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+        }
+        damage_add_bounds(c, &bounds);
+    }
+    return s;
+}
+
+static status compose_plot_points(xudk_ctx *ctx, const xudk_point *points, usize count) {
+    compose_state *c = compose_of(ctx);
+    status s = xudk_surface_plot_points(&c->back, points, count);
+    compose_rect bounds = { 0 };
+
+    if (xudk_ok(s)) {
+        for (usize i = 0; i < count; i++) {
+            damage_extend(&bounds, points[i].x, points[i].y, 1, 1);
+        }
+        damage_add_bounds(c, &bounds);
+    }
+    return s;
+}
+
+static status compose_draw_text_runs(xudk_ctx *ctx, const xudk_font *font, const xudk_text_run *runs, usize count) {
+    compose_state *c = compose_of(ctx);
+    status s = xudk_surface_text_runs(&c->back, font, runs, count);
+    compose_rect bounds = { 0 };
+    u32 width, height;
+
+    if (xudk_ok(s)) {
+        for (usize i = 0; i < count; i++) {
+            xudk_text_measure(font, runs[i].text, &width, &height);
+            damage_extend(&bounds, runs[i].x, runs[i].y, width, height);
+        }
+        damage_add_bounds(c, &bounds);
+    }
+    return s;
+}
+
+// =============================================================================
+// BACK BUFFER LIFETIME
+// =============================================================================
+
+// Size the back buffer after the backend's current mode and seed it with
+// what is on screen, which is the only time the framebuffer is read
+static status compose_attach(xudk_ctx *ctx, compose_state *c) {
+    xudk_graphics_mode mode;
+    addr base;
+    usize size;
+    status s;
+
+    s = c->backend.get_mode(ctx, &mode);
+    if (xudk_error(s)) {
+        return s;
+    }
+    if (xudk_error(c->backend.get_framebuffer(ctx, &base, &size))) {
+        base = 0;
+    }
+
+    c->front.pixels = (u32*)(usize)base;
+    c->front.width = mode.horizontal_resolution;
+    c->front.height = mode.vertical_resolution;
+    c->front.stride = mode.pixels_per_scanline;
+    c->front.pixel_format = mode.pixel_format;
+    c->back = c->front;
+    c->back.pixels = ctx->memory.alloc_type(ctx, (usize)c->back.stride * c->back.height * sizeof(u32),
+                                            XUDK_MEM_LOADER_DATA);
+    if (!c->back.pixels) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    if (c->front.pixels) {
+        xudk_memcpy(c->back.pixels, c->front.pixels, (usize)c->back.stride * c->back.height * sizeof(u32));
+    } else {
+        xudk_memset(c->back.pixels, 0, (usize)c->back.stride * c->back.height * sizeof(u32));
+    }
+    c->damage_count = 0;
+    return XUDK_OK;
+}
+
+// Hand the draw entries back to the backend and drop the back buffer
+static void compose_detach(xudk_ctx *ctx, compose_state *c) {
+    ctx->graphics.get_framebuffer = c->backend.get_framebuffer;
+    ctx->graphics.set_mode = c->backend.set_mode;
+    ctx->graphics.draw_pixel = c->backend.draw_pixel;
+    ctx->graphics.draw_rectangle = c->backend.draw_rectangle;
+    ctx->graphics.draw_text = c->backend.draw_text;
+    ctx->graphics.load_bitmap = c->backend.load_bitmap;
+    ctx->graphics.copy_buffer = c->backend.copy_buffer;
+    ctx->graphics.fill_spans = c->backend.fill_spans;
+    ctx->graphics.fill_rects = c->backend.fill_rects;
+    ctx->graphics.plot_points = c->backend.plot_points;
+    ctx->graphics.draw_text_runs = c->backend.draw_text_runs;
+    ctx->graphics_compositor = null;
+    if (c->back.pixels) {
+        ctx->memory.free(ctx, c->back.pixels);
+    }
+    if (c->staging) {
+        ctx->memory.free(ctx, c->staging);
+    }
+    ctx->memory.free(ctx, c);
+}
+
+// The new mode gets a fresh back buffer; without one, drawing goes direct again
+static status compose_set_mode(xudk_ctx *ctx, u32 mode_number) {
+    compose_state *c = compose_of(ctx);
+    status s = c->backend.set_mode(ctx, mode_number);
+
+    if (xudk_error(s)) {
+        return s;
+    }
+    ctx->memory.free(ctx, c->back.pixels);
+    c->back.pixels = null;
+    s = compose_attach(ctx, c);
+    if (xudk_error(s)) {
+        compose_detach(ctx, c);
+    }
+    return s;
+}
+
+// One copy_buffer for the region: straight from the back buffer when its rows
+// are contiguous there, else packed into staging. Should staging not grow,
+// the rows go one call each.
+static status compose_copy_region(xudk_ctx *ctx, compose_state *c, const compose_rect *r) {
+    u32 width = r->x1 - r->x0, height = r->y1 - r->y0;
+    const u32 *src = c->back.pixels + (usize)r->y0 * c->back.stride + r->x0;
+    usize pixels = (usize)width * height;
+    status s = XUDK_OK;
+
+    if (width == c->back.stride || height == 1) {
+        return c->backend.copy_buffer(ctx, src, r->x0, r->y0, width, height);
+    }
+    if (pixels > c->staging_pixels) {
+        u32 *grown = ctx->memory.alloc(ctx, pixels * sizeof(u32));
+        if (grown) {
+            if (c->staging) {
+                ctx->memory.free(ctx, c->staging);
+            }
+            c->staging = grown;
+            c->staging_pixels = pixels;
+        }
+    }
+    if (pixels <= c->staging_pixels) {
+        for (u32 y = 0; y < height; y++) {
+            xudk_memcpy(c->staging + (usize)y * width, src + (usize)y * c->back.stride, width * sizeof(u32));
+        }
+        return c->backend.copy_buffer(ctx, c->staging, r->x0, r->y0, width, height);
+    }
+    for (u32 y = 0; y < height && xudk_ok(s); y++) {
+        s = c->backend.copy_buffer(ctx, src + (usize)y * c->back.stride, r->x0, r->y0 + y, width, 1);
+    }
+    return s;
+}
+
+// Every region is copied even after one fails; the first failure is returned
+static status compose_present(xudk_ctx *ctx) {
+    compose_state *c = compose_of(ctx);
+    status result = XUDK_OK;
+
+    if (!c) {
+        return XUDK_OK;
+    }
+    damage_coalesce(c);
+    for (u32 i = 0; i < c->damage_count; i++) {
+        const compose_rect *r = &c->damage[i];
+        usize row_bytes = (usize)(r->x1 - r->x0) * sizeof(u32);
+
+        if (c->front.pixels) {
+            for (u32 y = r->y0; y < r->y1; y++) {
+                xudk_memcpy_stream(c->front.pixels + (usize)y * c->front.stride + r->x0,
+                                   c->back.pixels + (usize)y * c->back.stride + r->x0, row_bytes);
+            }
+        } else {
+            status s = compose_copy_region(ctx, c, r);
+            if (xudk_error(s) && xudk_ok(result)) {
+                result = s;
+            }
+        }
+    }
+    c->damage_count = 0;
+    return result;
+}
+
+static status compose_invalidate(xudk_ctx *ctx, u32 x, u32 y, u32 width, u32 height) {
+    compose_state *c = compose_of(ctx);
+
+    if (c) {
+        damage_add(c, x, y, width, height);
+    }
+    return XUDK_OK;
+}
+
+static status compose_enable(xudk_ctx *ctx, bool enable) {
+    compose_state *c = compose_of(ctx);
+    status s;
+
+    if (enable == (c != null)) {
+        return XUDK_OK;
+    }
+    if (!enable) {
+        compose_present(ctx);
+        compose_detach(ctx, c);
+        return XUDK_OK;
+    }
+
+    if (!ctx->graphics.get_mode) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    c = ctx->memory.alloc(ctx, sizeof(*c));
+    if (!c) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(c, 0, sizeof(*c));
+    c->backend = ctx->graphics;
+    s = compose_attach(ctx, c);
+    if (xudk_error(s)) {
+        ctx->memory.free(ctx, c);
+        return s;
+    }
+
+    ctx->graphics_compositor = c;
+    ctx->graphics.get_framebuffer = compose_get_framebuffer;
+    ctx->graphics.set_mode = compose_set_mode;
+    ctx->graphics.draw_pixel = compose_draw_pixel;
+    ctx->graphics.draw_rectangle = compose_draw_rectangle;
+    ctx->graphics.draw_text = compose_draw_text;
+    ctx->graphics.load_bitmap = compose_load_bitmap;
+    ctx->graphics.copy_buffer = compose_copy_buffer;
+    ctx->graphics.fill_spans = compose_fill_spans;
+    ctx->graphics.fill_rects = compose_fill_rects;
+    ctx->graphics.plot_points = compose_plot_points;
+    ctx->graphics.draw_text_runs = compose_draw_text_runs;
+    return XUDK_OK;
+}
+
+void xudk_compositor_install(xudk_graphics *graphics) {
+    graphics->enable_back_buffer = compose_enable;
+    graphics->invalidate = compose_invalidate;
+    graphics->present = compose_present;
+}
@@ -0,0 +1,306 @@
+/*
+ * XUDK - Core runtime internals
+ * Shared between the portable core and the platform backends.
+ * Not part of the public API; applications include uefi.h only.
+ */
+
+#ifndef XUDK_CORE_H
+#define XUDK_CORE_H
+
+#include "xudk/uefi.h"
+
+// =============================================================================
+// CONTEXT INTERNALS
+// =============================================================================
+
+// Free every xudk_memalloc_tracked() allocation; called from xudk_cleanup(),
+// which reports what was still live first when debug_level >= 2
+void xudk_release_tracked(xudk_ctx *ctx);
+
+// =============================================================================
+// PORTABILITY
+// =============================================================================
+
+// Vector code is compiled per function with a target attribute so the rest
+// of the image stays baseline; callers check xudk_cpu_features() first
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define XUDK_X86                1
+#if defined(_MSC_VER) && !defined(__clang__)
+#define XUDK_TARGET(isa)
+#else
+#define XUDK_TARGET(isa)        __attribute__((target(isa)))
+#endif
+#endif
+
+// Alias-safe types for unaligned loads and stores
+#if defined(__GNUC__)
+typedef u64 xudk_unaligned_u64 __attribute__((aligned(1), may_alias));
+typedef u32 xudk_unaligned_u32 __attribute__((aligned(1), may_alias));
+#else
+typedef u64 xudk_unaligned_u64;
+typedef u32 xudk_unaligned_u32;
+#endif
+
+// =============================================================================
+// CPU FEATURES
+// =============================================================================
+
+#define XUDK_CPU_SSE2       (1u << 0)
+#define XUDK_CPU_SSE42      (1u << 1)
+#define XUDK_CPU_PCLMUL     (1u << 2)   // Carry-less multiply
+#define XUDK_CPU_AVX2       (1u << 3)   // Only when YMM state is enabled
+#define XUDK_CPU_AVX512     (1u << 4)   // AVX-512 F and BW, only when ZMM state is enabled
+#define XUDK_CPU_ERMS       (1u << 5)   // Fast rep movsb / rep stosb
+#define XUDK_CPU_INVARIANT_TSC (1u << 6) // Timestamp counter runs at one rate in every P-, C- and T-state
+
+// XUDK_CPU_* bits of the running processor, detected on first call; 0 off x86
+u32 xudk_cpu_features(void);
+
+// Processor timestamp counter, for ordering and coarse timing; 0 off x86
+u64 xudk_cpu_cycles(void);
+
+// =============================================================================
+// MEMORY PRIMITIVES
+// =============================================================================
+
+// Copies and fills at least this large use non-temporal stores, so multi-MB
+// moves and clears do not evict the working set from the cache
+#define XUDK_MEM_STREAM_THRESHOLD   (4 * 1024 * 1024)
+
+// One implementation of xudk_memcpy / xudk_memset / xudk_memcmp
+typedef struct {
+    const char*     name;
+    u32             features;       // XUDK_CPU_* bits required
+    void            (*copy)(void *dst, const void *src, usize size);
+    void            (*set)(void *ptr, u8 value, usize size);
+    int             (*compare)(const void *s1, const void *s2, usize size);
+    void            (*stream)(void *dst, const void *src, usize size);  // Non-temporal, no overlap
+} xudk_mem_impl;
+
+// Every implementation built in, scalar first and fastest last
+const xudk_mem_impl* xudk_mem_impls(usize *count);
+
+// Point the xudk_mem* functions at the fastest implementation this CPU
+// supports; called by xudk_init, the scalar one is used until then
+void xudk_mem_init(void);
+
+// Fill the arena_* entries of a memory vtable; chunks come from its alloc_type/free
+void xudk_arena_install(xudk_memory *memory);
+
+// Put the size-class slab allocator in front of ctx->memory.alloc/free once
+// the backend has filled them in; the backend keeps serving spans and large blocks
+status xudk_slab_install(xudk_ctx *ctx);
+
+// Release every span and large block and restore the backend alloc/free
+void xudk_slab_shutdown(xudk_ctx *ctx);
+
+// =============================================================================
+// CHECKSUMS
+// =============================================================================
+
+// One implementation of xudk_crc32_update
+typedef struct {
+    const char*     name;
+    u32             features;       // XUDK_CPU_* bits required
+    u32             (*update)(u32 crc, const void *data, usize size);
+} xudk_crc32_impl;
+
+// One implementation of xudk_hash64; all of them return the same value
+typedef struct {
+    const char*     name;
+    u32             features;
+    u64             (*hash)(const void *data, usize size);
+} xudk_hash64_impl;
+
+// Every implementation built in, plain table first and fastest last
+const xudk_crc32_impl*  xudk_crc32_impls(usize *count);
+const xudk_hash64_impl* xudk_hash64_impls(usize *count);
+
+// Pick the fastest supported CRC and hash kernels; called by xudk_init
+void xudk_checksum_init(void);
+
+// =============================================================================
+// BUILT-IN FONT
+// =============================================================================
+
+// 5x7 bitmap font covering printable ASCII, one byte per row (bit 4 = left)
+#define XUDK_FONT_WIDTH     5
+#define XUDK_FONT_HEIGHT    7
+#define XUDK_FONT_ADVANCE   6   // Horizontal cell size in pixels
+#define XUDK_FONT_LINE      9   // Vertical cell size in pixels
+
+#define XUDK_FONT_GLYPHS    95  // 0x20..0x7E
+#define XUDK_FONT_SCALE_MAX 16
+
+// Glyph rows for a character; unknown characters map to '?'
+const u8* xudk_font_glyph(wchar c);
+
+// Where a glyph's ink sits in the atlas and in its character cell
+typedef struct {
+    u16             atlas_x;
+    u16             atlas_y;
+    u8              width;          // 0 for blank glyphs
+    u8              height;
+    u8              left;           // Offset from the cell's top-left corner
+    u8              top;
+} xudk_glyph;
+
+struct xudk_font {
+    u32             scale;
+    u32             flags;          // XUDK_FONT_*
+    u32             advance;        // Horizontal cell size in pixels
+    u32             line;           // Vertical cell size in pixels
+    u32             atlas_width;
+    u32             atlas_height;
+    u8*             atlas;          // 8-bit coverage, atlas_width bytes per row
+    xudk_glyph      glyphs[XUDK_FONT_GLYPHS];
+};
+
+// Rasterize the built-in 1x atlas; called by xudk_init
+void xudk_font_init(void);
+
+// The font draw_text uses and null stands for
+const xudk_font* xudk_font_builtin(void);
+
+static inline const xudk_glyph* xudk_font_lookup(const xudk_font *font, wchar c) {
+    if (c < 0x20 || c > 0x7E) {
+        c = L'?';
+    }
+    return &font->glyphs[c - 0x20];
+}
+
+// =============================================================================
+// PIXEL HELPERS
+// =============================================================================
+
+// Colors are passed around as 0xAARRGGBB; framebuffers are either BGRX
+// (pixel_format 1) or RGBX (pixel_format 0) in memory.
+#define XUDK_PIXEL_RGBX     0
+#define XUDK_PIXEL_BGRX     1
+
+static inline u32 xudk_color_to_pixel(u32 color, u32 pixel_format) {
+    if (pixel_format == XUDK_PIXEL_RGBX) {
+        return (color & 0xFF00FF00u) | ((color >> 16) & 0xFF) | ((color & 0xFF) << 16);
+    }
+    return color;
+}
+
+// Source-over for a single pixel, same rounding as the row kernels; two
+// channels at a time in 16-bit lanes, which cannot carry into each other
+static inline u32 xudk_pixel_blend(u32 dst, u32 pixel, u32 alpha) {
+    u32 ia = 255 - alpha;
+    u32 rb = (dst & 0x00FF00FFu) * ia + (pixel & 0x00FF00FFu) * alpha + 0x00800080u;
+    u32 ag = ((dst >> 8) & 0x00FF00FFu) * ia + ((pixel >> 8) & 0x00FF00FFu) * alpha + 0x00800080u;
+
+    rb = ((rb + ((rb >> 8) & 0x00FF00FFu)) >> 8) & 0x00FF00FFu;
+    ag = (ag + ((ag >> 8) & 0x00FF00FFu)) & 0xFF00FF00u;
+    return rb | ag;
+}
+
+// =============================================================================
+// PIXEL KERNELS
+// =============================================================================
+
+// One implementation of the row kernels behind the surface fills. `pixel` is
+// already in the surface's byte order; blend is source-over with 0 < alpha < 255.
+typedef struct {
+    const char*     name;
+    u32             features;       // XUDK_CPU_* bits required
+    void            (*fill)(u32 *row, u32 pixel, usize count);
+    void            (*blend)(u32 *row, u32 pixel, u32 alpha, usize count);
+    void            (*swap_rb)(u32 *dst, const u32 *src, usize count);     // RGBX <-> BGRX, may be in place
+    void            (*expand24)(u32 *dst, const u8 *src, usize count);     // 3-byte pixels, alpha 0xFF
+} xudk_pixel_impl;
+
+// Every implementation built in, scalar first and fastest last
+const xudk_pixel_impl* xudk_pixel_impls(usize *count);
+
+// Kernels picked by xudk_pixel_init (scalar until then)
+const xudk_pixel_impl* xudk_pixel_kernels(void);
+
+// Pick the fastest supported row kernels; called by xudk_init
+void xudk_pixel_init(void);
+
+// =============================================================================
+// SURFACES
+// =============================================================================
+
+// 32-bit pixels in memory: a mapped framebuffer or a back buffer in RAM
+typedef struct {
+    u32*            pixels;
+    u32             width;
+    u32             height;
+    u32             stride;         // Pixels per row
+    u32             pixel_format;   // XUDK_PIXEL_*
+} xudk_surface;
+
+// Clipped drawing with the xudk_graphics semantics: an origin outside the
+// surface is XUDK_INVALID_PARAM, anything hanging off the edge is cut
+status xudk_surface_pixel(const xudk_surface *surface, u32 x, u32 y, u32 color);
+status xudk_surface_fill(const xudk_surface *surface, u32 x, u32 y, u32 width, u32 height, u32 color);
+status xudk_surface_text(const xudk_surface *surface, u32 x, u32 y, const wchar *text, u32 color);  // Opaque, built-in font
+status xudk_surface_copy(const xudk_surface *surface, const u32 *src, u32 x, u32 y, u32 width, u32 height);
+
+// Batches clip each entry and skip the ones outside the surface; colors with
+// alpha below 0xFF are blended over what is there, alpha 0 draws nothing
+status xudk_surface_fill_spans(const xudk_surface *surface, const xudk_span *spans, usize count);
+status xudk_surface_fill_rects(const xudk_surface *surface, const xudk_fill_rect *rects, usize count);
+status xudk_surface_plot_points(const xudk_surface *surface, const xudk_point *points, usize count);
+status xudk_surface_text_runs(const xudk_surface *surface, const xudk_font *font,
+                              const xudk_text_run *runs, usize count);
+
+// BMP, PNG or QOI decoded straight onto the surface, translucent pixels
+// blended; the drawn size after clipping is optional
+status xudk_surface_load_image(xudk_ctx *ctx, const xudk_surface *surface, const wchar *path,
+                               u32 x, u32 y, u32 *drawn_width, u32 *drawn_height);
+
+// =============================================================================
+// IMAGE DECODERS
+// =============================================================================
+
+// Streaming BMP (24/32-bit), QOI and PNG (non-interlaced) decoding: the file
+// is read in small chunks and each row lands on the target as it is decoded
+typedef struct xudk_image xudk_image;
+
+typedef struct {
+    u32             width;
+    u32             height;
+    bool            alpha;          // Pixels may be translucent
+} xudk_image_info;
+
+#define XUDK_IMAGE_BLEND    0x1     // Blend translucent pixels over the target instead of storing them
+
+// Reads the header; the format comes from the file's magic bytes
+status xudk_image_open(xudk_ctx *ctx, const wchar *path, xudk_image **image, xudk_image_info *info);
+
+// Decode once, with the image's top-left corner at (x, y); rows are clipped
+status xudk_image_decode(xudk_image *image, const xudk_surface *target, u32 x, u32 y, u32 flags);
+void   xudk_image_close(xudk_image *image);
+
+// =============================================================================
+// BLOCK COMPRESSION
+// =============================================================================
+
+// One implementation of the BCn encoder's palette matching: for each of 16
+// pixels, the nearest of `palette_count` entries over the bytes in `mask`.
+// Writes 16 indices and returns the summed squared error.
+typedef struct {
+    const char*     name;
+    u32             features;       // XUDK_CPU_* bits required
+    u32             (*select)(const u32 *pixels, const u32 *palette, u32 palette_count, u32 mask, u8 *indices);
+} xudk_bcn_impl;
+
+// Every implementation built in, scalar first and fastest last
+const xudk_bcn_impl* xudk_bcn_impls(usize *count);
+
+// Kernel picked by xudk_bcn_init (scalar until then)
+const xudk_bcn_impl* xudk_bcn_kernels(void);
+
+// Pick the fastest supported kernel; called by xudk_init
+void xudk_bcn_init(void);
+
+// Fill the back buffer entries of a graphics vtable; the backend must
+// provide get_mode, get_framebuffer and copy_buffer
+void xudk_compositor_install(xudk_graphics *graphics);
+
+#endif // XUDK_CORE_H
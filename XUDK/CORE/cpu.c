@@ -0,0 +1,110 @@
+/*
+ * XUDK - CPU feature detection
+ * Queried once through CPUID; vector extensions are only reported when the
+ * firmware or OS has enabled their register state in XCR0.
+ */
+
+#include "core.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define XUDK_CPU_X86    1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define XUDK_CPU_X86    1
+#endif
+
+#if XUDK_CPU_X86
+
+static void cpuid(u32 leaf, u32 subleaf, u32 regs[4]) {
+#if defined(_MSC_VER)
+    __cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static u64 xgetbv0(void) {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    u32 lo, hi;
+    __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((u64)hi << 32) | lo;
+#endif
+}
+
+static u32 detect(void) {
+    u32 regs[4], max_leaf, features = 0;
+    u64 xcr0 = 0;
+
+    cpuid(0, 0, regs);
+    max_leaf = regs[0];
+    cpuid(1, 0, regs);
+    if (regs[3] & (1u << 26)) {
+        features |= XUDK_CPU_SSE2;
+    }
+    if (regs[2] & (1u << 20)) {
+        features |= XUDK_CPU_SSE42;
+    }
+    if (regs[2] & (1u << 1)) {
+        features |= XUDK_CPU_PCLMUL;
+    }
+    if (regs[2] & (1u << 27)) {
+        xcr0 = xgetbv0();   // OSXSAVE set, XGETBV is available
+    }
+    cpuid(0x80000000, 0, regs);
+    if (regs[0] >= 0x80000007) {
+        cpuid(0x80000007, 0, regs);
+        if (regs[3] & (1u << 8)) {
+            features |= XUDK_CPU_INVARIANT_TSC;
+        }
+    }
+    if (max_leaf < 7) {
+        return features;
+    }
+
+    cpuid(7, 0, regs);
+    if (regs[1] & (1u << 9)) {
+        features |= XUDK_CPU_ERMS;
+    }
+    // YMM needs XCR0 bits 1-2; ZMM additionally needs opmask and upper ZMM state (5-7)
+    if ((xcr0 & 0x06) == 0x06 && (regs[1] & (1u << 5))) {
+        features |= XUDK_CPU_AVX2;
+    }
+    if ((xcr0 & 0xE6) == 0xE6 && (regs[1] & (1u << 16)) && (regs[1] & (1u << 30))) {
+        features |= XUDK_CPU_AVX512;
+    }
+    return features;
+}
+
+#else
+
+static u32 detect(void) {
+    return 0;
+}
+
+#endif
+
+u64 xudk_cpu_cycles(void) {
+#if XUDK_CPU_X86 && defined(_MSC_VER)
+    return __rdtsc();
+#elif XUDK_CPU_X86
+    u32 lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((u64)hi << 32) | lo;
+#else
+    return 0;
+#endif
+}
+
+u32 xudk_cpu_features(void) {
+    static u32 features;
+    static bool detected = false;
+
+    if (!detected) {
+        features = detect();
+        detected = true;
+    }
+    return features;
+}
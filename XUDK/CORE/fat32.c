@@ -0,0 +1,642 @@
+/*
+ * XUDK - Native FAT32 reader
+ * Reads files off a FAT32 volume with storage.read_sectors rather than
+ * through the firmware's file system driver, which walks the cluster chain
+ * and reads a cluster at a time. The FAT is cached in windows as it is used.
+ * Opening a file turns its chain into extents of consecutive clusters, so a
+ * file the volume keeps in one piece reads in one transfer per extent, straight
+ * into the caller's buffer. Only a read that starts or ends inside a sector
+ * goes through a one-sector bounce buffer for that sector.
+ */
+
+#include "core.h"
+
+#define FAT_WINDOW_SECTORS  64              // FAT sectors read into the cache at once
+#define FAT_CACHE_BYTES     (8 * 1024 * 1024)
+#define FAT_MAX_TRANSFER    65536           // Sectors per read_sectors
+#define FAT_END             0x0FFFFFF8      // This and above end a chain
+#define FAT_LFN_MAX         260
+
+#define ATTR_VOLUME_ID      0x08
+#define ATTR_DIRECTORY      0x10
+#define ATTR_LFN            0x0F
+
+typedef struct {
+    u32             cluster;            // First cluster of the run
+    u32             count;
+    u32             index;              // Its cluster number within the file
+} fat_extent;
+
+struct xudk_fat32_volume {
+    u32             disk_id;
+    u32             sector_size;
+    u32             sectors_per_cluster;
+    u32             cluster_size;
+    u64             fat_lba;
+    u32             fat_sectors;
+    u64             data_lba;           // Cluster 2
+    u32             cluster_count;
+    u32             root_cluster;
+    u8*             fat_cache;          // fat_slots windows, direct-mapped
+    u32*            fat_tags;           // Window held by each slot, + 1
+    u32             fat_slots;
+    u32             window_shift;       // log2 of the FAT entries in a window
+    u8*             sector;             // Bounce buffer for partial sectors
+    u8*             cluster;            // Directory cluster being searched
+};
+
+struct xudk_fat32_file {
+    xudk_fat32_volume* volume;
+    u64             size;
+    u64             position;
+    fat_extent*     extents;
+    u32             extent_count;
+    u32             extent_hint;        // Extent the last read ended in
+};
+
+static u16 le16(const u8 *p) { return (u16)(p[0] | (p[1] << 8)); }
+static u32 le32(const u8 *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24); }
+static u64 le64(const u8 *p) { return le32(p) | ((u64)le32(p + 4) << 32); }
+
+// =============================================================================
+// FAT
+// =============================================================================
+
+static status fat_next(xudk_ctx *ctx, xudk_fat32_volume *vol, u32 cluster, u32 *next) {
+    u32 window = cluster >> vol->window_shift;
+    u32 slot = window % vol->fat_slots;
+    u8 *data = vol->fat_cache + ((usize)slot << vol->window_shift) * 4;
+
+    if (vol->fat_tags[slot] != window + 1) {
+        u32 first = window * FAT_WINDOW_SECTORS;
+        u32 count = vol->fat_sectors - first < FAT_WINDOW_SECTORS ? vol->fat_sectors - first : FAT_WINDOW_SECTORS;
+        status s = ctx->storage.read_sectors(ctx, vol->disk_id, vol->fat_lba + first, count, data);
+        if (xudk_error(s)) {
+            return s;
+        }
+        vol->fat_tags[slot] = window + 1;
+    }
+    *next = le32(data + (cluster & ((1u << vol->window_shift) - 1)) * 4) & 0x0FFFFFFF;
+    return XUDK_OK;
+}
+
+static bool valid_cluster(const xudk_fat32_volume *vol, u32 cluster) {
+    return cluster >= 2 && cluster - 2 < vol->cluster_count;
+}
+
+// The chain from `first` as extents, `clusters` long; 0 runs it to its end
+static status build_extents(xudk_ctx *ctx, xudk_fat32_volume *vol, u32 first, u32 clusters,
+                            fat_extent **extents, u32 *count) {
+    fat_extent *list = null;
+    u32 capacity = 0, used = 0, cluster = first;
+    status s = XUDK_OK;
+
+    for (u32 index = 0; clusters ? index < clusters : cluster < FAT_END; index++) {
+        if (!valid_cluster(vol, cluster) || index >= vol->cluster_count) {
+            s = XUDK_FILESYSTEM_ERROR;
+            break;
+        }
+        if (used && list[used - 1].cluster + list[used - 1].count == cluster) {
+            list[used - 1].count++;
+        } else {
+            if (used == capacity) {
+                fat_extent *grown = ctx->memory.alloc(ctx, (capacity ? capacity * 2 : 16) * sizeof(fat_extent));
+                if (!grown) {
+                    s = XUDK_OUT_OF_MEMORY;
+                    break;
+                }
+                if (list) {
+                    xudk_memcpy(grown, list, used * sizeof(fat_extent));
+                    ctx->memory.free(ctx, list);
+                }
+                list = grown;
+                capacity = capacity ? capacity * 2 : 16;
+            }
+            list[used].cluster = cluster;
+            list[used].count = 1;
+            list[used].index = index;
+            used++;
+        }
+        s = fat_next(ctx, vol, cluster, &cluster);
+        if (xudk_error(s)) {
+            break;
+        }
+    }
+    if (xudk_error(s)) {
+        if (list) {
+            ctx->memory.free(ctx, list);
+        }
+        return s;
+    }
+    *extents = list;
+    *count = used;
+    return XUDK_OK;
+}
+
+static u64 cluster_lba(const xudk_fat32_volume *vol, u32 cluster) {
+    return vol->data_lba + (u64)(cluster - 2) * vol->sectors_per_cluster;
+}
+
+// =============================================================================
+// DIRECTORIES
+// =============================================================================
+
+static wchar fold(wchar c) {
+    return c >= L'a' && c <= L'z' ? (wchar)(c - L'a' + L'A') : c;
+}
+
+static bool name_equals(const wchar *a, usize a_len, const wchar *b, usize b_len) {
+    if (a_len != b_len) {
+        return false;
+    }
+    for (usize i = 0; i < a_len; i++) {
+        if (fold(a[i]) != fold(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// "NAME.EXT" from the padded 8.3 form
+static usize short_name(const u8 *entry, wchar *name) {
+    usize len = 0, base = 8, ext = 3;
+
+    while (base && entry[base - 1] == ' ') {
+        base--;
+    }
+    while (ext && entry[8 + ext - 1] == ' ') {
+        ext--;
+    }
+    for (usize i = 0; i < base; i++) {
+        name[len++] = i == 0 && entry[0] == 0x05 ? 0xE5 : entry[i];
+    }
+    if (ext) {
+        name[len++] = L'.';
+        for (usize i = 0; i < ext; i++) {
+            name[len++] = entry[8 + i];
+        }
+    }
+    return len;
+}
+
+static u8 short_checksum(const u8 *entry) {
+    u8 sum = 0;
+    for (u32 i = 0; i < 11; i++) {
+        sum = (u8)(((sum & 1) << 7) + (sum >> 1) + entry[i]);
+    }
+    return sum;
+}
+
+// Finds `name` in a directory and copies out its 32-byte entry
+static status find_entry(xudk_ctx *ctx, xudk_fat32_volume *vol, u32 directory, const wchar *name, usize name_len,
+                         u8 *found) {
+    static const u8 lfn_offsets[13] = { 1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30 };
+    wchar lfn[FAT_LFN_MAX + 1], candidate[13];
+    u32 lfn_seq = 0, cluster = directory;
+    usize lfn_len = 0;
+    u8 lfn_sum = 0;
+
+    for (u32 steps = 0; cluster < FAT_END; steps++) {
+        status s;
+
+        if (!valid_cluster(vol, cluster) || steps >= vol->cluster_count) {
+            return XUDK_FILESYSTEM_ERROR;
+        }
+        s = ctx->storage.read_sectors(ctx, vol->disk_id, cluster_lba(vol, cluster), vol->sectors_per_cluster,
+                                      vol->cluster);
+        if (xudk_error(s)) {
+            return s;
+        }
+        for (u32 at = 0; at < vol->cluster_size; at += 32) {
+            const u8 *e = vol->cluster + at;
+
+            if (e[0] == 0x00) {
+                return XUDK_NOT_FOUND;
+            }
+            if (e[0] == 0xE5) {
+                lfn_seq = 0;
+                continue;
+            }
+            if ((e[11] & 0x3F) == ATTR_LFN) {
+                u32 seq = e[0] & 0x1F;
+
+                if (e[0] & 0x40) {
+                    lfn_len = seq * 13 <= FAT_LFN_MAX + 12 ? seq * 13 : 0;
+                    lfn_sum = e[13];
+                } else if (seq != lfn_seq - 1 || e[13] != lfn_sum) {
+                    lfn_len = 0;
+                }
+                lfn_seq = lfn_len && seq ? seq : 0;
+                for (u32 i = 0; lfn_seq && i < 13; i++) {
+                    usize at_char = (usize)(seq - 1) * 13 + i;
+                    wchar c = le16(e + lfn_offsets[i]);
+
+                    if (at_char < FAT_LFN_MAX) {
+                        lfn[at_char] = c;
+                    }
+                    if (c == 0 && at_char < lfn_len) {
+                        lfn_len = at_char;
+                    }
+                }
+                continue;
+            }
+            if (!(e[11] & ATTR_VOLUME_ID)) {
+                usize len = short_name(e, candidate);
+                bool long_match = lfn_seq == 1 && lfn_sum == short_checksum(e) && lfn_len <= FAT_LFN_MAX &&
+                                  name_equals(lfn, lfn_len, name, name_len);
+
+                if (long_match || name_equals(candidate, len, name, name_len)) {
+                    xudk_memcpy(found, e, 32);
+                    return XUDK_OK;
+                }
+            }
+            lfn_seq = 0;
+        }
+        s = fat_next(ctx, vol, cluster, &cluster);
+        if (xudk_error(s)) {
+            return s;
+        }
+    }
+    return XUDK_NOT_FOUND;
+}
+
+// =============================================================================
+// MOUNT
+// =============================================================================
+
+static bool mount_at(xudk_ctx *ctx, xudk_fat32_volume *vol, u64 lba) {
+    const u8 *bpb = vol->sector;
+    u32 reserved, fats, fat_size, total, spc;
+
+    if (xudk_error(ctx->storage.read_sectors(ctx, vol->disk_id, lba, 1, vol->sector)) ||
+        bpb[510] != 0x55 || bpb[511] != 0xAA || le16(bpb + 11) != vol->sector_size) {
+        return false;
+    }
+    spc = bpb[13];
+    reserved = le16(bpb + 14);
+    fats = bpb[16];
+    fat_size = le32(bpb + 36);
+    total = le16(bpb + 19) ? le16(bpb + 19) : le32(bpb + 32);
+    // FAT12/16 have a root directory region and a 16-bit FAT size
+    if (!spc || (spc & (spc - 1)) || !reserved || !fats || !fat_size || le16(bpb + 17) || le16(bpb + 22) ||
+        (u64)reserved + (u64)fats * fat_size >= total) {
+        return false;
+    }
+    vol->sectors_per_cluster = spc;
+    vol->cluster_size = spc * vol->sector_size;
+    vol->fat_lba = lba + reserved;
+    vol->fat_sectors = fat_size;
+    vol->data_lba = vol->fat_lba + (u64)fats * fat_size;
+    vol->cluster_count = (u32)((total - reserved - (u64)fats * fat_size) / spc);
+    // The FAT may not cover every cluster the size implies
+    if ((u64)vol->cluster_count + 2 > (u64)fat_size * vol->sector_size / 4) {
+        vol->cluster_count = (u32)((u64)fat_size * vol->sector_size / 4 - 2);
+    }
+    vol->root_cluster = le32(bpb + 44);
+    return valid_cluster(vol, vol->root_cluster);
+}
+
+// The volume itself, else the first FAT32 partition of a GPT or MBR
+static status find_volume(xudk_ctx *ctx, xudk_fat32_volume *vol, u64 total_sectors) {
+    u8 *sector = vol->sector;
+    u64 starts[4];
+    u32 start_count = 0;
+    status s;
+
+    if (mount_at(ctx, vol, 0)) {
+        return XUDK_OK;
+    }
+    s = ctx->storage.read_sectors(ctx, vol->disk_id, 0, 1, sector);
+    if (xudk_error(s) || sector[510] != 0x55 || sector[511] != 0xAA) {
+        return xudk_error(s) ? s : XUDK_NOT_FOUND;
+    }
+    for (u32 i = 0; i < 4; i++) {
+        const u8 *entry = sector + 446 + i * 16;
+        if (entry[4] && entry[4] != 0xEE) {
+            starts[start_count++] = le32(entry + 8);
+        }
+    }
+    if (sector[446 + 4] == 0xEE) {
+        u64 entries_lba;
+        u32 entry_count, entry_size;
+
+        s = ctx->storage.read_sectors(ctx, vol->disk_id, 1, 1, sector);
+        if (xudk_error(s) || xudk_memcmp(sector, "EFI PART", 8)) {
+            return xudk_error(s) ? s : XUDK_NOT_FOUND;
+        }
+        entries_lba = le64(sector + 72);
+        entry_count = le32(sector + 80);
+        entry_size = le32(sector + 84);
+        if (entry_size < 128 || entry_size > vol->sector_size || vol->sector_size % entry_size) {
+            return XUDK_NOT_FOUND;
+        }
+        for (u32 i = 0; i < entry_count && i < 128; i++) {
+            u32 per_sector = vol->sector_size / entry_size;
+            const u8 *entry;
+            u64 first;
+
+            if (i % per_sector == 0) {
+                s = ctx->storage.read_sectors(ctx, vol->disk_id, entries_lba + i / per_sector, 1, sector);
+                if (xudk_error(s)) {
+                    return s;
+                }
+            }
+            entry = sector + (i % per_sector) * entry_size;
+            first = le64(entry + 32);
+            if ((le64(entry) || le64(entry + 8)) && first < total_sectors) {
+                // mount_at reuses the sector buffer, so the entries are read again after
+                if (mount_at(ctx, vol, first)) {
+                    return XUDK_OK;
+                }
+                s = ctx->storage.read_sectors(ctx, vol->disk_id, entries_lba + i / per_sector, 1, sector);
+                if (xudk_error(s)) {
+                    return s;
+                }
+            }
+        }
+        return XUDK_NOT_FOUND;
+    }
+    for (u32 i = 0; i < start_count; i++) {
+        if (starts[i] < total_sectors && mount_at(ctx, vol, starts[i])) {
+            return XUDK_OK;
+        }
+    }
+    return XUDK_NOT_FOUND;
+}
+
+// =============================================================================
+// PUBLIC API
+// =============================================================================
+
+status xudk_fat32_unmount(xudk_ctx *ctx, xudk_fat32_volume *volume) {
+    if (!volume) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (volume->fat_cache) {
+        ctx->memory.free(ctx, volume->fat_cache);
+    }
+    if (volume->fat_tags) {
+        ctx->memory.free(ctx, volume->fat_tags);
+    }
+    if (volume->sector) {
+        ctx->memory.free(ctx, volume->sector);
+    }
+    if (volume->cluster) {
+        ctx->memory.free(ctx, volume->cluster);
+    }
+    ctx->memory.free(ctx, volume);
+    return XUDK_OK;
+}
+
+status xudk_fat32_mount(xudk_ctx *ctx, u32 disk_id, xudk_fat32_volume **volume) {
+    xudk_fat32_volume *vol;
+    xudk_disk_info info;
+    u32 windows;
+    status s;
+
+    if (!volume) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!ctx->storage.read_sectors || !ctx->storage.get_disk_info) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    s = ctx->storage.get_disk_info(ctx, disk_id, &info);
+    if (xudk_error(s)) {
+        return s;
+    }
+    if (info.sector_size < 512 || info.sector_size > 4096 || (info.sector_size & (info.sector_size - 1))) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    vol = ctx->memory.alloc(ctx, sizeof(*vol));
+    if (!vol) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(vol, 0, sizeof(*vol));
+    vol->disk_id = disk_id;
+    vol->sector_size = info.sector_size;
+    vol->sector = ctx->memory.alloc(ctx, info.sector_size);
+    if (!vol->sector) {
+        xudk_fat32_unmount(ctx, vol);
+        return XUDK_OUT_OF_MEMORY;
+    }
+    s = find_volume(ctx, vol, info.total_sectors);
+    if (xudk_error(s)) {
+        xudk_fat32_unmount(ctx, vol);
+        return s;
+    }
+
+    // The whole FAT when it fits the budget, else that much of it at a time
+    windows = (vol->fat_sectors + FAT_WINDOW_SECTORS - 1) / FAT_WINDOW_SECTORS;
+    while ((4u << vol->window_shift) < FAT_WINDOW_SECTORS * vol->sector_size) {
+        vol->window_shift++;
+    }
+    vol->fat_slots = FAT_CACHE_BYTES / (FAT_WINDOW_SECTORS * vol->sector_size);
+    if (vol->fat_slots > windows) {
+        vol->fat_slots = windows;
+    }
+    vol->fat_cache = ctx->memory.alloc(ctx, (usize)vol->fat_slots * FAT_WINDOW_SECTORS * vol->sector_size);
+    vol->fat_tags = ctx->memory.alloc(ctx, vol->fat_slots * sizeof(u32));
+    vol->cluster = ctx->memory.alloc(ctx, vol->cluster_size);
+    if (!vol->fat_cache || !vol->fat_tags || !vol->cluster) {
+        xudk_fat32_unmount(ctx, vol);
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(vol->fat_tags, 0, vol->fat_slots * sizeof(u32));
+    *volume = vol;
+    return XUDK_OK;
+}
+
+// Path components split on '\' or '/'; directories may be opened as files only
+// to reach what is in them
+status xudk_fat32_open(xudk_ctx *ctx, xudk_fat32_volume *volume, const wchar *path, xudk_fat32_file **file) {
+    xudk_fat32_file *f;
+    u32 cluster;
+    u8 entry[32];
+    bool directory = true;
+    status s;
+
+    if (!volume || !path || !file) {
+        return XUDK_INVALID_PARAM;
+    }
+    cluster = volume->root_cluster;
+    while (*path) {
+        const wchar *end = path;
+        while (*end && *end != L'\\' && *end != L'/') {
+            end++;
+        }
+        if (end != path) {
+            if (!directory) {
+                return XUDK_NOT_FOUND;
+            }
+            s = find_entry(ctx, volume, cluster, path, (usize)(end - path), entry);
+            if (xudk_error(s)) {
+                return s;
+            }
+            directory = (entry[11] & ATTR_DIRECTORY) != 0;
+            cluster = ((u32)le16(entry + 20) << 16) | le16(entry + 26);
+            if (directory && !cluster) {
+                cluster = volume->root_cluster;     // ".." of a top-level directory
+            }
+        }
+        path = *end ? end + 1 : end;
+    }
+    if (directory) {
+        return XUDK_ACCESS_DENIED;
+    }
+
+    f = ctx->memory.alloc(ctx, sizeof(*f));
+    if (!f) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(f, 0, sizeof(*f));
+    f->volume = volume;
+    f->size = le32(entry + 28);
+    if (f->size) {
+        s = build_extents(ctx, volume, cluster, (u32)((f->size + volume->cluster_size - 1) / volume->cluster_size),
+                          &f->extents, &f->extent_count);
+        if (xudk_error(s)) {
+            ctx->memory.free(ctx, f);
+            return s;
+        }
+    }
+    *file = f;
+    return XUDK_OK;
+}
+
+status xudk_fat32_close(xudk_ctx *ctx, xudk_fat32_file *file) {
+    if (!file) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (file->extents) {
+        ctx->memory.free(ctx, file->extents);
+    }
+    ctx->memory.free(ctx, file);
+    return XUDK_OK;
+}
+
+static const fat_extent* extent_of(xudk_fat32_file *file, u32 index) {
+    u32 low = 0, high = file->extent_count;
+    const fat_extent *e = &file->extents[file->extent_hint];
+
+    if (index >= e->index && index < e->index + e->count) {
+        return e;
+    }
+    while (high - low > 1) {
+        u32 mid = (low + high) / 2;
+        if (file->extents[mid].index <= index) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    file->extent_hint = low;
+    return &file->extents[low];
+}
+
+// With `tail_room` the buffer has space to the end of the last sector, so
+// that sector is read into it directly too
+static status read_at(xudk_ctx *ctx, xudk_fat32_file *file, u8 *buffer, usize size, bool tail_room) {
+    xudk_fat32_volume *vol = file->volume;
+    u64 position = file->position;
+
+    while (size) {
+        const fat_extent *e = extent_of(file, (u32)(position / vol->cluster_size));
+        u64 extent_end = (u64)(e->index + e->count) * vol->cluster_size;
+        u64 lba = cluster_lba(vol, e->cluster) + (position - (u64)e->index * vol->cluster_size) / vol->sector_size;
+        usize offset = (usize)(position % vol->sector_size);
+        usize done;
+        status s;
+
+        if (offset || (size < vol->sector_size && !tail_room)) {
+            s = ctx->storage.read_sectors(ctx, vol->disk_id, lba, 1, vol->sector);
+            done = vol->sector_size - offset < size ? vol->sector_size - offset : size;
+            if (xudk_ok(s)) {
+                xudk_memcpy(buffer, vol->sector + offset, done);
+            }
+        } else {
+            u64 sectors = (tail_room ? size + vol->sector_size - 1 : size) / vol->sector_size;
+            u64 left = (extent_end - position) / vol->sector_size;
+
+            sectors = sectors < left ? sectors : left;
+            sectors = sectors < FAT_MAX_TRANSFER ? sectors : FAT_MAX_TRANSFER;
+            s = ctx->storage.read_sectors(ctx, vol->disk_id, lba, (u32)sectors, buffer);
+            done = sectors * vol->sector_size < size ? (usize)sectors * vol->sector_size : size;
+        }
+        if (xudk_error(s)) {
+            return s;
+        }
+        buffer += done;
+        position += done;
+        size -= done;
+        file->position = position;
+    }
+    return XUDK_OK;
+}
+
+// On an error `read` still counts the bytes that arrived before it
+status xudk_fat32_read(xudk_ctx *ctx, xudk_fat32_file *file, void *buffer, usize size, usize *read) {
+    u64 start;
+    status s;
+
+    if (!file || (!buffer && size)) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (size > file->size - file->position) {
+        size = (usize)(file->size - file->position);
+    }
+    start = file->position;
+    s = read_at(ctx, file, buffer, size, false);
+    if (read) {
+        *read = (usize)(file->position - start);
+    }
+    return s;
+}
+
+status xudk_fat32_seek(xudk_ctx *ctx, xudk_fat32_file *file, u64 position) {
+    (void)ctx;
+    if (!file) {
+        return XUDK_INVALID_PARAM;
+    }
+    file->position = position < file->size ? position : file->size;
+    return XUDK_OK;
+}
+
+status xudk_fat32_get_file_size(xudk_ctx *ctx, xudk_fat32_file *file, u64 *size) {
+    (void)ctx;
+    if (!file || !size) {
+        return XUDK_INVALID_PARAM;
+    }
+    *size = file->size;
+    return XUDK_OK;
+}
+
+// The buffer is sized up to a whole sector, so even the tail is read in place
+status xudk_fat32_load_file(xudk_ctx *ctx, xudk_fat32_volume *volume, const wchar *path, void **buffer,
+                            usize *size) {
+    xudk_fat32_file *file;
+    void *data;
+    status s;
+
+    if (!buffer || !size) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = xudk_fat32_open(ctx, volume, path, &file);
+    if (xudk_error(s)) {
+        return s;
+    }
+    data = ctx->memory.alloc(ctx, (usize)((file->size + volume->sector_size - 1) / volume->sector_size *
+                                          volume->sector_size) + !file->size);
+    if (!data) {
+        xudk_fat32_close(ctx, file);
+        return XUDK_OUT_OF_MEMORY;
+    }
+    s = read_at(ctx, file, data, (usize)file->size, true);
+    if (xudk_error(s)) {
+        ctx->memory.free(ctx, data);
+    } else {
+        *buffer = data;
+        *size = (usize)file->size;
+    }
+    xudk_fat32_close(ctx, file);
+    return s;
+}
@@ -0,0 +1,184 @@
+/*
+ * XUDK - String formatting
+ * UEFI-flavoured printf: %s takes a wchar string, %a takes an ASCII string.
+ */
+
+#include "core.h"
+
+typedef struct {
+    wchar*  buffer;
+    usize   size;
+    usize   length;
+} fmt_out;
+
+static void fmt_put(fmt_out *out, wchar c) {
+    if (out->length + 1 < out->size) {
+        out->buffer[out->length] = c;
+    }
+    out->length++;
+}
+
+static void fmt_pad(fmt_out *out, wchar c, int count) {
+    while (count-- > 0) {
+        fmt_put(out, c);
+    }
+}
+
+static void fmt_number(fmt_out *out, u64 value, bool negative, u32 base, bool upper,
+                       int width, bool zero_pad, bool left) {
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    wchar tmp[24];
+    int n = 0;
+    int len;
+
+    do {
+        tmp[n++] = digits[value % base];
+        value /= base;
+    } while (value);
+
+    len = n + (negative ? 1 : 0);
+    if (!left && !zero_pad) {
+        fmt_pad(out, L' ', width - len);
+    }
+    if (negative) {
+        fmt_put(out, L'-');
+    }
+    if (!left && zero_pad) {
+        fmt_pad(out, L'0', width - len);
+    }
+    while (n) {
+        fmt_put(out, tmp[--n]);
+    }
+    if (left) {
+        fmt_pad(out, L' ', width - len);
+    }
+}
+
+usize xudk_vsprint(wchar *buffer, usize size, const wchar *fmt, va_list args) {
+    fmt_out out = { buffer, size, 0 };
+
+    while (*fmt) {
+        bool left = false, zero_pad = false;
+        int width = 0, longs = 0;
+        wchar c = *fmt++;
+
+        if (c != L'%') {
+            fmt_put(&out, c);
+            continue;
+        }
+
+        for (;; fmt++) {
+            if (*fmt == L'-') {
+                left = true;
+            } else if (*fmt == L'0') {
+                zero_pad = true;
+            } else {
+                break;
+            }
+        }
+        if (*fmt == L'*') {
+            width = va_arg(args, int);
+            fmt++;
+        }
+        while (*fmt >= L'0' && *fmt <= L'9') {
+            width = width * 10 + (*fmt++ - L'0');
+        }
+        for (;; fmt++) {
+            if (*fmt == L'l') {
+                longs++;
+            } else if (*fmt == L'z') {
+                longs = 2;
+            } else if (*fmt != L'h') {
+                break;
+            }
+        }
+
+        c = *fmt++;
+        switch (c) {
+        case L'd':
+        case L'i': {
+            i64 v = longs >= 2 ? va_arg(args, i64) : longs ? va_arg(args, long) : va_arg(args, int);
+            fmt_number(&out, v < 0 ? 0 - (u64)v : (u64)v, v < 0, 10, false, width, zero_pad, left);
+            break;
+        }
+        case L'u':
+        case L'x':
+        case L'X': {
+            u64 v = longs >= 2 ? va_arg(args, u64) : longs ? va_arg(args, unsigned long) : va_arg(args, unsigned);
+            fmt_number(&out, v, false, c == L'u' ? 10 : 16, c == L'X', width, zero_pad, left);
+            break;
+        }
+        case L'p':
+            fmt_put(&out, L'0');
+            fmt_put(&out, L'x');
+            fmt_number(&out, (u64)(usize)va_arg(args, void*), false, 16, false, width, true, false);
+            break;
+        case L'c':
+            fmt_put(&out, (wchar)va_arg(args, int));
+            break;
+        case L's': {
+            const wchar *s = va_arg(args, const wchar*);
+            int len;
+            if (!s) {
+                s = L"(null)";
+            }
+            len = (int)xudk_strlen(s);
+            if (!left) {
+                fmt_pad(&out, L' ', width - len);
+            }
+            while (*s) {
+                fmt_put(&out, *s++);
+            }
+            if (left) {
+                fmt_pad(&out, L' ', width - len);
+            }
+            break;
+        }
+        case L'a': {
+            const char *s = va_arg(args, const char*);
+            int len = 0;
+            if (!s) {
+                s = "(null)";
+            }
+            while (s[len]) {
+                len++;
+            }
+            if (!left) {
+                fmt_pad(&out, L' ', width - len);
+            }
+            while (*s) {
+                fmt_put(&out, (u8)*s++);
+            }
+            if (left) {
+                fmt_pad(&out, L' ', width - len);
+            }
+            break;
+        }
+        case L'%':
+            fmt_put(&out, L'%');
+            break;
+        case 0:
+            fmt--;
+            break;
+        default:
+            fmt_put(&out, L'%');
+            fmt_put(&out, c);
+            break;
+        }
+    }
+
+    if (size) {
+        buffer[out.length < size ? out.length : size - 1] = 0;
+    }
+    return out.length;
+}
+
+usize xudk_sprint(wchar *buffer, usize size, const wchar *fmt, ...) {
+    va_list args;
+    usize len;
+
+    va_start(args, fmt);
+    len = xudk_vsprint(buffer, size, fmt, args);
+    va_end(args);
+    return len;
+}
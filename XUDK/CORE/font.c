@@ -0,0 +1,288 @@
+/*
+ * XUDK - Built-in 5x7 bitmap font and glyph atlases
+ * A font rasterizes every glyph once, at a whole-number scale, into an
+ * 8-bit coverage atlas; text drawing then only blits from the atlas.
+ */
+
+#include "core.h"
+
+// Printable ASCII 0x20..0x7E, 7 rows per glyph, bit 4 is the leftmost column
+static const u8 font_5x7[95][XUDK_FONT_HEIGHT] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // ' '
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04},  // '!'
+    {0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00},  // '"'
+    {0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A},  // '#'
+    {0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04},  // '$'
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03},  // '%'
+    {0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D},  // '&'
+    {0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00},  // '''
+    {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02},  // '('
+    {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08},  // ')'
+    {0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00},  // '*'
+    {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00},  // '+'
+    {0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08},  // ','
+    {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00},  // '-'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C},  // '.'
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00},  // '/'
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E},  // '0'
+    {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E},  // '1'
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F},  // '2'
+    {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E},  // '3'
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02},  // '4'
+    {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E},  // '5'
+    {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E},  // '6'
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08},  // '7'
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E},  // '8'
+    {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C},  // '9'
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00},  // ':'
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08},  // ';'
+    {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02},  // '<'
+    {0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00},  // '='
+    {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08},  // '>'
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04},  // '?'
+    {0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E},  // '@'
+    {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},  // 'A'
+    {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E},  // 'B'
+    {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E},  // 'C'
+    {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C},  // 'D'
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F},  // 'E'
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10},  // 'F'
+    {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F},  // 'G'
+    {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},  // 'H'
+    {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E},  // 'I'
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C},  // 'J'
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11},  // 'K'
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F},  // 'L'
+    {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11},  // 'M'
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11},  // 'N'
+    {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},  // 'O'
+    {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10},  // 'P'
+    {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D},  // 'Q'
+    {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11},  // 'R'
+    {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E},  // 'S'
+    {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},  // 'T'
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},  // 'U'
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04},  // 'V'
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A},  // 'W'
+    {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11},  // 'X'
+    {0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04},  // 'Y'
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F},  // 'Z'
+    {0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E},  // '['
+    {0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00},  // '\\'
+    {0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E},  // ']'
+    {0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00},  // '^'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F},  // '_'
+    {0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00},  // '`'
+    {0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F},  // 'a'
+    {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1E},  // 'b'
+    {0x00, 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E},  // 'c'
+    {0x01, 0x01, 0x0D, 0x13, 0x11, 0x11, 0x0F},  // 'd'
+    {0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E},  // 'e'
+    {0x06, 0x09, 0x08, 0x1C, 0x08, 0x08, 0x08},  // 'f'
+    {0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x0E},  // 'g'
+    {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11},  // 'h'
+    {0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x0E},  // 'i'
+    {0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0C},  // 'j'
+    {0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12},  // 'k'
+    {0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E},  // 'l'
+    {0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11},  // 'm'
+    {0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11},  // 'n'
+    {0x00, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E},  // 'o'
+    {0x00, 0x00, 0x1E, 0x11, 0x1E, 0x10, 0x10},  // 'p'
+    {0x00, 0x00, 0x0D, 0x13, 0x0F, 0x01, 0x01},  // 'q'
+    {0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10},  // 'r'
+    {0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E},  // 's'
+    {0x08, 0x08, 0x1C, 0x08, 0x08, 0x09, 0x06},  // 't'
+    {0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0D},  // 'u'
+    {0x00, 0x00, 0x11, 0x11, 0x11, 0x0A, 0x04},  // 'v'
+    {0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0A},  // 'w'
+    {0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11},  // 'x'
+    {0x00, 0x00, 0x11, 0x11, 0x0F, 0x01, 0x0E},  // 'y'
+    {0x00, 0x00, 0x1F, 0x02, 0x04, 0x08, 0x1F},  // 'z'
+    {0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02},  // '{'
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},  // '|'
+    {0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08},  // '}'
+    {0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00},  // '~'
+};
+
+const u8* xudk_font_glyph(wchar c) {
+    if (c < 0x20 || c > 0x7E) {
+        c = L'?';
+    }
+    return font_5x7[c - 0x20];
+}
+
+// =============================================================================
+// GLYPH ATLAS
+// =============================================================================
+
+#define ATLAS_MIN_WIDTH     128
+#define SMOOTH_SAMPLES      4       // Coverage samples per pixel and axis
+
+// Built-in 1x font, rasterized by xudk_font_init; its atlas is about 3 KiB
+static u8 builtin_atlas[ATLAS_MIN_WIDTH * 32];
+static xudk_font builtin_font;
+
+static u32 glyph_bit(const u8 *rows, i32 col, i32 row) {
+    if (col < 0 || row < 0 || col >= XUDK_FONT_WIDTH || row >= XUDK_FONT_HEIGHT) {
+        return 0;
+    }
+    return (rows[row] >> (XUDK_FONT_WIDTH - 1 - col)) & 1;
+}
+
+static i32 floor_div(i32 a, i32 b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Smooth edges: the bitmap is interpolated bilinearly between pixel centers
+// and thresholded at 0.4, so diagonals become slopes instead of stairs and
+// pixels that only touch at a corner join up. Coverage is the fraction of
+// SMOOTH_SAMPLES^2 points inside that outline.
+static u8 smooth_coverage(const u8 *rows, u32 scale, u32 px, u32 py) {
+    i32 d = 2 * SMOOTH_SAMPLES * (i32)scale;
+    u32 inside = 0;
+
+    for (u32 sy = 0; sy < SMOOTH_SAMPLES; sy++) {
+        // Sample position in source pixels relative to pixel centers, in 1/d units
+        i32 v = 2 * (i32)(py * SMOOTH_SAMPLES + sy) + 1 - SMOOTH_SAMPLES * (i32)scale;
+        i32 row = floor_div(v, d), fy = v - row * d;
+
+        for (u32 sx = 0; sx < SMOOTH_SAMPLES; sx++) {
+            i32 u = 2 * (i32)(px * SMOOTH_SAMPLES + sx) + 1 - SMOOTH_SAMPLES * (i32)scale;
+            i32 col = floor_div(u, d), fx = u - col * d;
+            i64 value = (i64)glyph_bit(rows, col, row) * (d - fx) * (d - fy) +
+                        (i64)glyph_bit(rows, col + 1, row) * fx * (d - fy) +
+                        (i64)glyph_bit(rows, col, row + 1) * (d - fx) * fy +
+                        (i64)glyph_bit(rows, col + 1, row + 1) * fx * fy;
+            inside += value * 5 >= (i64)d * d * 2;
+        }
+    }
+    return (u8)(inside * 255 / (SMOOTH_SAMPLES * SMOOTH_SAMPLES));
+}
+
+// Ink boxes from the bitmaps and shelf packing; returns the atlas size in bytes
+static usize font_layout(xudk_font *font, u32 scale, u32 flags) {
+    u32 shelf_x = 0, shelf_y = 0, shelf_height = 0;
+
+    font->scale = scale;
+    font->flags = flags;
+    font->advance = XUDK_FONT_ADVANCE * scale;
+    font->line = XUDK_FONT_LINE * scale;
+    font->atlas_width = XUDK_FONT_WIDTH * scale * 16 > ATLAS_MIN_WIDTH ? XUDK_FONT_WIDTH * scale * 16
+                                                                       : ATLAS_MIN_WIDTH;
+
+    for (u32 g = 0; g < XUDK_FONT_GLYPHS; g++) {
+        xudk_glyph *glyph = &font->glyphs[g];
+        u32 columns = 0, top = XUDK_FONT_HEIGHT, bottom = 0, left = 0, right = 0;
+
+        for (u32 row = 0; row < XUDK_FONT_HEIGHT; row++) {
+            if (font_5x7[g][row]) {
+                columns |= font_5x7[g][row];
+                top = row < top ? row : top;
+                bottom = row + 1;
+            }
+        }
+        xudk_memset(glyph, 0, sizeof(*glyph));
+        if (!columns) {
+            continue;
+        }
+        while (!(columns & (0x10 >> left))) {
+            left++;
+        }
+        for (right = XUDK_FONT_WIDTH; !(columns & (0x10 >> (right - 1))); right--) {
+        }
+
+        glyph->left = (u8)(left * scale);
+        glyph->top = (u8)(top * scale);
+        glyph->width = (u8)((right - left) * scale);
+        glyph->height = (u8)((bottom - top) * scale);
+        if (shelf_x + glyph->width > font->atlas_width) {
+            shelf_y += shelf_height;
+            shelf_x = 0;
+            shelf_height = 0;
+        }
+        glyph->atlas_x = (u16)shelf_x;
+        glyph->atlas_y = (u16)shelf_y;
+        shelf_x += glyph->width;
+        shelf_height = glyph->height > shelf_height ? glyph->height : shelf_height;
+    }
+    font->atlas_height = shelf_y + shelf_height;
+    return (usize)font->atlas_width * font->atlas_height;
+}
+
+static void font_rasterize(xudk_font *font) {
+    for (u32 g = 0; g < XUDK_FONT_GLYPHS; g++) {
+        const xudk_glyph *glyph = &font->glyphs[g];
+
+        for (u32 y = 0; y < glyph->height; y++) {
+            u8 *dst = font->atlas + (usize)(glyph->atlas_y + y) * font->atlas_width + glyph->atlas_x;
+            u32 py = glyph->top + y;
+
+            for (u32 x = 0; x < glyph->width; x++) {
+                u32 px = glyph->left + x;
+                if (font->flags & XUDK_FONT_SMOOTH) {
+                    dst[x] = smooth_coverage(font_5x7[g], font->scale, px, py);
+                } else {
+                    dst[x] = glyph_bit(font_5x7[g], (i32)(px / font->scale), (i32)(py / font->scale)) ? 0xFF : 0;
+                }
+            }
+        }
+    }
+}
+
+void xudk_font_init(void) {
+    if (!builtin_font.atlas && font_layout(&builtin_font, 1, 0) <= sizeof(builtin_atlas)) {
+        builtin_font.atlas = builtin_atlas;
+        font_rasterize(&builtin_font);
+    }
+}
+
+const xudk_font* xudk_font_builtin(void) {
+    xudk_font_init();
+    return &builtin_font;
+}
+
+status xudk_font_create(xudk_ctx *ctx, u32 scale, u32 flags, xudk_font **font) {
+    xudk_font layout, *result;
+    usize atlas_size;
+
+    if (!font || !scale || scale > XUDK_FONT_SCALE_MAX) {
+        return XUDK_INVALID_PARAM;
+    }
+    atlas_size = font_layout(&layout, scale, flags);
+    result = ctx->memory.alloc(ctx, sizeof(*result) + atlas_size);
+    if (!result) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    *result = layout;
+    result->atlas = (u8*)(result + 1);
+    font_rasterize(result);
+    *font = result;
+    return XUDK_OK;
+}
+
+void xudk_font_destroy(xudk_ctx *ctx, xudk_font *font) {
+    if (font) {
+        ctx->memory.free(ctx, font);
+    }
+}
+
+void xudk_text_measure(const xudk_font *font, const wchar *text, u32 *width, u32 *height) {
+    u32 columns = 0, widest = 0, lines = 1;
+
+    if (!font) {
+        font = xudk_font_builtin();
+    }
+    for (; text && *text; text++) {
+        if (*text == L'\n') {
+            columns = 0;
+            lines++;
+            continue;
+        }
+        if (++columns > widest) {
+            widest = columns;
+        }
+    }
+    *width = widest ? (widest - 1) * font->advance + XUDK_FONT_WIDTH * font->scale : 0;
+    *height = (lines - 1) * font->line + XUDK_FONT_HEIGHT * font->scale;
+}
@@ -0,0 +1,189 @@
+/*
+ * XUDK - Frame scheduler
+ * Frames are due on a grid of the period from the first one, so the time a
+ * frame takes comes out of its wait rather than adding to it as with a fixed
+ * delay. xudk_frame_wait halts the BSP on a one-shot timer event until just
+ * before the next frame is due and stalls the rest: firmware timers often
+ * fire only on a tick of several milliseconds. How early to wake follows how
+ * late the timer has been firing.
+ */
+
+#include "core.h"
+
+#define FRAME_DEFAULT_RATE  60
+#define FRAME_SLACK_NS      1000000     // Timer lateness assumed before any is seen
+#define FRAME_MIN_SLACK_NS  50000
+
+struct xudk_frame_scheduler {
+    handle              timer;          // null without timer events: waits are stalls
+    u32                 flags;
+    u64                 period;
+    u64                 frame;
+    u64                 due;            // When the next frame is due
+    u64                 last;           // time_ns of the last frame
+    u64                 woke;           // When the last wait returned
+    bool                key_woken;      // The last frame started on a key
+    u64                 slack;          // Wake this far ahead of a frame
+    xudk_frame_stats    stats;
+};
+
+static u64 period_of(u32 frames_per_second) {
+    return 1000000000ULL / (frames_per_second ? frames_per_second : FRAME_DEFAULT_RATE);
+}
+
+// Seen lateness sets the slack at once; earlier firings shrink it slowly
+static void track_slack(xudk_frame_scheduler *scheduler, u64 late) {
+    if (late > scheduler->slack) {
+        scheduler->slack = late;
+    } else {
+        scheduler->slack -= (scheduler->slack - late) / 16;
+    }
+    if (scheduler->slack < FRAME_MIN_SLACK_NS) {
+        scheduler->slack = FRAME_MIN_SLACK_NS;
+    }
+    if (scheduler->slack > scheduler->period) {
+        scheduler->slack = scheduler->period;
+    }
+}
+
+// Halts until `until`; false when a key came first
+static bool sleep_until(xudk_ctx *ctx, xudk_frame_scheduler *scheduler, u64 until, bool key_wakes) {
+    u64 now = xudk_time_ns(ctx), target, woke;
+    status s;
+
+    if (scheduler->timer && until > now + scheduler->slack) {
+        target = until - scheduler->slack;
+        s = ctx->system.set_timer(ctx, scheduler->timer, target - now, false);
+        if (xudk_ok(s)) {
+            s = ctx->system.wait_for_timer(ctx, scheduler->timer, key_wakes);
+        }
+        woke = xudk_time_ns(ctx);
+        scheduler->stats.sleep_ns += woke - now;
+        if (s == XUDK_NOT_READY) {
+            ctx->system.set_timer(ctx, scheduler->timer, 0, false);
+            return false;
+        }
+        if (xudk_ok(s)) {
+            track_slack(scheduler, woke > target ? woke - target : 0);
+        }
+        now = woke;
+    }
+    if (until > now && ctx->system.delay) {
+        ctx->system.delay(ctx, (u32)((until - now) / 1000));
+        scheduler->stats.stall_ns += xudk_time_ns(ctx) - now;
+    }
+    return true;
+}
+
+status xudk_frame_scheduler_create(xudk_ctx *ctx, u32 frames_per_second, u32 flags,
+                                   xudk_frame_scheduler **scheduler) {
+    xudk_frame_scheduler *sched;
+
+    if (!scheduler) {
+        return XUDK_INVALID_PARAM;
+    }
+    sched = ctx->memory.alloc(ctx, sizeof(*sched));
+    if (!sched) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(sched, 0, sizeof(*sched));
+    sched->flags = flags;
+    sched->period = period_of(frames_per_second);
+    sched->slack = FRAME_SLACK_NS < sched->period ? FRAME_SLACK_NS : sched->period;
+    if (ctx->system.create_timer && xudk_error(ctx->system.create_timer(ctx, &sched->timer))) {
+        sched->timer = null;
+    }
+    xudk_time_ns(ctx);      // Calibrates the clock now rather than in the first wait
+    *scheduler = sched;
+    return XUDK_OK;
+}
+
+status xudk_frame_scheduler_destroy(xudk_ctx *ctx, xudk_frame_scheduler *scheduler) {
+    if (!scheduler) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (scheduler->timer) {
+        ctx->system.close_timer(ctx, scheduler->timer);
+    }
+    ctx->memory.free(ctx, scheduler);
+    return XUDK_OK;
+}
+
+status xudk_frame_scheduler_set_rate(xudk_ctx *ctx, xudk_frame_scheduler *scheduler, u32 frames_per_second) {
+    u64 period = period_of(frames_per_second);
+
+    (void)ctx;
+    if (!scheduler) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (scheduler->frame) {
+        scheduler->due = scheduler->due - scheduler->period + period;
+    }
+    scheduler->period = period;
+    return XUDK_OK;
+}
+
+// The first frame starts at once. A key wakes at most one frame per slot, so
+// a key left unread does not spin the loop.
+status xudk_frame_wait(xudk_ctx *ctx, xudk_frame_scheduler *scheduler, xudk_frame_info *info) {
+    u64 now, time, busy = 0, skipped = 0;
+    bool key = false;
+
+    if (!scheduler || !info) {
+        return XUDK_INVALID_PARAM;
+    }
+    now = xudk_time_ns(ctx);
+    if (!scheduler->frame) {
+        scheduler->due = now;
+    } else {
+        busy = now - scheduler->woke;
+        scheduler->stats.busy_ns += busy;
+        if (now < scheduler->due) {
+            key = !sleep_until(ctx, scheduler, scheduler->due,
+                               (scheduler->flags & XUDK_FRAME_WAKE_ON_KEY) && !scheduler->key_woken);
+            now = xudk_time_ns(ctx);
+        }
+    }
+
+    if (key) {
+        time = now;     // Off the grid; the next frame is still due when it was
+        scheduler->stats.key_wakes++;
+    } else {
+        if (now > scheduler->due && now - scheduler->due >= scheduler->period / 2) {
+            scheduler->stats.late_frames++;
+        }
+        if (now > scheduler->due && now - scheduler->due >= scheduler->period) {
+            if (scheduler->flags & XUDK_FRAME_SKIP_LATE) {
+                skipped = (now - scheduler->due) / scheduler->period;
+                scheduler->due += skipped * scheduler->period;
+            } else {
+                scheduler->due = now;
+            }
+        }
+        time = scheduler->due;
+        scheduler->due += scheduler->period;
+    }
+
+    info->frame = scheduler->frame;
+    info->time_ns = time;
+    info->delta_ns = scheduler->frame ? time - scheduler->last : 0;
+    info->busy_ns = busy;
+    info->skipped = (u32)skipped;
+    info->key_wake = key;
+    scheduler->frame++;
+    scheduler->last = time;
+    scheduler->woke = now;
+    scheduler->key_woken = key;
+    scheduler->stats.frames++;
+    scheduler->stats.skipped_frames += skipped;
+    return XUDK_OK;
+}
+
+status xudk_frame_scheduler_get_stats(xudk_ctx *ctx, xudk_frame_scheduler *scheduler, xudk_frame_stats *stats) {
+    (void)ctx;
+    if (!scheduler || !stats) {
+        return XUDK_INVALID_PARAM;
+    }
+    *stats = scheduler->stats;
+    return XUDK_OK;
+}
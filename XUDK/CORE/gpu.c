@@ -0,0 +1,311 @@
+/*
+ * XUDK - GPU helper functions
+ * Backend-independent wrappers over ctx->gpu. xudk_gpu_auto_init() falls
+ * back to the software rasterizer when no hardware device is usable.
+ */
+
+#include "core.h"
+#include "xudk/SWR/swr.h"
+
+// =============================================================================
+// SHADER SOURCES
+// =============================================================================
+
+const char* xudk_basic_vertex_shader_source =
+"cbuffer VertexBuffer : register(b0) {\n"
+"    float4x4 mvp_matrix;\n"
+"};\n"
+"\n"
+"struct VS_INPUT {\n"
+"    float3 position : POSITION;\n"
+"    float2 texcoord : TEXCOORD0;\n"
+"    float4 color : COLOR;\n"
+"};\n"
+"\n"
+"struct VS_OUTPUT {\n"
+"    float4 position : SV_POSITION;\n"
+"    float2 texcoord : TEXCOORD0;\n"
+"    float4 color : COLOR;\n"
+"};\n"
+"\n"
+"VS_OUTPUT main(VS_INPUT input) {\n"
+"    VS_OUTPUT output;\n"
+"    output.position = mul(float4(input.position, 1.0), mvp_matrix);\n"
+"    output.texcoord = input.texcoord;\n"
+"    output.color = input.color;\n"
+"    return output;\n"
+"}\n";
+
+const char* xudk_basic_fragment_shader_source =
+"Texture2D diffuse_texture : register(t0);\n"
+"SamplerState texture_sampler : register(s0);\n"
+"\n"
+"struct PS_INPUT {\n"
+"    float4 position : SV_POSITION;\n"
+"    float2 texcoord : TEXCOORD0;\n"
+"    float4 color : COLOR;\n"
+"};\n"
+"\n"
+"float4 main(PS_INPUT input) : SV_TARGET {\n"
+"    float4 texture_color = diffuse_texture.Sample(texture_sampler, input.texcoord);\n"
+"    return texture_color * input.color;\n"
+"}\n";
+
+const char* xudk_fullscreen_vertex_shader_source =
+"struct VS_OUTPUT {\n"
+"    float4 position : SV_POSITION;\n"
+"    float2 texcoord : TEXCOORD0;\n"
+"    float4 color : COLOR;\n"
+"};\n"
+"\n"
+"VS_OUTPUT main(uint id : SV_VertexID) {\n"
+"    VS_OUTPUT output;\n"
+"    output.texcoord = float2((id << 1) & 2, id & 2);\n"
+"    output.position = float4(output.texcoord * float2(2, -2) + float2(-1, 1), 0, 1);\n"
+"    output.color = float4(1, 1, 1, 1);\n"
+"    return output;\n"
+"}\n";
+
+// =============================================================================
+// INITIALIZATION & DETECTION
+// =============================================================================
+
+status xudk_gpu_init_best_device(xudk_ctx *ctx) {
+    xudk_gpu_info *devices;
+    usize count, best = 0;
+    status s;
+
+    if (!ctx->gpu.enumerate_devices || !ctx->gpu.initialize_device) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    s = ctx->gpu.enumerate_devices(ctx, &devices, &count);
+    if (xudk_error(s)) {
+        return s;
+    }
+    if (!count) {
+        ctx->memory.free(ctx, devices);
+        return XUDK_GPU_NOT_FOUND;
+    }
+
+    // Prefer hardware, then the most dedicated memory
+    for (usize i = 1; i < count; i++) {
+        bool sw_best = devices[best].vendor == XUDK_GPU_VENDOR_SOFTWARE;
+        bool sw_this = devices[i].vendor == XUDK_GPU_VENDOR_SOFTWARE;
+        if ((sw_best && !sw_this) || (sw_best == sw_this && devices[i].vram_size > devices[best].vram_size)) {
+            best = i;
+        }
+    }
+    ctx->memory.free(ctx, devices);
+    return ctx->gpu.initialize_device(ctx, (u32)best);
+}
+
+status xudk_gpu_auto_init(xudk_ctx *ctx) {
+    status s;
+
+    if (ctx->gpu_initialized) {
+        return XUDK_OK;
+    }
+    s = xudk_gpu_init_best_device(ctx);
+    if (xudk_ok(s)) {
+        return XUDK_OK;
+    }
+
+    xudk_log_info(ctx, L"No usable GPU (status 0x%llx), using the software rasterizer", s);
+    s = xudk_swr_install(ctx);
+    if (xudk_ok(s)) {
+        s = ctx->gpu.initialize_device(ctx, 0);
+    }
+    return s;
+}
+
+const wchar* xudk_gpu_vendor_name(xudk_gpu_vendor vendor) {
+    switch (vendor) {
+    case XUDK_GPU_VENDOR_NVIDIA:        return L"NVIDIA";
+    case XUDK_GPU_VENDOR_AMD:           return L"AMD";
+    case XUDK_GPU_VENDOR_INTEL:         return L"Intel";
+    case XUDK_GPU_VENDOR_ARM:           return L"ARM";
+    case XUDK_GPU_VENDOR_QUALCOMM:      return L"Qualcomm";
+    case XUDK_GPU_VENDOR_IMAGINATION:   return L"Imagination";
+    case XUDK_GPU_VENDOR_SOFTWARE:      return L"Software";
+    default:                            return L"Unknown";
+    }
+}
+
+const wchar* xudk_gpu_format_name(xudk_texture_format format) {
+    switch (format) {
+    case XUDK_FORMAT_R8G8B8A8_UNORM:        return L"R8G8B8A8_UNORM";
+    case XUDK_FORMAT_R8G8B8A8_SRGB:         return L"R8G8B8A8_SRGB";
+    case XUDK_FORMAT_B8G8R8A8_UNORM:        return L"B8G8R8A8_UNORM";
+    case XUDK_FORMAT_B8G8R8A8_SRGB:         return L"B8G8R8A8_SRGB";
+    case XUDK_FORMAT_R32G32B32A32_FLOAT:    return L"R32G32B32A32_FLOAT";
+    case XUDK_FORMAT_R16G16B16A16_FLOAT:    return L"R16G16B16A16_FLOAT";
+    case XUDK_FORMAT_R32G32_FLOAT:          return L"R32G32_FLOAT";
+    case XUDK_FORMAT_R32_FLOAT:             return L"R32_FLOAT";
+    case XUDK_FORMAT_D32_FLOAT:             return L"D32_FLOAT";
+    case XUDK_FORMAT_D24_UNORM_S8_UINT:     return L"D24_UNORM_S8_UINT";
+    case XUDK_FORMAT_BC1_UNORM:             return L"BC1_UNORM";
+    case XUDK_FORMAT_BC2_UNORM:             return L"BC2_UNORM";
+    case XUDK_FORMAT_BC3_UNORM:             return L"BC3_UNORM";
+    case XUDK_FORMAT_BC4_UNORM:             return L"BC4_UNORM";
+    case XUDK_FORMAT_BC5_UNORM:             return L"BC5_UNORM";
+    case XUDK_FORMAT_BC6H_UF16:             return L"BC6H_UF16";
+    case XUDK_FORMAT_BC7_UNORM:             return L"BC7_UNORM";
+    default:                                return L"UNKNOWN";
+    }
+}
+
+// =============================================================================
+// RESOURCE HELPERS
+// =============================================================================
+
+static status create_filled_buffer(xudk_ctx *ctx, const void *data, usize size, xudk_buffer_usage usage,
+                                   xudk_gpu_buffer *buffer) {
+    status s = ctx->gpu.allocate_buffer(ctx, size, usage, buffer);
+
+    if (xudk_ok(s) && data) {
+        s = ctx->gpu.upload_buffer_data(ctx, buffer, data, size, 0);
+        if (xudk_error(s)) {
+            ctx->gpu.free_buffer(ctx, buffer);
+        }
+    }
+    return s;
+}
+
+status xudk_gpu_create_vertex_buffer(xudk_ctx *ctx, const void *vertices, usize size, xudk_gpu_buffer *buffer) {
+    return create_filled_buffer(ctx, vertices, size, XUDK_BUFFER_VERTEX, buffer);
+}
+
+status xudk_gpu_create_index_buffer(xudk_ctx *ctx, const void *indices, usize size, bool is_32bit, xudk_gpu_buffer *buffer) {
+    (void)is_32bit;     // Index width is given again at bind time
+    return create_filled_buffer(ctx, indices, size, XUDK_BUFFER_INDEX, buffer);
+}
+
+status xudk_gpu_create_uniform_buffer(xudk_ctx *ctx, usize size, xudk_gpu_buffer *buffer) {
+    return create_filled_buffer(ctx, null, size, XUDK_BUFFER_UNIFORM | XUDK_BUFFER_DYNAMIC, buffer);
+}
+
+status xudk_gpu_update_uniform_buffer(xudk_ctx *ctx, xudk_gpu_buffer *buffer, const void *data, usize size) {
+    return ctx->gpu.upload_buffer_data(ctx, buffer, data, size, 0);
+}
+
+status xudk_gpu_create_vertex_shader_from_file(xudk_ctx *ctx, const wchar *path, xudk_gpu_shader *shader) {
+    return ctx->gpu.load_shader_from_file(ctx, path, XUDK_SHADER_VERTEX, L"main", shader);
+}
+
+status xudk_gpu_create_fragment_shader_from_file(xudk_ctx *ctx, const wchar *path, xudk_gpu_shader *shader) {
+    return ctx->gpu.load_shader_from_file(ctx, path, XUDK_SHADER_FRAGMENT, L"main", shader);
+}
+
+status xudk_gpu_create_compute_shader_from_file(xudk_ctx *ctx, const wchar *path, xudk_gpu_shader *shader) {
+    return ctx->gpu.load_shader_from_file(ctx, path, XUDK_SHADER_COMPUTE, L"main", shader);
+}
+
+// =============================================================================
+// PIPELINE & RENDER PASS HELPERS
+// =============================================================================
+
+status xudk_gpu_create_simple_pipeline(xudk_ctx *ctx, xudk_gpu_shader *vs, xudk_gpu_shader *fs,
+                                       xudk_primitive_topology topology, xudk_gpu_pipeline *pipeline) {
+    xudk_gpu_pipeline_desc desc;
+
+    xudk_memset(&desc, 0, sizeof(desc));
+    desc.vertex_shader = vs;
+    desc.fragment_shader = fs;
+    desc.topology = topology;
+    desc.render_target_count = 1;
+    desc.render_target_formats[0] = XUDK_FORMAT_B8G8R8A8_UNORM;
+    desc.sample_count = 1;
+    return ctx->gpu.create_graphics_pipeline(ctx, &desc, pipeline);
+}
+
+// Pipelines keep what they need from their shaders, so the vertex shader is released here
+status xudk_gpu_create_fullscreen_pipeline(xudk_ctx *ctx, xudk_gpu_shader *fs, xudk_gpu_pipeline *pipeline) {
+    xudk_gpu_shader vs;
+    status s;
+
+    s = ctx->gpu.compile_shader(ctx, XUDK_SHADER_VERTEX, xudk_fullscreen_vertex_shader_source, "main", &vs);
+    if (xudk_error(s)) {
+        return s;
+    }
+    s = xudk_gpu_create_simple_pipeline(ctx, &vs, fs, XUDK_TOPOLOGY_TRIANGLES, pipeline);
+    ctx->gpu.destroy_shader(ctx, &vs);
+    return s;
+}
+
+status xudk_gpu_create_simple_render_pass(xudk_ctx *ctx, xudk_gpu_texture *color_target,
+                                         xudk_gpu_texture *depth_target, xudk_gpu_render_pass *render_pass) {
+    xudk_gpu_texture *size_source = color_target ? color_target : depth_target;
+
+    if (!render_pass || !size_source) {
+        return XUDK_INVALID_PARAM;
+    }
+    xudk_memset(render_pass, 0, sizeof(*render_pass));
+    if (color_target) {
+        render_pass->color_targets = xudk_memalloc_tracked(ctx, sizeof(xudk_gpu_texture*));
+        if (!render_pass->color_targets) {
+            return XUDK_OUT_OF_MEMORY;
+        }
+        render_pass->color_targets[0] = color_target;
+        render_pass->color_target_count = 1;
+        render_pass->clear_color = true;
+        render_pass->clear_color_value[3] = 1.0f;
+    }
+    render_pass->depth_target = depth_target;
+    render_pass->width = size_source->width;
+    render_pass->height = size_source->height;
+    render_pass->clear_depth = depth_target != null;
+    render_pass->clear_depth_value = 1.0f;
+    return XUDK_OK;
+}
+
+status xudk_gpu_create_offscreen_render_pass(xudk_ctx *ctx, u32 width, u32 height,
+                                            xudk_texture_format format, xudk_gpu_render_pass *render_pass) {
+    xudk_gpu_texture *target = xudk_memalloc_tracked(ctx, sizeof(*target));
+    status s;
+
+    if (!target) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    s = ctx->gpu.create_render_target(ctx, width, height, format, 1, target);
+    if (xudk_error(s)) {
+        return s;
+    }
+    s = xudk_gpu_create_simple_render_pass(ctx, target, null, render_pass);
+    if (xudk_error(s)) {
+        ctx->gpu.destroy_texture(ctx, target);
+    }
+    return s;
+}
+
+status xudk_gpu_create_command_list(xudk_ctx *ctx, bool is_compute, xudk_gpu_cmd_buffer *list) {
+    status s;
+
+    if (!ctx->gpu.execute_commands) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    s = ctx->gpu.create_command_buffer(ctx, is_compute, list);
+    if (xudk_ok(s)) {
+        list->level = XUDK_CMD_BUFFER_SECONDARY;
+    }
+    return s;
+}
+
+// =============================================================================
+// DRAWING & COMPUTE HELPERS
+// =============================================================================
+
+// Expects a pipeline from xudk_gpu_create_fullscreen_pipeline() to be bound
+status xudk_gpu_draw_fullscreen_quad(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    return ctx->gpu.draw(ctx, cmd_buffer, 3, 1, 0, 0);
+}
+
+// width/height/depth are workgroup counts
+status xudk_gpu_dispatch_compute(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer,
+                                xudk_gpu_pipeline *pipeline, u32 width, u32 height, u32 depth) {
+    status s = ctx->gpu.bind_pipeline(ctx, cmd_buffer, pipeline);
+
+    if (xudk_ok(s)) {
+        s = ctx->gpu.dispatch(ctx, cmd_buffer, width, height, depth);
+    }
+    return s;
+}
@@ -0,0 +1,368 @@
+/*
+ * XUDK - Descriptor set pool
+ * Sets are created once and reused. xudk_gpu_descriptor_pool_get hashes the
+ * layout and the resources written into it, so drawing with the same
+ * bindings as any draw of the last frame_count frames hands back that set
+ * without a write; alloc gives a per-frame set to fill. A set unused for
+ * frame_count frames goes back on the free list at begin_frame, which is why
+ * begin_frame must come after the frame frame_count back has completed.
+ * As with the GPU APIs, a set's bindings are undefined until written: a
+ * recycled set keeps what its last user gave it. A resource is known only by
+ * its address and handle. A resource created after another is freed can get
+ * both back and would then match the old sets, which still bind the freed
+ * one; nothing here can tell, so the caller must forget it before freeing.
+ */
+
+#include "core.h"
+
+#define DESC_WRITE_WORDS    6           // Hashed per write
+#define DESC_HASH_CHUNK     32          // Writes hashed per update
+
+typedef struct {
+    u64             key;                // 0 for a set from alloc or forgotten, never looked up
+    handle          layout;
+    handle          set;
+    u64             last_frame;
+    u32             next;               // Next entry of the bucket, index + 1
+    u32             write_count;
+    u64*            words;              // DESC_WRITE_WORDS per write, checked on a key match
+} desc_entry;
+
+typedef struct {
+    handle          layout;
+    handle          set;
+} desc_free;
+
+struct xudk_gpu_descriptor_pool {
+    u32             frame_count;
+    u64             frame;
+    desc_entry*     entries;
+    usize           count;
+    usize           capacity;
+    u32*            buckets;            // Heads, index + 1; a power of two of them
+    usize           bucket_count;
+    desc_free*      free;
+    usize           free_count;
+    usize           free_capacity;
+};
+
+static bool grow(xudk_ctx *ctx, void **array, usize *capacity, usize needed, usize element_size) {
+    usize new_capacity = *capacity ? *capacity : 16;
+    void *grown;
+
+    if (needed <= *capacity) {
+        return true;
+    }
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    grown = ctx->memory.alloc(ctx, new_capacity * element_size);
+    if (!grown) {
+        return false;
+    }
+    if (*array) {
+        xudk_memcpy(grown, *array, *capacity * element_size);
+        ctx->memory.free(ctx, *array);
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+// Resources enter a write's words by address and handle
+static void write_words(const xudk_gpu_descriptor_write *w, u64 *words) {
+    words[0] = w->binding | (u64)w->array_index << 32;
+    words[1] = (u64)(usize)w->buffer;
+    words[2] = w->buffer ? (u64)(usize)w->buffer->buffer_handle : 0;
+    words[3] = w->offset;
+    words[4] = (u64)(usize)w->texture;
+    words[5] = w->texture ? (u64)(usize)w->texture->texture_handle : 0;
+}
+
+static u64 writes_key(handle layout, u32 count, const xudk_gpu_descriptor_write *writes) {
+    u64 words[DESC_HASH_CHUNK][DESC_WRITE_WORDS];
+    xudk_hash64_state state;
+    u64 key;
+
+    xudk_hash64_init(&state);
+    xudk_hash64_update(&state, &layout, sizeof(layout));
+    for (u32 i = 0; i < count; i += DESC_HASH_CHUNK) {
+        u32 chunk = count - i < DESC_HASH_CHUNK ? count - i : DESC_HASH_CHUNK;
+
+        for (u32 j = 0; j < chunk; j++) {
+            write_words(&writes[i + j], words[j]);
+        }
+        xudk_hash64_update(&state, words, chunk * sizeof(words[0]));
+    }
+    key = xudk_hash64_final(&state);
+    return key ? key : 1;
+}
+
+// Rules out two different writes sharing a key; a recreated resource still matches
+static bool writes_match(const desc_entry *e, u32 count, const xudk_gpu_descriptor_write *writes) {
+    u64 words[DESC_WRITE_WORDS];
+
+    if (e->write_count != count) {
+        return false;
+    }
+    for (u32 i = 0; i < count; i++) {
+        write_words(&writes[i], words);
+        if (xudk_memcmp(words, e->words + (usize)i * DESC_WRITE_WORDS, sizeof(words))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void drop_words(xudk_ctx *ctx, desc_entry *e) {
+    if (e->words) {
+        ctx->memory.free(ctx, e->words);
+        e->words = null;
+    }
+}
+
+static void link(xudk_gpu_descriptor_pool *pool, usize index) {
+    u32 *head = &pool->buckets[pool->entries[index].key & (pool->bucket_count - 1)];
+
+    pool->entries[index].next = *head;
+    *head = (u32)(index + 1);
+}
+
+// Keeps the buckets at no more than one entry each on average
+static bool rehash(xudk_ctx *ctx, xudk_gpu_descriptor_pool *pool) {
+    usize bucket_count = pool->bucket_count ? pool->bucket_count : 64;
+    u32 *buckets;
+
+    while (bucket_count < pool->capacity) {
+        bucket_count *= 2;
+    }
+    if (bucket_count != pool->bucket_count) {
+        buckets = ctx->memory.alloc(ctx, bucket_count * sizeof(u32));
+        if (!buckets) {
+            return false;
+        }
+        if (pool->buckets) {
+            ctx->memory.free(ctx, pool->buckets);
+        }
+        pool->buckets = buckets;
+        pool->bucket_count = bucket_count;
+    }
+    xudk_memset(pool->buckets, 0, pool->bucket_count * sizeof(u32));
+    for (usize i = 0; i < pool->count; i++) {
+        if (pool->entries[i].key) {
+            link(pool, i);
+        }
+    }
+    return true;
+}
+
+// A recycled set of the layout if there is one, else a new one
+static status take_set(xudk_ctx *ctx, xudk_gpu_descriptor_pool *pool, xudk_gpu_descriptor_layout *layout,
+                       desc_entry **entry) {
+    usize capacity = pool->capacity;
+    desc_entry *e;
+    handle set = null;
+    status s;
+
+    if (!grow(ctx, (void**)&pool->entries, &pool->capacity, pool->count + 1, sizeof(desc_entry))) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    if (pool->capacity != capacity && !rehash(ctx, pool)) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    for (usize i = pool->free_count; i--;) {
+        if (pool->free[i].layout == layout->layout_handle) {
+            set = pool->free[i].set;
+            pool->free[i] = pool->free[--pool->free_count];
+            break;
+        }
+    }
+    if (!set) {
+        s = ctx->gpu.create_descriptor_set(ctx, layout, &set);
+        if (xudk_error(s)) {
+            return s;
+        }
+    }
+    e = &pool->entries[pool->count++];
+    xudk_memset(e, 0, sizeof(*e));
+    e->layout = layout->layout_handle;
+    e->set = set;
+    e->last_frame = pool->frame;
+    *entry = e;
+    return XUDK_OK;
+}
+
+// Drops an entry just taken, keeping its set for reuse
+static void give_back(xudk_gpu_descriptor_pool *pool) {
+    desc_entry *e = &pool->entries[--pool->count];
+
+    pool->free[pool->free_count].layout = e->layout;
+    pool->free[pool->free_count++].set = e->set;
+}
+
+status xudk_gpu_descriptor_pool_create(xudk_ctx *ctx, u32 frame_count, xudk_gpu_descriptor_pool **pool) {
+    xudk_gpu_descriptor_pool *p;
+
+    if (!pool || !frame_count) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!ctx->gpu.create_descriptor_set || !ctx->gpu.update_descriptor_set) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    p = ctx->memory.alloc(ctx, sizeof(*p));
+    if (!p) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(p, 0, sizeof(*p));
+    p->frame_count = frame_count;
+    *pool = p;
+    return XUDK_OK;
+}
+
+// The GPU must be done with every set the pool handed out
+status xudk_gpu_descriptor_pool_destroy(xudk_ctx *ctx, xudk_gpu_descriptor_pool *pool) {
+    if (!pool) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (usize i = 0; i < pool->count; i++) {
+        drop_words(ctx, &pool->entries[i]);
+        ctx->gpu.destroy_descriptor_set(ctx, pool->entries[i].set);
+    }
+    for (usize i = 0; i < pool->free_count; i++) {
+        ctx->gpu.destroy_descriptor_set(ctx, pool->free[i].set);
+    }
+    if (pool->entries) {
+        ctx->memory.free(ctx, pool->entries);
+    }
+    if (pool->buckets) {
+        ctx->memory.free(ctx, pool->buckets);
+    }
+    if (pool->free) {
+        ctx->memory.free(ctx, pool->free);
+    }
+    ctx->memory.free(ctx, pool);
+    return XUDK_OK;
+}
+
+// Sets last used frame_count frames ago go back on the free list
+status xudk_gpu_descriptor_pool_begin_frame(xudk_ctx *ctx, xudk_gpu_descriptor_pool *pool) {
+    usize kept = 0;
+
+    if (!pool) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!grow(ctx, (void**)&pool->free, &pool->free_capacity, pool->free_count + pool->count, sizeof(desc_free))) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    pool->frame++;
+    for (usize i = 0; i < pool->count; i++) {
+        desc_entry *e = &pool->entries[i];
+
+        if (e->last_frame + pool->frame_count <= pool->frame) {
+            drop_words(ctx, e);
+            pool->free[pool->free_count].layout = e->layout;
+            pool->free[pool->free_count++].set = e->set;
+        } else {
+            pool->entries[kept++] = *e;
+        }
+    }
+    if (kept != pool->count) {
+        pool->count = kept;
+        rehash(ctx, pool);      // Same bucket count, so this cannot fail
+    }
+    return XUDK_OK;
+}
+
+// A set of `layout` for this frame; the caller writes every binding it reads
+status xudk_gpu_descriptor_pool_alloc(xudk_ctx *ctx, xudk_gpu_descriptor_pool *pool,
+                                      xudk_gpu_descriptor_layout *layout, handle *descriptor_set) {
+    desc_entry *e;
+    status s;
+
+    if (!pool || !layout || !layout->layout_handle || !descriptor_set) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!grow(ctx, (void**)&pool->free, &pool->free_capacity, pool->free_count + 1, sizeof(desc_free))) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    s = take_set(ctx, pool, layout, &e);
+    if (xudk_ok(s)) {
+        *descriptor_set = e->set;
+    }
+    return s;
+}
+
+// A set of `layout` holding `writes`, shared with every other get of the same
+// writes in the same order. Do not update it.
+status xudk_gpu_descriptor_pool_get(xudk_ctx *ctx, xudk_gpu_descriptor_pool *pool,
+                                    xudk_gpu_descriptor_layout *layout, u32 count,
+                                    const xudk_gpu_descriptor_write *writes, handle *descriptor_set) {
+    desc_entry *e;
+    u64 key;
+    status s;
+
+    if (!pool || !layout || !layout->layout_handle || (count && !writes) || !descriptor_set) {
+        return XUDK_INVALID_PARAM;
+    }
+    key = writes_key(layout->layout_handle, count, writes);
+    if (pool->bucket_count) {
+        for (u32 i = pool->buckets[key & (pool->bucket_count - 1)]; i; i = e->next) {
+            e = &pool->entries[i - 1];
+            if (e->key == key && e->layout == layout->layout_handle && writes_match(e, count, writes)) {
+                e->last_frame = pool->frame;
+                *descriptor_set = e->set;
+                return XUDK_OK;
+            }
+        }
+    }
+    if (!grow(ctx, (void**)&pool->free, &pool->free_capacity, pool->free_count + 1, sizeof(desc_free))) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    s = take_set(ctx, pool, layout, &e);
+    if (xudk_error(s)) {
+        return s;
+    }
+    e->words = count ? ctx->memory.alloc(ctx, (usize)count * sizeof(u64) * DESC_WRITE_WORDS) : null;
+    s = count && !e->words ? XUDK_OUT_OF_MEMORY : ctx->gpu.update_descriptor_set(ctx, e->set, count, writes);
+    if (xudk_error(s)) {
+        drop_words(ctx, e);
+        give_back(pool);
+        return s;
+    }
+    for (u32 i = 0; i < count; i++) {
+        write_words(&writes[i], e->words + (usize)i * DESC_WRITE_WORDS);
+    }
+    e->write_count = count;
+    e->key = key;
+    link(pool, (usize)(e - pool->entries));
+    *descriptor_set = e->set;
+    return XUDK_OK;
+}
+
+// Sets binding `buffer` or `texture` are no longer handed out by get. They
+// stay in use until they age out, as the GPU may still be reading them.
+status xudk_gpu_descriptor_pool_forget(xudk_ctx *ctx, xudk_gpu_descriptor_pool *pool,
+                                       const xudk_gpu_buffer *buffer, const xudk_gpu_texture *texture) {
+    bool dropped = false;
+
+    if (!pool || (!buffer && !texture)) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (usize i = 0; i < pool->count; i++) {
+        desc_entry *e = &pool->entries[i];
+
+        for (u32 w = 0; e->key && w < e->write_count; w++) {
+            const u64 *words = e->words + (usize)w * DESC_WRITE_WORDS;
+
+            if ((buffer && words[1] == (u64)(usize)buffer) || (texture && words[4] == (u64)(usize)texture)) {
+                drop_words(ctx, e);
+                e->key = 0;
+                dropped = true;
+            }
+        }
+    }
+    if (dropped) {
+        rehash(ctx, pool);      // Same bucket count, so this cannot fail
+    }
+    return XUDK_OK;
+}
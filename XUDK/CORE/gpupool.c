@@ -0,0 +1,635 @@
+/*
+ * XUDK - GPU memory pool
+ * Buffer memory is taken from the device in large blocks, one set per heap
+ * from get_memory_heaps and per mapped/unmapped use, and handed out in ranges
+ * by a TLSF allocator: two-level segregated free lists with bitmaps, so both
+ * allocation and free are constant time. The bookkeeping lives in CPU memory,
+ * since device memory may not be readable. Transient render targets are kept
+ * and handed to the next pass that asks for the same size and format.
+ */
+
+#include "core.h"
+
+#define POOL_DEFAULT_BLOCK  (8u * 1024 * 1024)
+#define POOL_GRANULARITY    64              // Smallest range and finest offset
+#define POOL_SL_BITS        4
+#define POOL_SL_COUNT       (1u << POOL_SL_BITS)
+#define POOL_FL_COUNT       48
+#define POOL_MAX_HEAPS      8
+#define POOL_RANGE_CHUNK    64
+#define POOL_TARGET_CHUNK   16
+
+typedef struct pool_block pool_block;
+typedef struct pool_range pool_range;
+typedef struct pool_class pool_class;
+
+// A run of bytes in a block, free or allocated
+struct pool_range {
+    u64             offset;
+    u64             size;
+    pool_range*     prev_phys;      // Neighbours in the same block
+    pool_range*     next_phys;
+    pool_range*     prev_free;      // Free list links while free
+    pool_range*     next_free;
+    pool_block*     block;
+    bool            free;
+};
+
+struct pool_block {
+    xudk_gpu_buffer buffer;
+    u8*             mapped;
+    pool_class*     owner;
+    pool_block*     next;
+    u32             live;           // Allocated ranges
+};
+
+typedef struct pool_chunk {
+    struct pool_chunk*  next;
+    pool_range          ranges[POOL_RANGE_CHUNK];
+} pool_chunk;
+
+// One TLSF instance per heap and mapping
+struct pool_class {
+    pool_range*     lists[POOL_FL_COUNT][POOL_SL_COUNT];
+    u64             fl_bitmap;
+    u16             sl_bitmap[POOL_FL_COUNT];
+    pool_block*     blocks;
+    u32             heap;
+    bool            mapped;
+};
+
+typedef struct {
+    xudk_gpu_texture    texture;
+    xudk_texture_format format;
+    bool                in_use;
+} pool_target;
+
+// Targets never move once created, since their textures are handed out
+typedef struct target_chunk {
+    struct target_chunk*    next;
+    u32                     count;
+    pool_target             targets[POOL_TARGET_CHUNK];
+} target_chunk;
+
+struct xudk_gpu_pool {
+    xudk_ctx*           ctx;
+    u64                 block_size;
+    u32                 heap_count;
+    xudk_gpu_pool_stats stats[POOL_MAX_HEAPS];  // Running counters; the free-space fields are filled on request
+    pool_class          classes[POOL_MAX_HEAPS * 2];
+    pool_range*         spare;                  // Unused range records
+    pool_chunk*         chunks;
+    target_chunk*       targets;                // Newest first; only it has room
+    usize               target_count;
+};
+
+static u32 top_bit(u64 value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (u32)index;
+#else
+    return 63 - (u32)__builtin_clzll(value);
+#endif
+}
+
+static u32 low_bit(u64 value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (u32)index;
+#else
+    return (u32)__builtin_ctzll(value);
+#endif
+}
+
+static u64 align_up(u64 value, u64 alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// =============================================================================
+// TLSF
+// =============================================================================
+
+// Sizes are at least POOL_GRANULARITY, so fl is always above POOL_SL_BITS
+static void mapping(u64 size, u32 *fl, u32 *sl) {
+    *fl = top_bit(size);
+    *sl = (u32)(size >> (*fl - POOL_SL_BITS)) & (POOL_SL_COUNT - 1);
+}
+
+static void list_insert(pool_class *c, pool_range *r) {
+    u32 fl, sl;
+
+    mapping(r->size, &fl, &sl);
+    r->free = true;
+    r->prev_free = null;
+    r->next_free = c->lists[fl][sl];
+    if (r->next_free) {
+        r->next_free->prev_free = r;
+    }
+    c->lists[fl][sl] = r;
+    c->fl_bitmap |= 1ull << fl;
+    c->sl_bitmap[fl] |= (u16)(1u << sl);
+}
+
+static void list_remove(pool_class *c, pool_range *r) {
+    u32 fl, sl;
+
+    mapping(r->size, &fl, &sl);
+    if (r->prev_free) {
+        r->prev_free->next_free = r->next_free;
+    } else {
+        c->lists[fl][sl] = r->next_free;
+        if (!c->lists[fl][sl]) {
+            c->sl_bitmap[fl] &= (u16)~(1u << sl);
+            if (!c->sl_bitmap[fl]) {
+                c->fl_bitmap &= ~(1ull << fl);
+            }
+        }
+    }
+    if (r->next_free) {
+        r->next_free->prev_free = r->prev_free;
+    }
+    r->free = false;
+}
+
+// Any range on the returned list is at least `size`: the request is rounded up
+// to the next list boundary first
+static pool_range* list_find(pool_class *c, u64 size) {
+    u32 fl, sl;
+    u64 sl_map;
+
+    if (top_bit(size) >= POOL_FL_COUNT - 1) {
+        return null;
+    }
+    size += (1ull << (top_bit(size) - POOL_SL_BITS)) - 1;
+    mapping(size, &fl, &sl);
+    sl_map = c->sl_bitmap[fl] & (~0ull << sl);
+    if (!sl_map) {
+        u64 fl_map = fl + 1 < 64 ? c->fl_bitmap & (~0ull << (fl + 1)) : 0;
+        if (!fl_map) {
+            return null;
+        }
+        fl = low_bit(fl_map);
+        sl_map = c->sl_bitmap[fl];
+    }
+    return c->lists[fl][low_bit(sl_map)];
+}
+
+static pool_range* range_new(xudk_gpu_pool *pool) {
+    pool_range *r = pool->spare;
+
+    if (!r) {
+        pool_chunk *chunk = pool->ctx->memory.alloc(pool->ctx, sizeof(*chunk));
+        if (!chunk) {
+            return null;
+        }
+        chunk->next = pool->chunks;
+        pool->chunks = chunk;
+        for (u32 i = 0; i < POOL_RANGE_CHUNK; i++) {
+            chunk->ranges[i].next_free = i + 1 < POOL_RANGE_CHUNK ? &chunk->ranges[i + 1] : null;
+        }
+        r = chunk->ranges;
+    }
+    pool->spare = r->next_free;
+    xudk_memset(r, 0, sizeof(*r));
+    return r;
+}
+
+static void range_release(xudk_gpu_pool *pool, pool_range *r) {
+    r->next_free = pool->spare;
+    pool->spare = r;
+}
+
+// Cut `r` so it holds exactly `size` bytes; the rest goes back on the lists
+static bool range_split(xudk_gpu_pool *pool, pool_class *c, pool_range *r, u64 size) {
+    pool_range *rest;
+
+    if (r->size - size < POOL_GRANULARITY) {
+        return true;
+    }
+    rest = range_new(pool);
+    if (!rest) {
+        return false;
+    }
+    rest->offset = r->offset + size;
+    rest->size = r->size - size;
+    rest->block = r->block;
+    rest->prev_phys = r;
+    rest->next_phys = r->next_phys;
+    if (rest->next_phys) {
+        rest->next_phys->prev_phys = rest;
+    }
+    r->next_phys = rest;
+    r->size = size;
+    list_insert(c, rest);
+    return true;
+}
+
+// Fold `next` into `r`; both are off the lists
+static void range_merge(xudk_gpu_pool *pool, pool_range *r, pool_range *next) {
+    r->size += next->size;
+    r->next_phys = next->next_phys;
+    if (r->next_phys) {
+        r->next_phys->prev_phys = r;
+    }
+    range_release(pool, next);
+}
+
+// =============================================================================
+// BLOCKS
+// =============================================================================
+
+// Returns the new block's one free range, left on the lists
+static pool_range* block_create(xudk_gpu_pool *pool, pool_class *c, u64 size) {
+    xudk_ctx *ctx = pool->ctx;
+    xudk_gpu_pool_stats *stats = &pool->stats[c->heap];
+    xudk_buffer_usage usage = XUDK_BUFFER_VERTEX | XUDK_BUFFER_INDEX | XUDK_BUFFER_UNIFORM | XUDK_BUFFER_STORAGE;
+    pool_block *block;
+    pool_range *r;
+    void *mapped = null;
+
+    if (stats->budget && stats->reserved + size > stats->budget) {
+        return null;
+    }
+    block = ctx->memory.alloc(ctx, sizeof(*block));
+    r = range_new(pool);
+    if (!block || !r) {
+        if (block) {
+            ctx->memory.free(ctx, block);
+        }
+        if (r) {
+            range_release(pool, r);
+        }
+        return null;
+    }
+    xudk_memset(block, 0, sizeof(*block));
+    if (c->mapped) {
+        usage |= XUDK_BUFFER_DYNAMIC;
+    }
+    if (xudk_error(ctx->gpu.allocate_buffer(ctx, size, usage, &block->buffer))) {
+        ctx->memory.free(ctx, block);
+        range_release(pool, r);
+        return null;
+    }
+    if (c->mapped && xudk_error(ctx->gpu.map_buffer(ctx, &block->buffer, &mapped))) {
+        ctx->gpu.free_buffer(ctx, &block->buffer);
+        ctx->memory.free(ctx, block);
+        range_release(pool, r);
+        return null;
+    }
+    block->mapped = mapped;
+    block->owner = c;
+    block->next = c->blocks;
+    c->blocks = block;
+
+    r->offset = 0;
+    r->size = size;
+    r->block = block;
+    list_insert(c, r);
+    stats->reserved += size;
+    stats->block_count++;
+    return r;
+}
+
+// `r` is the block's only range and is off the lists
+static void block_release(xudk_gpu_pool *pool, pool_class *c, pool_block *block, pool_range *r) {
+    xudk_ctx *ctx = pool->ctx;
+    xudk_gpu_pool_stats *stats = &pool->stats[c->heap];
+    pool_block **link = &c->blocks;
+
+    while (*link != block) {
+        link = &(*link)->next;
+    }
+    *link = block->next;
+    stats->reserved -= block->buffer.size;
+    stats->block_count--;
+    if (block->mapped) {
+        ctx->gpu.unmap_buffer(ctx, &block->buffer);
+    }
+    ctx->gpu.free_buffer(ctx, &block->buffer);
+    ctx->memory.free(ctx, block);
+    range_release(pool, r);
+}
+
+// Host-visible requests need a host-visible heap; among the candidates, a heap
+// whose device_local matches the hint wins
+static pool_class* pick_class(xudk_gpu_pool *pool, u32 flags) {
+    bool want_host = (flags & XUDK_GPU_ALLOC_HOST_VISIBLE) != 0;
+    bool want_local = (flags & XUDK_GPU_ALLOC_DEVICE_LOCAL) != 0 || !want_host;
+    i32 best = -1, best_score = -1;
+
+    for (u32 i = 0; i < pool->heap_count; i++) {
+        const xudk_gpu_pool_stats *heap = &pool->stats[i];
+        i32 score;
+
+        if (want_host && !heap->host_visible) {
+            continue;
+        }
+        score = (heap->device_local == want_local ? 2 : 0) + (heap->host_visible == want_host ? 1 : 0);
+        if (score > best_score) {
+            best = (i32)i;
+            best_score = score;
+        }
+    }
+    return best < 0 ? null : &pool->classes[best * 2 + (want_host ? 1 : 0)];
+}
+
+// =============================================================================
+// POOL
+// =============================================================================
+
+status xudk_gpu_pool_create(xudk_ctx *ctx, u64 block_size, xudk_gpu_pool **pool) {
+    xudk_gpu_heap *heaps = null;
+    usize heap_count = 0;
+    xudk_gpu_pool *p;
+
+    if (!pool || (block_size && block_size < POOL_GRANULARITY)) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!ctx->gpu_initialized || !ctx->gpu.allocate_buffer) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    p = ctx->memory.alloc(ctx, sizeof(*p));
+    if (!p) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(p, 0, sizeof(*p));
+    p->ctx = ctx;
+    p->block_size = align_up(block_size ? block_size : POOL_DEFAULT_BLOCK, POOL_GRANULARITY);
+
+    // Without heap information everything goes to one unified heap of unknown size
+    if (!ctx->gpu.get_memory_heaps || xudk_error(ctx->gpu.get_memory_heaps(ctx, &heaps, &heap_count)) || !heap_count) {
+        heap_count = 0;
+    }
+    p->heap_count = heap_count ? (u32)(heap_count < POOL_MAX_HEAPS ? heap_count : POOL_MAX_HEAPS) : 1;
+    for (u32 i = 0; i < p->heap_count; i++) {
+        xudk_gpu_pool_stats *stats = &p->stats[i];
+
+        stats->type = heap_count ? heaps[i].type : XUDK_GPU_MEM_UNIFIED;
+        stats->device_local = heap_count ? heaps[i].device_local : true;
+        stats->host_visible = heap_count ? heaps[i].host_visible : true;
+        stats->budget = heap_count ? heaps[i].size : 0;
+        p->classes[i * 2].heap = p->classes[i * 2 + 1].heap = i;
+        p->classes[i * 2 + 1].mapped = true;
+    }
+    *pool = p;
+    return XUDK_OK;
+}
+
+// Also destroys every render target the pool handed out
+status xudk_gpu_pool_destroy(xudk_ctx *ctx, xudk_gpu_pool *pool) {
+    if (!pool) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (u32 i = 0; i < POOL_MAX_HEAPS * 2; i++) {
+        pool_block *block = pool->classes[i].blocks;
+
+        while (block) {
+            pool_block *next = block->next;
+            if (block->mapped) {
+                ctx->gpu.unmap_buffer(ctx, &block->buffer);
+            }
+            ctx->gpu.free_buffer(ctx, &block->buffer);
+            ctx->memory.free(ctx, block);
+            block = next;
+        }
+    }
+    while (pool->chunks) {
+        pool_chunk *next = pool->chunks->next;
+        ctx->memory.free(ctx, pool->chunks);
+        pool->chunks = next;
+    }
+    while (pool->targets) {
+        target_chunk *next = pool->targets->next;
+        for (u32 i = 0; i < pool->targets->count; i++) {
+            ctx->gpu.destroy_texture(ctx, &pool->targets->targets[i].texture);
+        }
+        ctx->memory.free(ctx, pool->targets);
+        pool->targets = next;
+    }
+    ctx->memory.free(ctx, pool);
+    return XUDK_OK;
+}
+
+// Requests over half a block get a block of their own, released with them. A
+// new block's range is taken as it is, since list_find rounds the request up
+// past a block sized to fit it.
+status xudk_gpu_pool_alloc(xudk_ctx *ctx, xudk_gpu_pool *pool, u64 size, u64 alignment, u32 flags,
+                           xudk_gpu_allocation *allocation) {
+    pool_class *c;
+    pool_range *r;
+    u64 search, offset;
+    bool fresh = false;
+
+    (void)ctx;
+    if (!pool || !allocation || !size || (alignment & (alignment - 1))) {
+        return XUDK_INVALID_PARAM;
+    }
+    c = pick_class(pool, flags);
+    if (!c) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    alignment = alignment > POOL_GRANULARITY ? alignment : POOL_GRANULARITY;
+    size = align_up(size, POOL_GRANULARITY);
+    search = size + alignment - POOL_GRANULARITY;
+    if (search < size || top_bit(size) >= POOL_FL_COUNT - 1) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+
+    r = list_find(c, search);
+    if (!r) {
+        // Offset 0 suits any alignment, so a dedicated block needs only `size`
+        r = block_create(pool, c, search > pool->block_size / 2 ? size : pool->block_size);
+        if (!r) {
+            return XUDK_OUT_OF_MEMORY;
+        }
+        fresh = true;
+    }
+    list_remove(c, r);
+
+    // Leading padding for the alignment becomes a free range of its own
+    offset = align_up(r->offset, alignment);
+    if (offset != r->offset) {
+        pool_range *lead = r;
+        if (!range_split(pool, c, lead, offset - r->offset)) {
+            list_insert(c, r);
+            return XUDK_OUT_OF_MEMORY;
+        }
+        r = lead->next_phys;
+        list_remove(c, r);
+        list_insert(c, lead);
+    }
+    if (!range_split(pool, c, r, size)) {
+        if (fresh) {
+            block_release(pool, c, r->block, r);
+        } else {
+            list_insert(c, r);
+        }
+        return XUDK_OUT_OF_MEMORY;
+    }
+
+    r->block->live++;
+    pool->stats[c->heap].allocated += r->size;
+    pool->stats[c->heap].allocation_count++;
+
+    allocation->buffer = &r->block->buffer;
+    allocation->offset = r->offset;
+    allocation->size = r->size;
+    allocation->mapped = r->block->mapped ? r->block->mapped + r->offset : null;
+    allocation->gpu_address = r->block->buffer.gpu_address + r->offset;
+    allocation->allocation_handle = r;
+    return XUDK_OK;
+}
+
+// The GPU must be done with the range. Empty blocks go back to the device,
+// except the last regular block of a kind.
+status xudk_gpu_pool_free(xudk_ctx *ctx, xudk_gpu_pool *pool, xudk_gpu_allocation *allocation) {
+    pool_range *r;
+    pool_block *block;
+    pool_class *c;
+
+    (void)ctx;
+    if (!pool || !allocation || !allocation->allocation_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    r = allocation->allocation_handle;
+    if (r->free) {
+        return XUDK_INVALID_PARAM;
+    }
+    block = r->block;
+    c = block->owner;
+
+    block->live--;
+    pool->stats[c->heap].allocated -= r->size;
+    pool->stats[c->heap].allocation_count--;
+    if (r->next_phys && r->next_phys->free) {
+        list_remove(c, r->next_phys);
+        range_merge(pool, r, r->next_phys);
+    }
+    if (r->prev_phys && r->prev_phys->free) {
+        pool_range *prev = r->prev_phys;
+        list_remove(c, prev);
+        range_merge(pool, prev, r);
+        r = prev;
+    }
+    if (!block->live && r->size == block->buffer.size &&
+        (block->buffer.size != pool->block_size || c->blocks != block || block->next)) {
+        block_release(pool, c, block, r);
+    } else {
+        list_insert(c, r);
+    }
+    xudk_memset(allocation, 0, sizeof(*allocation));
+    return XUDK_OK;
+}
+
+// =============================================================================
+// TRANSIENT RENDER TARGETS
+// =============================================================================
+
+// Hands out an idle render target of the same size and format when there is
+// one, so passes that never overlap share the memory
+status xudk_gpu_pool_acquire_render_target(xudk_ctx *ctx, xudk_gpu_pool *pool, u32 width, u32 height,
+                                           xudk_texture_format format, xudk_gpu_texture **texture) {
+    pool_target *target;
+    status s;
+
+    if (!pool || !texture || !width || !height) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (target_chunk *chunk = pool->targets; chunk; chunk = chunk->next) {
+        for (u32 i = 0; i < chunk->count; i++) {
+            target = &chunk->targets[i];
+            if (!target->in_use && target->texture.width == width && target->texture.height == height &&
+                target->format == format) {
+                target->in_use = true;
+                *texture = &target->texture;
+                return XUDK_OK;
+            }
+        }
+    }
+
+    if (!pool->targets || pool->targets->count == POOL_TARGET_CHUNK) {
+        target_chunk *chunk = ctx->memory.alloc(ctx, sizeof(*chunk));
+        if (!chunk) {
+            return XUDK_OUT_OF_MEMORY;
+        }
+        chunk->next = pool->targets;
+        chunk->count = 0;
+        pool->targets = chunk;
+    }
+    target = &pool->targets->targets[pool->targets->count];
+    s = ctx->gpu.create_render_target(ctx, width, height, format, 1, &target->texture);
+    if (xudk_error(s)) {
+        return s;
+    }
+    target->format = format;
+    target->in_use = true;
+    pool->targets->count++;
+    pool->target_count++;
+    *texture = &target->texture;
+    return XUDK_OK;
+}
+
+status xudk_gpu_pool_release_render_target(xudk_ctx *ctx, xudk_gpu_pool *pool, xudk_gpu_texture *texture) {
+    (void)ctx;
+    if (!pool || !texture) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (target_chunk *chunk = pool->targets; chunk; chunk = chunk->next) {
+        for (u32 i = 0; i < chunk->count; i++) {
+            if (&chunk->targets[i].texture == texture && chunk->targets[i].in_use) {
+                chunk->targets[i].in_use = false;
+                return XUDK_OK;
+            }
+        }
+    }
+    return XUDK_INVALID_PARAM;
+}
+
+// =============================================================================
+// STATISTICS
+// =============================================================================
+
+// `stats` holds at least `*count` entries; on return `*count` is the heap count
+status xudk_gpu_pool_get_stats(xudk_gpu_pool *pool, xudk_gpu_pool_stats *stats, u32 *count) {
+    if (!pool || !count || (*count && !stats)) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (u32 i = 0; i < pool->heap_count && i < *count; i++) {
+        xudk_gpu_pool_stats *out = &stats[i];
+        u64 free_bytes = 0;
+
+        *out = pool->stats[i];
+        out->largest_free = 0;
+        for (u32 m = 0; m < 2; m++) {
+            const pool_class *c = &pool->classes[i * 2 + m];
+
+            for (u32 fl = 0; fl < POOL_FL_COUNT; fl++) {
+                for (u32 sl = 0; sl < POOL_SL_COUNT; sl++) {
+                    for (const pool_range *r = c->lists[fl][sl]; r; r = r->next_free) {
+                        free_bytes += r->size;
+                        out->largest_free = r->size > out->largest_free ? r->size : out->largest_free;
+                    }
+                }
+            }
+        }
+        out->fragmentation = free_bytes ? (u32)((free_bytes - out->largest_free) * 100 / free_bytes) : 0;
+    }
+    // Render targets are counted against the heap device-local requests go to
+    if (pool->target_count && *count) {
+        pool_class *c = pick_class(pool, XUDK_GPU_ALLOC_DEVICE_LOCAL);
+        u32 heap = c ? c->heap : 0;
+
+        if (heap < *count) {
+            for (const target_chunk *chunk = pool->targets; chunk; chunk = chunk->next) {
+                for (u32 i = 0; i < chunk->count; i++) {
+                    stats[heap].render_target_count++;
+                    stats[heap].render_target_bytes += chunk->targets[i].texture.size;
+                }
+            }
+        }
+    }
+    *count = pool->heap_count;
+    return XUDK_OK;
+}
@@ -0,0 +1,665 @@
+/*
+ * XUDK - GPU profiler
+ * While open, every render pass and dispatch is a GPU scope, bracketed by two
+ * timestamp queries (and a pipeline statistics query when asked for);
+ * xudk_gpu_profile_begin / _end add named scopes around any other work.
+ * A frame's queries are read back when its slot comes round again,
+ * PROFILER_FRAMES frames later, so reading them never stalls the GPU.
+ * xudk_profile_begin / _end time CPU work on the same timeline. GPU scopes
+ * are placed from the first submission of their frame: durations are exact,
+ * placement is off by however long that submission queued. Everything
+ * recorded goes to the ESP as Chrome trace JSON with
+ * xudk_gpu_profiler_write_trace (open it in chrome://tracing or Perfetto).
+ */
+
+#include "core.h"
+
+#define PROFILER_FRAMES         3                   // Frames whose queries may still be in flight
+#define PROFILER_MAX_DEPTH      16                  // Open scopes per timeline
+#define PROFILER_MAX_EVENTS     (1u << 20)          // Kept until the next write_trace
+#define PROFILER_WRITE_CHUNK    (64 * 1024)
+#define PROFILER_NO_SCOPE       0xFFFFFFFFu         // Stack entry of a scope past max_scopes
+
+#define PROFILER_TRACK_CPU      1                   // Chrome trace thread ids
+#define PROFILER_TRACK_GPU      2
+
+typedef struct {
+    const char*     name;
+    u64             start;                          // Nanoseconds since open
+    u64             duration;
+    u32             track;                          // PROFILER_TRACK_*
+    u32             depth;
+    bool            has_statistics;
+    xudk_gpu_pipeline_statistics statistics;
+} prof_event;
+
+typedef struct {
+    const char*     name;
+    u32             depth;
+    bool            ended;
+} prof_scope;
+
+typedef struct {
+    prof_scope*     scopes;                         // max_scopes of them
+    u32             scope_count;
+    u64             begin;                          // CPU time of begin_frame
+    u64             anchor;                         // CPU time of the first submission, 0 before it
+} prof_frame;
+
+typedef struct {
+    const char*     name;
+    u64             start;
+} prof_cpu_scope;
+
+typedef struct {
+    xudk_gpu                backend;                // Entries the profiler replaced
+    u64                     origin;                 // xudk_time_ns at open
+    bool                    gpu_scopes;             // Timestamp queries are available
+    bool                    statistics;
+    u32                     max_scopes;
+    xudk_gpu_query_pool     timestamps;             // Two per scope per frame slot
+    xudk_gpu_query_pool     pipeline_statistics;    // One per scope per frame slot
+    prof_frame              frames[PROFILER_FRAMES];
+    u64                     frame;
+    bool                    in_frame;
+    u32                     gpu_stack[PROFILER_MAX_DEPTH];
+    u32                     gpu_depth;
+    u32                     gpu_overflow;           // Scopes begun past PROFILER_MAX_DEPTH
+    prof_cpu_scope          cpu_stack[PROFILER_MAX_DEPTH];
+    u32                     cpu_depth;
+    u32                     cpu_overflow;
+    u64                     gpu_end;                // Latest GPU event end placed so far
+    prof_event*             events;
+    usize                   event_count;
+    usize                   event_capacity;
+    u64                     dropped;                // Events past PROFILER_MAX_EVENTS
+    xudk_gpu_profile_scope* resolved;               // Last frame read back
+    u32                     resolved_count;
+    u64                     (*ticks)[2];            // Scratch for reading one frame back
+} profiler;
+
+static profiler* profiler_of(xudk_ctx *ctx) {
+    return ctx->gpu_profiler;
+}
+
+// =============================================================================
+// CLOCK
+// =============================================================================
+
+// `ticks` at `frequency` per second in nanoseconds, without overflowing
+static u64 ticks_to_ns(u64 ticks, u64 frequency) {
+    return ticks / frequency * 1000000000ULL + ticks % frequency * 1000000000ULL / frequency;
+}
+
+static u64 now_ns(xudk_ctx *ctx, const profiler *prof) {
+    return xudk_time_ns(ctx) - prof->origin;
+}
+
+// =============================================================================
+// EVENTS
+// =============================================================================
+
+static prof_event* add_event(xudk_ctx *ctx, profiler *prof, const char *name, u32 track, u32 depth,
+                             u64 start, u64 end) {
+    prof_event *event;
+
+    if (prof->event_count == prof->event_capacity) {
+        usize capacity = prof->event_capacity ? prof->event_capacity * 2 : 256;
+        prof_event *grown;
+
+        if (prof->event_count >= PROFILER_MAX_EVENTS ||
+            !(grown = ctx->memory.alloc(ctx, capacity * sizeof(*grown)))) {
+            prof->dropped++;
+            return null;
+        }
+        if (prof->events) {
+            xudk_memcpy(grown, prof->events, prof->event_count * sizeof(*grown));
+            ctx->memory.free(ctx, prof->events);
+        }
+        prof->events = grown;
+        prof->event_capacity = capacity;
+    }
+    event = &prof->events[prof->event_count++];
+    event->name = name;
+    event->start = start;
+    event->duration = end > start ? end - start : 0;
+    event->track = track;
+    event->depth = depth;
+    event->has_statistics = false;
+    return event;
+}
+
+// =============================================================================
+// GPU SCOPES
+// =============================================================================
+
+static prof_frame* current_frame(profiler *prof) {
+    return &prof->frames[prof->frame % PROFILER_FRAMES];
+}
+
+static u32 query_base(const profiler *prof, const prof_frame *frame) {
+    return (u32)(frame - prof->frames) * prof->max_scopes;
+}
+
+static status scope_begin(xudk_ctx *ctx, profiler *prof, xudk_gpu_cmd_buffer *cmd_buffer, const char *name) {
+    prof_frame *frame = current_frame(prof);
+    u32 index = frame->scope_count, query = query_base(prof, frame) + index;
+    status s;
+
+    if (prof->gpu_depth == PROFILER_MAX_DEPTH) {
+        prof->gpu_overflow++;
+        return XUDK_OK;
+    }
+    if (!prof->gpu_scopes || !prof->in_frame || index == prof->max_scopes) {
+        prof->gpu_stack[prof->gpu_depth++] = PROFILER_NO_SCOPE;
+        return XUDK_OK;
+    }
+    s = prof->backend.write_timestamp(ctx, cmd_buffer, &prof->timestamps, query * 2);
+    if (xudk_ok(s) && prof->statistics) {
+        s = prof->backend.begin_query(ctx, cmd_buffer, &prof->pipeline_statistics, query);
+    }
+    if (xudk_error(s)) {
+        return s;
+    }
+    frame->scopes[index].name = name;
+    frame->scopes[index].depth = prof->gpu_depth;
+    frame->scopes[index].ended = false;
+    frame->scope_count++;
+    prof->gpu_stack[prof->gpu_depth++] = index;
+    return XUDK_OK;
+}
+
+static status scope_end(xudk_ctx *ctx, profiler *prof, xudk_gpu_cmd_buffer *cmd_buffer) {
+    prof_frame *frame = current_frame(prof);
+    u32 index, query;
+    status s = XUDK_OK;
+
+    if (prof->gpu_overflow) {
+        prof->gpu_overflow--;
+        return XUDK_OK;
+    }
+    if (!prof->gpu_depth) {
+        return XUDK_INVALID_PARAM;
+    }
+    index = prof->gpu_stack[--prof->gpu_depth];
+    if (index == PROFILER_NO_SCOPE) {
+        return XUDK_OK;
+    }
+    query = query_base(prof, frame) + index;
+    if (prof->statistics) {
+        s = prof->backend.end_query(ctx, cmd_buffer, &prof->pipeline_statistics, query);
+    }
+    if (xudk_ok(s)) {
+        s = prof->backend.write_timestamp(ctx, cmd_buffer, &prof->timestamps, query * 2 + 1);
+    }
+    frame->scopes[index].ended = xudk_ok(s);
+    return s;
+}
+
+// Reads a frame's queries back, waiting for the GPU only if they are not in yet,
+// and turns its scopes into events
+static void resolve(xudk_ctx *ctx, profiler *prof, prof_frame *frame) {
+    u32 base = query_base(prof, frame);
+    u64 first = ~0ULL, anchor, frequency = prof->timestamps.timestamp_frequency;
+    u64 (*ticks)[2] = prof->ticks;
+    bool waited = false;
+
+    if (!frame->scope_count) {
+        return;
+    }
+    prof->resolved_count = 0;
+    for (u32 i = 0; i < frame->scope_count; i++) {
+        status s = XUDK_NOT_READY;
+
+        if (frame->scopes[i].ended) {
+            s = prof->backend.get_query_results(ctx, &prof->timestamps, (base + i) * 2, 2, ticks[i]);
+            if (s == XUDK_NOT_READY && !waited) {
+                waited = true;
+                prof->backend.wait_idle(ctx);
+                s = prof->backend.get_query_results(ctx, &prof->timestamps, (base + i) * 2, 2, ticks[i]);
+            }
+        }
+        frame->scopes[i].ended = xudk_ok(s);
+        if (xudk_ok(s) && ticks[i][0] < first) {
+            first = ticks[i][0];
+        }
+    }
+
+    anchor = frame->anchor ? frame->anchor : frame->begin;
+    anchor = anchor > prof->gpu_end ? anchor : prof->gpu_end;
+    for (u32 i = 0; i < frame->scope_count; i++) {
+        const prof_scope *scope = &frame->scopes[i];
+        xudk_gpu_profile_scope *out = &prof->resolved[prof->resolved_count];
+        u64 start, end;
+        prof_event *event;
+
+        if (!scope->ended) {
+            continue;
+        }
+        start = ticks_to_ns(ticks[i][0] - first, frequency);
+        end = ticks[i][1] > ticks[i][0] ? start + ticks_to_ns(ticks[i][1] - ticks[i][0], frequency) : start;
+        xudk_memset(out, 0, sizeof(*out));
+        out->name = scope->name;
+        out->depth = scope->depth;
+        out->start_ns = start;
+        out->duration_ns = end - start;
+        if (prof->statistics) {
+            prof->backend.get_query_results(ctx, &prof->pipeline_statistics, base + i, 1, &out->statistics);
+        }
+        prof->resolved_count++;
+
+        event = add_event(ctx, prof, scope->name, PROFILER_TRACK_GPU, scope->depth, anchor + start, anchor + end);
+        if (event && prof->statistics) {
+            event->has_statistics = true;
+            event->statistics = out->statistics;
+        }
+        if (anchor + end > prof->gpu_end) {
+            prof->gpu_end = anchor + end;
+        }
+    }
+    frame->scope_count = 0;
+}
+
+// =============================================================================
+// WRAPPED ENTRY POINTS
+// =============================================================================
+
+static status prof_begin_render_pass(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer,
+                                     xudk_gpu_render_pass *render_pass) {
+    profiler *prof = profiler_of(ctx);
+    status s = scope_begin(ctx, prof, cmd_buffer, "Render pass");
+
+    return xudk_ok(s) ? prof->backend.begin_render_pass(ctx, cmd_buffer, render_pass) : s;
+}
+
+static status prof_end_render_pass(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    profiler *prof = profiler_of(ctx);
+    status s = prof->backend.end_render_pass(ctx, cmd_buffer);
+
+    return xudk_ok(s) ? scope_end(ctx, prof, cmd_buffer) : s;
+}
+
+static status prof_dispatch(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 group_count_x, u32 group_count_y,
+                            u32 group_count_z) {
+    profiler *prof = profiler_of(ctx);
+    status s = scope_begin(ctx, prof, cmd_buffer, "Dispatch");
+
+    if (xudk_ok(s)) {
+        s = prof->backend.dispatch(ctx, cmd_buffer, group_count_x, group_count_y, group_count_z);
+        scope_end(ctx, prof, cmd_buffer);
+    }
+    return s;
+}
+
+static void note_submission(xudk_ctx *ctx, profiler *prof) {
+    prof_frame *frame = current_frame(prof);
+
+    if (!frame->anchor && frame->scope_count) {
+        frame->anchor = now_ns(ctx, prof);
+    }
+}
+
+static status prof_submit_command_buffer(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    profiler *prof = profiler_of(ctx);
+
+    note_submission(ctx, prof);
+    return prof->backend.submit_command_buffer(ctx, cmd_buffer);
+}
+
+static status prof_submit_and_signal(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_fence *fence,
+                                     u64 value) {
+    profiler *prof = profiler_of(ctx);
+
+    note_submission(ctx, prof);
+    return prof->backend.submit_and_signal(ctx, cmd_buffer, fence, value);
+}
+
+// =============================================================================
+// CHROME TRACE
+// =============================================================================
+
+typedef struct {
+    xudk_ctx*       ctx;
+    handle          file;
+    char*           buffer;
+    usize           used;
+    status          status;
+} trace_writer;
+
+static void flush_out(trace_writer *w) {
+    usize written;
+
+    if (xudk_ok(w->status) && w->used) {
+        w->status = w->ctx->filesystem.write_file(w->ctx, w->file, w->buffer, w->used, &written);
+        if (xudk_ok(w->status) && written != w->used) {
+            w->status = XUDK_DEVICE_ERROR;
+        }
+    }
+    w->used = 0;
+}
+
+static void put_char(trace_writer *w, char c) {
+    if (w->used == PROFILER_WRITE_CHUNK) {
+        flush_out(w);
+    }
+    w->buffer[w->used++] = c;
+}
+
+static void put(trace_writer *w, const char *text) {
+    for (; *text; text++) {
+        put_char(w, *text);
+    }
+}
+
+static void put_u64(trace_writer *w, u64 value) {
+    char digits[21];
+    u32 i = sizeof(digits) - 1;
+
+    digits[i] = 0;
+    do {
+        digits[--i] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    put(w, digits + i);
+}
+
+// Nanoseconds as the microseconds Chrome trace expects
+static void put_us(trace_writer *w, u64 ns) {
+    char fraction[5] = { '.', (char)('0' + ns / 100 % 10), (char)('0' + ns / 10 % 10), (char)('0' + ns % 10), 0 };
+
+    put_u64(w, ns / 1000);
+    put(w, fraction);
+}
+
+static void put_string(trace_writer *w, const char *text) {
+    static const char hex[] = "0123456789abcdef";
+
+    put_char(w, '"');
+    for (; *text; text++) {
+        u8 c = (u8)*text;
+
+        if (c == '"' || c == '\\') {
+            put_char(w, '\\');
+        } else if (c < 0x20) {
+            put(w, "\\u00");
+            put_char(w, hex[c >> 4]);
+            c = (u8)hex[c & 0xF];
+        }
+        put_char(w, (char)c);
+    }
+    put_char(w, '"');
+}
+
+static void put_event(trace_writer *w, const prof_event *event) {
+    static const char *names[] = {
+        "input_vertices", "input_primitives", "vertex_invocations",
+        "rasterized_primitives", "fragment_invocations", "compute_invocations"
+    };
+    const u64 *statistics = (const u64*)&event->statistics;
+
+    put(w, ",\n{\"name\":");
+    put_string(w, event->name);
+    put(w, ",\"cat\":");
+    put(w, event->track == PROFILER_TRACK_GPU ? "\"gpu\"" : "\"cpu\"");
+    put(w, ",\"ph\":\"X\",\"pid\":1,\"tid\":");
+    put_u64(w, event->track);
+    put(w, ",\"ts\":");
+    put_us(w, event->start);
+    put(w, ",\"dur\":");
+    put_us(w, event->duration);
+    if (event->has_statistics) {
+        put(w, ",\"args\":{");
+        for (u32 i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            put(w, i ? ",\"" : "\"");
+            put(w, names[i]);
+            put(w, "\":");
+            put_u64(w, statistics[i]);
+        }
+        put(w, "}");
+    }
+    put(w, "}");
+}
+
+// =============================================================================
+// PUBLIC API
+// =============================================================================
+
+// `max_scopes` bounds the GPU scopes of one frame; pipeline statistics are
+// collected only when asked for, as they slow some GPUs down
+status xudk_gpu_profiler_open(xudk_ctx *ctx, u32 max_scopes, bool pipeline_statistics) {
+    profiler *prof;
+    usize size;
+    status s;
+
+    if (profiler_of(ctx) || !max_scopes || max_scopes > 0xFFFFFFFFu / (2 * PROFILER_FRAMES)) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!ctx->gpu_initialized || !ctx->gpu.begin_render_pass || !ctx->gpu.end_render_pass || !ctx->gpu.dispatch ||
+        !ctx->gpu.submit_command_buffer || !ctx->gpu.submit_and_signal) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    size = sizeof(*prof) + (usize)max_scopes * (sizeof(xudk_gpu_profile_scope) + sizeof(*prof->ticks) +
+                                                PROFILER_FRAMES * sizeof(prof_scope));
+    prof = ctx->memory.alloc(ctx, size);
+    if (!prof) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(prof, 0, size);
+    prof->backend = ctx->gpu;
+    prof->max_scopes = max_scopes;
+    prof->resolved = (xudk_gpu_profile_scope*)(prof + 1);
+    prof->ticks = (u64(*)[2])(prof->resolved + max_scopes);
+    for (u32 i = 0; i < PROFILER_FRAMES; i++) {
+        prof->frames[i].scopes = (prof_scope*)(prof->ticks + max_scopes) + i * max_scopes;
+    }
+
+    // Without timestamp queries only the CPU timeline is recorded
+    if (ctx->gpu.create_query_pool && ctx->gpu.write_timestamp && ctx->gpu.get_query_results &&
+        ctx->gpu.reset_queries && ctx->gpu.wait_idle) {
+        s = ctx->gpu.create_query_pool(ctx, XUDK_QUERY_TIMESTAMP, max_scopes * 2 * PROFILER_FRAMES,
+                                       &prof->timestamps);
+        prof->gpu_scopes = xudk_ok(s);
+    }
+    if (prof->gpu_scopes && pipeline_statistics && ctx->gpu.begin_query && ctx->gpu.end_query) {
+        s = ctx->gpu.create_query_pool(ctx, XUDK_QUERY_PIPELINE_STATISTICS, max_scopes * PROFILER_FRAMES,
+                                       &prof->pipeline_statistics);
+        prof->statistics = xudk_ok(s);
+    }
+    prof->origin = xudk_time_ns(ctx);
+
+    ctx->gpu_profiler = prof;
+    ctx->gpu.begin_render_pass = prof_begin_render_pass;
+    ctx->gpu.end_render_pass = prof_end_render_pass;
+    ctx->gpu.dispatch = prof_dispatch;
+    ctx->gpu.submit_command_buffer = prof_submit_command_buffer;
+    ctx->gpu.submit_and_signal = prof_submit_and_signal;
+    return XUDK_OK;
+}
+
+// Anything not written with write_trace is dropped. A layer opened since
+// that wraps the same entries has to be closed first.
+status xudk_gpu_profiler_close(xudk_ctx *ctx) {
+    profiler *prof = profiler_of(ctx);
+
+    if (!prof) {
+        return XUDK_OK;
+    }
+    if (ctx->gpu.begin_render_pass != prof_begin_render_pass || ctx->gpu.end_render_pass != prof_end_render_pass ||
+        ctx->gpu.dispatch != prof_dispatch || ctx->gpu.submit_command_buffer != prof_submit_command_buffer ||
+        ctx->gpu.submit_and_signal != prof_submit_and_signal) {
+        return XUDK_ACCESS_DENIED;
+    }
+    ctx->gpu.begin_render_pass = prof->backend.begin_render_pass;
+    ctx->gpu.end_render_pass = prof->backend.end_render_pass;
+    ctx->gpu.dispatch = prof->backend.dispatch;
+    ctx->gpu.submit_command_buffer = prof->backend.submit_command_buffer;
+    ctx->gpu.submit_and_signal = prof->backend.submit_and_signal;
+    ctx->gpu_profiler = null;
+    if (prof->gpu_scopes || prof->statistics) {
+        ctx->gpu.wait_idle(ctx);   // The queries may still be written
+    }
+    if (prof->gpu_scopes) {
+        ctx->gpu.destroy_query_pool(ctx, &prof->timestamps);
+    }
+    if (prof->statistics) {
+        ctx->gpu.destroy_query_pool(ctx, &prof->pipeline_statistics);
+    }
+    if (prof->events) {
+        ctx->memory.free(ctx, prof->events);
+    }
+    ctx->memory.free(ctx, prof);
+    return XUDK_OK;
+}
+
+// Reads back the frame that last used this slot, then starts the next one
+status xudk_gpu_profiler_begin_frame(xudk_ctx *ctx) {
+    profiler *prof = profiler_of(ctx);
+    prof_frame *frame;
+
+    if (!prof || prof->in_frame) {
+        return XUDK_INVALID_PARAM;
+    }
+    frame = current_frame(prof);
+    resolve(ctx, prof, frame);
+    if (prof->gpu_scopes) {
+        prof->backend.reset_queries(ctx, &prof->timestamps, query_base(prof, frame) * 2, prof->max_scopes * 2);
+    }
+    if (prof->statistics) {
+        prof->backend.reset_queries(ctx, &prof->pipeline_statistics, query_base(prof, frame), prof->max_scopes);
+    }
+    frame->begin = now_ns(ctx, prof);
+    frame->anchor = 0;
+    prof->in_frame = true;
+    return XUDK_OK;
+}
+
+// GPU scopes still open are dropped with the frame
+status xudk_gpu_profiler_end_frame(xudk_ctx *ctx) {
+    profiler *prof = profiler_of(ctx);
+    prof_frame *frame;
+
+    if (!prof || !prof->in_frame) {
+        return XUDK_INVALID_PARAM;
+    }
+    frame = current_frame(prof);
+    add_event(ctx, prof, "Frame", PROFILER_TRACK_CPU, 0, frame->begin, now_ns(ctx, prof));
+    prof->gpu_depth = 0;
+    prof->gpu_overflow = 0;
+    prof->frame++;
+    prof->in_frame = false;
+    return XUDK_OK;
+}
+
+// `name` is kept, not copied: pass a string that outlives the profiler
+status xudk_gpu_profile_begin(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, const char *name) {
+    profiler *prof = profiler_of(ctx);
+
+    if (!prof || !cmd_buffer || !name) {
+        return XUDK_INVALID_PARAM;
+    }
+    return scope_begin(ctx, prof, cmd_buffer, name);
+}
+
+status xudk_gpu_profile_end(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    profiler *prof = profiler_of(ctx);
+
+    if (!prof || !cmd_buffer) {
+        return XUDK_INVALID_PARAM;
+    }
+    return scope_end(ctx, prof, cmd_buffer);
+}
+
+status xudk_profile_begin(xudk_ctx *ctx, const char *name) {
+    profiler *prof = profiler_of(ctx);
+
+    if (!prof || !name) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (prof->cpu_depth == PROFILER_MAX_DEPTH) {
+        prof->cpu_overflow++;
+        return XUDK_OK;
+    }
+    prof->cpu_stack[prof->cpu_depth].name = name;
+    prof->cpu_stack[prof->cpu_depth++].start = now_ns(ctx, prof);
+    return XUDK_OK;
+}
+
+status xudk_profile_end(xudk_ctx *ctx) {
+    profiler *prof = profiler_of(ctx);
+    const prof_cpu_scope *scope;
+    u64 end;
+
+    if (!prof || (!prof->cpu_depth && !prof->cpu_overflow)) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (prof->cpu_overflow) {
+        prof->cpu_overflow--;
+        return XUDK_OK;
+    }
+    end = now_ns(ctx, prof);
+    scope = &prof->cpu_stack[--prof->cpu_depth];
+    add_event(ctx, prof, scope->name, PROFILER_TRACK_CPU, prof->cpu_depth + 1, scope->start, end);
+    return XUDK_OK;
+}
+
+// The GPU scopes of the last frame read back, in the order they began; valid
+// until the next begin_frame
+status xudk_gpu_profiler_get_scopes(xudk_ctx *ctx, const xudk_gpu_profile_scope **scopes, u32 *count) {
+    profiler *prof = profiler_of(ctx);
+
+    if (!prof || !scopes || !count) {
+        return XUDK_INVALID_PARAM;
+    }
+    *scopes = prof->resolved;
+    *count = prof->resolved_count;
+    return XUDK_OK;
+}
+
+// Reads back every frame still pending, writes all events so far and starts
+// collecting afresh
+status xudk_gpu_profiler_write_trace(xudk_ctx *ctx, const wchar *path) {
+    profiler *prof = profiler_of(ctx);
+    trace_writer w;
+    status s;
+
+    if (!prof || !path) {
+        return XUDK_INVALID_PARAM;
+    }
+    // Oldest first; the frame being recorded stays as it is
+    for (u32 i = 0; i < PROFILER_FRAMES; i++) {
+        prof_frame *frame = &prof->frames[(prof->frame + i) % PROFILER_FRAMES];
+
+        if (i || !prof->in_frame) {
+            resolve(ctx, prof, frame);
+        }
+    }
+
+    xudk_memset(&w, 0, sizeof(w));
+    w.ctx = ctx;
+    w.buffer = ctx->memory.alloc(ctx, PROFILER_WRITE_CHUNK);
+    if (!w.buffer) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    s = ctx->filesystem.create_file(ctx, path, &w.file);
+    if (xudk_error(s)) {
+        ctx->memory.free(ctx, w.buffer);
+        return s;
+    }
+    put(&w, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":");
+    put_u64(&w, prof->dropped);
+    put(&w, "},\"traceEvents\":[\n"
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n"
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+    for (usize i = 0; i < prof->event_count; i++) {
+        put_event(&w, &prof->events[i]);
+    }
+    put(&w, "\n]}\n");
+    flush_out(&w);
+    s = w.status;
+    ctx->filesystem.close_file(ctx, w.file);
+    ctx->memory.free(ctx, w.buffer);
+
+    prof->event_count = 0;
+    prof->dropped = 0;
+    return s;
+}
@@ -0,0 +1,137 @@
+/*
+ * XUDK - Per-frame GPU ring allocator
+ * One dynamic buffer is mapped for the ring's lifetime and handed out in
+ * slices. Frames claim the space in order; a frame's space comes back when
+ * begin_frame, frame_count frames later, has waited for the submission that
+ * read it. Steady-state rendering allocates nothing.
+ */
+
+#include "core.h"
+
+#define RING_DEFAULT_ALIGNMENT  256     // Uniform offset alignment on every common GPU
+
+static u64 align_up(u64 value, u64 alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+status xudk_gpu_ring_create(xudk_ctx *ctx, u64 size, u32 frame_count, xudk_gpu_ring *ring) {
+    void *mapped;
+    status s;
+
+    if (!ring || !size || !frame_count || frame_count > XUDK_GPU_RING_MAX_FRAMES) {
+        return XUDK_INVALID_PARAM;
+    }
+    xudk_memset(ring, 0, sizeof(*ring));
+    s = ctx->gpu.allocate_buffer(ctx, size, XUDK_BUFFER_VERTEX | XUDK_BUFFER_INDEX | XUDK_BUFFER_UNIFORM |
+                                 XUDK_BUFFER_DYNAMIC, &ring->buffer);
+    if (xudk_error(s)) {
+        return s;
+    }
+    s = ctx->gpu.map_buffer(ctx, &ring->buffer, &mapped);
+    if (xudk_error(s)) {
+        ctx->gpu.free_buffer(ctx, &ring->buffer);
+        return s;
+    }
+    ring->mapped = mapped;
+    ring->frame_count = frame_count;
+    return XUDK_OK;
+}
+
+status xudk_gpu_ring_destroy(xudk_ctx *ctx, xudk_gpu_ring *ring) {
+    if (!ring || !ring->buffer.buffer_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    // The GPU may still be reading the last frames
+    for (u32 i = 0; i < ring->frame_count; i++) {
+        if (ring->frame_work[i]) {
+            ctx->gpu.wait_for_completion(ctx, ring->frame_work[i]);
+        }
+    }
+    ctx->gpu.unmap_buffer(ctx, &ring->buffer);
+    ctx->gpu.free_buffer(ctx, &ring->buffer);
+    xudk_memset(ring, 0, sizeof(*ring));
+    return XUDK_OK;
+}
+
+// Retires the frame that last used this slot, waiting for it if need be
+status xudk_gpu_ring_begin_frame(xudk_ctx *ctx, xudk_gpu_ring *ring) {
+    u32 slot;
+
+    if (!ring || !ring->mapped || ring->in_frame) {
+        return XUDK_INVALID_PARAM;
+    }
+    slot = (u32)(ring->frame % ring->frame_count);
+    if (ring->frame >= ring->frame_count) {
+        if (ring->frame_work[slot]) {
+            status s = ctx->gpu.wait_for_completion(ctx, ring->frame_work[slot]);
+            if (xudk_error(s)) {
+                return s;
+            }
+            ring->frame_work[slot] = null;
+        }
+        ring->tail = ring->frame_end[slot];
+    }
+    ring->in_frame = true;
+    return XUDK_OK;
+}
+
+// `cmd_buffer` is the submission that reads this frame's slices; null if nothing does
+status xudk_gpu_ring_end_frame(xudk_ctx *ctx, xudk_gpu_ring *ring, xudk_gpu_cmd_buffer *cmd_buffer) {
+    u32 slot;
+
+    (void)ctx;
+    if (!ring || !ring->in_frame) {
+        return XUDK_INVALID_PARAM;
+    }
+    slot = (u32)(ring->frame % ring->frame_count);
+    ring->frame_end[slot] = ring->head;
+    ring->frame_work[slot] = cmd_buffer;
+    ring->frame++;
+    ring->in_frame = false;
+    return XUDK_OK;
+}
+
+// A slice never wraps: if it would run off the end, it starts over at offset 0
+status xudk_gpu_ring_alloc(xudk_gpu_ring *ring, u64 size, u64 alignment, xudk_gpu_slice *slice) {
+    u64 capacity, lap, start, offset;
+
+    if (!ring || !ring->mapped || !slice || !size || (alignment & (alignment - 1))) {
+        return XUDK_INVALID_PARAM;
+    }
+    capacity = ring->buffer.size;
+    alignment = alignment ? alignment : RING_DEFAULT_ALIGNMENT;
+    if (size > capacity) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    lap = ring->head - ring->head % capacity;
+    offset = align_up(ring->head % capacity, alignment);
+    if (offset + size > capacity) {
+        lap += capacity;
+        offset = 0;
+    }
+    start = lap + offset;
+    if (start + size - ring->tail > capacity) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    ring->head = start + size;
+
+    slice->buffer = &ring->buffer;
+    slice->data = ring->mapped + offset;
+    slice->offset = offset;
+    slice->gpu_address = ring->buffer.gpu_address + offset;
+    slice->size = size;
+    return XUDK_OK;
+}
+
+status xudk_gpu_ring_push(xudk_gpu_ring *ring, const void *data, u64 size, u64 alignment, xudk_gpu_slice *slice) {
+    status s;
+
+    if (!data) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = xudk_gpu_ring_alloc(ring, size, alignment, slice);
+    if (xudk_ok(s)) {
+        xudk_memcpy(slice->data, data, (usize)size);
+    }
+    return s;
+}
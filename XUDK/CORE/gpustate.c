@@ -0,0 +1,376 @@
+/*
+ * XUDK - GPU resource state tracking
+ * While open, every buffer and texture carries the state of its last
+ * recorded use. xudk_gpu_use_buffer / _texture declare how the next pass,
+ * dispatch or copy uses a resource; render pass attachments and copy
+ * operands are declared automatically. Declared uses collect per command
+ * buffer and go out as one resource_barrier call right before the work that
+ * needs them, with source and destination stages taken from the uses, so
+ * reads after reads cost nothing and nothing drains the whole GPU.
+ * States follow recording order: record command buffers in the order they
+ * are submitted.
+ */
+
+#include "core.h"
+
+// A use declared since the command buffer's last flush
+typedef struct {
+    xudk_gpu_cmd_buffer*    cmd_buffer;
+    xudk_gpu_buffer*        buffer;
+    xudk_gpu_texture*       texture;
+    u32                     before;
+    u32                     after;
+} state_use;
+
+typedef struct {
+    xudk_gpu                backend;        // Entries the tracker replaced
+    state_use*              uses;
+    usize                   use_count;
+    usize                   use_capacity;
+    xudk_gpu_barrier*       barriers;       // Scratch for one flush
+    usize                   barrier_capacity;
+} state_tracker;
+
+static state_tracker* tracker_of(xudk_ctx *ctx) {
+    return ctx->gpu_state_tracker;
+}
+
+static bool grow(xudk_ctx *ctx, void **array, usize *capacity, usize needed, usize element_size) {
+    usize new_capacity = *capacity ? *capacity : 16;
+    void *grown;
+
+    if (needed <= *capacity) {
+        return true;
+    }
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    grown = ctx->memory.alloc(ctx, new_capacity * element_size);
+    if (!grown) {
+        return false;
+    }
+    if (*array) {
+        xudk_memcpy(grown, *array, *capacity * element_size);
+        ctx->memory.free(ctx, *array);
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+static bool read_only(u32 state) {
+    return !(state & ~XUDK_STATE_READ_MASK);
+}
+
+// Stages that touch a resource in `state`; shader access is compute work or
+// both graphics shader stages, since a use does not say which of the two
+static u32 state_stages(u32 state, bool compute) {
+    u32 stages = 0;
+
+    if (state & (XUDK_STATE_VERTEX_BUFFER | XUDK_STATE_INDEX_BUFFER)) {
+        stages |= XUDK_STAGE_VERTEX_INPUT;
+    }
+    if (state & (XUDK_STATE_UNIFORM_BUFFER | XUDK_STATE_SHADER_READ | XUDK_STATE_SHADER_WRITE)) {
+        stages |= compute ? XUDK_STAGE_COMPUTE : XUDK_STAGE_VERTEX_SHADER | XUDK_STAGE_FRAGMENT_SHADER;
+    }
+    if (state & (XUDK_STATE_DEPTH_READ | XUDK_STATE_DEPTH_WRITE)) {
+        stages |= XUDK_STAGE_DEPTH;
+    }
+    if (state & XUDK_STATE_RENDER_TARGET) {
+        stages |= XUDK_STAGE_COLOR_OUTPUT;
+    }
+    if (state & (XUDK_STATE_COPY_SOURCE | XUDK_STATE_COPY_DEST)) {
+        stages |= XUDK_STAGE_TRANSFER;
+    }
+    return stages;  // Nothing on the GPU reads XUDK_STATE_PRESENT
+}
+
+// Exactly one of buffer and texture is set
+static status declare(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_buffer *buffer,
+                      xudk_gpu_texture *texture, u32 state) {
+    state_tracker *tracker = tracker_of(ctx);
+    u32 *current = buffer ? &buffer->state : &texture->state;
+    state_use *use = null;
+
+    if (!tracker) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!cmd_buffer || !cmd_buffer->is_recording || !state || (!read_only(state) && (state & (state - 1)))) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (usize i = 0; i < tracker->use_count; i++) {
+        state_use *u = &tracker->uses[i];
+
+        if (u->cmd_buffer == cmd_buffer && u->buffer == buffer && u->texture == texture) {
+            use = u;
+            break;
+        }
+    }
+    if (use) {
+        // Declared twice for the same work: reads add up, a write replaces
+        use->after = read_only(use->after) && read_only(state) ? use->after | state : state;
+    } else {
+        if (!grow(ctx, (void**)&tracker->uses, &tracker->use_capacity, tracker->use_count + 1, sizeof(state_use))) {
+            return XUDK_OUT_OF_MEMORY;
+        }
+        use = &tracker->uses[tracker->use_count++];
+        use->cmd_buffer = cmd_buffer;
+        use->buffer = buffer;
+        use->texture = texture;
+        use->before = *current;
+        // Reads the resource is already in need no transition
+        use->after = read_only(*current) && *current && !(state & ~*current) ? *current : state;
+    }
+    *current = use->after;
+    return XUDK_OK;
+}
+
+// One barrier for every transition the command buffer's declared uses need;
+// a use that stays in a read state only adds its stages to the resource
+static status flush(xudk_ctx *ctx, state_tracker *tracker, xudk_gpu_cmd_buffer *cmd_buffer, bool compute) {
+    usize kept = 0;
+    u32 count = 0;
+
+    if (!grow(ctx, (void**)&tracker->barriers, &tracker->barrier_capacity, tracker->use_count,
+              sizeof(xudk_gpu_barrier))) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    for (usize i = 0; i < tracker->use_count; i++) {
+        state_use *use = &tracker->uses[i];
+        u32 *stages, dst;
+
+        if (use->cmd_buffer != cmd_buffer) {
+            tracker->uses[kept++] = *use;
+            continue;
+        }
+        stages = use->buffer ? &use->buffer->stages : &use->texture->stages;
+        dst = state_stages(use->after, compute);
+        // Shader writes after shader writes still need ordering
+        if (use->before != use->after || (use->after & XUDK_STATE_SHADER_WRITE)) {
+            xudk_gpu_barrier *barrier = &tracker->barriers[count++];
+
+            barrier->buffer = use->buffer;
+            barrier->texture = use->texture;
+            barrier->before = use->before;
+            barrier->after = use->after;
+            barrier->src_stages = *stages;
+            barrier->dst_stages = dst;
+            *stages = dst;
+        } else {
+            *stages |= dst;
+        }
+    }
+    tracker->use_count = kept;
+    if (!count) {
+        return XUDK_OK;
+    }
+    if (!tracker->backend.resource_barrier) {
+        return tracker->backend.insert_barrier(ctx, cmd_buffer);
+    }
+    return tracker->backend.resource_barrier(ctx, cmd_buffer, count, tracker->barriers);
+}
+
+// =============================================================================
+// WRAPPED ENTRIES
+// =============================================================================
+
+static status track_begin_render_pass(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer,
+                                      xudk_gpu_render_pass *render_pass) {
+    state_tracker *tracker = tracker_of(ctx);
+    status s = XUDK_OK;
+
+    if (!render_pass || (render_pass->color_target_count && !render_pass->color_targets)) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (u32 i = 0; i < render_pass->color_target_count && xudk_ok(s); i++) {
+        if (render_pass->color_targets[i]) {
+            s = declare(ctx, cmd_buffer, null, render_pass->color_targets[i], XUDK_STATE_RENDER_TARGET);
+        }
+    }
+    if (xudk_ok(s) && render_pass->depth_target) {
+        s = declare(ctx, cmd_buffer, null, render_pass->depth_target, XUDK_STATE_DEPTH_WRITE);
+    }
+    if (xudk_ok(s)) {
+        s = flush(ctx, tracker, cmd_buffer, false);
+    }
+    return xudk_ok(s) ? tracker->backend.begin_render_pass(ctx, cmd_buffer, render_pass) : s;
+}
+
+static status track_dispatch(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 group_count_x,
+                             u32 group_count_y, u32 group_count_z) {
+    state_tracker *tracker = tracker_of(ctx);
+    status s = flush(ctx, tracker, cmd_buffer, true);
+
+    return xudk_ok(s) ? tracker->backend.dispatch(ctx, cmd_buffer, group_count_x, group_count_y, group_count_z) : s;
+}
+
+static status track_copy_buffer(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_buffer *src,
+                                u64 src_offset, xudk_gpu_buffer *dst, u64 dst_offset, u64 size) {
+    state_tracker *tracker = tracker_of(ctx);
+    status s;
+
+    if (!src || !dst) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = declare(ctx, cmd_buffer, src, null, XUDK_STATE_COPY_SOURCE);
+    if (xudk_ok(s)) {
+        s = declare(ctx, cmd_buffer, dst, null, XUDK_STATE_COPY_DEST);
+    }
+    if (xudk_ok(s)) {
+        s = flush(ctx, tracker, cmd_buffer, cmd_buffer->is_compute);
+    }
+    return xudk_ok(s) ? tracker->backend.copy_buffer(ctx, cmd_buffer, src, src_offset, dst, dst_offset, size) : s;
+}
+
+static status track_copy_buffer_to_texture(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_buffer *src,
+                                           u64 src_offset, u64 size, xudk_gpu_texture *texture, u32 mip_level,
+                                           u32 array_slice) {
+    state_tracker *tracker = tracker_of(ctx);
+    status s;
+
+    if (!src || !texture) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = declare(ctx, cmd_buffer, src, null, XUDK_STATE_COPY_SOURCE);
+    if (xudk_ok(s)) {
+        s = declare(ctx, cmd_buffer, null, texture, XUDK_STATE_COPY_DEST);
+    }
+    if (xudk_ok(s)) {
+        s = flush(ctx, tracker, cmd_buffer, cmd_buffer->is_compute);
+    }
+    return xudk_ok(s) ? tracker->backend.copy_buffer_to_texture(ctx, cmd_buffer, src, src_offset, size, texture,
+                                                                mip_level, array_slice) : s;
+}
+
+// Uses declared after the last work, such as XUDK_STATE_PRESENT, go out here
+static status track_end_recording(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    state_tracker *tracker = tracker_of(ctx);
+    status s = XUDK_OK;
+
+    if (cmd_buffer && cmd_buffer->is_recording) {
+        s = flush(ctx, tracker, cmd_buffer, cmd_buffer->is_compute);
+    }
+    return xudk_ok(s) ? tracker->backend.end_recording(ctx, cmd_buffer) : s;
+}
+
+// Pending uses must not outlive what they point at
+static void drop_uses(state_tracker *tracker, const void *object) {
+    usize kept = 0;
+
+    for (usize i = 0; i < tracker->use_count; i++) {
+        state_use *use = &tracker->uses[i];
+
+        if (use->cmd_buffer != object && (const void*)use->buffer != object && (const void*)use->texture != object) {
+            tracker->uses[kept++] = *use;
+        }
+    }
+    tracker->use_count = kept;
+}
+
+static status track_destroy_command_buffer(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    state_tracker *tracker = tracker_of(ctx);
+
+    drop_uses(tracker, cmd_buffer);
+    return tracker->backend.destroy_command_buffer(ctx, cmd_buffer);
+}
+
+static status track_free_buffer(xudk_ctx *ctx, xudk_gpu_buffer *buffer) {
+    state_tracker *tracker = tracker_of(ctx);
+
+    drop_uses(tracker, buffer);
+    return tracker->backend.free_buffer(ctx, buffer);
+}
+
+static status track_destroy_texture(xudk_ctx *ctx, xudk_gpu_texture *texture) {
+    state_tracker *tracker = tracker_of(ctx);
+
+    drop_uses(tracker, texture);
+    return tracker->backend.destroy_texture(ctx, texture);
+}
+
+// =============================================================================
+// PUBLIC API
+// =============================================================================
+
+status xudk_gpu_state_tracking_open(xudk_ctx *ctx) {
+    state_tracker *tracker;
+
+    if (tracker_of(ctx)) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!ctx->gpu_initialized || !ctx->gpu.begin_render_pass || !ctx->gpu.dispatch || !ctx->gpu.copy_buffer ||
+        !ctx->gpu.copy_buffer_to_texture || !ctx->gpu.end_recording || !ctx->gpu.destroy_command_buffer ||
+        !ctx->gpu.free_buffer || !ctx->gpu.destroy_texture ||
+        (!ctx->gpu.resource_barrier && !ctx->gpu.insert_barrier)) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    tracker = ctx->memory.alloc(ctx, sizeof(*tracker));
+    if (!tracker) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(tracker, 0, sizeof(*tracker));
+    tracker->backend = ctx->gpu;
+
+    ctx->gpu_state_tracker = tracker;
+    ctx->gpu.begin_render_pass = track_begin_render_pass;
+    ctx->gpu.dispatch = track_dispatch;
+    ctx->gpu.copy_buffer = track_copy_buffer;
+    ctx->gpu.copy_buffer_to_texture = track_copy_buffer_to_texture;
+    ctx->gpu.end_recording = track_end_recording;
+    ctx->gpu.destroy_command_buffer = track_destroy_command_buffer;
+    ctx->gpu.free_buffer = track_free_buffer;
+    ctx->gpu.destroy_texture = track_destroy_texture;
+    return XUDK_OK;
+}
+
+// Uses not flushed yet are dropped. A layer opened since that wraps the same
+// entries has to be closed first.
+status xudk_gpu_state_tracking_close(xudk_ctx *ctx) {
+    state_tracker *tracker = tracker_of(ctx);
+
+    if (!tracker) {
+        return XUDK_OK;
+    }
+    if (ctx->gpu.begin_render_pass != track_begin_render_pass || ctx->gpu.dispatch != track_dispatch ||
+        ctx->gpu.copy_buffer != track_copy_buffer || ctx->gpu.copy_buffer_to_texture != track_copy_buffer_to_texture ||
+        ctx->gpu.end_recording != track_end_recording ||
+        ctx->gpu.destroy_command_buffer != track_destroy_command_buffer ||
+        ctx->gpu.free_buffer != track_free_buffer || ctx->gpu.destroy_texture != track_destroy_texture) {
+        return XUDK_ACCESS_DENIED;
+    }
+    ctx->gpu.begin_render_pass = tracker->backend.begin_render_pass;
+    ctx->gpu.dispatch = tracker->backend.dispatch;
+    ctx->gpu.copy_buffer = tracker->backend.copy_buffer;
+    ctx->gpu.copy_buffer_to_texture = tracker->backend.copy_buffer_to_texture;
+    ctx->gpu.end_recording = tracker->backend.end_recording;
+    ctx->gpu.destroy_command_buffer = tracker->backend.destroy_command_buffer;
+    ctx->gpu.free_buffer = tracker->backend.free_buffer;
+    ctx->gpu.destroy_texture = tracker->backend.destroy_texture;
+    ctx->gpu_state_tracker = null;
+    if (tracker->uses) {
+        ctx->memory.free(ctx, tracker->uses);
+    }
+    if (tracker->barriers) {
+        ctx->memory.free(ctx, tracker->barriers);
+    }
+    ctx->memory.free(ctx, tracker);
+    return XUDK_OK;
+}
+
+status xudk_gpu_use_buffer(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_buffer *buffer, u32 state) {
+    return buffer ? declare(ctx, cmd_buffer, buffer, null, state) : XUDK_INVALID_PARAM;
+}
+
+status xudk_gpu_use_texture(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_texture *texture, u32 state) {
+    return texture ? declare(ctx, cmd_buffer, null, texture, state) : XUDK_INVALID_PARAM;
+}
+
+// Sends the declared uses now, ahead of work the tracker does not wrap
+status xudk_gpu_flush_barriers(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    state_tracker *tracker = tracker_of(ctx);
+
+    if (!tracker || !cmd_buffer || !cmd_buffer->is_recording) {
+        return XUDK_INVALID_PARAM;
+    }
+    return flush(ctx, tracker, cmd_buffer, cmd_buffer->is_compute);
+}
@@ -0,0 +1,290 @@
+/*
+ * XUDK - GPU upload queue
+ * Uploads are written into one persistently mapped staging buffer and
+ * recorded as copy commands on a compute command buffer, so many small
+ * uploads go to the GPU as one submission. Each submitted batch signals the
+ * queue's fence with the next value; its staging space comes back once the
+ * fence has passed it. The CPU only blocks when the staging buffer is full.
+ */
+
+#include "core.h"
+
+#define UPLOAD_MAX_BATCHES          4       // Submitted batches in flight
+#define UPLOAD_BUFFER_ALIGNMENT     16
+#define UPLOAD_TEXTURE_ALIGNMENT    512     // Strictest texture copy placement of common GPUs
+
+typedef struct {
+    xudk_gpu_cmd_buffer     cmd_buffer;
+    u64                     end;            // Staging position after its last upload
+    u64                     value;          // Fence value it signals, 0 until submitted
+} upload_batch;
+
+struct xudk_gpu_upload_queue {
+    xudk_gpu_buffer         staging;
+    u8*                     mapped;
+    xudk_gpu_fence          fence;
+    u64                     head;           // Positions only grow; the offset is position % size
+    u64                     tail;           // Start of the oldest batch not yet completed
+    u64                     submitted;      // Fence value of the last submitted batch
+    u64                     completed;      // Fence value last read back
+    bool                    recording;      // Batch submitted + 1 is open
+    upload_batch            batches[UPLOAD_MAX_BATCHES];
+};
+
+static upload_batch* open_batch(xudk_gpu_upload_queue *queue) {
+    return &queue->batches[queue->submitted % UPLOAD_MAX_BATCHES];
+}
+
+// Reads the fence and frees the staging space of every batch it has passed
+static status refresh(xudk_ctx *ctx, xudk_gpu_upload_queue *queue) {
+    status s = ctx->gpu.get_fence_value(ctx, &queue->fence, &queue->completed);
+
+    if (xudk_error(s)) {
+        return s;
+    }
+    for (u32 i = 0; i < UPLOAD_MAX_BATCHES; i++) {
+        upload_batch *batch = &queue->batches[i];
+
+        if (batch->value && batch->value <= queue->completed && batch->end > queue->tail) {
+            queue->tail = batch->end;
+        }
+    }
+    return XUDK_OK;
+}
+
+static status wait_value(xudk_ctx *ctx, xudk_gpu_upload_queue *queue, u64 value) {
+    status s = ctx->gpu.wait_fence(ctx, &queue->fence, value);
+    return xudk_ok(s) ? refresh(ctx, queue) : s;
+}
+
+// Reserves `size` contiguous staging bytes, submitting and waiting as needed
+static status stage(xudk_ctx *ctx, xudk_gpu_upload_queue *queue, u64 size, u64 alignment, u64 *offset) {
+    u64 capacity = queue->staging.size;
+    status s;
+
+    if (size > capacity) {
+        return XUDK_BUFFER_TOO_SMALL;
+    }
+    for (;;) {
+        u64 lap = queue->head - queue->head % capacity;
+        u64 start = (queue->head % capacity + alignment - 1) & ~(alignment - 1);
+
+        if (start + size > capacity) {
+            lap += capacity;
+            start = 0;
+        }
+        if (lap + start + size - queue->tail <= capacity) {
+            queue->head = lap + start + size;
+            *offset = start;
+            return XUDK_OK;
+        }
+        if (queue->completed < queue->submitted) {
+            s = wait_value(ctx, queue, queue->completed + 1);
+        } else if (queue->recording) {
+            s = xudk_gpu_upload_queue_submit(ctx, queue, null);  // The open batch holds the rest
+        } else {
+            // Nothing owns the space: start over at the beginning of the next lap
+            queue->head = queue->tail = queue->head - queue->head % capacity + capacity;
+            continue;
+        }
+        if (xudk_error(s)) {
+            return s;
+        }
+    }
+}
+
+// Opens a batch if none is, reusing the slot of the batch UPLOAD_MAX_BATCHES back
+static status record_batch(xudk_ctx *ctx, xudk_gpu_upload_queue *queue, upload_batch **batch) {
+    status s;
+
+    *batch = open_batch(queue);
+    if (queue->recording) {
+        return XUDK_OK;
+    }
+    if ((*batch)->value > queue->completed) {
+        s = wait_value(ctx, queue, (*batch)->value);
+        if (xudk_error(s)) {
+            return s;
+        }
+    }
+    s = ctx->gpu.begin_recording(ctx, &(*batch)->cmd_buffer);
+    if (xudk_ok(s)) {
+        (*batch)->value = 0;
+        queue->recording = true;
+    }
+    return s;
+}
+
+status xudk_gpu_upload_queue_create(xudk_ctx *ctx, u64 staging_size, xudk_gpu_upload_queue **queue) {
+    xudk_gpu_upload_queue *q;
+    void *mapped;
+    u32 created = 0;
+    status s;
+
+    if (!queue || !staging_size) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!ctx->gpu.create_fence || !ctx->gpu.copy_buffer) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    q = ctx->memory.alloc(ctx, sizeof(*q));
+    if (!q) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(q, 0, sizeof(*q));
+    s = ctx->gpu.allocate_buffer(ctx, staging_size, XUDK_BUFFER_STAGING, &q->staging);
+    if (xudk_error(s)) {
+        ctx->memory.free(ctx, q);
+        return s;
+    }
+    s = ctx->gpu.map_buffer(ctx, &q->staging, &mapped);
+    if (xudk_ok(s)) {
+        q->mapped = mapped;
+        s = ctx->gpu.create_fence(ctx, 0, &q->fence);
+    }
+    // Compute command buffers go to the compute/copy queue where there is one
+    for (; xudk_ok(s) && created < UPLOAD_MAX_BATCHES; created++) {
+        s = ctx->gpu.create_command_buffer(ctx, true, &q->batches[created].cmd_buffer);
+    }
+    if (xudk_error(s)) {
+        while (created--) {
+            ctx->gpu.destroy_command_buffer(ctx, &q->batches[created].cmd_buffer);
+        }
+        if (q->fence.fence_handle) {
+            ctx->gpu.destroy_fence(ctx, &q->fence);
+        }
+        if (q->mapped) {
+            ctx->gpu.unmap_buffer(ctx, &q->staging);
+        }
+        ctx->gpu.free_buffer(ctx, &q->staging);
+        ctx->memory.free(ctx, q);
+        return s;
+    }
+    *queue = q;
+    return XUDK_OK;
+}
+
+// Uploads still open are submitted, and everything in flight finished, first
+status xudk_gpu_upload_queue_destroy(xudk_ctx *ctx, xudk_gpu_upload_queue *queue) {
+    if (!queue) {
+        return XUDK_INVALID_PARAM;
+    }
+    xudk_gpu_upload_queue_submit(ctx, queue, null);
+    ctx->gpu.wait_fence(ctx, &queue->fence, queue->submitted);
+    for (u32 i = 0; i < UPLOAD_MAX_BATCHES; i++) {
+        ctx->gpu.destroy_command_buffer(ctx, &queue->batches[i].cmd_buffer);
+    }
+    ctx->gpu.destroy_fence(ctx, &queue->fence);
+    ctx->gpu.unmap_buffer(ctx, &queue->staging);
+    ctx->gpu.free_buffer(ctx, &queue->staging);
+    ctx->memory.free(ctx, queue);
+    return XUDK_OK;
+}
+
+// Data larger than the staging buffer goes in pieces of half of it, so one
+// piece is written while the previous one copies
+status xudk_gpu_upload_buffer(xudk_ctx *ctx, xudk_gpu_upload_queue *queue, xudk_gpu_buffer *buffer, u64 offset,
+                              const void *data, u64 size) {
+    u64 piece = queue ? queue->staging.size / 2 : 0;
+    const u8 *src = data;
+    status s = XUDK_OK;
+
+    if (!queue || !buffer || (!data && size)) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (offset > buffer->size || size > buffer->size - offset) {
+        return XUDK_BUFFER_OVERFLOW;
+    }
+    piece = piece ? piece : 1;
+    while (size && xudk_ok(s)) {
+        u64 chunk = size < piece ? size : piece;
+        upload_batch *batch;
+        u64 at;
+
+        s = stage(ctx, queue, chunk, UPLOAD_BUFFER_ALIGNMENT, &at);
+        if (xudk_ok(s)) {
+            s = record_batch(ctx, queue, &batch);
+        }
+        if (xudk_ok(s)) {
+            xudk_memcpy(queue->mapped + at, src, (usize)chunk);
+            s = ctx->gpu.copy_buffer(ctx, &batch->cmd_buffer, &queue->staging, at, buffer, offset, chunk);
+        }
+        src += chunk;
+        offset += chunk;
+        size -= chunk;
+    }
+    return s;
+}
+
+// A subresource copies in one piece; one too big for the staging buffer is
+// uploaded directly once the queue has drained
+status xudk_gpu_upload_texture(xudk_ctx *ctx, xudk_gpu_upload_queue *queue, xudk_gpu_texture *texture,
+                               u32 mip_level, u32 array_slice, const void *data, u64 size) {
+    upload_batch *batch;
+    u64 at;
+    status s;
+
+    if (!queue || !texture || !data || !size) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (size > queue->staging.size) {
+        s = xudk_gpu_upload_queue_submit(ctx, queue, null);
+        if (xudk_ok(s)) {
+            s = wait_value(ctx, queue, queue->submitted);
+        }
+        return xudk_ok(s) ? ctx->gpu.upload_texture_data(ctx, texture, data, (usize)size, mip_level, array_slice) : s;
+    }
+    s = stage(ctx, queue, size, UPLOAD_TEXTURE_ALIGNMENT, &at);
+    if (xudk_ok(s)) {
+        s = record_batch(ctx, queue, &batch);
+    }
+    if (xudk_ok(s)) {
+        xudk_memcpy(queue->mapped + at, data, (usize)size);
+        s = ctx->gpu.copy_buffer_to_texture(ctx, &batch->cmd_buffer, &queue->staging, at, size, texture,
+                                            mip_level, array_slice);
+    }
+    return s;
+}
+
+// With nothing open, `fence_value` is that of the last batch submitted
+status xudk_gpu_upload_queue_submit(xudk_ctx *ctx, xudk_gpu_upload_queue *queue, u64 *fence_value) {
+    upload_batch *batch;
+    status s = XUDK_OK;
+
+    if (!queue) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (queue->recording) {
+        batch = open_batch(queue);
+        queue->recording = false;
+        s = ctx->gpu.end_recording(ctx, &batch->cmd_buffer);
+        if (xudk_error(s)) {
+            return s;   // Dropped; its staging space comes back with the next batch
+        }
+        batch->end = queue->head;
+        batch->value = ++queue->submitted;
+        s = ctx->gpu.submit_and_signal(ctx, &batch->cmd_buffer, &queue->fence, batch->value);
+    }
+    if (fence_value) {
+        *fence_value = queue->submitted;
+    }
+    return s;
+}
+
+status xudk_gpu_upload_queue_poll(xudk_ctx *ctx, xudk_gpu_upload_queue *queue, u64 *completed_value) {
+    status s;
+
+    if (!queue || !completed_value) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = refresh(ctx, queue);
+    *completed_value = queue->completed;
+    return s;
+}
+
+status xudk_gpu_upload_queue_wait(xudk_ctx *ctx, xudk_gpu_upload_queue *queue, u64 fence_value) {
+    if (!queue || fence_value > queue->submitted) {
+        return XUDK_INVALID_PARAM;
+    }
+    return fence_value <= queue->completed ? XUDK_OK : wait_value(ctx, queue, fence_value);
+}
@@ -0,0 +1,594 @@
+/*
+ * XUDK - Checksums and hashing
+ * xudk_crc32 is CRC-32/IEEE with a slicing-by-8 table path and a PCLMULQDQ
+ * folding path. xudk_hash64 is XXH3-64 (seed 0, default secret): its long
+ * input loop is 32x32->64 multiplies on eight independent lanes, which maps
+ * directly onto SSE2/AVX2, and it can be fed in chunks through
+ * xudk_hash64_init/update/final.
+ */
+
+#include "core.h"
+
+#if XUDK_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+static u64 read64(const u8 *p) {
+    return *(const xudk_unaligned_u64*)p;
+}
+
+static u32 read32(const u8 *p) {
+    return *(const xudk_unaligned_u32*)p;
+}
+
+// =============================================================================
+// CRC-32
+// =============================================================================
+
+// CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320). The kernels work on
+// the raw register; the public functions apply the pre/post inversion.
+static u32 crc_tables[8][256];
+static bool crc_tables_ready = false;
+
+static void crc_build_tables(void) {
+    for (u32 i = 0; i < 256; i++) {
+        u32 c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c >> 1) ^ (0xEDB88320 & (0 - (c & 1)));
+        }
+        crc_tables[0][i] = c;
+    }
+    // Table k advances a byte through k further zero bytes
+    for (u32 i = 0; i < 256; i++) {
+        for (u32 k = 1; k < 8; k++) {
+            u32 c = crc_tables[k - 1][i];
+            crc_tables[k][i] = (c >> 8) ^ crc_tables[0][c & 0xFF];
+        }
+    }
+    crc_tables_ready = true;
+}
+
+static u32 crc_bytes(u32 reg, const u8 *p, usize size) {
+    while (size--) {
+        reg = crc_tables[0][(reg ^ *p++) & 0xFF] ^ (reg >> 8);
+    }
+    return reg;
+}
+
+// Eight bytes per step through eight independent table lookups (little-endian)
+static u32 crc_slice8(u32 reg, const u8 *p, usize size) {
+    while (size && ((usize)p & 7)) {
+        reg = crc_tables[0][(reg ^ *p++) & 0xFF] ^ (reg >> 8);
+        size--;
+    }
+    for (; size >= 8; size -= 8, p += 8) {
+        u32 lo = *(const u32*)p ^ reg;
+        u32 hi = *(const u32*)(p + 4);
+        reg = crc_tables[7][lo & 0xFF] ^ crc_tables[6][(lo >> 8) & 0xFF] ^
+              crc_tables[5][(lo >> 16) & 0xFF] ^ crc_tables[4][lo >> 24] ^
+              crc_tables[3][hi & 0xFF] ^ crc_tables[2][(hi >> 8) & 0xFF] ^
+              crc_tables[1][(hi >> 16) & 0xFF] ^ crc_tables[0][hi >> 24];
+    }
+    return crc_bytes(reg, p, size);
+}
+
+static u32 crc32_update_table(u32 crc, const void *data, usize size) {
+    if (!crc_tables_ready) {
+        crc_build_tables();
+    }
+    return ~crc_bytes(~crc, data, size);
+}
+
+static u32 crc32_update_slice8(u32 crc, const void *data, usize size) {
+    if (!crc_tables_ready) {
+        crc_build_tables();
+    }
+    return ~crc_slice8(~crc, data, size);
+}
+
+#if XUDK_X86
+
+// Fold 64 bytes per step with carry-less multiplies, then Barrett-reduce the
+// last 128 bits. Constants are x^n mod P for the reflected polynomial:
+// (x^(4*128+32), x^(4*128-32)), (x^(128+32), x^(128-32)), x^64 and (mu, P).
+static XUDK_TARGET("pclmul,sse4.1") u32 crc32_update_pclmul(u32 crc, const void *data, usize size) {
+    const u8 *p = data;
+    __m128i x1, x2, x3, x4, x5, k;
+    __m128i mask32 = _mm_set_epi32(0, 0, 0, -1);
+    u32 reg = ~crc;
+
+    if (!crc_tables_ready) {
+        crc_build_tables();
+    }
+    if (size < 64) {
+        return ~crc_slice8(reg, p, size);
+    }
+
+    x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), _mm_cvtsi32_si128((int)reg));
+    x2 = _mm_loadu_si128((const __m128i*)(p + 16));
+    x3 = _mm_loadu_si128((const __m128i*)(p + 32));
+    x4 = _mm_loadu_si128((const __m128i*)(p + 48));
+    p += 64;
+    size -= 64;
+
+    k = _mm_set_epi64x(0x00000001C6E41596LL, 0x0000000154442BD4LL);
+    for (; size >= 64; size -= 64, p += 64) {
+        x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x11), x5), _mm_loadu_si128((const __m128i*)p));
+        x5 = _mm_clmulepi64_si128(x2, k, 0x00);
+        x2 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x2, k, 0x11), x5), _mm_loadu_si128((const __m128i*)(p + 16)));
+        x5 = _mm_clmulepi64_si128(x3, k, 0x00);
+        x3 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x3, k, 0x11), x5), _mm_loadu_si128((const __m128i*)(p + 32)));
+        x5 = _mm_clmulepi64_si128(x4, k, 0x00);
+        x4 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x4, k, 0x11), x5), _mm_loadu_si128((const __m128i*)(p + 48)));
+    }
+
+    // Four lanes into one, then any remaining 16-byte blocks
+    k = _mm_set_epi64x(0x00000000CCAA009ELL, 0x00000001751997D0LL);
+    x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x11), x5), x2);
+    x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x11), x5), x3);
+    x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x11), x5), x4);
+    for (; size >= 16; size -= 16, p += 16) {
+        x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x11), x5), _mm_loadu_si128((const __m128i*)p));
+    }
+
+    // 128 -> 64 -> 32 bits
+    x2 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x10), x2);
+    k = _mm_set_epi64x(0, 0x0000000163CD6124LL);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x00), x2);
+    k = _mm_set_epi64x(0x00000001F7011641LL, 0x00000001DB710641LL);
+    x2 = x1;
+    x1 = _mm_and_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x10), mask32);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x00), x2);
+    reg = (u32)_mm_extract_epi32(x1, 1);
+
+    return ~crc_slice8(reg, p, size);
+}
+
+#endif // XUDK_X86
+
+// =============================================================================
+// XXH3-64
+// =============================================================================
+
+#define PRIME32_1       0x9E3779B1U
+#define PRIME32_2       0x85EBCA77U
+#define PRIME32_3       0xC2B2AE3DU
+#define PRIME64_1       0x9E3779B185EBCA87ULL
+#define PRIME64_2       0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3       0x165667B19E3779F9ULL
+#define PRIME64_4       0x85EBCA77C2B2AE63ULL
+#define PRIME64_5       0x27D4EB2F165667C5ULL
+#define PRIME_MX1       0x165667919E3779F9ULL
+#define PRIME_MX2       0x9FB21C651E98DF25ULL
+
+#define STRIPE_SIZE         64
+#define SECRET_SIZE         192
+#define STRIPES_PER_BLOCK   ((SECRET_SIZE - STRIPE_SIZE) / 8)
+#define BLOCK_SIZE          (STRIPE_SIZE * STRIPES_PER_BLOCK)
+#define MIDSIZE_MAX         240
+
+static const u8 secret[SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static const u64 initial_acc[8] = {
+    PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+};
+
+// Stripe kernels: accumulate `stripes` 64-byte stripes, the key advancing 8
+// bytes per stripe, and scramble the accumulators at the end of a block
+typedef struct {
+    void    (*accumulate)(u64 acc[8], const u8 *input, const u8 *key, usize stripes);
+    void    (*scramble)(u64 acc[8], const u8 *key);
+} hash_kernel;
+
+static u64 mul128_fold64(u64 a, u64 b) {
+#if defined(__SIZEOF_INT128__)
+    __extension__ unsigned __int128 product = (unsigned __int128)a * b;
+    return (u64)product ^ (u64)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    u64 hi, lo = _umul128(a, b, &hi);
+    return lo ^ hi;
+#else
+    u64 lo_lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    u64 hi_lo = (a >> 32) * (b & 0xFFFFFFFF);
+    u64 lo_hi = (a & 0xFFFFFFFF) * (b >> 32);
+    u64 hi_hi = (a >> 32) * (b >> 32);
+    u64 cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    u64 upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    return ((cross << 32) | (lo_lo & 0xFFFFFFFF)) ^ upper;
+#endif
+}
+
+static u64 rotl64(u64 v, u32 r) {
+    return (v << r) | (v >> (64 - r));
+}
+
+static u64 swap64(u64 v) {
+    v = ((v & 0x00FF00FF00FF00FFULL) << 8) | ((v >> 8) & 0x00FF00FF00FF00FFULL);
+    v = ((v & 0x0000FFFF0000FFFFULL) << 16) | ((v >> 16) & 0x0000FFFF0000FFFFULL);
+    return (v << 32) | (v >> 32);
+}
+
+static u64 xxh64_avalanche(u64 h) {
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    return h ^ (h >> 32);
+}
+
+static u64 xxh3_avalanche(u64 h) {
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    return h ^ (h >> 32);
+}
+
+static u64 mix16(const u8 *input, const u8 *key) {
+    return mul128_fold64(read64(input) ^ read64(key), read64(input + 8) ^ read64(key + 8));
+}
+
+static u64 hash_short(const u8 *p, usize size) {
+    if (size > 16) {
+        u64 acc = size * PRIME64_1;
+
+        if (size > 128) {
+            // 129..240 bytes
+            usize rounds = size / 16;
+            u64 tail = mix16(p + size - 16, secret + 136 - 17);
+
+            for (usize i = 0; i < 8; i++) {
+                acc += mix16(p + 16 * i, secret + 16 * i);
+            }
+            acc = xxh3_avalanche(acc);
+            for (usize i = 8; i < rounds; i++) {
+                tail += mix16(p + 16 * i, secret + 16 * (i - 8) + 3);
+            }
+            return xxh3_avalanche(acc + tail);
+        }
+        if (size > 32) {
+            if (size > 64) {
+                if (size > 96) {
+                    acc += mix16(p + 48, secret + 96);
+                    acc += mix16(p + size - 64, secret + 112);
+                }
+                acc += mix16(p + 32, secret + 64);
+                acc += mix16(p + size - 48, secret + 80);
+            }
+            acc += mix16(p + 16, secret + 32);
+            acc += mix16(p + size - 32, secret + 48);
+        }
+        acc += mix16(p, secret);
+        acc += mix16(p + size - 16, secret + 16);
+        return xxh3_avalanche(acc);
+    }
+    if (size > 8) {
+        u64 lo = read64(p) ^ (read64(secret + 24) ^ read64(secret + 32));
+        u64 hi = read64(p + size - 8) ^ (read64(secret + 40) ^ read64(secret + 48));
+        return xxh3_avalanche(size + swap64(lo) + hi + mul128_fold64(lo, hi));
+    }
+    if (size >= 4) {
+        u64 keyed = ((u64)read32(p + size - 4) + ((u64)read32(p) << 32)) ^ (read64(secret + 8) ^ read64(secret + 16));
+        keyed ^= rotl64(keyed, 49) ^ rotl64(keyed, 24);
+        keyed *= PRIME_MX2;
+        keyed ^= (keyed >> 35) + size;
+        keyed *= PRIME_MX2;
+        return keyed ^ (keyed >> 28);
+    }
+    if (size) {
+        u32 combined = ((u32)p[0] << 16) | ((u32)p[size >> 1] << 24) | p[size - 1] | ((u32)size << 8);
+        return xxh64_avalanche(combined ^ (u64)(read32(secret) ^ read32(secret + 4)));
+    }
+    return xxh64_avalanche(read64(secret + 56) ^ read64(secret + 64));
+}
+
+static u64 merge_accs(const u64 acc[8], u64 total_size) {
+    u64 result = total_size * PRIME64_1;
+
+    for (u32 i = 0; i < 4; i++) {
+        result += mul128_fold64(acc[2 * i] ^ read64(secret + 11 + 16 * i), acc[2 * i + 1] ^ read64(secret + 11 + 16 * i + 8));
+    }
+    return xxh3_avalanche(result);
+}
+
+// Inputs above MIDSIZE_MAX bytes: whole blocks, the partial block, and the
+// last 64 bytes as an extra stripe with its own key
+static u64 hash_long(const u8 *p, usize size, const hash_kernel *kernel) {
+    u64 acc[8];
+    usize blocks = (size - 1) / BLOCK_SIZE;
+
+    for (u32 i = 0; i < 8; i++) {
+        acc[i] = initial_acc[i];
+    }
+    for (usize n = 0; n < blocks; n++) {
+        kernel->accumulate(acc, p + n * BLOCK_SIZE, secret, STRIPES_PER_BLOCK);
+        kernel->scramble(acc, secret + SECRET_SIZE - STRIPE_SIZE);
+    }
+    kernel->accumulate(acc, p + blocks * BLOCK_SIZE, secret, ((size - 1) - blocks * BLOCK_SIZE) / STRIPE_SIZE);
+    kernel->accumulate(acc, p + size - STRIPE_SIZE, secret + SECRET_SIZE - STRIPE_SIZE - 7, 1);
+    return merge_accs(acc, size);
+}
+
+static void accumulate_scalar(u64 acc[8], const u8 *input, const u8 *key, usize stripes) {
+    for (usize n = 0; n < stripes; n++, input += STRIPE_SIZE, key += 8) {
+        for (u32 i = 0; i < 8; i++) {
+            u64 value = read64(input + 8 * i);
+            u64 keyed = value ^ read64(key + 8 * i);
+            acc[i ^ 1] += value;
+            acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+        }
+    }
+}
+
+static void scramble_scalar(u64 acc[8], const u8 *key) {
+    for (u32 i = 0; i < 8; i++) {
+        u64 a = acc[i];
+        a ^= a >> 47;
+        a ^= read64(key + 8 * i);
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+#if XUDK_X86
+
+static XUDK_TARGET("sse2") void accumulate_sse2(u64 acc[8], const u8 *input, const u8 *key, usize stripes) {
+    __m128i a[4];
+
+    for (u32 i = 0; i < 4; i++) {
+        a[i] = _mm_loadu_si128((const __m128i*)acc + i);
+    }
+    for (usize n = 0; n < stripes; n++, input += STRIPE_SIZE, key += 8) {
+        for (u32 i = 0; i < 4; i++) {
+            __m128i value = _mm_loadu_si128((const __m128i*)input + i);
+            __m128i keyed = _mm_xor_si128(value, _mm_loadu_si128((const __m128i*)key + i));
+            __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+            a[i] = _mm_add_epi64(a[i], _mm_add_epi64(product, _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+    }
+    for (u32 i = 0; i < 4; i++) {
+        _mm_storeu_si128((__m128i*)acc + i, a[i]);
+    }
+}
+
+static XUDK_TARGET("sse2") void scramble_sse2(u64 acc[8], const u8 *key) {
+    __m128i prime = _mm_set1_epi32((int)PRIME32_1);
+
+    for (u32 i = 0; i < 4; i++) {
+        __m128i a = _mm_loadu_si128((const __m128i*)acc + i);
+        a = _mm_xor_si128(_mm_xor_si128(a, _mm_srli_epi64(a, 47)), _mm_loadu_si128((const __m128i*)key + i));
+        a = _mm_add_epi64(_mm_mul_epu32(a, prime),
+                          _mm_slli_epi64(_mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime), 32));
+        _mm_storeu_si128((__m128i*)acc + i, a);
+    }
+}
+
+static XUDK_TARGET("avx2") void accumulate_avx2(u64 acc[8], const u8 *input, const u8 *key, usize stripes) {
+    __m256i a0 = _mm256_loadu_si256((const __m256i*)acc);
+    __m256i a1 = _mm256_loadu_si256((const __m256i*)acc + 1);
+
+    for (usize n = 0; n < stripes; n++, input += STRIPE_SIZE, key += 8) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)input);
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)input + 1);
+        __m256i k0 = _mm256_xor_si256(v0, _mm256_loadu_si256((const __m256i*)key));
+        __m256i k1 = _mm256_xor_si256(v1, _mm256_loadu_si256((const __m256i*)key + 1));
+
+        a0 = _mm256_add_epi64(a0, _mm256_add_epi64(_mm256_mul_epu32(k0, _mm256_shuffle_epi32(k0, _MM_SHUFFLE(0, 3, 0, 1))),
+                                                   _mm256_shuffle_epi32(v0, _MM_SHUFFLE(1, 0, 3, 2))));
+        a1 = _mm256_add_epi64(a1, _mm256_add_epi64(_mm256_mul_epu32(k1, _mm256_shuffle_epi32(k1, _MM_SHUFFLE(0, 3, 0, 1))),
+                                                   _mm256_shuffle_epi32(v1, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+    _mm256_storeu_si256((__m256i*)acc, a0);
+    _mm256_storeu_si256((__m256i*)acc + 1, a1);
+}
+
+static XUDK_TARGET("avx2") void scramble_avx2(u64 acc[8], const u8 *key) {
+    __m256i prime = _mm256_set1_epi32((int)PRIME32_1);
+
+    for (u32 i = 0; i < 2; i++) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)acc + i);
+        a = _mm256_xor_si256(_mm256_xor_si256(a, _mm256_srli_epi64(a, 47)), _mm256_loadu_si256((const __m256i*)key + i));
+        a = _mm256_add_epi64(_mm256_mul_epu32(a, prime),
+                             _mm256_slli_epi64(_mm256_mul_epu32(_mm256_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime), 32));
+        _mm256_storeu_si256((__m256i*)acc + i, a);
+    }
+}
+
+#endif // XUDK_X86
+
+static const hash_kernel hash_kernels[] = {
+    { accumulate_scalar, scramble_scalar },
+#if XUDK_X86
+    { accumulate_sse2, scramble_sse2 },
+    { accumulate_avx2, scramble_avx2 },
+#endif
+};
+
+static u64 hash64_scalar(const void *data, usize size) {
+    return size > MIDSIZE_MAX ? hash_long(data, size, &hash_kernels[0]) : hash_short(data, size);
+}
+
+#if XUDK_X86
+
+static u64 hash64_sse2(const void *data, usize size) {
+    return size > MIDSIZE_MAX ? hash_long(data, size, &hash_kernels[1]) : hash_short(data, size);
+}
+
+static u64 hash64_avx2(const void *data, usize size) {
+    return size > MIDSIZE_MAX ? hash_long(data, size, &hash_kernels[2]) : hash_short(data, size);
+}
+
+#endif // XUDK_X86
+
+// =============================================================================
+// DISPATCH
+// =============================================================================
+
+static const xudk_crc32_impl crc32_impls[] = {
+    { "table", 0, crc32_update_table },
+    { "slice8", 0, crc32_update_slice8 },
+#if XUDK_X86
+    { "pclmul", XUDK_CPU_PCLMUL | XUDK_CPU_SSE42, crc32_update_pclmul },
+#endif
+};
+
+// Same order as hash_kernels
+static const xudk_hash64_impl hash64_impls[] = {
+    { "scalar", 0, hash64_scalar },
+#if XUDK_X86
+    { "sse2", XUDK_CPU_SSE2, hash64_sse2 },
+    { "avx2", XUDK_CPU_AVX2, hash64_avx2 },
+#endif
+};
+
+static const xudk_crc32_impl *crc32_active = &crc32_impls[1];
+static usize hash64_active = 0;
+
+const xudk_crc32_impl* xudk_crc32_impls(usize *count) {
+    *count = sizeof(crc32_impls) / sizeof(crc32_impls[0]);
+    return crc32_impls;
+}
+
+const xudk_hash64_impl* xudk_hash64_impls(usize *count) {
+    *count = sizeof(hash64_impls) / sizeof(hash64_impls[0]);
+    return hash64_impls;
+}
+
+void xudk_checksum_init(void) {
+    u32 features = xudk_cpu_features();
+
+    if (!crc_tables_ready) {
+        crc_build_tables();
+    }
+    for (usize i = 0; i < sizeof(crc32_impls) / sizeof(crc32_impls[0]); i++) {
+        if ((crc32_impls[i].features & features) == crc32_impls[i].features) {
+            crc32_active = &crc32_impls[i];
+        }
+    }
+    for (usize i = 0; i < sizeof(hash64_impls) / sizeof(hash64_impls[0]); i++) {
+        if ((hash64_impls[i].features & features) == hash64_impls[i].features) {
+            hash64_active = i;
+        }
+    }
+}
+
+u32 xudk_crc32(const void *data, usize size) {
+    return crc32_active->update(0, data, size);
+}
+
+u32 xudk_crc32_update(u32 crc, const void *data, usize size) {
+    return crc32_active->update(crc, data, size);
+}
+
+u64 xudk_hash64(const void *data, usize size) {
+    return hash64_impls[hash64_active].hash(data, size);
+}
+
+// =============================================================================
+// STREAMING HASH
+// =============================================================================
+
+// Feed stripes into the running block, scrambling whenever a block completes
+static const u8* hash_consume(xudk_hash64_state *state, const u8 *input, usize stripes) {
+    const hash_kernel *kernel = &hash_kernels[hash64_active];
+
+    while (stripes) {
+        usize count = STRIPES_PER_BLOCK - state->stripes;
+
+        if (count > stripes) {
+            count = stripes;
+        }
+        kernel->accumulate(state->acc, input, secret + state->stripes * 8, count);
+        input += count * STRIPE_SIZE;
+        stripes -= count;
+        state->stripes += (u32)count;
+        if (state->stripes == STRIPES_PER_BLOCK) {
+            kernel->scramble(state->acc, secret + SECRET_SIZE - STRIPE_SIZE);
+            state->stripes = 0;
+        }
+    }
+    return input;
+}
+
+void xudk_hash64_init(xudk_hash64_state *state) {
+    for (u32 i = 0; i < 8; i++) {
+        state->acc[i] = initial_acc[i];
+    }
+    state->total_size = 0;
+    state->buffered = 0;
+    state->stripes = 0;
+}
+
+// Stripes are only consumed once more input follows them, so the final
+// 1..256 bytes always stay in the buffer for xudk_hash64_final
+void xudk_hash64_update(xudk_hash64_state *state, const void *data, usize size) {
+    const u8 *input = data;
+    const u8 *end = input + size;
+    usize buffer_stripes = sizeof(state->buffer) / STRIPE_SIZE;
+
+    state->total_size += size;
+    if (state->buffered + size <= sizeof(state->buffer)) {
+        xudk_memcpy(state->buffer + state->buffered, input, size);
+        state->buffered += (u32)size;
+        return;
+    }
+
+    if (state->buffered) {
+        usize fill = sizeof(state->buffer) - state->buffered;
+        xudk_memcpy(state->buffer + state->buffered, input, fill);
+        input += fill;
+        hash_consume(state, state->buffer, buffer_stripes);
+        state->buffered = 0;
+    }
+    if ((usize)(end - input) > sizeof(state->buffer)) {
+        input = hash_consume(state, input, (usize)(end - 1 - input) / STRIPE_SIZE);
+        // Keep the last consumed stripe: the final stripe may reach back into it
+        xudk_memcpy(state->buffer + sizeof(state->buffer) - STRIPE_SIZE, input - STRIPE_SIZE, STRIPE_SIZE);
+    }
+    xudk_memcpy(state->buffer, input, (usize)(end - input));
+    state->buffered = (u32)(end - input);
+}
+
+u64 xudk_hash64_final(const xudk_hash64_state *state) {
+    const hash_kernel *kernel = &hash_kernels[hash64_active];
+    xudk_hash64_state copy;
+    u8 last[STRIPE_SIZE];
+    const u8 *last_stripe;
+
+    if (state->total_size <= MIDSIZE_MAX) {
+        return hash_short(state->buffer, (usize)state->total_size);
+    }
+
+    copy = *state;
+    if (copy.buffered >= STRIPE_SIZE) {
+        hash_consume(&copy, copy.buffer, (copy.buffered - 1) / STRIPE_SIZE);
+        last_stripe = copy.buffer + copy.buffered - STRIPE_SIZE;
+    } else {
+        usize catchup = STRIPE_SIZE - copy.buffered;
+        xudk_memcpy(last, copy.buffer + sizeof(copy.buffer) - catchup, catchup);
+        xudk_memcpy(last + catchup, copy.buffer, copy.buffered);
+        last_stripe = last;
+    }
+    kernel->accumulate(copy.acc, last_stripe, secret + SECRET_SIZE - STRIPE_SIZE - 7, 1);
+    return merge_accs(copy.acc, copy.total_size);
+}
@@ -0,0 +1,951 @@
+/*
+ * XUDK - Streaming image decoders (BMP, QOI, PNG)
+ * The file is pulled through a small read buffer and decoded one row at a
+ * time straight into the target surface, so memory stays bounded by the
+ * image width rather than the file size, and rows drawn to the framebuffer
+ * show up while the rest of the file is still being read.
+ */
+
+#include "core.h"
+
+#define IMAGE_READ_CHUNK    (16 * 1024)
+#define IMAGE_MAX_DIMENSION 16384
+
+enum { IMAGE_BMP, IMAGE_QOI, IMAGE_PNG };
+
+// =============================================================================
+// INFLATE STATE (RFC 1951)
+// =============================================================================
+
+#define INFLATE_WINDOW      32768
+#define HUFFMAN_FAST_BITS   9
+
+// Canonical Huffman code with a direct lookup for codes up to HUFFMAN_FAST_BITS
+typedef struct {
+    u16             fast[1 << HUFFMAN_FAST_BITS];   // (symbol << 4) | length, 0 = longer code
+    u16             count[16];                      // Codes of each length
+    u16             symbol[288];                    // Symbols ordered by code
+} huffman;
+
+enum { INFLATE_HEADER, INFLATE_STORED, INFLATE_CODES, INFLATE_DONE };
+
+typedef struct {
+    u64             bits;           // Bit buffer, next bit in bit 0
+    u32             bit_count;
+    u32             mode;           // INFLATE_*
+    bool            final;          // Current block is the last one
+    u32             stored_left;
+    u32             copy_length;    // Match bytes still to produce
+    u32             copy_distance;
+    u32             window_pos;     // Total output, modulo the window
+    u64             total_out;
+    huffman         literals;
+    huffman         distances;
+    u8              window[INFLATE_WINDOW];
+} inflater;
+
+struct xudk_image {
+    xudk_ctx*       ctx;
+    handle          file;
+    u8*             buffer;         // IMAGE_READ_CHUNK bytes of the file
+    usize           buffered;       // Valid bytes in buffer
+    usize           pos;            // Next unread byte in buffer
+    bool            eof;
+    u32             format;         // IMAGE_*
+    xudk_image_info info;
+    u32*            row;            // One decoded row of pixels
+
+    // BMP
+    u32             bmp_bits;       // 24 or 32
+    u32             bmp_stride;     // Bytes per row in the file, padding included
+    bool            bmp_bottom_up;
+
+    // PNG
+    u32             png_color_type;
+    u32             png_depth;
+    u32             png_channels;
+    u32             png_chunk_left; // IDAT bytes not yet consumed
+    u32             palette[256];   // RGBX byte order, tRNS alpha applied
+    u32             palette_size;
+    inflater*       inflate;
+};
+
+// =============================================================================
+// READER
+// =============================================================================
+
+static bool reader_fill(xudk_image *image) {
+    usize got = 0;
+
+    if (image->eof) {
+        return false;
+    }
+    if (xudk_error(image->ctx->filesystem.read_file(image->ctx, image->file, image->buffer,
+                                                    IMAGE_READ_CHUNK, &got)) || !got) {
+        image->eof = true;
+        return false;
+    }
+    image->buffered = got;
+    image->pos = 0;
+    return true;
+}
+
+static bool reader_read(xudk_image *image, void *dst, usize size) {
+    u8 *out = dst;
+
+    while (size) {
+        usize n;
+        if (image->pos == image->buffered && !reader_fill(image)) {
+            return false;
+        }
+        n = image->buffered - image->pos < size ? image->buffered - image->pos : size;
+        xudk_memcpy(out, image->buffer + image->pos, n);
+        image->pos += n;
+        out += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool reader_skip(xudk_image *image, u64 size) {
+    while (size) {
+        usize n;
+        if (image->pos == image->buffered && !reader_fill(image)) {
+            return false;
+        }
+        n = image->buffered - image->pos < size ? image->buffered - image->pos : (usize)size;
+        image->pos += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Next byte, or -1 at the end of the file
+static inline i32 reader_byte(xudk_image *image) {
+    if (image->pos == image->buffered && !reader_fill(image)) {
+        return -1;
+    }
+    return image->buffer[image->pos++];
+}
+
+static u32 le16(const u8 *p) { return p[0] | (p[1] << 8); }
+static u32 le32(const u8 *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24); }
+static u32 be32(const u8 *p) { return ((u32)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+
+// =============================================================================
+// ROW OUTPUT
+// =============================================================================
+
+// Land image->row, in `layout` byte order (XUDK_PIXEL_*), as row y of the image
+// placed at (x, y0) on the target; translucent pixels blend when asked to
+static void image_emit(xudk_image *image, const xudk_surface *target, u32 x, u32 y0, u32 y,
+                       u32 layout, u32 flags) {
+    u32 width = image->info.width;
+    u32 *dst;
+
+    if (x >= target->width || y0 >= target->height || y >= target->height - y0) {
+        return;
+    }
+    if (width > target->width - x) {
+        width = target->width - x;
+    }
+    if (layout != target->pixel_format) {
+        xudk_pixel_kernels()->swap_rb(image->row, image->row, width);
+    }
+
+    dst = target->pixels + (usize)(y0 + y) * target->stride + x;
+    if (!image->info.alpha || !(flags & XUDK_IMAGE_BLEND)) {
+        xudk_memcpy(dst, image->row, width * sizeof(u32));
+        return;
+    }
+    for (u32 i = 0; i < width; i++) {
+        u32 pixel = image->row[i], alpha = pixel >> 24;
+        if (alpha == 0xFF) {
+            dst[i] = pixel;
+        } else if (alpha) {
+            dst[i] = xudk_pixel_blend(dst[i], pixel, alpha);
+        }
+    }
+}
+
+// =============================================================================
+// BMP
+// =============================================================================
+
+// Uncompressed 24/32-bit, BI_RGB (0) or BI_BITFIELDS (3); 32-bit alpha is only trusted with a bitfield header
+// that declares an alpha mask, plain 32-bit files often leave it zero
+static status bmp_open(xudk_image *image) {
+    u8 header[70];
+    u32 offset, header_size, compression;
+    i32 height;
+
+    if (!reader_read(image, header, 54)) {
+        return XUDK_TEXTURE_ERROR;
+    }
+    offset = le32(header + 10);
+    header_size = le32(header + 14);
+    height = (i32)le32(header + 22);
+    image->info.width = le32(header + 18);
+    image->info.height = (u32)(height < 0 ? -height : height);
+    image->bmp_bits = le16(header + 28);
+    image->bmp_bottom_up = height > 0;
+    compression = le32(header + 30);
+    if ((image->bmp_bits != 24 && image->bmp_bits != 32) || (compression != 0 && compression != 3) ||
+        offset < 54) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    image->bmp_stride = (image->info.width * image->bmp_bits / 8 + 3) & ~3u;
+
+    if (image->bmp_bits == 32 && compression == 3 && header_size >= 56 && offset >= 70) {
+        if (!reader_read(image, header + 54, 16)) {
+            return XUDK_TEXTURE_ERROR;
+        }
+        image->info.alpha = le32(header + 66) == 0xFF000000u;
+        offset -= 16;
+    }
+    return reader_skip(image, offset - 54) ? XUDK_OK : XUDK_TEXTURE_ERROR;
+}
+
+static status bmp_decode(xudk_image *image, const xudk_surface *target, u32 x, u32 y, u32 flags) {
+    u32 rows = image->info.height, width = image->info.width;
+    u8 *line = (u8*)(image->row + width);   // Scratch after the row, sized for the file stride
+
+    for (u32 j = 0; j < rows; j++) {
+        if (!reader_read(image, line, image->bmp_stride)) {
+            return XUDK_TEXTURE_ERROR;
+        }
+        if (image->bmp_bits == 24) {
+            xudk_pixel_kernels()->expand24(image->row, line, width);
+        } else {
+            xudk_memcpy(image->row, line, width * sizeof(u32));
+            if (!image->info.alpha) {
+                for (u32 i = 0; i < width; i++) {
+                    image->row[i] |= 0xFF000000u;
+                }
+            }
+        }
+        image_emit(image, target, x, y, image->bmp_bottom_up ? rows - 1 - j : j, XUDK_PIXEL_BGRX, flags);
+    }
+    return XUDK_OK;
+}
+
+// =============================================================================
+// QOI
+// =============================================================================
+
+static status qoi_open(xudk_image *image) {
+    u8 header[14];
+
+    if (!reader_read(image, header, sizeof(header))) {
+        return XUDK_TEXTURE_ERROR;
+    }
+    image->info.width = be32(header + 4);
+    image->info.height = be32(header + 8);
+    if (header[12] != 3 && header[12] != 4) {
+        return XUDK_TEXTURE_ERROR;
+    }
+    image->info.alpha = header[12] == 4;
+    return XUDK_OK;
+}
+
+// Pixels are kept as RGBX-order u32s, so a channel is a byte shift away
+static status qoi_decode(xudk_image *image, const xudk_surface *target, u32 x, u32 y, u32 flags) {
+    u32 index[64];
+    u32 pixel = 0xFF000000u, run = 0;
+
+    xudk_memset(index, 0, sizeof(index));
+    for (u32 j = 0; j < image->info.height; j++) {
+        for (u32 i = 0; i < image->info.width; i++) {
+            if (run) {
+                run--;
+            } else {
+                i32 op = reader_byte(image);
+                u32 r = pixel & 0xFF, g = (pixel >> 8) & 0xFF, b = (pixel >> 16) & 0xFF, a = pixel >> 24;
+
+                if (op < 0) {
+                    return XUDK_TEXTURE_ERROR;
+                }
+                if (op == 0xFE || op == 0xFF) {
+                    u8 c[4];
+                    if (!reader_read(image, c, op == 0xFF ? 4 : 3)) {
+                        return XUDK_TEXTURE_ERROR;
+                    }
+                    r = c[0];
+                    g = c[1];
+                    b = c[2];
+                    a = op == 0xFF ? c[3] : a;
+                } else if ((op >> 6) == 0) {
+                    pixel = index[op];
+                    image->row[i] = pixel;
+                    continue;
+                } else if ((op >> 6) == 1) {
+                    r += ((op >> 4) & 3) - 2;
+                    g += ((op >> 2) & 3) - 2;
+                    b += (op & 3) - 2;
+                } else if ((op >> 6) == 2) {
+                    i32 next = reader_byte(image);
+                    u32 dg = (op & 0x3F) - 32;
+                    if (next < 0) {
+                        return XUDK_TEXTURE_ERROR;
+                    }
+                    r += dg - 8 + ((next >> 4) & 0xF);
+                    g += dg;
+                    b += dg - 8 + (next & 0xF);
+                } else {
+                    run = op & 0x3F;
+                }
+                pixel = (r & 0xFF) | ((g & 0xFF) << 8) | ((b & 0xFF) << 16) | (a << 24);
+                index[((r & 0xFF) * 3 + (g & 0xFF) * 5 + (b & 0xFF) * 7 + a * 11) & 63] = pixel;
+            }
+            image->row[i] = pixel;
+        }
+        image_emit(image, target, x, y, j, XUDK_PIXEL_RGBX, flags);
+    }
+    return XUDK_OK;
+}
+
+// =============================================================================
+// INFLATE
+// =============================================================================
+
+static const u16 length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const u8 length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const u16 distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const u8 distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Move to the next IDAT chunk once the current one is used up
+static bool png_next_idat(xudk_image *image) {
+    u8 header[12];
+
+    while (!image->png_chunk_left) {
+        // CRC of the finished chunk, then the next chunk's length and type
+        if (!reader_read(image, header, 12) || xudk_memcmp(header + 8, "IDAT", 4) != 0) {
+            return false;
+        }
+        image->png_chunk_left = be32(header + 4);
+    }
+    return true;
+}
+
+// Top the bit buffer up to at least 56 bits while compressed data lasts
+static void inflate_refill(xudk_image *image, inflater *z) {
+    while (z->bit_count < 56) {
+        usize avail, n;
+
+        if (!image->png_chunk_left && !png_next_idat(image)) {
+            return;
+        }
+        if (image->pos == image->buffered && !reader_fill(image)) {
+            return;
+        }
+        avail = image->buffered - image->pos;
+        avail = avail < image->png_chunk_left ? avail : image->png_chunk_left;
+        n = (63 - z->bit_count) >> 3;
+        if (avail >= 8) {
+            u64 v = *(const xudk_unaligned_u64*)(image->buffer + image->pos);
+            z->bits |= (v & (((u64)1 << (n * 8)) - 1)) << z->bit_count;
+        } else {
+            n = 1;
+            z->bits |= (u64)image->buffer[image->pos] << z->bit_count;
+        }
+        image->pos += n;
+        image->png_chunk_left -= (u32)n;
+        z->bit_count += (u32)n * 8;
+    }
+}
+
+// Take `count` bits (at most 32); false when the data ran out
+static bool inflate_bits(xudk_image *image, inflater *z, u32 count, u32 *value) {
+    if (z->bit_count < count) {
+        inflate_refill(image, z);
+        if (z->bit_count < count) {
+            return false;
+        }
+    }
+    *value = (u32)(z->bits & (((u64)1 << count) - 1));
+    z->bits >>= count;
+    z->bit_count -= count;
+    return true;
+}
+
+static bool huffman_build(huffman *h, const u8 *lengths, u32 count) {
+    u16 offsets[16], next_code[16];
+    i32 left = 1;
+    u32 code = 0;
+
+    xudk_memset(h, 0, sizeof(*h));
+    for (u32 i = 0; i < count; i++) {
+        h->count[lengths[i]]++;
+    }
+    h->count[0] = 0;
+    for (u32 len = 1; len < 16; len++) {
+        left = left * 2 - h->count[len];
+        if (left < 0) {
+            return false;   // Over-subscribed; incomplete codes are allowed
+        }
+    }
+
+    offsets[1] = 0;
+    next_code[1] = 0;
+    for (u32 len = 1; len < 15; len++) {
+        offsets[len + 1] = offsets[len] + h->count[len];
+        code = (code + h->count[len]) << 1;
+        next_code[len + 1] = (u16)code;
+    }
+    for (u32 i = 0; i < count; i++) {
+        u32 len = lengths[i], reversed = 0;
+
+        if (!len) {
+            continue;
+        }
+        h->symbol[offsets[len]++] = (u16)i;
+        code = next_code[len]++;
+        if (len > HUFFMAN_FAST_BITS) {
+            continue;
+        }
+        for (u32 b = 0; b < len; b++) {
+            reversed |= ((code >> b) & 1) << (len - 1 - b);
+        }
+        for (u32 k = reversed; k < (1u << HUFFMAN_FAST_BITS); k += 1u << len) {
+            h->fast[k] = (u16)((i << 4) | len);
+        }
+    }
+    return true;
+}
+
+// Next symbol, or -1 on a bad code or missing data; expects a refilled buffer
+static i32 huffman_decode(inflater *z, const huffman *h) {
+    u32 entry = h->fast[z->bits & ((1u << HUFFMAN_FAST_BITS) - 1)];
+    i32 code = 0, first = 0, index = 0;
+
+    if (entry) {
+        u32 len = entry & 15;
+        if (len > z->bit_count) {
+            return -1;
+        }
+        z->bits >>= len;
+        z->bit_count -= len;
+        return (i32)(entry >> 4);
+    }
+    // Longer codes, one bit at a time (codes are stored most significant bit first)
+    for (u32 len = 1; len < 16 && len <= z->bit_count; len++) {
+        i32 count = h->count[len];
+        code |= (i32)((z->bits >> (len - 1)) & 1);
+        if (code - count < first) {
+            z->bits >>= len;
+            z->bit_count -= len;
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static bool inflate_fixed(inflater *z) {
+    u8 lengths[288 + 30];
+    u32 i = 0;
+
+    for (; i < 144; i++) lengths[i] = 8;
+    for (; i < 256; i++) lengths[i] = 9;
+    for (; i < 280; i++) lengths[i] = 7;
+    for (; i < 288; i++) lengths[i] = 8;
+    for (; i < 288 + 30; i++) lengths[i] = 5;
+    return huffman_build(&z->literals, lengths, 288) && huffman_build(&z->distances, lengths + 288, 30);
+}
+
+static bool inflate_dynamic(xudk_image *image, inflater *z) {
+    static const u8 order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    u8 lengths[288 + 32];
+    u32 nlen, ndist, ncode, value;
+    huffman *codes = &z->distances;     // Borrowed until the distance code is read
+
+    if (!inflate_bits(image, z, 5, &nlen) || !inflate_bits(image, z, 5, &ndist) ||
+        !inflate_bits(image, z, 4, &ncode)) {
+        return false;
+    }
+    nlen += 257;
+    ndist += 1;
+    ncode += 4;
+    if (nlen > 286 || ndist > 30) {
+        return false;
+    }
+    xudk_memset(lengths, 0, 19);
+    for (u32 i = 0; i < ncode; i++) {
+        if (!inflate_bits(image, z, 3, &value)) {
+            return false;
+        }
+        lengths[order[i]] = (u8)value;
+    }
+    if (!huffman_build(codes, lengths, 19)) {
+        return false;
+    }
+
+    for (u32 i = 0; i < nlen + ndist;) {
+        i32 symbol;
+        u32 repeat, fill = 0;
+
+        inflate_refill(image, z);
+        symbol = huffman_decode(z, codes);
+        if (symbol < 0) {
+            return false;
+        }
+        if (symbol < 16) {
+            lengths[i++] = (u8)symbol;
+            continue;
+        }
+        if (symbol == 16) {
+            if (!i || !inflate_bits(image, z, 2, &repeat)) {
+                return false;
+            }
+            fill = lengths[i - 1];
+            repeat += 3;
+        } else if (symbol == 17) {
+            if (!inflate_bits(image, z, 3, &repeat)) {
+                return false;
+            }
+            repeat += 3;
+        } else {
+            if (!inflate_bits(image, z, 7, &repeat)) {
+                return false;
+            }
+            repeat += 11;
+        }
+        if (i + repeat > nlen + ndist) {
+            return false;
+        }
+        while (repeat--) {
+            lengths[i++] = (u8)fill;
+        }
+    }
+    return lengths[256] && huffman_build(&z->literals, lengths, nlen) &&
+           huffman_build(&z->distances, lengths + nlen, ndist);
+}
+
+static bool inflate_block_header(xudk_image *image, inflater *z) {
+    u32 value, type;
+
+    if (z->final) {
+        return false;   // Stream ended before the image did
+    }
+    if (!inflate_bits(image, z, 1, &value) || !inflate_bits(image, z, 2, &type)) {
+        return false;
+    }
+    z->final = value != 0;
+    if (type == 0) {
+        u32 length, check;
+        z->bits >>= z->bit_count & 7;
+        z->bit_count &= ~7u;
+        if (!inflate_bits(image, z, 16, &length) || !inflate_bits(image, z, 16, &check) ||
+            (length ^ 0xFFFF) != check) {
+            return false;
+        }
+        z->stored_left = length;
+        z->mode = INFLATE_STORED;
+        return true;
+    }
+    if (type == 3 || !(type == 1 ? inflate_fixed(z) : inflate_dynamic(image, z))) {
+        return false;
+    }
+    z->mode = INFLATE_CODES;
+    return true;
+}
+
+static inline void inflate_put(inflater *z, u8 **out, u8 byte) {
+    z->window[z->window_pos] = byte;
+    z->window_pos = (z->window_pos + 1) & (INFLATE_WINDOW - 1);
+    *(*out)++ = byte;
+}
+
+// Produce exactly `size` bytes of the zlib stream into dst
+static bool inflate_read(xudk_image *image, inflater *z, u8 *dst, usize size) {
+    u8 *out = dst, *end = dst + size;
+
+    while (out < end) {
+        if (z->copy_length) {
+            u32 from = (z->window_pos - z->copy_distance) & (INFLATE_WINDOW - 1);
+            while (z->copy_length && out < end) {
+                inflate_put(z, &out, z->window[from]);
+                from = (from + 1) & (INFLATE_WINDOW - 1);
+                z->copy_length--;
+            }
+            continue;
+        }
+
+        if (z->mode == INFLATE_HEADER) {
+            if (!inflate_block_header(image, z)) {
+                return false;
+            }
+        } else if (z->mode == INFLATE_STORED) {
+            u32 value;
+            if (!z->stored_left) {
+                z->mode = INFLATE_HEADER;
+                continue;
+            }
+            if (!inflate_bits(image, z, 8, &value)) {
+                return false;
+            }
+            inflate_put(z, &out, (u8)value);
+            z->stored_left--;
+        } else {
+            i32 symbol;
+            u32 extra, index;
+
+            // One refill covers a length, a distance and their extra bits
+            inflate_refill(image, z);
+            symbol = huffman_decode(z, &z->literals);
+            if (symbol < 256) {
+                if (symbol < 0) {
+                    return false;
+                }
+                inflate_put(z, &out, (u8)symbol);
+                continue;
+            }
+            if (symbol == 256) {
+                z->mode = INFLATE_HEADER;
+                continue;
+            }
+            index = (u32)symbol - 257;
+            if (index >= 29 || !inflate_bits(image, z, length_extra[index], &extra)) {
+                return false;
+            }
+            z->copy_length = length_base[index] + extra;
+            symbol = huffman_decode(z, &z->distances);
+            if (symbol < 0 || symbol >= 30 || !inflate_bits(image, z, distance_extra[symbol], &extra)) {
+                return false;
+            }
+            z->copy_distance = distance_base[symbol] + extra;
+            if (z->copy_distance > z->total_out + (u64)(out - dst)) {
+                return false;
+            }
+        }
+    }
+    z->total_out += size;
+    return true;
+}
+
+// =============================================================================
+// PNG
+// =============================================================================
+
+static const u8 png_signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+// Chunks up to the first IDAT; non-interlaced images of any bit depth
+static status png_open(xudk_image *image) {
+    u8 header[8 + 8 + 13];
+    static const u8 channels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    static const u32 depths[7] = {  // Bit d set where depth d is legal for the colour type
+        0x10116, 0, 0x10100, 0x116, 0x10100, 0, 0x10100
+    };
+
+    if (!reader_read(image, header, sizeof(header)) || xudk_memcmp(header, png_signature, 8) != 0 ||
+        xudk_memcmp(header + 12, "IHDR", 4) != 0 || be32(header + 8) != 13) {
+        return XUDK_TEXTURE_ERROR;
+    }
+    image->info.width = be32(header + 16);
+    image->info.height = be32(header + 20);
+    image->png_depth = header[24];
+    image->png_color_type = header[25];
+    if (image->png_depth > 16 || image->png_color_type > 6 ||
+        !(depths[image->png_color_type] & (1u << image->png_depth)) || header[26] || header[27]) {
+        return XUDK_TEXTURE_ERROR;
+    }
+    if (header[28]) {
+        return XUDK_NOT_SUPPORTED;     // Adam7 interlacing
+    }
+    image->png_channels = channels[image->png_color_type];
+    image->info.alpha = image->png_color_type == 4 || image->png_color_type == 6;
+
+    // Skip the IHDR CRC, then walk to the first IDAT
+    if (!reader_skip(image, 4)) {
+        return XUDK_TEXTURE_ERROR;
+    }
+    for (;;) {
+        u8 chunk[8];
+        u32 length;
+
+        if (!reader_read(image, chunk, 8)) {
+            return XUDK_TEXTURE_ERROR;
+        }
+        length = be32(chunk);
+        if (!xudk_memcmp(chunk + 4, "IDAT", 4)) {
+            image->png_chunk_left = length;
+            return XUDK_OK;
+        }
+        if (!xudk_memcmp(chunk + 4, "PLTE", 4) && length <= 768 && length % 3 == 0) {
+            u8 rgb[768];
+            if (!reader_read(image, rgb, length)) {
+                return XUDK_TEXTURE_ERROR;
+            }
+            image->palette_size = length / 3;
+            for (u32 i = 0; i < image->palette_size; i++) {
+                image->palette[i] = 0xFF000000u | rgb[i * 3] | (rgb[i * 3 + 1] << 8) | ((u32)rgb[i * 3 + 2] << 16);
+            }
+            length = 0;
+        } else if (!xudk_memcmp(chunk + 4, "tRNS", 4) && image->png_color_type == 3 && length <= 256) {
+            u8 alpha[256];
+            if (!reader_read(image, alpha, length)) {
+                return XUDK_TEXTURE_ERROR;
+            }
+            for (u32 i = 0; i < length && i < image->palette_size; i++) {
+                image->palette[i] = (image->palette[i] & 0x00FFFFFFu) | ((u32)alpha[i] << 24);
+            }
+            image->info.alpha = true;
+            length = 0;
+        } else if (!xudk_memcmp(chunk + 4, "IEND", 4)) {
+            return XUDK_TEXTURE_ERROR;
+        }
+        if (!reader_skip(image, (u64)length + 4)) {
+            return XUDK_TEXTURE_ERROR;
+        }
+    }
+}
+
+static u8 paeth(u8 a, u8 b, u8 c) {
+    i32 p = (i32)a + b - c;
+    i32 pa = p > a ? p - a : a - p;
+    i32 pb = p > b ? p - b : b - p;
+    i32 pc = p > c ? p - c : c - p;
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// Undo a scanline filter in place; `bpp` is the filter's byte distance
+static bool png_unfilter(u8 *line, const u8 *prior, usize size, u32 bpp, u32 filter) {
+    switch (filter) {
+    case 0:
+        break;
+    case 1:
+        for (usize i = bpp; i < size; i++) line[i] += line[i - bpp];
+        break;
+    case 2:
+        for (usize i = 0; i < size; i++) line[i] += prior[i];
+        break;
+    case 3:
+        for (usize i = 0; i < bpp; i++) line[i] += prior[i] >> 1;
+        for (usize i = bpp; i < size; i++) line[i] += (u8)((line[i - bpp] + prior[i]) >> 1);
+        break;
+    case 4:
+        for (usize i = 0; i < bpp; i++) line[i] += prior[i];
+        for (usize i = bpp; i < size; i++) line[i] += paeth(line[i - bpp], prior[i], prior[i - bpp]);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+// Sample i of a scanline scaled to 8 bits (16-bit samples keep their high byte)
+static u32 png_sample(const u8 *line, u32 i, u32 depth) {
+    u32 bit;
+
+    if (depth == 8) {
+        return line[i];
+    }
+    if (depth == 16) {
+        return line[i * 2];
+    }
+    bit = i * depth;
+    return (line[bit >> 3] >> (8 - depth - (bit & 7))) & ((1u << depth) - 1);
+}
+
+// One unfiltered scanline into image->row in RGBX byte order
+static void png_convert(xudk_image *image, const u8 *line) {
+    u32 width = image->info.width, depth = image->png_depth;
+    u32 *row = image->row;
+
+    if (depth == 8 && image->png_color_type == 6) {
+        xudk_memcpy(row, line, width * sizeof(u32));
+        return;
+    }
+    if (depth == 8 && image->png_color_type == 2) {
+        xudk_pixel_kernels()->expand24(row, line, width);
+        return;
+    }
+    for (u32 i = 0; i < width; i++) {
+        u32 g, a = 0xFF;
+
+        switch (image->png_color_type) {
+        case 0:
+            g = png_sample(line, i, depth) * (depth < 8 ? 255 / ((1u << depth) - 1) : 1);
+            row[i] = 0xFF000000u | g | (g << 8) | (g << 16);
+            break;
+        case 2:
+            row[i] = 0xFF000000u | png_sample(line, i * 3, depth) | (png_sample(line, i * 3 + 1, depth) << 8) |
+                     (png_sample(line, i * 3 + 2, depth) << 16);
+            break;
+        case 3:
+            g = png_sample(line, i, depth);
+            row[i] = g < image->palette_size ? image->palette[g] : 0xFF000000u;
+            break;
+        case 4:
+            g = png_sample(line, i * 2, depth);
+            a = png_sample(line, i * 2 + 1, depth);
+            row[i] = (a << 24) | g | (g << 8) | (g << 16);
+            break;
+        default:
+            row[i] = png_sample(line, i * 4, depth) | (png_sample(line, i * 4 + 1, depth) << 8) |
+                     (png_sample(line, i * 4 + 2, depth) << 16) | (png_sample(line, i * 4 + 3, depth) << 24);
+            break;
+        }
+    }
+}
+
+// Chunk CRCs and the zlib Adler-32 are not checked; a damaged stream fails on
+// its Huffman codes or distances rather than on a checksum
+static status png_decode(xudk_image *image, const xudk_surface *target, u32 x, u32 y, u32 flags) {
+    usize bits_per_pixel = (usize)image->png_channels * image->png_depth;
+    usize stride = (image->info.width * bits_per_pixel + 7) / 8;
+    u32 bpp = (u32)((bits_per_pixel + 7) / 8);
+    inflater *z = image->inflate;
+    u8 *line, *prior, zlib[2];
+    u32 value;
+
+    // Two scanlines, each with its filter byte, right after the pixel row
+    line = (u8*)(image->row + image->info.width);
+    prior = line + stride + 1;
+    xudk_memset(prior, 0, stride + 1);
+
+    for (u32 i = 0; i < 2; i++) {
+        if (!inflate_bits(image, z, 8, &value)) {
+            return XUDK_TEXTURE_ERROR;
+        }
+        zlib[i] = (u8)value;
+    }
+    if ((zlib[0] & 0x0F) != 8 || (zlib[1] & 0x20) || ((zlib[0] << 8) | zlib[1]) % 31) {
+        return XUDK_TEXTURE_ERROR;
+    }
+
+    for (u32 j = 0; j < image->info.height; j++) {
+        u8 *swap;
+
+        if (!inflate_read(image, z, line, stride + 1) ||
+            !png_unfilter(line + 1, prior + 1, stride, bpp, line[0])) {
+            return XUDK_TEXTURE_ERROR;
+        }
+        png_convert(image, line + 1);
+        image_emit(image, target, x, y, j, XUDK_PIXEL_RGBX, flags);
+        swap = line;
+        line = prior;
+        prior = swap;
+    }
+    return XUDK_OK;
+}
+
+// =============================================================================
+// OPEN / DECODE
+// =============================================================================
+
+status xudk_image_open(xudk_ctx *ctx, const wchar *path, xudk_image **result, xudk_image_info *info) {
+    xudk_image *image;
+    usize scratch;
+    status s;
+
+    if (!path || !result) {
+        return XUDK_INVALID_PARAM;
+    }
+    image = ctx->memory.alloc(ctx, sizeof(*image));
+    if (!image) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(image, 0, sizeof(*image));
+    image->ctx = ctx;
+    image->buffer = ctx->memory.alloc(ctx, IMAGE_READ_CHUNK);
+    s = image->buffer ? ctx->filesystem.open_file(ctx, path, &image->file) : XUDK_OUT_OF_MEMORY;
+    if (xudk_error(s)) {
+        xudk_image_close(image);
+        return s;
+    }
+
+    // The magic picks the decoder; it stays in the buffer for the header parse
+    if (!reader_fill(image) || image->buffered < 4) {
+        s = XUDK_NOT_SUPPORTED;
+    } else if (image->buffer[0] == 'B' && image->buffer[1] == 'M') {
+        image->format = IMAGE_BMP;
+        s = bmp_open(image);
+    } else if (!xudk_memcmp(image->buffer, "qoif", 4)) {
+        image->format = IMAGE_QOI;
+        s = qoi_open(image);
+    } else if (!xudk_memcmp(image->buffer, png_signature, 4)) {
+        image->format = IMAGE_PNG;
+        s = png_open(image);
+    } else {
+        s = XUDK_NOT_SUPPORTED;
+    }
+    if (xudk_ok(s) && (!image->info.width || !image->info.height ||
+                       image->info.width > IMAGE_MAX_DIMENSION || image->info.height > IMAGE_MAX_DIMENSION)) {
+        s = XUDK_NOT_SUPPORTED;
+    }
+
+    // Row of pixels plus per-format scratch: a BMP row, or two PNG scanlines
+    if (xudk_ok(s)) {
+        scratch = image->format == IMAGE_BMP ? image->bmp_stride
+                : image->format == IMAGE_PNG ? 2 * ((image->info.width * (usize)image->png_channels * 16 + 7) / 8 + 1)
+                : 0;
+        image->row = ctx->memory.alloc(ctx, image->info.width * sizeof(u32) + scratch);
+        if (image->format == IMAGE_PNG) {
+            image->inflate = ctx->memory.alloc(ctx, sizeof(inflater));
+            if (image->inflate) {
+                xudk_memset(image->inflate, 0, sizeof(inflater));
+            }
+        }
+        if (!image->row || (image->format == IMAGE_PNG && !image->inflate)) {
+            s = XUDK_OUT_OF_MEMORY;
+        }
+    }
+    if (xudk_error(s)) {
+        xudk_image_close(image);
+        return s;
+    }
+    if (info) {
+        *info = image->info;
+    }
+    *result = image;
+    return XUDK_OK;
+}
+
+status xudk_image_decode(xudk_image *image, const xudk_surface *target, u32 x, u32 y, u32 flags) {
+    if (!image || !target) {
+        return XUDK_INVALID_PARAM;
+    }
+    switch (image->format) {
+    case IMAGE_BMP:
+        return bmp_decode(image, target, x, y, flags);
+    case IMAGE_QOI:
+        return qoi_decode(image, target, x, y, flags);
+    default:
+        return png_decode(image, target, x, y, flags);
+    }
+}
+
+void xudk_image_close(xudk_image *image) {
+    xudk_ctx *ctx;
+
+    if (!image) {
+        return;
+    }
+    ctx = image->ctx;
+    if (image->file) {
+        ctx->filesystem.close_file(ctx, image->file);
+    }
+    if (image->inflate) {
+        ctx->memory.free(ctx, image->inflate);
+    }
+    if (image->row) {
+        ctx->memory.free(ctx, image->row);
+    }
+    if (image->buffer) {
+        ctx->memory.free(ctx, image->buffer);
+    }
+    ctx->memory.free(ctx, image);
+}
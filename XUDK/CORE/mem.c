@@ -0,0 +1,693 @@
+/*
+ * XUDK - Memory primitives
+ * xudk_memcpy / xudk_memset / xudk_memcmp go through function pointers picked
+ * once from the CPU features. Every xudk_memcpy implementation keeps memmove
+ * semantics, callers rely on it for in-place relocation.
+ */
+
+#include "core.h"
+
+#if XUDK_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// =============================================================================
+// SCALAR
+// =============================================================================
+
+static void memset_scalar(void *ptr, u8 value, usize size) {
+    u8 *p = ptr;
+    u64 pattern = value * 0x0101010101010101ULL;
+
+    while (size && ((usize)p & 7)) {
+        *p++ = value;
+        size--;
+    }
+    for (; size >= 8; size -= 8, p += 8) {
+        *(u64*)p = pattern;
+    }
+    while (size--) {
+        *p++ = value;
+    }
+}
+
+static void memcpy_scalar(void *dst, const void *src, usize size) {
+    u8 *d = dst;
+    const u8 *s = src;
+
+    if (d == s || !size) {
+        return;
+    }
+    if (d > s && d < s + size) {
+        // Overlapping move towards higher addresses, copy backwards
+        while (size--) {
+            d[size] = s[size];
+        }
+        return;
+    }
+    if ((((usize)d ^ (usize)s) & 7) == 0) {
+        while (size && ((usize)d & 7)) {
+            *d++ = *s++;
+            size--;
+        }
+        for (; size >= 8; size -= 8, d += 8, s += 8) {
+            *(u64*)d = *(const u64*)s;
+        }
+    }
+    while (size--) {
+        *d++ = *s++;
+    }
+}
+
+static int memcmp_scalar(const void *s1, const void *s2, usize size) {
+    const u8 *a = s1;
+    const u8 *b = s2;
+
+    for (usize i = 0; i < size; i++) {
+        if (a[i] != b[i]) {
+            return (int)a[i] - (int)b[i];
+        }
+    }
+    return 0;
+}
+
+// Below 16 bytes every load happens before the first store, so overlap is safe
+static void copy_small(u8 *d, const u8 *s, usize size) {
+    if (size >= 8) {
+        u64 head = *(const xudk_unaligned_u64*)s;
+        u64 tail = *(const xudk_unaligned_u64*)(s + size - 8);
+        *(xudk_unaligned_u64*)d = head;
+        *(xudk_unaligned_u64*)(d + size - 8) = tail;
+    } else if (size >= 4) {
+        u32 head = *(const xudk_unaligned_u32*)s;
+        u32 tail = *(const xudk_unaligned_u32*)(s + size - 4);
+        *(xudk_unaligned_u32*)d = head;
+        *(xudk_unaligned_u32*)(d + size - 4) = tail;
+    } else if (size) {
+        u8 first = s[0], middle = s[size / 2], last = s[size - 1];
+        d[0] = first;
+        d[size / 2] = middle;
+        d[size - 1] = last;
+    }
+}
+
+static void set_small(u8 *p, u8 value, usize size) {
+    u64 pattern = value * 0x0101010101010101ULL;
+
+    if (size >= 8) {
+        *(xudk_unaligned_u64*)p = pattern;
+        *(xudk_unaligned_u64*)(p + size - 8) = pattern;
+    } else if (size >= 4) {
+        *(xudk_unaligned_u32*)p = (u32)pattern;
+        *(xudk_unaligned_u32*)(p + size - 4) = (u32)pattern;
+    } else if (size) {
+        p[0] = p[size / 2] = p[size - 1] = value;
+    }
+}
+
+#if XUDK_X86
+
+static u32 first_set(u64 mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return (u32)index;
+#else
+    return (u32)__builtin_ctzll(mask);
+#endif
+}
+
+static bool overlaps(const u8 *d, const u8 *s, usize size) {
+    return d < s + size && s < d + size;
+}
+
+// =============================================================================
+// SSE2
+// =============================================================================
+
+// Overlapping move in 16-byte steps; each step loads before it stores
+static XUDK_TARGET("sse2") void move_sse2(u8 *d, const u8 *s, usize size) {
+    if (d < s) {
+        for (; size >= 16; size -= 16, d += 16, s += 16) {
+            _mm_storeu_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+        }
+        copy_small(d, s, size);
+    } else {
+        for (; size >= 16; size -= 16) {
+            _mm_storeu_si128((__m128i*)(d + size - 16), _mm_loadu_si128((const __m128i*)(s + size - 16)));
+        }
+        copy_small(d, s, size);
+    }
+}
+
+// 16 to 32 bytes: two possibly overlapping vectors
+static XUDK_TARGET("sse2") void copy_16_32(u8 *d, const u8 *s, usize size) {
+    __m128i head = _mm_loadu_si128((const __m128i*)s);
+    __m128i tail = _mm_loadu_si128((const __m128i*)(s + size - 16));
+    _mm_storeu_si128((__m128i*)d, head);
+    _mm_storeu_si128((__m128i*)(d + size - 16), tail);
+}
+
+static XUDK_TARGET("sse2") void memcpy_sse2(void *dst, const void *src, usize size) {
+    u8 *d = dst;
+    const u8 *s = src;
+    u8 *end = d + size;
+    __m128i head, tail;
+    usize skip;
+
+    if (size < 16) {
+        copy_small(d, s, size);
+        return;
+    }
+    if (size <= 32) {
+        copy_16_32(d, s, size);
+        return;
+    }
+    if (overlaps(d, s, size)) {
+        if (d != s) {
+            move_sse2(d, s, size);
+        }
+        return;
+    }
+
+    // Unaligned head and tail, aligned stores in between
+    head = _mm_loadu_si128((const __m128i*)s);
+    tail = _mm_loadu_si128((const __m128i*)(s + size - 16));
+    skip = 16 - ((usize)d & 15);
+    d += skip;
+    s += skip;
+    size -= skip;
+    if (size >= XUDK_MEM_STREAM_THRESHOLD) {
+        for (; size >= 64; size -= 64, d += 64, s += 64) {
+            _mm_stream_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+            _mm_stream_si128((__m128i*)(d + 16), _mm_loadu_si128((const __m128i*)(s + 16)));
+            _mm_stream_si128((__m128i*)(d + 32), _mm_loadu_si128((const __m128i*)(s + 32)));
+            _mm_stream_si128((__m128i*)(d + 48), _mm_loadu_si128((const __m128i*)(s + 48)));
+        }
+        _mm_sfence();
+    }
+    for (; size >= 64; size -= 64, d += 64, s += 64) {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)s);
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(s + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i*)(s + 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i*)(s + 48));
+        _mm_store_si128((__m128i*)d, v0);
+        _mm_store_si128((__m128i*)(d + 16), v1);
+        _mm_store_si128((__m128i*)(d + 32), v2);
+        _mm_store_si128((__m128i*)(d + 48), v3);
+    }
+    for (; size >= 16; size -= 16, d += 16, s += 16) {
+        _mm_store_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+    }
+    _mm_storeu_si128((__m128i*)(end - 16), tail);
+    _mm_storeu_si128((__m128i*)dst, head);
+}
+
+// Non-temporal copy for framebuffers and other write-combined or uncached
+// targets: regular stores for the unaligned head and tail, streaming between
+static XUDK_TARGET("sse2") void stream_sse2(void *dst, const void *src, usize size) {
+    u8 *d = dst;
+    const u8 *s = src;
+    u8 *end = d + size;
+    __m128i head, tail;
+    usize skip;
+
+    if (size < 64) {
+        memcpy_sse2(d, s, size);
+        return;
+    }
+    head = _mm_loadu_si128((const __m128i*)s);
+    tail = _mm_loadu_si128((const __m128i*)(s + size - 16));
+    skip = 16 - ((usize)d & 15);
+    d += skip;
+    s += skip;
+    size -= skip;
+    for (; size >= 64; size -= 64, d += 64, s += 64) {
+        _mm_stream_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+        _mm_stream_si128((__m128i*)(d + 16), _mm_loadu_si128((const __m128i*)(s + 16)));
+        _mm_stream_si128((__m128i*)(d + 32), _mm_loadu_si128((const __m128i*)(s + 32)));
+        _mm_stream_si128((__m128i*)(d + 48), _mm_loadu_si128((const __m128i*)(s + 48)));
+    }
+    for (; size >= 16; size -= 16, d += 16, s += 16) {
+        _mm_stream_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+    }
+    _mm_sfence();
+    _mm_storeu_si128((__m128i*)(end - 16), tail);
+    _mm_storeu_si128((__m128i*)dst, head);
+}
+
+static XUDK_TARGET("sse2") void memset_sse2(void *ptr, u8 value, usize size) {
+    u8 *p = ptr;
+    u8 *end = p + size;
+    __m128i v = _mm_set1_epi8((char)value);
+
+    if (size < 16) {
+        set_small(p, value, size);
+        return;
+    }
+    _mm_storeu_si128((__m128i*)p, v);
+    _mm_storeu_si128((__m128i*)(end - 16), v);
+    if (size <= 32) {
+        return;
+    }
+
+    p = (u8*)(((usize)p + 16) & ~(usize)15);
+    size = (usize)(end - p);
+    if (size >= XUDK_MEM_STREAM_THRESHOLD) {
+        for (; size >= 64; size -= 64, p += 64) {
+            _mm_stream_si128((__m128i*)p, v);
+            _mm_stream_si128((__m128i*)(p + 16), v);
+            _mm_stream_si128((__m128i*)(p + 32), v);
+            _mm_stream_si128((__m128i*)(p + 48), v);
+        }
+        _mm_sfence();
+    }
+    for (; size >= 64; size -= 64, p += 64) {
+        _mm_store_si128((__m128i*)p, v);
+        _mm_store_si128((__m128i*)(p + 16), v);
+        _mm_store_si128((__m128i*)(p + 32), v);
+        _mm_store_si128((__m128i*)(p + 48), v);
+    }
+    for (; size >= 16; size -= 16, p += 16) {
+        _mm_store_si128((__m128i*)p, v);
+    }
+}
+
+static XUDK_TARGET("sse2") int memcmp_sse2(const void *s1, const void *s2, usize size) {
+    const u8 *a = s1;
+    const u8 *b = s2;
+    usize i = 0;
+
+    if (size < 16) {
+        return memcmp_scalar(a, b, size);
+    }
+    for (;;) {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+        u32 ne = ~(u32)_mm_movemask_epi8(eq) & 0xFFFF;
+
+        if (ne) {
+            i += first_set(ne);
+            return (int)a[i] - (int)b[i];
+        }
+        if (i + 16 == size) {
+            return 0;
+        }
+        // The last step re-checks a few equal bytes instead of going scalar
+        i = i + 32 <= size ? i + 16 : size - 16;
+    }
+}
+
+// =============================================================================
+// ENHANCED REP MOVSB / STOSB
+// =============================================================================
+
+static void rep_movsb(u8 *d, const u8 *s, usize size) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    __movsb(d, s, size);
+#else
+    __asm__ volatile ("rep movsb" : "+D"(d), "+S"(s), "+c"(size) : : "memory");
+#endif
+}
+
+static void rep_stosb(u8 *p, u8 value, usize size) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    __stosb(p, value, size);
+#else
+    __asm__ volatile ("rep stosb" : "+D"(p), "+c"(size) : "a"(value) : "memory");
+#endif
+}
+
+static void memcpy_erms(void *dst, const void *src, usize size) {
+    u8 *d = dst;
+    const u8 *s = src;
+
+    // The microcode start-up cost only pays off on larger copies
+    if (size <= 32) {
+        memcpy_sse2(d, s, size);
+    } else if (d > s && d < s + size) {
+        move_sse2(d, s, size);
+    } else if (d != s) {
+        rep_movsb(d, s, size);
+    }
+}
+
+static void memset_erms(void *ptr, u8 value, usize size) {
+    if (size <= 32) {
+        memset_sse2(ptr, value, size);
+    } else {
+        rep_stosb(ptr, value, size);
+    }
+}
+
+// =============================================================================
+// AVX2
+// =============================================================================
+
+static XUDK_TARGET("avx2") void memcpy_avx2(void *dst, const void *src, usize size) {
+    u8 *d = dst;
+    const u8 *s = src;
+    u8 *end = d + size;
+    __m256i head, tail;
+    usize skip;
+
+    if (size <= 32) {
+        memcpy_sse2(d, s, size);
+        return;
+    }
+    if (size <= 64) {
+        head = _mm256_loadu_si256((const __m256i*)s);
+        tail = _mm256_loadu_si256((const __m256i*)(s + size - 32));
+        _mm256_storeu_si256((__m256i*)d, head);
+        _mm256_storeu_si256((__m256i*)(end - 32), tail);
+        return;
+    }
+    if (overlaps(d, s, size)) {
+        if (d != s) {
+            move_sse2(d, s, size);
+        }
+        return;
+    }
+
+    head = _mm256_loadu_si256((const __m256i*)s);
+    tail = _mm256_loadu_si256((const __m256i*)(s + size - 32));
+    skip = 32 - ((usize)d & 31);
+    d += skip;
+    s += skip;
+    size -= skip;
+    if (size >= XUDK_MEM_STREAM_THRESHOLD) {
+        for (; size >= 128; size -= 128, d += 128, s += 128) {
+            _mm256_stream_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+            _mm256_stream_si256((__m256i*)(d + 32), _mm256_loadu_si256((const __m256i*)(s + 32)));
+            _mm256_stream_si256((__m256i*)(d + 64), _mm256_loadu_si256((const __m256i*)(s + 64)));
+            _mm256_stream_si256((__m256i*)(d + 96), _mm256_loadu_si256((const __m256i*)(s + 96)));
+        }
+        _mm_sfence();
+    }
+    for (; size >= 128; size -= 128, d += 128, s += 128) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)s);
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(s + 32));
+        __m256i v2 = _mm256_loadu_si256((const __m256i*)(s + 64));
+        __m256i v3 = _mm256_loadu_si256((const __m256i*)(s + 96));
+        _mm256_store_si256((__m256i*)d, v0);
+        _mm256_store_si256((__m256i*)(d + 32), v1);
+        _mm256_store_si256((__m256i*)(d + 64), v2);
+        _mm256_store_si256((__m256i*)(d + 96), v3);
+    }
+    for (; size >= 32; size -= 32, d += 32, s += 32) {
+        _mm256_store_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+    }
+    _mm256_storeu_si256((__m256i*)(end - 32), tail);
+    _mm256_storeu_si256((__m256i*)dst, head);
+}
+
+static XUDK_TARGET("avx2") void stream_avx2(void *dst, const void *src, usize size) {
+    u8 *d = dst;
+    const u8 *s = src;
+    u8 *end = d + size;
+    __m256i head, tail;
+    usize skip;
+
+    if (size < 128) {
+        memcpy_avx2(d, s, size);
+        return;
+    }
+    head = _mm256_loadu_si256((const __m256i*)s);
+    tail = _mm256_loadu_si256((const __m256i*)(s + size - 32));
+    skip = 32 - ((usize)d & 31);
+    d += skip;
+    s += skip;
+    size -= skip;
+    for (; size >= 128; size -= 128, d += 128, s += 128) {
+        _mm256_stream_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+        _mm256_stream_si256((__m256i*)(d + 32), _mm256_loadu_si256((const __m256i*)(s + 32)));
+        _mm256_stream_si256((__m256i*)(d + 64), _mm256_loadu_si256((const __m256i*)(s + 64)));
+        _mm256_stream_si256((__m256i*)(d + 96), _mm256_loadu_si256((const __m256i*)(s + 96)));
+    }
+    for (; size >= 32; size -= 32, d += 32, s += 32) {
+        _mm256_stream_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+    }
+    _mm_sfence();
+    _mm256_storeu_si256((__m256i*)(end - 32), tail);
+    _mm256_storeu_si256((__m256i*)dst, head);
+}
+
+static XUDK_TARGET("avx2") void memset_avx2(void *ptr, u8 value, usize size) {
+    u8 *p = ptr;
+    u8 *end = p + size;
+    __m256i v;
+
+    // Before any YMM register is live: the SSE2 path is legacy-encoded
+    if (size <= 32) {
+        memset_sse2(p, value, size);
+        return;
+    }
+    v = _mm256_set1_epi8((char)value);
+    _mm256_storeu_si256((__m256i*)p, v);
+    _mm256_storeu_si256((__m256i*)(end - 32), v);
+    if (size <= 64) {
+        return;
+    }
+
+    p = (u8*)(((usize)p + 32) & ~(usize)31);
+    size = (usize)(end - p);
+    if (size >= XUDK_MEM_STREAM_THRESHOLD) {
+        for (; size >= 128; size -= 128, p += 128) {
+            _mm256_stream_si256((__m256i*)p, v);
+            _mm256_stream_si256((__m256i*)(p + 32), v);
+            _mm256_stream_si256((__m256i*)(p + 64), v);
+            _mm256_stream_si256((__m256i*)(p + 96), v);
+        }
+        _mm_sfence();
+    }
+    for (; size >= 128; size -= 128, p += 128) {
+        _mm256_store_si256((__m256i*)p, v);
+        _mm256_store_si256((__m256i*)(p + 32), v);
+        _mm256_store_si256((__m256i*)(p + 64), v);
+        _mm256_store_si256((__m256i*)(p + 96), v);
+    }
+    for (; size >= 32; size -= 32, p += 32) {
+        _mm256_store_si256((__m256i*)p, v);
+    }
+}
+
+static XUDK_TARGET("avx2") int memcmp_avx2(const void *s1, const void *s2, usize size) {
+    const u8 *a = s1;
+    const u8 *b = s2;
+    usize i = 0;
+
+    if (size < 32) {
+        return memcmp_sse2(a, b, size);
+    }
+    for (;;) {
+        __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+        u32 ne = ~(u32)_mm256_movemask_epi8(eq);
+
+        if (ne) {
+            i += first_set(ne);
+            return (int)a[i] - (int)b[i];
+        }
+        if (i + 32 == size) {
+            return 0;
+        }
+        i = i + 64 <= size ? i + 32 : size - 32;
+    }
+}
+
+// =============================================================================
+// AVX-512
+// =============================================================================
+
+// Masked loads and stores handle the head and tail, so there is no scalar edge
+static XUDK_TARGET("avx512f,avx512bw") void memcpy_avx512(void *dst, const void *src, usize size) {
+    u8 *d = dst;
+    const u8 *s = src;
+    usize skip;
+
+    if (size <= 64) {
+        __mmask64 mask = size == 64 ? ~(__mmask64)0 : ((__mmask64)1 << size) - 1;
+        _mm512_mask_storeu_epi8(d, mask, _mm512_maskz_loadu_epi8(mask, s));
+        return;
+    }
+    if (overlaps(d, s, size)) {
+        if (d != s) {
+            move_sse2(d, s, size);
+        }
+        return;
+    }
+
+    skip = (0 - (usize)d) & 63;
+    if (skip) {
+        __mmask64 mask = ((__mmask64)1 << skip) - 1;
+        _mm512_mask_storeu_epi8(d, mask, _mm512_maskz_loadu_epi8(mask, s));
+        d += skip;
+        s += skip;
+        size -= skip;
+    }
+    if (size >= XUDK_MEM_STREAM_THRESHOLD) {
+        for (; size >= 256; size -= 256, d += 256, s += 256) {
+            _mm512_stream_si512((void*)d, _mm512_loadu_si512(s));
+            _mm512_stream_si512((void*)(d + 64), _mm512_loadu_si512(s + 64));
+            _mm512_stream_si512((void*)(d + 128), _mm512_loadu_si512(s + 128));
+            _mm512_stream_si512((void*)(d + 192), _mm512_loadu_si512(s + 192));
+        }
+        _mm_sfence();
+    }
+    for (; size >= 256; size -= 256, d += 256, s += 256) {
+        __m512i v0 = _mm512_loadu_si512(s);
+        __m512i v1 = _mm512_loadu_si512(s + 64);
+        __m512i v2 = _mm512_loadu_si512(s + 128);
+        __m512i v3 = _mm512_loadu_si512(s + 192);
+        _mm512_store_si512(d, v0);
+        _mm512_store_si512(d + 64, v1);
+        _mm512_store_si512(d + 128, v2);
+        _mm512_store_si512(d + 192, v3);
+    }
+    for (; size >= 64; size -= 64, d += 64, s += 64) {
+        _mm512_store_si512(d, _mm512_loadu_si512(s));
+    }
+    if (size) {
+        __mmask64 mask = ((__mmask64)1 << size) - 1;
+        _mm512_mask_storeu_epi8(d, mask, _mm512_maskz_loadu_epi8(mask, s));
+    }
+}
+
+static XUDK_TARGET("avx512f,avx512bw") void stream_avx512(void *dst, const void *src, usize size) {
+    u8 *d = dst;
+    const u8 *s = src;
+    usize skip;
+
+    if (size < 256) {
+        memcpy_avx512(d, s, size);
+        return;
+    }
+    skip = (0 - (usize)d) & 63;
+    if (skip) {
+        __mmask64 mask = ((__mmask64)1 << skip) - 1;
+        _mm512_mask_storeu_epi8(d, mask, _mm512_maskz_loadu_epi8(mask, s));
+        d += skip;
+        s += skip;
+        size -= skip;
+    }
+    for (; size >= 256; size -= 256, d += 256, s += 256) {
+        _mm512_stream_si512((void*)d, _mm512_loadu_si512(s));
+        _mm512_stream_si512((void*)(d + 64), _mm512_loadu_si512(s + 64));
+        _mm512_stream_si512((void*)(d + 128), _mm512_loadu_si512(s + 128));
+        _mm512_stream_si512((void*)(d + 192), _mm512_loadu_si512(s + 192));
+    }
+    for (; size >= 64; size -= 64, d += 64, s += 64) {
+        _mm512_stream_si512((void*)d, _mm512_loadu_si512(s));
+    }
+    _mm_sfence();
+    if (size) {
+        __mmask64 mask = ((__mmask64)1 << size) - 1;
+        _mm512_mask_storeu_epi8(d, mask, _mm512_maskz_loadu_epi8(mask, s));
+    }
+}
+
+static XUDK_TARGET("avx512f,avx512bw") void memset_avx512(void *ptr, u8 value, usize size) {
+    u8 *p = ptr;
+    __m512i v = _mm512_set1_epi8((char)value);
+    usize skip;
+
+    if (size <= 64) {
+        _mm512_mask_storeu_epi8(p, size == 64 ? ~(__mmask64)0 : ((__mmask64)1 << size) - 1, v);
+        return;
+    }
+
+    skip = (0 - (usize)p) & 63;
+    if (skip) {
+        _mm512_mask_storeu_epi8(p, ((__mmask64)1 << skip) - 1, v);
+        p += skip;
+        size -= skip;
+    }
+    if (size >= XUDK_MEM_STREAM_THRESHOLD) {
+        for (; size >= 256; size -= 256, p += 256) {
+            _mm512_stream_si512((void*)p, v);
+            _mm512_stream_si512((void*)(p + 64), v);
+            _mm512_stream_si512((void*)(p + 128), v);
+            _mm512_stream_si512((void*)(p + 192), v);
+        }
+        _mm_sfence();
+    }
+    for (; size >= 256; size -= 256, p += 256) {
+        _mm512_store_si512(p, v);
+        _mm512_store_si512(p + 64, v);
+        _mm512_store_si512(p + 128, v);
+        _mm512_store_si512(p + 192, v);
+    }
+    for (; size >= 64; size -= 64, p += 64) {
+        _mm512_store_si512(p, v);
+    }
+    if (size) {
+        _mm512_mask_storeu_epi8(p, ((__mmask64)1 << size) - 1, v);
+    }
+}
+
+static XUDK_TARGET("avx512f,avx512bw") int memcmp_avx512(const void *s1, const void *s2, usize size) {
+    const u8 *a = s1;
+    const u8 *b = s2;
+
+    for (usize i = 0; i < size; i += 64) {
+        usize n = size - i < 64 ? size - i : 64;
+        __mmask64 mask = n == 64 ? ~(__mmask64)0 : ((__mmask64)1 << n) - 1;
+        u64 ne = _mm512_mask_cmpneq_epu8_mask(mask, _mm512_maskz_loadu_epi8(mask, a + i), _mm512_maskz_loadu_epi8(mask, b + i));
+
+        if (ne) {
+            i += first_set(ne);
+            return (int)a[i] - (int)b[i];
+        }
+    }
+    return 0;
+}
+
+#endif // XUDK_X86
+
+// =============================================================================
+// DISPATCH
+// =============================================================================
+
+static const xudk_mem_impl mem_impls[] = {
+    { "scalar", 0, memcpy_scalar, memset_scalar, memcmp_scalar, memcpy_scalar },
+#if XUDK_X86
+    { "sse2", XUDK_CPU_SSE2, memcpy_sse2, memset_sse2, memcmp_sse2, stream_sse2 },
+    { "erms", XUDK_CPU_SSE2 | XUDK_CPU_ERMS, memcpy_erms, memset_erms, memcmp_sse2, stream_sse2 },
+    { "avx2", XUDK_CPU_SSE2 | XUDK_CPU_AVX2, memcpy_avx2, memset_avx2, memcmp_avx2, stream_avx2 },
+    { "avx512", XUDK_CPU_SSE2 | XUDK_CPU_AVX512, memcpy_avx512, memset_avx512, memcmp_avx512, stream_avx512 },
+#endif
+};
+
+static const xudk_mem_impl *mem_active = &mem_impls[0];
+
+const xudk_mem_impl* xudk_mem_impls(usize *count) {
+    *count = sizeof(mem_impls) / sizeof(mem_impls[0]);
+    return mem_impls;
+}
+
+void xudk_mem_init(void) {
+    u32 features = xudk_cpu_features();
+
+    for (usize i = 0; i < sizeof(mem_impls) / sizeof(mem_impls[0]); i++) {
+        if ((mem_impls[i].features & features) == mem_impls[i].features) {
+            mem_active = &mem_impls[i];
+        }
+    }
+}
+
+void xudk_memset(void *ptr, u8 value, usize size) {
+    mem_active->set(ptr, value, size);
+}
+
+void xudk_memcpy(void *dst, const void *src, usize size) {
+    mem_active->copy(dst, src, size);
+}
+
+int xudk_memcmp(const void *s1, const void *s2, usize size) {
+    return mem_active->compare(s1, s2, size);
+}
+
+void xudk_memcpy_stream(void *dst, const void *src, usize size) {
+    mem_active->stream(dst, src, size);
+}
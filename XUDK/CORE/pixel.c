@@ -0,0 +1,240 @@
+/*
+ * XUDK - Pixel row kernels
+ * Solid fills and source-over blends of one color across a row of 32-bit
+ * pixels. The color is converted to the surface's byte order once per call,
+ * after which RGBX and BGRX rows blend the same way, channel by channel.
+ * The image decoders use the byte-order conversions to land rows in the
+ * target's format.
+ */
+
+#include "core.h"
+
+#if XUDK_X86
+#include <immintrin.h>
+#endif
+
+// dst * (255 - a) + src * a, divided by 255 with rounding; `sa` is src * a + 128
+static u32 blend_channel(u32 dst, u32 sa, u32 ia) {
+    u32 t = dst * ia + sa;
+    return (t + (t >> 8)) >> 8;
+}
+
+// =============================================================================
+// SCALAR
+// =============================================================================
+
+static void fill_scalar(u32 *row, u32 pixel, usize count) {
+    for (usize i = 0; i < count; i++) {
+        row[i] = pixel;
+    }
+}
+
+static void blend_scalar(u32 *row, u32 pixel, u32 alpha, usize count) {
+    u32 ia = 255 - alpha;
+    u32 sa[4];
+
+    for (u32 c = 0; c < 4; c++) {
+        sa[c] = ((pixel >> (c * 8)) & 0xFF) * alpha + 128;
+    }
+    for (usize i = 0; i < count; i++) {
+        u32 d = row[i];
+        row[i] = blend_channel(d & 0xFF, sa[0], ia) |
+                 (blend_channel((d >> 8) & 0xFF, sa[1], ia) << 8) |
+                 (blend_channel((d >> 16) & 0xFF, sa[2], ia) << 16) |
+                 (blend_channel(d >> 24, sa[3], ia) << 24);
+    }
+}
+
+static void swap_rb_scalar(u32 *dst, const u32 *src, usize count) {
+    for (usize i = 0; i < count; i++) {
+        u32 p = src[i];
+        dst[i] = (p & 0xFF00FF00u) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+    }
+}
+
+static void expand24_scalar(u32 *dst, const u8 *src, usize count) {
+    for (usize i = 0; i < count; i++, src += 3) {
+        dst[i] = 0xFF000000u | src[0] | ((u32)src[1] << 8) | ((u32)src[2] << 16);
+    }
+}
+
+#if XUDK_X86
+
+// =============================================================================
+// SSE2
+// =============================================================================
+
+static XUDK_TARGET("sse2") void fill_sse2(u32 *row, u32 pixel, usize count) {
+    __m128i v = _mm_set1_epi32((int)pixel);
+    usize i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        _mm_storeu_si128((__m128i*)(row + i), v);
+        _mm_storeu_si128((__m128i*)(row + i + 4), v);
+        _mm_storeu_si128((__m128i*)(row + i + 8), v);
+        _mm_storeu_si128((__m128i*)(row + i + 12), v);
+    }
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i*)(row + i), v);
+    }
+    for (; i < count; i++) {
+        row[i] = pixel;
+    }
+}
+
+// Two pixels per 128-bit register once widened to 16-bit channels
+static XUDK_TARGET("sse2") __m128i blend4_sse2(__m128i d, __m128i sa, __m128i ia) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ia), sa);
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ia), sa);
+
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+    return _mm_packus_epi16(lo, hi);
+}
+
+static XUDK_TARGET("sse2") void blend_sse2(u32 *row, u32 pixel, u32 alpha, usize count) {
+    __m128i src = _mm_unpacklo_epi8(_mm_set1_epi32((int)pixel), _mm_setzero_si128());
+    __m128i sa = _mm_add_epi16(_mm_mullo_epi16(src, _mm_set1_epi16((short)alpha)), _mm_set1_epi16(128));
+    __m128i ia = _mm_set1_epi16((short)(255 - alpha));
+    usize i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i*)(row + i));
+        _mm_storeu_si128((__m128i*)(row + i), blend4_sse2(d, sa, ia));
+    }
+    if (i < count) {
+        blend_scalar(row + i, pixel, alpha, count - i);
+    }
+}
+
+static XUDK_TARGET("sse2") void swap_rb_sse2(u32 *dst, const u32 *src, usize count) {
+    __m128i ag_mask = _mm_set1_epi32((int)0xFF00FF00u);
+    usize i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i rb = _mm_andnot_si128(ag_mask, v);
+        rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_and_si128(v, ag_mask), rb));
+    }
+    swap_rb_scalar(dst + i, src + i, count - i);
+}
+
+// =============================================================================
+// AVX2
+// =============================================================================
+
+static XUDK_TARGET("avx2") void fill_avx2(u32 *row, u32 pixel, usize count) {
+    __m256i v;
+    usize i = 0;
+
+    if (count < 8) {
+        fill_sse2(row, pixel, count);
+        return;
+    }
+    v = _mm256_set1_epi32((int)pixel);
+    for (; i + 32 <= count; i += 32) {
+        _mm256_storeu_si256((__m256i*)(row + i), v);
+        _mm256_storeu_si256((__m256i*)(row + i + 8), v);
+        _mm256_storeu_si256((__m256i*)(row + i + 16), v);
+        _mm256_storeu_si256((__m256i*)(row + i + 24), v);
+    }
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256((__m256i*)(row + i), v);
+    }
+    // Overlapping last store covers the tail
+    if (i < count) {
+        _mm256_storeu_si256((__m256i*)(row + count - 8), v);
+    }
+}
+
+static XUDK_TARGET("avx2") void blend_avx2(u32 *row, u32 pixel, u32 alpha, usize count) {
+    __m256i zero, src, sa, ia;
+    usize i = 0;
+
+    if (count < 8) {
+        blend_sse2(row, pixel, alpha, count);
+        return;
+    }
+    zero = _mm256_setzero_si256();
+    src = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)pixel), zero);
+    sa = _mm256_add_epi16(_mm256_mullo_epi16(src, _mm256_set1_epi16((short)alpha)), _mm256_set1_epi16(128));
+    ia = _mm256_set1_epi16((short)(255 - alpha));
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i d = _mm256_loadu_si256((const __m256i*)(row + i));
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), ia), sa);
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), ia), sa);
+
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+        _mm256_storeu_si256((__m256i*)(row + i), _mm256_packus_epi16(lo, hi));
+    }
+    if (i < count) {
+        blend_scalar(row + i, pixel, alpha, count - i);
+    }
+}
+
+static XUDK_TARGET("avx2") void swap_rb_avx2(u32 *dst, const u32 *src, usize count) {
+    __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                       2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    usize i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_shuffle_epi8(v, shuffle));
+    }
+    swap_rb_sse2(dst + i, src + i, count - i);
+}
+
+// Eight 3-byte pixels per step: two 12-byte groups, one per 128-bit lane
+static XUDK_TARGET("avx2") void expand24_avx2(u32 *dst, const u8 *src, usize count) {
+    __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                       0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+    usize i = 0;
+
+    // Each lane loads 16 bytes for 12, so stop while 4 spare bytes remain
+    for (; i + 10 <= count; i += 8, src += 24) {
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)src)),
+                                            _mm_loadu_si128((const __m128i*)(src + 12)), 1);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha));
+    }
+    expand24_scalar(dst + i, src, count - i);
+}
+
+#endif
+
+// =============================================================================
+// DISPATCH
+// =============================================================================
+
+static const xudk_pixel_impl pixel_impls[] = {
+    { "scalar", 0, fill_scalar, blend_scalar, swap_rb_scalar, expand24_scalar },
+#if XUDK_X86
+    { "sse2", XUDK_CPU_SSE2, fill_sse2, blend_sse2, swap_rb_sse2, expand24_scalar },
+    { "avx2", XUDK_CPU_SSE2 | XUDK_CPU_AVX2, fill_avx2, blend_avx2, swap_rb_avx2, expand24_avx2 },
+#endif
+};
+
+static const xudk_pixel_impl *pixel_active = &pixel_impls[0];
+
+const xudk_pixel_impl* xudk_pixel_impls(usize *count) {
+    *count = sizeof(pixel_impls) / sizeof(pixel_impls[0]);
+    return pixel_impls;
+}
+
+const xudk_pixel_impl* xudk_pixel_kernels(void) {
+    return pixel_active;
+}
+
+void xudk_pixel_init(void) {
+    u32 features = xudk_cpu_features();
+
+    for (usize i = 0; i < sizeof(pixel_impls) / sizeof(pixel_impls[0]); i++) {
+        if ((pixel_impls[i].features & features) == pixel_impls[i].features) {
+            pixel_active = &pixel_impls[i];
+        }
+    }
+}
@@ -0,0 +1,620 @@
+/*
+ * XUDK - Pipeline state cache
+ * While open, create_graphics_pipeline and create_compute_pipeline hash the
+ * descriptor (shader bytecode, entry points and fixed-function state) and
+ * hand back a shared, reference-counted backend pipeline for repeats. Idle
+ * pipelines stay built until the cache closes, so returning to a screen never
+ * rebuilds its states. Backends whose bytecode survives a reboot also get the
+ * descriptors of the pipelines used this boot written to the ESP; the next
+ * open queues them and xudk_gpu_pipeline_cache_prewarm builds them ahead of use.
+ */
+
+#include "core.h"
+
+#define PSOCACHE_MAGIC      0x4F535058u     // "XPSO"
+#define PSOCACHE_VERSION    1
+#define PSOCACHE_MAX_BLOB   (16u * 1024 * 1024)
+#define PSOCACHE_MAX_STAGES 4
+
+#define PSOCACHE_DEPTH_TEST     0x1
+#define PSOCACHE_DEPTH_WRITE    0x2
+#define PSOCACHE_BLEND          0x4
+
+// Blob layout: this header, then the records. `hash` covers everything after
+// the header.
+typedef struct {
+    u32             magic;
+    u32             version;
+    u32             entry_count;
+    u32             reserved;
+    u64             hash;
+} psocache_header;
+
+// One pipeline: fixed-function state, then `stage_count` stages. Hashed with
+// key and size zeroed to form the key.
+typedef struct {
+    u64             key;
+    u32             size;           // Whole record with its stages, a multiple of 8
+    u32             stage_count;
+    u32             is_compute;
+    u32             topology;
+    u32             flags;          // PSOCACHE_DEPTH_TEST | _DEPTH_WRITE | _BLEND
+    u32             render_target_count;
+    u32             render_target_formats[8];
+    u32             depth_stencil_format;
+    u32             sample_count;
+} psocache_record;
+
+// Followed by the entry point (entry_length wchars and a terminator), then the
+// bytecode, padded to 8 bytes
+typedef struct {
+    u32             type;
+    u32             size;
+    u32             entry_length;
+    u32             reserved;
+} psocache_stage;
+
+typedef struct {
+    u64             key;
+    handle          pipeline;       // Backend pipeline, null while only queued
+    u32             refs;
+    bool            is_compute;
+    bool            used;           // Handed out this boot
+    const u8*       record;         // Serialized descriptor, null when not persistent
+    bool            owned;          // Record copied this boot, rather than pointing into the blob
+} psocache_entry;
+
+typedef struct {
+    xudk_gpu        backend;        // Entries the cache replaced
+    wchar*          path;           // Null for a cache that is never saved
+    bool            persistent;     // Backend bytecode is valid across boots
+    bool            dirty;
+    u8*             blob;
+    psocache_entry* entries;
+    usize           count;
+    usize           capacity;
+} psocache_state;
+
+static psocache_state* psocache_of(xudk_ctx *ctx) {
+    return ctx->gpu_pipeline_cache;
+}
+
+static usize pad8(usize size) {
+    return (size + 7) & ~(usize)7;
+}
+
+// =============================================================================
+// DESCRIPTORS
+// =============================================================================
+
+// Stages in record order; a compute pipeline has only its compute shader
+static u32 desc_stages(const xudk_gpu_pipeline_desc *desc, const xudk_gpu_shader *stages[PSOCACHE_MAX_STAGES]) {
+    const xudk_gpu_shader *all[PSOCACHE_MAX_STAGES] = {
+        desc->vertex_shader, desc->fragment_shader, desc->geometry_shader, desc->compute_shader
+    };
+    u32 count = 0;
+
+    for (u32 i = 0; i < PSOCACHE_MAX_STAGES; i++) {
+        if (all[i]) {
+            stages[count++] = all[i];
+        }
+    }
+    return count;
+}
+
+static void fill_record(const xudk_gpu_pipeline_desc *desc, bool is_compute, u32 stage_count, psocache_record *record) {
+    xudk_memset(record, 0, sizeof(*record));
+    record->stage_count = stage_count;
+    record->is_compute = is_compute;
+    if (is_compute) {
+        return;
+    }
+    record->topology = desc->topology;
+    record->flags = (desc->depth_test_enable ? PSOCACHE_DEPTH_TEST : 0) |
+                    (desc->depth_write_enable ? PSOCACHE_DEPTH_WRITE : 0) |
+                    (desc->blend_enable ? PSOCACHE_BLEND : 0);
+    record->render_target_count = desc->render_target_count < 8 ? desc->render_target_count : 8;
+    for (u32 i = 0; i < record->render_target_count; i++) {
+        record->render_target_formats[i] = desc->render_target_formats[i];
+    }
+    record->depth_stencil_format = desc->depth_stencil_format;
+    record->sample_count = desc->sample_count;
+}
+
+static void fill_stage(const xudk_gpu_shader *shader, psocache_stage *stage) {
+    stage->type = shader->type;
+    stage->size = shader->bytecode ? shader->bytecode_size : 0;
+    stage->entry_length = shader->entry_point ? (u32)xudk_strlen(shader->entry_point) : 0;
+    stage->reserved = 0;
+}
+
+static usize stage_size(const psocache_stage *stage) {
+    return pad8(sizeof(*stage) + (stage->entry_length + 1) * sizeof(wchar) + stage->size);
+}
+
+// Device and driver are part of the key, so a blob from other hardware just misses
+static u64 desc_key(xudk_ctx *ctx, const xudk_gpu_pipeline_desc *desc, bool is_compute) {
+    const xudk_gpu_info *info = &ctx->gpu_device_info;
+    const xudk_gpu_shader *stages[PSOCACHE_MAX_STAGES];
+    u32 count = desc_stages(desc, stages);
+    u32 device[2] = { info->vendor_id, info->device_id };
+    psocache_record record;
+    xudk_hash64_state state;
+
+    fill_record(desc, is_compute, count, &record);
+    xudk_hash64_init(&state);
+    xudk_hash64_update(&state, device, sizeof(device));
+    if (info->driver_version) {
+        xudk_hash64_update(&state, info->driver_version, xudk_strlen(info->driver_version) * sizeof(wchar));
+    }
+    xudk_hash64_update(&state, &record, sizeof(record));
+    for (u32 i = 0; i < count; i++) {
+        psocache_stage stage;
+
+        fill_stage(stages[i], &stage);
+        xudk_hash64_update(&state, &stage, sizeof(stage));
+        if (stage.entry_length) {
+            xudk_hash64_update(&state, stages[i]->entry_point, stage.entry_length * sizeof(wchar));
+        }
+        if (stage.size) {
+            xudk_hash64_update(&state, stages[i]->bytecode, stage.size);
+        }
+    }
+    return xudk_hash64_final(&state);
+}
+
+// Null when a stage has no bytecode to keep; the pipeline is then cached for this boot only
+static u8* serialize_desc(xudk_ctx *ctx, const xudk_gpu_pipeline_desc *desc, bool is_compute, u64 key) {
+    const xudk_gpu_shader *stages[PSOCACHE_MAX_STAGES];
+    u32 count = desc_stages(desc, stages);
+    psocache_record record;
+    usize size = sizeof(record), offset = sizeof(record);
+    u8 *out;
+
+    for (u32 i = 0; i < count; i++) {
+        psocache_stage stage;
+
+        fill_stage(stages[i], &stage);
+        if (!stage.size) {
+            return null;
+        }
+        size += stage_size(&stage);
+    }
+    out = ctx->memory.alloc(ctx, size);
+    if (!out) {
+        return null;
+    }
+    xudk_memset(out, 0, size);
+    fill_record(desc, is_compute, count, &record);
+    record.key = key;
+    record.size = (u32)size;
+    xudk_memcpy(out, &record, sizeof(record));
+
+    for (u32 i = 0; i < count; i++) {
+        psocache_stage stage;
+        usize entry_bytes;
+
+        fill_stage(stages[i], &stage);
+        entry_bytes = stage.entry_length * sizeof(wchar);
+        xudk_memcpy(out + offset, &stage, sizeof(stage));
+        if (entry_bytes) {
+            xudk_memcpy(out + offset + sizeof(stage), stages[i]->entry_point, entry_bytes);
+        }
+        xudk_memcpy(out + offset + sizeof(stage) + entry_bytes + sizeof(wchar), stages[i]->bytecode, stage.size);
+        offset += stage_size(&stage);
+    }
+    return out;
+}
+
+// Recreate the shaders a record describes and build its pipeline on the backend
+static status build_record(xudk_ctx *ctx, psocache_state *cache, const u8 *data, handle *pipeline) {
+    xudk_gpu_shader shaders[PSOCACHE_MAX_STAGES];
+    xudk_gpu_pipeline_desc desc;
+    xudk_gpu_pipeline built;
+    psocache_record record;
+    usize offset = sizeof(record);
+    u32 created = 0;
+    status s = XUDK_OK;
+
+    xudk_memcpy(&record, data, sizeof(record));
+    xudk_memset(&desc, 0, sizeof(desc));
+    desc.topology = record.topology;
+    desc.depth_test_enable = (record.flags & PSOCACHE_DEPTH_TEST) != 0;
+    desc.depth_write_enable = (record.flags & PSOCACHE_DEPTH_WRITE) != 0;
+    desc.blend_enable = (record.flags & PSOCACHE_BLEND) != 0;
+    desc.render_target_count = record.render_target_count;
+    for (u32 i = 0; i < record.render_target_count; i++) {
+        desc.render_target_formats[i] = record.render_target_formats[i];
+    }
+    desc.depth_stencil_format = record.depth_stencil_format;
+    desc.sample_count = record.sample_count;
+
+    for (; created < record.stage_count; created++) {
+        xudk_gpu_shader *shader = &shaders[created];
+        psocache_stage stage;
+        const wchar *entry;
+
+        xudk_memcpy(&stage, data + offset, sizeof(stage));
+        entry = stage.entry_length ? (const wchar*)(data + offset + sizeof(stage)) : null;
+        s = ctx->gpu.create_shader(ctx, stage.type, data + offset + sizeof(stage) + (stage.entry_length + 1) * sizeof(wchar),
+                                   stage.size, entry, shader);
+        if (xudk_error(s)) {
+            break;
+        }
+        switch (stage.type) {
+            case XUDK_SHADER_VERTEX:    desc.vertex_shader = shader; break;
+            case XUDK_SHADER_FRAGMENT:  desc.fragment_shader = shader; break;
+            case XUDK_SHADER_GEOMETRY:  desc.geometry_shader = shader; break;
+            default:                    desc.compute_shader = shader; break;
+        }
+        offset += stage_size(&stage);
+    }
+
+    if (xudk_ok(s)) {
+        s = record.is_compute ? cache->backend.create_compute_pipeline(ctx, desc.compute_shader, &built)
+                              : cache->backend.create_graphics_pipeline(ctx, &desc, &built);
+        *pipeline = xudk_ok(s) ? built.pipeline_handle : null;
+    }
+    // Pipelines keep what they need from their shaders
+    while (created) {
+        ctx->gpu.destroy_shader(ctx, &shaders[--created]);
+    }
+    return s;
+}
+
+// =============================================================================
+// ENTRIES
+// =============================================================================
+
+static psocache_entry* find_key(psocache_state *cache, u64 key) {
+    for (usize i = 0; i < cache->count; i++) {
+        if (cache->entries[i].key == key) {
+            return &cache->entries[i];
+        }
+    }
+    return null;
+}
+
+static psocache_entry* find_pipeline(psocache_state *cache, handle pipeline) {
+    for (usize i = 0; i < cache->count; i++) {
+        if (cache->entries[i].pipeline == pipeline) {
+            return &cache->entries[i];
+        }
+    }
+    return null;
+}
+
+static psocache_entry* append_entry(xudk_ctx *ctx, psocache_state *cache) {
+    if (cache->count == cache->capacity) {
+        usize capacity = cache->capacity ? cache->capacity * 2 : 32;
+        psocache_entry *grown = ctx->memory.alloc(ctx, capacity * sizeof(*grown));
+        if (!grown) {
+            return null;
+        }
+        if (cache->entries) {
+            xudk_memcpy(grown, cache->entries, cache->count * sizeof(*grown));
+            ctx->memory.free(ctx, cache->entries);
+        }
+        cache->entries = grown;
+        cache->capacity = capacity;
+    }
+    xudk_memset(&cache->entries[cache->count], 0, sizeof(psocache_entry));
+    return &cache->entries[cache->count++];
+}
+
+static void remove_entry(xudk_ctx *ctx, psocache_state *cache, psocache_entry *entry) {
+    if (entry->owned) {
+        ctx->memory.free(ctx, (void*)entry->record);
+    }
+    *entry = cache->entries[--cache->count];
+}
+
+static void release_pipeline(xudk_ctx *ctx, psocache_state *cache, handle pipeline) {
+    xudk_gpu_pipeline p;
+
+    xudk_memset(&p, 0, sizeof(p));
+    p.pipeline_handle = pipeline;
+    cache->backend.destroy_pipeline(ctx, &p);
+}
+
+// Shared by both create entries: find or build the pipeline, then hand out a reference
+static status cache_create(xudk_ctx *ctx, const xudk_gpu_pipeline_desc *desc, bool is_compute,
+                           xudk_gpu_pipeline *pipeline) {
+    psocache_state *cache = psocache_of(ctx);
+    u64 key = desc_key(ctx, desc, is_compute);
+    psocache_entry *entry = find_key(cache, key);
+    xudk_gpu_pipeline built;
+    status s;
+
+    if (!entry || !entry->pipeline) {
+        s = is_compute ? cache->backend.create_compute_pipeline(ctx, desc->compute_shader, &built)
+                       : cache->backend.create_graphics_pipeline(ctx, desc, &built);
+        if (xudk_error(s)) {
+            return s;
+        }
+        if (!entry) {
+            entry = append_entry(ctx, cache);
+            if (!entry) {
+                // Still a valid pipeline, just not a shared one
+                *pipeline = built;
+                return XUDK_OK;
+            }
+            entry->key = key;
+            entry->is_compute = is_compute;
+            if (cache->persistent) {
+                entry->record = serialize_desc(ctx, desc, is_compute, key);
+                entry->owned = entry->record != null;
+                cache->dirty |= entry->record != null;
+            }
+        }
+        entry->pipeline = built.pipeline_handle;
+    }
+
+    entry->refs++;
+    entry->used = true;
+    xudk_memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->pipeline_handle = entry->pipeline;
+    pipeline->desc = *desc;
+    pipeline->is_compute = is_compute;
+    return XUDK_OK;
+}
+
+// =============================================================================
+// GPU ENTRIES
+// =============================================================================
+
+static status cache_create_graphics_pipeline(xudk_ctx *ctx, const xudk_gpu_pipeline_desc *desc,
+                                             xudk_gpu_pipeline *pipeline) {
+    if (!desc || !pipeline) {
+        return psocache_of(ctx)->backend.create_graphics_pipeline(ctx, desc, pipeline);
+    }
+    return cache_create(ctx, desc, false, pipeline);
+}
+
+static status cache_create_compute_pipeline(xudk_ctx *ctx, xudk_gpu_shader *compute_shader,
+                                            xudk_gpu_pipeline *pipeline) {
+    xudk_gpu_pipeline_desc desc;
+
+    if (!compute_shader || !pipeline) {
+        return psocache_of(ctx)->backend.create_compute_pipeline(ctx, compute_shader, pipeline);
+    }
+    xudk_memset(&desc, 0, sizeof(desc));
+    desc.compute_shader = compute_shader;
+    return cache_create(ctx, &desc, true, pipeline);
+}
+
+// Dropping the last reference keeps the pipeline built for the next request
+static status cache_destroy_pipeline(xudk_ctx *ctx, xudk_gpu_pipeline *pipeline) {
+    psocache_state *cache = psocache_of(ctx);
+    psocache_entry *entry;
+
+    if (!pipeline || !pipeline->pipeline_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    entry = find_pipeline(cache, pipeline->pipeline_handle);
+    if (!entry || !entry->refs) {
+        return cache->backend.destroy_pipeline(ctx, pipeline);
+    }
+    entry->refs--;
+    pipeline->pipeline_handle = null;
+    return XUDK_OK;
+}
+
+// =============================================================================
+// BLOB
+// =============================================================================
+
+// Any inconsistency throws the whole blob away; it is only a cache
+static void load_blob(xudk_ctx *ctx, psocache_state *cache) {
+    const psocache_header *header;
+    void *data;
+    usize size, offset = sizeof(psocache_header);
+
+    if (xudk_error(ctx->filesystem.load_file_to_memory(ctx, cache->path, &data, &size))) {
+        return;
+    }
+    header = data;
+    if (size < sizeof(*header) || size > PSOCACHE_MAX_BLOB || header->magic != PSOCACHE_MAGIC ||
+        header->version != PSOCACHE_VERSION ||
+        header->hash != xudk_hash64((const u8*)data + sizeof(*header), size - sizeof(*header))) {
+        ctx->memory.free(ctx, data);
+        return;
+    }
+
+    cache->blob = data;
+    for (u32 i = 0; i < header->entry_count; i++) {
+        psocache_record record;
+        psocache_entry *entry;
+        usize stage_offset = sizeof(record);
+        bool valid;
+
+        if (size - offset < sizeof(record)) {
+            break;
+        }
+        xudk_memcpy(&record, cache->blob + offset, sizeof(record));
+        valid = record.size >= sizeof(record) && record.size <= size - offset && !(record.size & 7) &&
+                record.stage_count && record.stage_count <= PSOCACHE_MAX_STAGES && record.render_target_count <= 8;
+        for (u32 j = 0; valid && j < record.stage_count; j++) {
+            psocache_stage stage;
+
+            valid = record.size - stage_offset >= sizeof(stage);
+            if (valid) {
+                xudk_memcpy(&stage, cache->blob + offset + stage_offset, sizeof(stage));
+                valid = stage.size && stage.size <= record.size && stage.entry_length <= record.size &&
+                        stage_size(&stage) <= record.size - stage_offset;
+                stage_offset += valid ? stage_size(&stage) : 0;
+            }
+        }
+        if (!valid || find_key(cache, record.key) || !(entry = append_entry(ctx, cache))) {
+            break;
+        }
+        entry->key = record.key;
+        entry->is_compute = record.is_compute != 0;
+        entry->record = cache->blob + offset;
+        offset += record.size;
+    }
+}
+
+// Only pipelines handed out this boot are written, so retired screens do not pile up
+static status save_blob(xudk_ctx *ctx, psocache_state *cache) {
+    psocache_header *header;
+    usize size = sizeof(*header), offset = sizeof(*header), written;
+    handle file;
+    u8 *blob;
+    status s;
+
+    for (usize i = 0; i < cache->count; i++) {
+        const psocache_entry *entry = &cache->entries[i];
+        if (entry->used && entry->record) {
+            size += ((const psocache_record*)entry->record)->size;
+        }
+    }
+    if (size > PSOCACHE_MAX_BLOB) {
+        return XUDK_BUFFER_OVERFLOW;
+    }
+    blob = ctx->memory.alloc(ctx, size);
+    if (!blob) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(blob, 0, size);
+
+    header = (psocache_header*)blob;
+    header->magic = PSOCACHE_MAGIC;
+    header->version = PSOCACHE_VERSION;
+    for (usize i = 0; i < cache->count; i++) {
+        const psocache_entry *entry = &cache->entries[i];
+        u32 record_size;
+
+        if (!entry->used || !entry->record) {
+            continue;
+        }
+        record_size = ((const psocache_record*)entry->record)->size;
+        xudk_memcpy(blob + offset, entry->record, record_size);
+        offset += record_size;
+        header->entry_count++;
+    }
+    header->hash = xudk_hash64(blob + sizeof(*header), size - sizeof(*header));
+
+    s = ctx->filesystem.create_file(ctx, cache->path, &file);
+    if (xudk_ok(s)) {
+        s = ctx->filesystem.write_file(ctx, file, blob, size, &written);
+        if (xudk_ok(s) && written != size) {
+            s = XUDK_DEVICE_ERROR;
+        }
+        ctx->filesystem.close_file(ctx, file);
+    }
+    ctx->memory.free(ctx, blob);
+    return s;
+}
+
+// =============================================================================
+// OPEN, PREWARM & CLOSE
+// =============================================================================
+
+status xudk_gpu_pipeline_cache_open(xudk_ctx *ctx, const wchar *path) {
+    psocache_state *cache;
+
+    if (psocache_of(ctx)) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!ctx->gpu_initialized || !ctx->gpu.create_graphics_pipeline || !ctx->gpu.create_compute_pipeline ||
+        !ctx->gpu.destroy_pipeline) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    cache = ctx->memory.alloc(ctx, sizeof(*cache));
+    if (!cache) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(cache, 0, sizeof(*cache));
+    if (path) {
+        cache->path = xudk_strdup(ctx, path);
+        if (!cache->path) {
+            ctx->memory.free(ctx, cache);
+            return XUDK_OUT_OF_MEMORY;
+        }
+    }
+    cache->backend = ctx->gpu;
+    cache->persistent = path && ctx->gpu_device_info.supports_shader_cache && ctx->gpu.create_shader;
+    if (cache->persistent) {
+        load_blob(ctx, cache);
+    }
+
+    ctx->gpu_pipeline_cache = cache;
+    ctx->gpu.create_graphics_pipeline = cache_create_graphics_pipeline;
+    ctx->gpu.create_compute_pipeline = cache_create_compute_pipeline;
+    ctx->gpu.destroy_pipeline = cache_destroy_pipeline;
+    return XUDK_OK;
+}
+
+// Builds up to max_count queued pipelines (0 for all of them), so callers can
+// spread the work over idle frames. Records the backend rejects are dropped.
+status xudk_gpu_pipeline_cache_prewarm(xudk_ctx *ctx, u32 max_count, u32 *remaining) {
+    psocache_state *cache = psocache_of(ctx);
+    u32 built = 0, left = 0;
+
+    if (!cache) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (usize i = 0; i < cache->count; ) {
+        psocache_entry *entry = &cache->entries[i];
+
+        if (entry->pipeline || !entry->record) {
+            i++;
+            continue;
+        }
+        if (max_count && built == max_count) {
+            left++;
+            i++;
+            continue;
+        }
+        if (xudk_error(build_record(ctx, cache, entry->record, &entry->pipeline))) {
+            remove_entry(ctx, cache, entry);
+            continue;
+        }
+        built++;
+        i++;
+    }
+    if (remaining) {
+        *remaining = left;
+    }
+    return XUDK_OK;
+}
+
+// Every cached pipeline is released, including ones callers still hold
+status xudk_gpu_pipeline_cache_close(xudk_ctx *ctx) {
+    psocache_state *cache = psocache_of(ctx);
+    status s = XUDK_OK;
+
+    if (!cache) {
+        return XUDK_OK;
+    }
+    if (cache->persistent && cache->dirty) {
+        s = save_blob(ctx, cache);
+    }
+
+    ctx->gpu.create_graphics_pipeline = cache->backend.create_graphics_pipeline;
+    ctx->gpu.create_compute_pipeline = cache->backend.create_compute_pipeline;
+    ctx->gpu.destroy_pipeline = cache->backend.destroy_pipeline;
+    ctx->gpu_pipeline_cache = null;
+    for (usize i = 0; i < cache->count; i++) {
+        psocache_entry *entry = &cache->entries[i];
+
+        if (entry->pipeline) {
+            release_pipeline(ctx, cache, entry->pipeline);
+        }
+        if (entry->owned) {
+            ctx->memory.free(ctx, (void*)entry->record);
+        }
+    }
+    if (cache->entries) {
+        ctx->memory.free(ctx, cache->entries);
+    }
+    if (cache->blob) {
+        ctx->memory.free(ctx, cache->blob);
+    }
+    if (cache->path) {
+        ctx->memory.free(ctx, cache->path);
+    }
+    ctx->memory.free(ctx, cache);
+    return s;
+}
@@ -0,0 +1,421 @@
+/*
+ * XUDK - Persistent shader cache
+ * While open, compile_shader and load_shader_from_file look bytecode up by a
+ * hash of the source, entry point, shader type and device, and hand hits to
+ * the backend's create_shader instead of compiling. The cache lives in one
+ * blob on the ESP, read when it is opened and rewritten on close if anything
+ * was compiled. Backends whose bytecode does not survive a reboot still get
+ * reuse within the boot, but nothing is read from or written to the ESP.
+ */
+
+#include "core.h"
+
+#define SHCACHE_MAGIC       0x43485358u     // "XSHC"
+#define SHCACHE_VERSION     1
+#define SHCACHE_MAX_BLOB    (64u * 1024 * 1024)
+
+// Blob layout: this header, then per entry a record and its bytecode padded
+// to 8 bytes. `hash` covers everything after the header.
+typedef struct {
+    u32             magic;
+    u32             version;
+    u32             entry_count;
+    u32             reserved;
+    u64             hash;
+} shcache_header;
+
+typedef struct {
+    u64             key;
+    u32             type;
+    u32             size;
+} shcache_record;
+
+typedef struct {
+    u64             key;
+    u32             type;
+    u32             size;
+    const u8*       bytecode;
+    bool            owned;          // Copied this boot, rather than pointing into the blob
+    bool            used;           // Hit or added this boot
+} shcache_entry;
+
+typedef struct {
+    xudk_gpu        backend;        // Entries the cache replaced
+    wchar*          path;
+    bool            persistent;     // Backend bytecode is valid across boots
+    bool            dirty;
+    u8*             blob;
+    shcache_entry*  entries;
+    usize           count;
+    usize           capacity;
+} shcache_state;
+
+static shcache_state* shcache_of(xudk_ctx *ctx) {
+    return ctx->gpu_shader_cache;
+}
+
+static usize pad8(usize size) {
+    return (size + 7) & ~(usize)7;
+}
+
+// =============================================================================
+// ENTRIES
+// =============================================================================
+
+// Device and driver are part of the key, so a blob from other hardware just misses
+static u64 shader_key(xudk_ctx *ctx, xudk_shader_type type, const void *entry_point, usize entry_size,
+                      const void *source, usize size) {
+    const xudk_gpu_info *info = &ctx->gpu_device_info;
+    u32 fields[4] = { info->vendor_id, info->device_id, (u32)type, (u32)entry_size };
+    xudk_hash64_state state;
+
+    xudk_hash64_init(&state);
+    xudk_hash64_update(&state, fields, sizeof(fields));
+    if (info->driver_version) {
+        xudk_hash64_update(&state, info->driver_version, xudk_strlen(info->driver_version) * sizeof(wchar));
+    }
+    xudk_hash64_update(&state, entry_point, entry_size);
+    xudk_hash64_update(&state, source, size);
+    return xudk_hash64_final(&state);
+}
+
+static shcache_entry* find_entry(shcache_state *cache, u64 key, xudk_shader_type type) {
+    for (usize i = 0; i < cache->count; i++) {
+        if (cache->entries[i].key == key && cache->entries[i].type == (u32)type) {
+            return &cache->entries[i];
+        }
+    }
+    return null;
+}
+
+static shcache_entry* append_entry(xudk_ctx *ctx, shcache_state *cache) {
+    if (cache->count == cache->capacity) {
+        usize capacity = cache->capacity ? cache->capacity * 2 : 32;
+        shcache_entry *grown = ctx->memory.alloc(ctx, capacity * sizeof(*grown));
+        if (!grown) {
+            return null;
+        }
+        if (cache->entries) {
+            xudk_memcpy(grown, cache->entries, cache->count * sizeof(*grown));
+            ctx->memory.free(ctx, cache->entries);
+        }
+        cache->entries = grown;
+        cache->capacity = capacity;
+    }
+    return &cache->entries[cache->count++];
+}
+
+// Keep a copy of what the backend just compiled; failing to cache is not an error
+static void add_entry(xudk_ctx *ctx, shcache_state *cache, u64 key, xudk_shader_type type,
+                      const xudk_gpu_shader *shader) {
+    shcache_entry *entry;
+    u8 *bytecode;
+
+    if (!shader->bytecode || !shader->bytecode_size || find_entry(cache, key, type)) {
+        return;
+    }
+    bytecode = ctx->memory.alloc(ctx, shader->bytecode_size);
+    if (!bytecode) {
+        return;
+    }
+    entry = append_entry(ctx, cache);
+    if (!entry) {
+        ctx->memory.free(ctx, bytecode);
+        return;
+    }
+    xudk_memcpy(bytecode, shader->bytecode, shader->bytecode_size);
+    entry->key = key;
+    entry->type = (u32)type;
+    entry->size = shader->bytecode_size;
+    entry->bytecode = bytecode;
+    entry->owned = true;
+    entry->used = true;
+    cache->dirty = true;
+}
+
+// A hit the backend refuses (a driver update it cannot detect, say) is dropped
+// and the caller compiles as if it had missed
+static status create_from_entry(xudk_ctx *ctx, shcache_state *cache, shcache_entry *entry, xudk_shader_type type,
+                                const wchar *entry_point, xudk_gpu_shader *shader) {
+    status s = cache->backend.create_shader(ctx, type, entry->bytecode, entry->size, entry_point, shader);
+
+    if (xudk_ok(s)) {
+        entry->used = true;
+        return XUDK_OK;
+    }
+    if (entry->owned) {
+        ctx->memory.free(ctx, (void*)entry->bytecode);
+    }
+    *entry = cache->entries[--cache->count];
+    cache->dirty = true;
+    return s;
+}
+
+// =============================================================================
+// BLOB
+// =============================================================================
+
+// Any inconsistency throws the whole blob away; it is only a cache
+static void load_blob(xudk_ctx *ctx, shcache_state *cache) {
+    const shcache_header *header;
+    void *data;
+    usize size, offset = sizeof(shcache_header);
+
+    if (xudk_error(ctx->filesystem.load_file_to_memory(ctx, cache->path, &data, &size))) {
+        return;
+    }
+    header = data;
+    if (size < sizeof(*header) || size > SHCACHE_MAX_BLOB || header->magic != SHCACHE_MAGIC ||
+        header->version != SHCACHE_VERSION ||
+        header->hash != xudk_hash64((const u8*)data + sizeof(*header), size - sizeof(*header))) {
+        ctx->memory.free(ctx, data);
+        return;
+    }
+
+    cache->blob = data;
+    for (u32 i = 0; i < header->entry_count; i++) {
+        shcache_record record;
+        shcache_entry *entry;
+
+        if (size - offset < sizeof(record)) {
+            break;
+        }
+        xudk_memcpy(&record, cache->blob + offset, sizeof(record));
+        offset += sizeof(record);
+        if (!record.size || record.size > size - offset || !(entry = append_entry(ctx, cache))) {
+            break;
+        }
+        entry->key = record.key;
+        entry->type = record.type;
+        entry->size = record.size;
+        entry->bytecode = cache->blob + offset;
+        entry->owned = false;
+        entry->used = false;
+        offset += pad8(record.size) < size - offset ? pad8(record.size) : size - offset;
+    }
+}
+
+// Only entries used this boot are written, so edited shaders do not pile up
+static status save_blob(xudk_ctx *ctx, shcache_state *cache) {
+    shcache_header *header;
+    usize size = sizeof(*header), offset = sizeof(*header), written;
+    handle file;
+    u8 *blob;
+    status s;
+
+    for (usize i = 0; i < cache->count; i++) {
+        if (cache->entries[i].used) {
+            size += sizeof(shcache_record) + pad8(cache->entries[i].size);
+        }
+    }
+    if (size > SHCACHE_MAX_BLOB) {
+        return XUDK_BUFFER_OVERFLOW;
+    }
+    blob = ctx->memory.alloc(ctx, size);
+    if (!blob) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(blob, 0, size);
+
+    header = (shcache_header*)blob;
+    header->magic = SHCACHE_MAGIC;
+    header->version = SHCACHE_VERSION;
+    for (usize i = 0; i < cache->count; i++) {
+        const shcache_entry *entry = &cache->entries[i];
+        shcache_record record;
+
+        if (!entry->used) {
+            continue;
+        }
+        record.key = entry->key;
+        record.type = entry->type;
+        record.size = entry->size;
+        xudk_memcpy(blob + offset, &record, sizeof(record));
+        xudk_memcpy(blob + offset + sizeof(record), entry->bytecode, entry->size);
+        offset += sizeof(record) + pad8(entry->size);
+        header->entry_count++;
+    }
+    header->hash = xudk_hash64(blob + sizeof(*header), size - sizeof(*header));
+
+    s = ctx->filesystem.create_file(ctx, cache->path, &file);
+    if (xudk_ok(s)) {
+        s = ctx->filesystem.write_file(ctx, file, blob, size, &written);
+        if (xudk_ok(s) && written != size) {
+            s = XUDK_DEVICE_ERROR;
+        }
+        ctx->filesystem.close_file(ctx, file);
+    }
+    ctx->memory.free(ctx, blob);
+    return s;
+}
+
+// =============================================================================
+// GPU ENTRIES
+// =============================================================================
+
+static status cache_compile_shader(xudk_ctx *ctx, xudk_shader_type type, const char *source, const char *entry_point,
+                                   xudk_gpu_shader *shader) {
+    shcache_state *cache = shcache_of(ctx);
+    usize source_size = 0, entry_size = 0;
+    wchar *entry_name = null;
+    shcache_entry *entry;
+    status s;
+    u64 key;
+
+    if (!source || !shader) {
+        return cache->backend.compile_shader(ctx, type, source, entry_point, shader);
+    }
+    while (source[source_size]) {
+        source_size++;
+    }
+    while (entry_point && entry_point[entry_size]) {
+        entry_size++;
+    }
+    key = shader_key(ctx, type, entry_point, entry_size, source, source_size);
+
+    entry = find_entry(cache, key, type);
+    if (entry) {
+        if (entry_point) {
+            entry_name = ctx->memory.alloc(ctx, (entry_size + 1) * sizeof(wchar));
+            if (!entry_name) {
+                return XUDK_OUT_OF_MEMORY;
+            }
+            xudk_ascii_to_unicode(entry_point, entry_name);
+        }
+        s = create_from_entry(ctx, cache, entry, type, entry_name, shader);
+        if (entry_name) {
+            ctx->memory.free(ctx, entry_name);
+        }
+        if (xudk_ok(s)) {
+            return XUDK_OK;
+        }
+    }
+    s = cache->backend.compile_shader(ctx, type, source, entry_point, shader);
+    if (xudk_ok(s)) {
+        add_entry(ctx, cache, key, type, shader);
+    }
+    return s;
+}
+
+// The file holds shader source, as it does for the backend's own
+// load_shader_from_file, so a miss compiles the bytes already read
+static status compile_loaded_source(xudk_ctx *ctx, shcache_state *cache, xudk_shader_type type, const void *data,
+                                    usize size, const wchar *entry_point, xudk_gpu_shader *shader) {
+    char *source, *entry_name = null;
+    status s;
+
+    source = ctx->memory.alloc(ctx, size + 1);
+    if (!source) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memcpy(source, data, size);
+    source[size] = 0;
+    if (entry_point) {
+        entry_name = ctx->memory.alloc(ctx, xudk_strlen(entry_point) + 1);
+        if (!entry_name) {
+            ctx->memory.free(ctx, source);
+            return XUDK_OUT_OF_MEMORY;
+        }
+        xudk_unicode_to_ascii(entry_point, entry_name);
+    }
+    s = cache->backend.compile_shader(ctx, type, source, entry_name, shader);
+    if (entry_name) {
+        ctx->memory.free(ctx, entry_name);
+    }
+    ctx->memory.free(ctx, source);
+    return s;
+}
+
+// Keyed by the file's contents, not its path, so replacing the file is a miss
+static status cache_load_shader_from_file(xudk_ctx *ctx, const wchar *path, xudk_shader_type type,
+                                          const wchar *entry_point, xudk_gpu_shader *shader) {
+    shcache_state *cache = shcache_of(ctx);
+    shcache_entry *entry;
+    void *data;
+    usize size;
+    status s;
+    u64 key;
+
+    if (!path || !shader || xudk_error(ctx->filesystem.load_file_to_memory(ctx, path, &data, &size))) {
+        return cache->backend.load_shader_from_file(ctx, path, type, entry_point, shader);
+    }
+    key = shader_key(ctx, type, entry_point, entry_point ? xudk_strlen(entry_point) * sizeof(wchar) : 0, data, size);
+
+    entry = find_entry(cache, key, type);
+    if (entry && xudk_ok(create_from_entry(ctx, cache, entry, type, entry_point, shader))) {
+        ctx->memory.free(ctx, data);
+        return XUDK_OK;
+    }
+    s = compile_loaded_source(ctx, cache, type, data, size, entry_point, shader);
+    ctx->memory.free(ctx, data);
+    if (xudk_ok(s)) {
+        add_entry(ctx, cache, key, type, shader);
+    }
+    return s;
+}
+
+// =============================================================================
+// OPEN & CLOSE
+// =============================================================================
+
+status xudk_gpu_shader_cache_open(xudk_ctx *ctx, const wchar *path) {
+    shcache_state *cache;
+
+    if (!path || shcache_of(ctx)) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!ctx->gpu_initialized || !ctx->gpu.create_shader || !ctx->gpu.compile_shader ||
+        !ctx->gpu.load_shader_from_file) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    cache = ctx->memory.alloc(ctx, sizeof(*cache));
+    if (!cache) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(cache, 0, sizeof(*cache));
+    cache->path = xudk_strdup(ctx, path);
+    if (!cache->path) {
+        ctx->memory.free(ctx, cache);
+        return XUDK_OUT_OF_MEMORY;
+    }
+    cache->backend = ctx->gpu;
+    cache->persistent = ctx->gpu_device_info.supports_shader_cache;
+    if (cache->persistent) {
+        load_blob(ctx, cache);
+    }
+
+    ctx->gpu_shader_cache = cache;
+    ctx->gpu.compile_shader = cache_compile_shader;
+    ctx->gpu.load_shader_from_file = cache_load_shader_from_file;
+    return XUDK_OK;
+}
+
+status xudk_gpu_shader_cache_close(xudk_ctx *ctx) {
+    shcache_state *cache = shcache_of(ctx);
+    status s = XUDK_OK;
+
+    if (!cache) {
+        return XUDK_OK;
+    }
+    if (cache->persistent && cache->dirty) {
+        s = save_blob(ctx, cache);
+    }
+
+    ctx->gpu.compile_shader = cache->backend.compile_shader;
+    ctx->gpu.load_shader_from_file = cache->backend.load_shader_from_file;
+    ctx->gpu_shader_cache = null;
+    for (usize i = 0; i < cache->count; i++) {
+        if (cache->entries[i].owned) {
+            ctx->memory.free(ctx, (void*)cache->entries[i].bytecode);
+        }
+    }
+    if (cache->entries) {
+        ctx->memory.free(ctx, cache->entries);
+    }
+    if (cache->blob) {
+        ctx->memory.free(ctx, cache->blob);
+    }
+    ctx->memory.free(ctx, cache->path);
+    ctx->memory.free(ctx, cache);
+    return s;
+}
@@ -0,0 +1,446 @@
+/*
+ * XUDK - Size-class slab allocator
+ * Sits in front of the backend's memory.alloc/free. Small requests are served
+ * from 64 KiB spans carved into one size class each, through a per-class
+ * magazine of free objects; anything above the largest class goes straight to
+ * page allocation. Spans and large blocks are found again on free through an
+ * open-addressing table keyed by address, so alloc and free stay O(1) and the
+ * backend is only called once per span instead of once per string.
+ */
+
+#include "core.h"
+
+#define SLAB_SPAN_SIZE          (64 * 1024)
+#define SLAB_SPAN_MASK          ((usize)SLAB_SPAN_SIZE - 1)
+#define SLAB_HEADER_SIZE        64
+#define SLAB_MAX_SIZE           2048
+#define SLAB_MAGAZINE           32
+#define SLAB_REFILL             (SLAB_MAGAZINE / 2)
+#define SLAB_TABLE_MIN          256
+#define SLAB_EMPTY_SPANS        8       // Empty spans kept for any class before going back to the backend
+
+static const u32 slab_class_sizes[XUDK_MEM_SIZE_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+
+// Class index for every 16-byte step up to SLAB_MAX_SIZE
+static u8 slab_class_of[SLAB_MAX_SIZE / 16 + 1];
+
+typedef struct slab_span slab_span;
+struct slab_span {
+    slab_span*      next;           // Partial list of the class
+    slab_span*      prev;
+    void*           free;           // Returned objects
+    u8*             bump;           // Start of the never-used tail
+    u32             in_use;         // Objects out of the span, magazines included
+    u32             capacity;
+    u32             size_class;
+};
+
+typedef struct {
+    u32             size;
+    u32             cached;         // Objects in magazine
+    void*           magazine[SLAB_MAGAZINE];
+    slab_span*      partial;        // Spans with free objects
+    u64             in_use;         // Objects held by callers
+    u32             spans;
+} slab_class;
+
+#define SLAB_ENTRY_SPAN         1
+#define SLAB_ENTRY_LARGE        2
+
+typedef struct {
+    usize           key;            // Span base or large block address, 0 = empty
+    usize           size;
+    u32             kind;
+    u32             size_class;     // Spans only, so free never reads the span header
+} slab_entry;
+
+typedef struct {
+    // Backend functions the slab allocator replaced
+    void*           (*alloc)(xudk_ctx *ctx, usize size);
+    void            (*free)(xudk_ctx *ctx, void *ptr);
+
+    slab_class      classes[XUDK_MEM_SIZE_CLASSES];
+    slab_span*      empty;          // Cached empty spans, linked through next
+    u32             empty_count;
+    slab_entry*     table;
+    usize           table_mask;
+    usize           table_count;
+
+    u64             large_count;
+    u64             large_bytes;
+    u64             backend_calls;
+} slab_heap;
+
+// =============================================================================
+// ADDRESS TABLE
+// =============================================================================
+
+static usize slab_hash(usize key, usize mask) {
+    return (usize)(((u64)key >> 12) * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+}
+
+static slab_entry* slab_find(slab_heap *heap, usize key) {
+    usize i = slab_hash(key, heap->table_mask);
+
+    while (heap->table[i].key) {
+        if (heap->table[i].key == key) {
+            return &heap->table[i];
+        }
+        i = (i + 1) & heap->table_mask;
+    }
+    return null;
+}
+
+static void slab_place(slab_entry *table, usize mask, const slab_entry *entry) {
+    usize i = slab_hash(entry->key, mask);
+
+    while (table[i].key) {
+        i = (i + 1) & mask;
+    }
+    table[i] = *entry;
+}
+
+static bool slab_insert(xudk_ctx *ctx, slab_heap *heap, usize key, usize size, u32 kind) {
+    slab_entry entry;
+
+    // Keep the load factor under one half
+    if ((heap->table_count + 1) * 2 > heap->table_mask + 1) {
+        usize capacity = (heap->table_mask + 1) * 2;
+        slab_entry *table = heap->alloc(ctx, capacity * sizeof(slab_entry));
+        if (!table) {
+            return false;
+        }
+        xudk_memset(table, 0, capacity * sizeof(slab_entry));
+        for (usize i = 0; i <= heap->table_mask; i++) {
+            if (heap->table[i].key) {
+                slab_place(table, capacity - 1, &heap->table[i]);
+            }
+        }
+        heap->free(ctx, heap->table);
+        heap->table = table;
+        heap->table_mask = capacity - 1;
+    }
+    entry.key = key;
+    entry.size = size;
+    entry.kind = kind;
+    entry.size_class = 0;
+    slab_place(heap->table, heap->table_mask, &entry);
+    heap->table_count++;
+    return true;
+}
+
+// Backward-shift deletion, so lookups never need tombstones
+static void slab_remove(slab_heap *heap, slab_entry *entry) {
+    usize mask = heap->table_mask;
+    usize hole = (usize)(entry - heap->table);
+    usize i = hole;
+
+    for (;;) {
+        usize home;
+        i = (i + 1) & mask;
+        if (!heap->table[i].key) {
+            break;
+        }
+        home = slab_hash(heap->table[i].key, mask);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            heap->table[hole] = heap->table[i];
+            hole = i;
+        }
+    }
+    heap->table[hole].key = 0;
+    heap->table_count--;
+}
+
+// =============================================================================
+// SPANS
+// =============================================================================
+
+static void span_link(slab_class *cls, slab_span *span) {
+    span->prev = null;
+    span->next = cls->partial;
+    if (cls->partial) {
+        cls->partial->prev = span;
+    }
+    cls->partial = span;
+}
+
+static void span_unlink(slab_class *cls, slab_span *span) {
+    if (span->prev) {
+        span->prev->next = span->next;
+    } else {
+        cls->partial = span->next;
+    }
+    if (span->next) {
+        span->next->prev = span->prev;
+    }
+    span->next = span->prev = null;
+}
+
+static slab_span* span_create(xudk_ctx *ctx, slab_heap *heap, u32 size_class) {
+    slab_class *cls = &heap->classes[size_class];
+    slab_span *span;
+
+    if (heap->empty) {
+        span = heap->empty;
+        heap->empty = span->next;
+        heap->empty_count--;
+    } else {
+        span = ctx->memory.alloc_aligned(ctx, SLAB_SPAN_SIZE, SLAB_SPAN_SIZE);
+        heap->backend_calls++;
+        if (!span) {
+            return null;
+        }
+        if (!slab_insert(ctx, heap, (usize)span, SLAB_SPAN_SIZE, SLAB_ENTRY_SPAN)) {
+            heap->free(ctx, span);
+            return null;
+        }
+    }
+    span->free = null;
+    span->bump = (u8*)span + SLAB_HEADER_SIZE;
+    span->in_use = 0;
+    span->capacity = (SLAB_SPAN_SIZE - SLAB_HEADER_SIZE) / cls->size;
+    span->size_class = size_class;
+    slab_find(heap, (usize)span)->size_class = size_class;
+    span_link(cls, span);
+    cls->spans++;
+    return span;
+}
+
+// Park an empty span for reuse by any class, or hand it back once enough are parked
+static void span_release(xudk_ctx *ctx, slab_heap *heap, slab_span *span) {
+    slab_class *cls = &heap->classes[span->size_class];
+
+    span_unlink(cls, span);
+    cls->spans--;
+    if (heap->empty_count < SLAB_EMPTY_SPANS) {
+        span->next = heap->empty;
+        heap->empty = span;
+        heap->empty_count++;
+        return;
+    }
+    slab_remove(heap, slab_find(heap, (usize)span));
+    heap->free(ctx, span);
+    heap->backend_calls++;
+}
+
+static bool span_exhausted(const slab_span *span, u32 size) {
+    return !span->free && span->bump + size > (u8*)span + SLAB_SPAN_SIZE;
+}
+
+// Move up to SLAB_REFILL objects from the partial spans into the magazine
+static void slab_refill(xudk_ctx *ctx, slab_heap *heap, u32 size_class) {
+    slab_class *cls = &heap->classes[size_class];
+
+    while (cls->cached < SLAB_REFILL) {
+        slab_span *span = cls->partial;
+        u8 *end;
+
+        if (!span && !(span = span_create(ctx, heap, size_class))) {
+            return;
+        }
+        while (span->free && cls->cached < SLAB_REFILL) {
+            void *obj = span->free;
+            span->free = *(void**)obj;
+            cls->magazine[cls->cached++] = obj;
+            span->in_use++;
+        }
+        end = (u8*)span + SLAB_SPAN_SIZE - cls->size;
+        while (span->bump <= end && cls->cached < SLAB_REFILL) {
+            cls->magazine[cls->cached++] = span->bump;
+            span->bump += cls->size;
+            span->in_use++;
+        }
+        if (span_exhausted(span, cls->size)) {
+            span_unlink(cls, span);
+        }
+    }
+}
+
+// Give the oldest half of a full magazine back to its spans; a span that
+// empties is released unless it is the last one the class has
+static void slab_flush(xudk_ctx *ctx, slab_heap *heap, u32 size_class) {
+    slab_class *cls = &heap->classes[size_class];
+
+    for (u32 i = 0; i < SLAB_REFILL; i++) {
+        void *obj = cls->magazine[i];
+        slab_span *span = (slab_span*)((usize)obj & ~SLAB_SPAN_MASK);
+
+        if (span_exhausted(span, cls->size)) {
+            span_link(cls, span);
+        }
+        *(void**)obj = span->free;
+        span->free = obj;
+        if (--span->in_use == 0 && (span->prev || span->next)) {
+            span_release(ctx, heap, span);
+        }
+    }
+    cls->cached -= SLAB_REFILL;
+    for (u32 i = 0; i < cls->cached; i++) {
+        cls->magazine[i] = cls->magazine[i + SLAB_REFILL];
+    }
+}
+
+// =============================================================================
+// ALLOCATOR
+// =============================================================================
+
+static slab_heap* slab_of(xudk_ctx *ctx) {
+    return ctx->memory_heap;
+}
+
+static void* slab_alloc(xudk_ctx *ctx, usize size) {
+    slab_heap *heap = slab_of(ctx);
+    slab_class *cls;
+    u32 size_class;
+    void *ptr;
+
+    if (size > SLAB_MAX_SIZE) {
+        size = (usize)xudk_align_up(size, 4096);
+        ptr = ctx->memory.alloc_type(ctx, size, XUDK_MEM_LOADER_DATA);
+        heap->backend_calls++;
+        if (!ptr) {
+            return null;
+        }
+        if (!slab_insert(ctx, heap, (usize)ptr, size, SLAB_ENTRY_LARGE)) {
+            heap->free(ctx, ptr);
+            return null;
+        }
+        heap->large_count++;
+        heap->large_bytes += size;
+        return ptr;
+    }
+
+    size_class = slab_class_of[(size + 15) >> 4];
+    cls = &heap->classes[size_class];
+    if (!cls->cached) {
+        slab_refill(ctx, heap, size_class);
+        if (!cls->cached) {
+            return null;
+        }
+    }
+    cls->in_use++;
+    return cls->magazine[--cls->cached];
+}
+
+static void slab_free(xudk_ctx *ctx, void *ptr) {
+    slab_heap *heap = slab_of(ctx);
+    slab_entry *entry;
+
+    if (!ptr) {
+        return;
+    }
+    entry = slab_find(heap, (usize)ptr & ~SLAB_SPAN_MASK);
+    if (entry && entry->kind == SLAB_ENTRY_SPAN) {
+        u32 size_class = entry->size_class;
+        slab_class *cls = &heap->classes[size_class];
+
+        if (cls->cached == SLAB_MAGAZINE) {
+            slab_flush(ctx, heap, size_class);
+        }
+        cls->magazine[cls->cached++] = ptr;
+        cls->in_use--;
+        return;
+    }
+
+    if (!entry || entry->key != (usize)ptr) {
+        entry = slab_find(heap, (usize)ptr);
+    }
+    if (entry) {
+        heap->large_count--;
+        heap->large_bytes -= entry->size;
+        slab_remove(heap, entry);
+    }
+    // Large blocks and anything from alloc_aligned/alloc_type
+    heap->free(ctx, ptr);
+    heap->backend_calls++;
+}
+
+static void slab_get_stats(xudk_ctx *ctx, xudk_mem_stats *stats) {
+    slab_heap *heap = slab_of(ctx);
+    u64 reserved;
+
+    xudk_memset(stats, 0, sizeof(*stats));
+    stats->large_count = heap->large_count;
+    stats->large_bytes = heap->large_bytes;
+    stats->backend_calls = heap->backend_calls;
+    stats->bytes_in_use = heap->large_bytes;
+    stats->bytes_reserved = heap->large_bytes + (u64)heap->empty_count * SLAB_SPAN_SIZE;
+    stats->empty_spans = heap->empty_count;
+
+    for (u32 c = 0; c < XUDK_MEM_SIZE_CLASSES; c++) {
+        slab_class *cls = &heap->classes[c];
+        xudk_mem_class_stats *out = &stats->classes[c];
+        u64 capacity = (u64)cls->spans * ((SLAB_SPAN_SIZE - SLAB_HEADER_SIZE) / cls->size);
+
+        out->size = cls->size;
+        out->spans = cls->spans;
+        out->in_use = cls->in_use;
+        out->cached = cls->cached;
+        out->free = capacity - cls->in_use - cls->cached;
+        stats->bytes_in_use += cls->in_use * cls->size;
+        stats->bytes_reserved += (u64)cls->spans * SLAB_SPAN_SIZE;
+    }
+
+    reserved = stats->bytes_reserved;
+    stats->fragmentation = reserved ? (u32)((reserved - stats->bytes_in_use) * 100 / reserved) : 0;
+}
+
+status xudk_slab_install(xudk_ctx *ctx) {
+    slab_heap *heap;
+
+    if (ctx->memory_heap) {
+        return XUDK_OK;
+    }
+    for (u32 c = 0, i = 0; i <= SLAB_MAX_SIZE / 16; i++) {
+        while (slab_class_sizes[c] < i * 16) {
+            c++;
+        }
+        slab_class_of[i] = (u8)c;
+    }
+
+    heap = ctx->memory.alloc(ctx, sizeof(*heap));
+    if (!heap) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(heap, 0, sizeof(*heap));
+    heap->table = ctx->memory.alloc(ctx, SLAB_TABLE_MIN * sizeof(slab_entry));
+    if (!heap->table) {
+        ctx->memory.free(ctx, heap);
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(heap->table, 0, SLAB_TABLE_MIN * sizeof(slab_entry));
+    heap->table_mask = SLAB_TABLE_MIN - 1;
+    for (u32 c = 0; c < XUDK_MEM_SIZE_CLASSES; c++) {
+        heap->classes[c].size = slab_class_sizes[c];
+    }
+
+    heap->alloc = ctx->memory.alloc;
+    heap->free = ctx->memory.free;
+    ctx->memory_heap = heap;
+    ctx->memory.alloc = slab_alloc;
+    ctx->memory.free = slab_free;
+    ctx->memory.get_stats = slab_get_stats;
+    return XUDK_OK;
+}
+
+void xudk_slab_shutdown(xudk_ctx *ctx) {
+    slab_heap *heap = slab_of(ctx);
+
+    if (!heap) {
+        return;
+    }
+    // Spans and large blocks still live are leaks; take them back anyway
+    for (usize i = 0; i <= heap->table_mask; i++) {
+        if (heap->table[i].key) {
+            heap->free(ctx, (void*)heap->table[i].key);
+        }
+    }
+    ctx->memory.alloc = heap->alloc;
+    ctx->memory.free = heap->free;
+    ctx->memory.get_stats = null;
+    ctx->memory_heap = null;
+    heap->free(ctx, heap->table);
+    heap->free(ctx, heap);
+}
@@ -0,0 +1,275 @@
+/*
+ * XUDK - 32-bit pixel surfaces
+ * Clipped drawing shared by the framebuffer backends and the compositor's
+ * back buffer, so both render the same pixels.
+ */
+
+#include "core.h"
+
+static u32* surface_row(const xudk_surface *surface, u32 y) {
+    return surface->pixels + (usize)y * surface->stride;
+}
+
+status xudk_surface_pixel(const xudk_surface *surface, u32 x, u32 y, u32 color) {
+    if (x >= surface->width || y >= surface->height) {
+        return XUDK_INVALID_PARAM;
+    }
+    surface_row(surface, y)[x] = xudk_color_to_pixel(color, surface->pixel_format);
+    return XUDK_OK;
+}
+
+status xudk_surface_fill(const xudk_surface *surface, u32 x, u32 y, u32 width, u32 height, u32 color) {
+    u32 pixel = xudk_color_to_pixel(color, surface->pixel_format);
+    u32 *row;
+
+    if (x >= surface->width || y >= surface->height) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (width > surface->width - x) {
+        width = surface->width - x;
+    }
+    if (height > surface->height - y) {
+        height = surface->height - y;
+    }
+
+    row = surface_row(surface, y) + x;
+    for (u32 j = 0; j < height; j++, row += surface->stride) {
+        xudk_pixel_kernels()->fill(row, pixel, width);
+    }
+    return XUDK_OK;
+}
+
+// =============================================================================
+// BATCHES
+// =============================================================================
+
+static void fill_row(const xudk_pixel_impl *kernels, u32 *row, u32 pixel, usize count) {
+    u32 alpha = pixel >> 24;
+
+    if (alpha == 0xFF) {
+        kernels->fill(row, pixel, count);
+    } else if (alpha) {
+        kernels->blend(row, pixel, alpha, count);
+    }
+}
+
+status xudk_surface_fill_spans(const xudk_surface *surface, const xudk_span *spans, usize count) {
+    const xudk_pixel_impl *kernels = xudk_pixel_kernels();
+
+    if (!spans && count) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (usize n = 0; n < count; n++) {
+        const xudk_span *span = &spans[n];
+        u32 length = span->length;
+
+        if (span->x >= surface->width || span->y >= surface->height) {
+            continue;
+        }
+        if (length > surface->width - span->x) {
+            length = surface->width - span->x;
+        }
+        fill_row(kernels, surface_row(surface, span->y) + span->x,
+                 xudk_color_to_pixel(span->color, surface->pixel_format), length);
+    }
+    return XUDK_OK;
+}
+
+status xudk_surface_fill_rects(const xudk_surface *surface, const xudk_fill_rect *rects, usize count) {
+    const xudk_pixel_impl *kernels = xudk_pixel_kernels();
+
+    if (!rects && count) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (usize n = 0; n < count; n++) {
+        const xudk_fill_rect *rect = &rects[n];
+        u32 pixel = xudk_color_to_pixel(rect->color, surface->pixel_format);
+        u32 width = rect->width, height = rect->height;
+        u32 *row;
+
+        if (rect->x >= surface->width || rect->y >= surface->height) {
+            continue;
+        }
+        if (width > surface->width - rect->x) {
+            width = surface->width - rect->x;
+        }
+        if (height > surface->height - rect->y) {
+            height = surface->height - rect->y;
+        }
+        row = surface_row(surface, rect->y) + rect->x;
+        for (u32 j = 0; j < height; j++, row += surface->stride) {
+            fill_row(kernels, row, pixel, width);
+        }
+    }
+    return XUDK_OK;
+}
+
+// Points land anywhere, so they are blended one at a time without the kernels
+status xudk_surface_plot_points(const xudk_surface *surface, const xudk_point *points, usize count) {
+    if (!points && count) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (usize n = 0; n < count; n++) {
+        const xudk_point *point = &points[n];
+        u32 pixel, alpha, *dst;
+
+        if (point->x >= surface->width || point->y >= surface->height) {
+            continue;
+        }
+        pixel = xudk_color_to_pixel(point->color, surface->pixel_format);
+        alpha = pixel >> 24;
+        dst = surface_row(surface, point->y) + point->x;
+        if (alpha == 0xFF) {
+            *dst = pixel;
+        } else if (alpha) {
+            *dst = xudk_pixel_blend(*dst, pixel, alpha);
+        }
+    }
+    return XUDK_OK;
+}
+
+// =============================================================================
+// TEXT
+// =============================================================================
+
+// Blit one glyph's coverage from the atlas. Hard-edged fonts only hold 0 and
+// 0xFF, so an opaque color is a branch-free masked store.
+static void blit_glyph(const xudk_surface *surface, const xudk_font *font, const xudk_glyph *glyph,
+                       u64 x, u64 y, u32 pixel, u32 alpha) {
+    const u8 *src = font->atlas + (usize)glyph->atlas_y * font->atlas_width + glyph->atlas_x;
+    u32 width = glyph->width, height = glyph->height;
+    u32 *dst;
+
+    x += glyph->left;
+    y += glyph->top;
+    if (x >= surface->width || y >= surface->height) {
+        return;
+    }
+    if (width > surface->width - x) {
+        width = surface->width - (u32)x;
+    }
+    if (height > surface->height - y) {
+        height = surface->height - (u32)y;
+    }
+
+    dst = surface_row(surface, (u32)y) + x;
+    if (alpha == 0xFF && !(font->flags & XUDK_FONT_SMOOTH)) {
+        for (u32 j = 0; j < height; j++, src += font->atlas_width, dst += surface->stride) {
+            for (u32 i = 0; i < width; i++) {
+                u32 mask = src[i] * 0x01010101u;
+                dst[i] = (dst[i] & ~mask) | (pixel & mask);
+            }
+        }
+        return;
+    }
+    for (u32 j = 0; j < height; j++, src += font->atlas_width, dst += surface->stride) {
+        for (u32 i = 0; i < width; i++) {
+            u32 a = src[i];
+            if (!a) {
+                continue;
+            }
+            if (alpha != 0xFF) {
+                a = (a * alpha + 127) / 255;
+            }
+            dst[i] = a == 0xFF ? pixel : xudk_pixel_blend(dst[i], pixel, a);
+        }
+    }
+}
+
+static void text_run(const xudk_surface *surface, const xudk_font *font, const xudk_text_run *run) {
+    u32 pixel = xudk_color_to_pixel(run->color, surface->pixel_format);
+    u32 alpha = pixel >> 24;
+    u64 pen_x = run->x, pen_y = run->y;
+
+    if (!alpha || !run->text) {
+        return;
+    }
+    for (const wchar *text = run->text; *text; text++) {
+        const xudk_glyph *glyph;
+
+        if (*text == L'\n') {
+            pen_x = run->x;
+            pen_y += font->line;
+            if (pen_y >= surface->height) {
+                break;
+            }
+            continue;
+        }
+        glyph = xudk_font_lookup(font, *text);
+        if (glyph->width && pen_x < surface->width) {
+            blit_glyph(surface, font, glyph, pen_x, pen_y, pixel, alpha);
+        }
+        pen_x += font->advance;
+    }
+}
+
+status xudk_surface_text_runs(const xudk_surface *surface, const xudk_font *font,
+                              const xudk_text_run *runs, usize count) {
+    if (!runs && count) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!font) {
+        font = xudk_font_builtin();
+    }
+    for (usize n = 0; n < count; n++) {
+        text_run(surface, font, &runs[n]);
+    }
+    return XUDK_OK;
+}
+
+status xudk_surface_text(const xudk_surface *surface, u32 x, u32 y, const wchar *text, u32 color) {
+    xudk_text_run run;
+
+    if (!text) {
+        return XUDK_INVALID_PARAM;
+    }
+    run.x = x;
+    run.y = y;
+    run.text = text;
+    run.color = color | 0xFF000000u;
+    text_run(surface, xudk_font_builtin(), &run);
+    return XUDK_OK;
+}
+
+status xudk_surface_copy(const xudk_surface *surface, const u32 *src, u32 x, u32 y, u32 width, u32 height) {
+    u32 *dst;
+    u32 copy_width;
+
+    if (!src || x >= surface->width || y >= surface->height) {
+        return XUDK_INVALID_PARAM;
+    }
+    copy_width = width < surface->width - x ? width : surface->width - x;
+    if (height > surface->height - y) {
+        height = surface->height - y;
+    }
+
+    dst = surface_row(surface, y) + x;
+    for (u32 j = 0; j < height; j++) {
+        xudk_memcpy(dst, src, copy_width * sizeof(u32));
+        dst += surface->stride;
+        src += width;
+    }
+    return XUDK_OK;
+}
+
+status xudk_surface_load_image(xudk_ctx *ctx, const xudk_surface *surface, const wchar *path,
+                               u32 x, u32 y, u32 *drawn_width, u32 *drawn_height) {
+    xudk_image *image;
+    xudk_image_info info;
+    status s;
+
+    s = xudk_image_open(ctx, path, &image, &info);
+    if (xudk_error(s)) {
+        return s;
+    }
+    // Reported even when decoding fails part way, since earlier rows are already drawn
+    if (drawn_width) {
+        *drawn_width = x < surface->width ? (info.width < surface->width - x ? info.width : surface->width - x) : 0;
+    }
+    if (drawn_height) {
+        *drawn_height = y < surface->height ? (info.height < surface->height - y ? info.height : surface->height - y) : 0;
+    }
+    s = xudk_image_decode(image, surface, x, y, XUDK_IMAGE_BLEND);
+    xudk_image_close(image);
+    return s;
+}
@@ -0,0 +1,215 @@
+/*
+ * XUDK - Tracked allocations
+ * Every xudk_memalloc_tracked() block is recorded in an open-addressing table
+ * keyed by pointer, with its size, call-site tag and allocation time, so
+ * freeing or checking a tracked pointer is O(1) and usage can be attributed.
+ */
+
+#include "core.h"
+
+#define TRACK_TABLE_MIN     64
+#define TRACK_REPORT_TAGS   64      // Distinct call sites the report can tell apart
+
+static usize track_hash(const void *ptr, usize mask) {
+    return (usize)(((u64)(usize)ptr >> 4) * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+}
+
+static xudk_alloc_record* track_find(xudk_ctx *ctx, const void *ptr) {
+    usize mask = ctx->pool_capacity - 1;
+    usize i;
+
+    if (!ctx->allocated_pools || !ptr) {
+        return null;
+    }
+    for (i = track_hash(ptr, mask); ctx->allocated_pools[i].ptr; i = (i + 1) & mask) {
+        if (ctx->allocated_pools[i].ptr == ptr) {
+            return &ctx->allocated_pools[i];
+        }
+    }
+    return null;
+}
+
+static void track_place(xudk_alloc_record *table, usize mask, const xudk_alloc_record *record) {
+    usize i = track_hash(record->ptr, mask);
+
+    while (table[i].ptr) {
+        i = (i + 1) & mask;
+    }
+    table[i] = *record;
+}
+
+// Double the table once it is half full
+static bool track_reserve(xudk_ctx *ctx) {
+    usize capacity;
+    xudk_alloc_record *table;
+
+    if ((ctx->pool_count + 1) * 2 <= ctx->pool_capacity) {
+        return true;
+    }
+    capacity = ctx->pool_capacity ? ctx->pool_capacity * 2 : TRACK_TABLE_MIN;
+    table = ctx->memory.alloc(ctx, capacity * sizeof(xudk_alloc_record));
+    if (!table) {
+        return false;
+    }
+    xudk_memset(table, 0, capacity * sizeof(xudk_alloc_record));
+    for (usize i = 0; i < ctx->pool_capacity; i++) {
+        if (ctx->allocated_pools[i].ptr) {
+            track_place(table, capacity - 1, &ctx->allocated_pools[i]);
+        }
+    }
+    if (ctx->allocated_pools) {
+        ctx->memory.free(ctx, ctx->allocated_pools);
+    }
+    ctx->allocated_pools = table;
+    ctx->pool_capacity = capacity;
+    return true;
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+static void track_remove(xudk_ctx *ctx, xudk_alloc_record *record) {
+    xudk_alloc_record *table = ctx->allocated_pools;
+    usize mask = ctx->pool_capacity - 1;
+    usize hole = (usize)(record - table);
+    usize i = hole;
+
+    ctx->pool_bytes -= record->size;
+    for (;;) {
+        usize home;
+        i = (i + 1) & mask;
+        if (!table[i].ptr) {
+            break;
+        }
+        home = track_hash(table[i].ptr, mask);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            table[hole] = table[i];
+            hole = i;
+        }
+    }
+    table[hole].ptr = null;
+    ctx->pool_count--;
+}
+
+void* xudk_memalloc_tagged(xudk_ctx *ctx, usize size, const char *tag) {
+    xudk_alloc_record record;
+
+    if (!track_reserve(ctx)) {
+        return null;
+    }
+    record.ptr = ctx->memory.alloc(ctx, size);
+    if (!record.ptr) {
+        return null;
+    }
+    record.size = size;
+    record.tag = tag ? tag : "?";
+    record.timestamp = xudk_cpu_cycles();
+    track_place(ctx->allocated_pools, ctx->pool_capacity - 1, &record);
+    ctx->pool_count++;
+    ctx->pool_bytes += size;
+    if (ctx->pool_bytes > ctx->pool_peak) {
+        ctx->pool_peak = ctx->pool_bytes;
+    }
+    return record.ptr;
+}
+
+void xudk_memfree_tracked(xudk_ctx *ctx, void *ptr) {
+    xudk_alloc_record *record = track_find(ctx, ptr);
+
+    if (record) {
+        track_remove(ctx, record);
+        ctx->memory.free(ctx, ptr);
+    }
+}
+
+bool xudk_is_tracked(xudk_ctx *ctx, const void *ptr) {
+    return track_find(ctx, ptr) != null;
+}
+
+// =============================================================================
+// USAGE REPORT
+// =============================================================================
+
+typedef struct {
+    const char*     tag;
+    usize           bytes;
+    usize           count;
+} track_site;
+
+static bool tag_equal(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+void xudk_memory_report(xudk_ctx *ctx, u32 top) {
+    track_site sites[TRACK_REPORT_TAGS];
+    usize site_count = 0, other_bytes = 0, other_count = 0;
+
+    xudk_log_info(ctx, L"Tracked memory: %llu bytes in %llu blocks, peak %llu bytes",
+                  (u64)ctx->pool_bytes, (u64)ctx->pool_count, (u64)ctx->pool_peak);
+
+    // Group live blocks by call site
+    for (usize i = 0; i < ctx->pool_capacity; i++) {
+        const xudk_alloc_record *record = &ctx->allocated_pools[i];
+        usize s;
+
+        if (!record->ptr) {
+            continue;
+        }
+        for (s = 0; s < site_count && !tag_equal(sites[s].tag, record->tag); s++) {
+        }
+        if (s == site_count) {
+            if (site_count == TRACK_REPORT_TAGS) {
+                other_bytes += record->size;
+                other_count++;
+                continue;
+            }
+            sites[s].tag = record->tag;
+            sites[s].bytes = 0;
+            sites[s].count = 0;
+            site_count++;
+        }
+        sites[s].bytes += record->size;
+        sites[s].count++;
+    }
+
+    // Partial selection sort: only the first `top` places matter
+    for (usize n = 0; n < site_count && n < top; n++) {
+        usize best = n;
+        track_site swap;
+
+        for (usize s = n + 1; s < site_count; s++) {
+            if (sites[s].bytes > sites[best].bytes) {
+                best = s;
+            }
+        }
+        swap = sites[n];
+        sites[n] = sites[best];
+        sites[best] = swap;
+        xudk_log_info(ctx, L"  %10llu bytes %6llu blocks  %a",
+                      (u64)sites[n].bytes, (u64)sites[n].count, sites[n].tag);
+    }
+    if (other_count) {
+        xudk_log_info(ctx, L"  %10llu bytes %6llu blocks  (other call sites)",
+                      (u64)other_bytes, (u64)other_count);
+    }
+}
+
+void xudk_release_tracked(xudk_ctx *ctx) {
+    if (ctx->pool_count && ctx->debug_level >= 2) {
+        xudk_memory_report(ctx, 8);
+    }
+    for (usize i = 0; i < ctx->pool_capacity; i++) {
+        if (ctx->allocated_pools[i].ptr) {
+            ctx->memory.free(ctx, ctx->allocated_pools[i].ptr);
+        }
+    }
+    if (ctx->allocated_pools) {
+        ctx->memory.free(ctx, ctx->allocated_pools);
+    }
+    ctx->allocated_pools = null;
+    ctx->pool_count = 0;
+    ctx->pool_capacity = 0;
+    ctx->pool_bytes = 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * XUDK - Core utility functions
+ * String, math, error handling and logging helpers shared by every backend.
+ */
+
+#include "core.h"
+
+// =============================================================================
+// STRING UTILITIES
+// =============================================================================
+
+usize xudk_strlen(const wchar *str) {
+    usize len = 0;
+    if (!str) {
+        return 0;
+    }
+    while (str[len]) {
+        len++;
+    }
+    return len;
+}
+
+void xudk_strcpy(wchar *dst, const wchar *src) {
+    while ((*dst++ = *src++) != 0) {
+    }
+}
+
+int xudk_strcmp(const wchar *s1, const wchar *s2) {
+    while (*s1 && *s1 == *s2) {
+        s1++;
+        s2++;
+    }
+    return (int)*s1 - (int)*s2;
+}
+
+wchar* xudk_strdup(xudk_ctx *ctx, const wchar *src) {
+    usize size = (xudk_strlen(src) + 1) * sizeof(wchar);
+    wchar *dst = ctx->memory.alloc(ctx, size);
+    if (dst) {
+        xudk_memcpy(dst, src, size);
+    }
+    return dst;
+}
+
+void xudk_ascii_to_unicode(const char *ascii, wchar *unicode) {
+    while ((*unicode++ = (u8)*ascii++) != 0) {
+    }
+}
+
+void xudk_unicode_to_ascii(const wchar *unicode, char *ascii) {
+    while (*unicode) {
+        *ascii++ = *unicode < 0x80 ? (char)*unicode : '?';
+        unicode++;
+    }
+    *ascii = 0;
+}
+
+// =============================================================================
+// MATH UTILITIES
+// =============================================================================
+
+u64 xudk_align_up(u64 value, u64 alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+u64 xudk_align_down(u64 value, u64 alignment) {
+    return value & ~(alignment - 1);
+}
+
+// =============================================================================
+// ERROR HANDLING & LOGGING
+// =============================================================================
+
+void xudk_handle_error(xudk_ctx *ctx, status error, const wchar *message) {
+    ctx->last_error = error;
+    ctx->last_error_message = (wchar*)message;
+
+    if (ctx->error_handler) {
+        ctx->error_handler(ctx, error, message);
+    } else {
+        xudk_log_error(ctx, L"%s (status 0x%llx)", message, error);
+    }
+}
+
+static void log_message(xudk_ctx *ctx, u32 level, const wchar *prefix, const wchar *format, va_list args) {
+    wchar line[512];
+    usize len = xudk_strlen(prefix);
+
+    if (ctx->debug_level < level || !ctx->console.println) {
+        return;
+    }
+    xudk_memcpy(line, prefix, len * sizeof(wchar));
+    xudk_vsprint(line + len, sizeof(line) / sizeof(wchar) - len, format, args);
+    ctx->console.println(ctx, line);
+}
+
+void xudk_log_info(xudk_ctx *ctx, const wchar *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_message(ctx, 1, L"[INFO] ", format, args);
+    va_end(args);
+}
+
+void xudk_log_warning(xudk_ctx *ctx, const wchar *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_message(ctx, 1, L"[WARN] ", format, args);
+    va_end(args);
+}
+
+void xudk_log_error(xudk_ctx *ctx, const wchar *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_message(ctx, 1, L"[ERROR] ", format, args);
+    va_end(args);
+}
+
+void xudk_log_debug(xudk_ctx *ctx, const wchar *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_message(ctx, 2, L"[DEBUG] ", format, args);
+    va_end(args);
+}
+
+// =============================================================================
+// CONTEXT MANAGEMENT
+// =============================================================================
+
+void xudk_set_debug_level(xudk_ctx *ctx, u32 level) {
+    ctx->debug_level = level;
+}
+
+void xudk_set_error_handler(xudk_ctx *ctx, void (*handler)(xudk_ctx *ctx, status error, const wchar *message)) {
+    ctx->error_handler = handler;
+}
+
+void xudk_set_event_handler(xudk_ctx *ctx, void (*handler)(xudk_ctx *ctx, u32 event_type, void *event_data)) {
+    ctx->event_handler = handler;
+}
@@ -0,0 +1,187 @@
+/*
+ * XUDK - Hosted POSIX backend: boot entries kept in memory
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+
+static void free_entry(xudk_boot_entry *entry) {
+    free(entry->description);
+    free(entry->file_path);
+    free(entry->optional_data);
+}
+
+static status boot_get_boot_entries(xudk_ctx *ctx, xudk_boot_entry **entries, usize *count) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    if (!entries || !count) {
+        return XUDK_INVALID_PARAM;
+    }
+    *entries = ctx->memory.alloc(ctx, (host->boot_entry_count ? host->boot_entry_count : 1) * sizeof(xudk_boot_entry));
+    if (!*entries) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memcpy(*entries, host->boot_entries, host->boot_entry_count * sizeof(xudk_boot_entry));
+    *count = host->boot_entry_count;
+    return XUDK_OK;
+}
+
+static status boot_create_boot_entry(xudk_ctx *ctx, const xudk_boot_entry *entry, u16 *boot_number) {
+    xudk_host *host = xudk_host_of(ctx);
+    xudk_boot_entry *entries, *e;
+    u16 number = 0;
+
+    if (!entry || !entry->description || !entry->file_path) {
+        return XUDK_INVALID_PARAM;
+    }
+
+    // Lowest unused BootXXXX number
+    for (usize i = 0; i < host->boot_entry_count; i++) {
+        if (host->boot_entries[i].boot_number == number) {
+            number++;
+            i = (usize)-1;
+        }
+    }
+
+    entries = realloc(host->boot_entries, (host->boot_entry_count + 1) * sizeof(*entries));
+    if (!entries) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    host->boot_entries = entries;
+    e = &entries[host->boot_entry_count];
+    *e = *entry;
+    e->boot_number = number;
+    e->description = xudk_host_wcsdup(entry->description);
+    e->file_path = xudk_host_wcsdup(entry->file_path);
+    e->optional_data = null;
+    if (entry->optional_data_size) {
+        e->optional_data = malloc(entry->optional_data_size);
+        if (e->optional_data) {
+            memcpy(e->optional_data, entry->optional_data, entry->optional_data_size);
+        }
+    }
+    if (!e->description || !e->file_path || (entry->optional_data_size && !e->optional_data)) {
+        free_entry(e);
+        return XUDK_OUT_OF_MEMORY;
+    }
+    host->boot_entry_count++;
+    if (boot_number) {
+        *boot_number = number;
+    }
+    return XUDK_OK;
+}
+
+static status boot_delete_boot_entry(xudk_ctx *ctx, u16 boot_number) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    for (usize i = 0; i < host->boot_entry_count; i++) {
+        if (host->boot_entries[i].boot_number == boot_number) {
+            free_entry(&host->boot_entries[i]);
+            memmove(&host->boot_entries[i], &host->boot_entries[i + 1],
+                    (host->boot_entry_count - i - 1) * sizeof(xudk_boot_entry));
+            host->boot_entry_count--;
+            return XUDK_OK;
+        }
+    }
+    return XUDK_NOT_FOUND;
+}
+
+static status boot_set_boot_order(xudk_ctx *ctx, u16 *boot_order, usize count) {
+    xudk_host *host = xudk_host_of(ctx);
+    u16 *order;
+
+    if (!boot_order && count) {
+        return XUDK_INVALID_PARAM;
+    }
+    order = malloc((count ? count : 1) * sizeof(u16));
+    if (!order) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    memcpy(order, boot_order, count * sizeof(u16));
+    free(host->boot_order);
+    host->boot_order = order;
+    host->boot_order_count = count;
+    return XUDK_OK;
+}
+
+static status boot_get_boot_order(xudk_ctx *ctx, u16 **boot_order, usize *count) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    if (!boot_order || !count) {
+        return XUDK_INVALID_PARAM;
+    }
+    *boot_order = ctx->memory.alloc(ctx, (host->boot_order_count ? host->boot_order_count : 1) * sizeof(u16));
+    if (!*boot_order) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memcpy(*boot_order, host->boot_order, host->boot_order_count * sizeof(u16));
+    *count = host->boot_order_count;
+    return XUDK_OK;
+}
+
+static status boot_set_boot_next(xudk_ctx *ctx, u16 boot_number) {
+    xudk_host_of(ctx)->boot_next = boot_number;
+    return XUDK_OK;
+}
+
+// Images are validated for presence only; the host cannot execute PE/COFF
+static status boot_load_image(xudk_ctx *ctx, const wchar *path, handle *image) {
+    handle file;
+    status s;
+
+    if (!path || !image) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = ctx->filesystem.open_file(ctx, path, &file);
+    if (xudk_error(s)) {
+        return s;
+    }
+    ctx->filesystem.close_file(ctx, file);
+    *image = xudk_host_wcsdup(path);
+    return *image ? XUDK_OK : XUDK_OUT_OF_MEMORY;
+}
+
+static status boot_start_image(xudk_ctx *ctx, handle image, usize *exit_data_size, wchar **exit_data) {
+    (void)ctx;
+    (void)exit_data_size;
+    (void)exit_data;
+    free(image);
+    return XUDK_NOT_SUPPORTED;
+}
+
+static status boot_exit_boot_services(xudk_ctx *ctx, handle image, usize map_key) {
+    (void)image;
+    (void)map_key;
+    ctx->boot_services_active = false;
+    return XUDK_OK;
+}
+
+void xudk_host_boot_init(xudk_ctx *ctx) {
+    ctx->boot.get_boot_entries = boot_get_boot_entries;
+    ctx->boot.create_boot_entry = boot_create_boot_entry;
+    ctx->boot.delete_boot_entry = boot_delete_boot_entry;
+    ctx->boot.set_boot_order = boot_set_boot_order;
+    ctx->boot.get_boot_order = boot_get_boot_order;
+    ctx->boot.set_boot_next = boot_set_boot_next;
+    ctx->boot.load_image = boot_load_image;
+    ctx->boot.start_image = boot_start_image;
+    ctx->boot.exit_boot_services = boot_exit_boot_services;
+}
+
+void xudk_host_boot_shutdown(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    for (usize i = 0; i < host->boot_entry_count; i++) {
+        free_entry(&host->boot_entries[i]);
+    }
+    free(host->boot_entries);
+    free(host->boot_order);
+    host->boot_entries = null;
+    host->boot_order = null;
+    host->boot_entry_count = 0;
+    host->boot_order_count = 0;
+}
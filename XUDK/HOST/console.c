@@ -0,0 +1,170 @@
+/*
+ * XUDK - Hosted POSIX backend: text console on stdout
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "host.h"
+
+#define HOST_CONSOLE_COLUMNS  80
+
+// EFI text attribute colors to ANSI color indices
+static const u8 ansi_colors[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+static void console_write(xudk_ctx *ctx, const wchar *text) {
+    xudk_host *host = xudk_host_of(ctx);
+    char out[1024];
+    usize n = 0;
+
+    for (; *text; text++) {
+        wchar c = *text;
+
+        if (n + 4 > sizeof(out)) {
+            fwrite(out, 1, n, stdout);
+            n = 0;
+        }
+        if (c == L'\n') {
+            host->cursor_x = 0;
+            host->cursor_y++;
+        } else if (c == L'\r') {
+            host->cursor_x = 0;
+        } else if (++host->cursor_x >= HOST_CONSOLE_COLUMNS) {
+            host->cursor_x = 0;
+            host->cursor_y++;
+        }
+
+        if (c < 0x80) {
+            out[n++] = (char)c;
+        } else if (c < 0x800) {
+            out[n++] = (char)(0xC0 | (c >> 6));
+            out[n++] = (char)(0x80 | (c & 0x3F));
+        } else {
+            out[n++] = (char)(0xE0 | (c >> 12));
+            out[n++] = (char)(0x80 | ((c >> 6) & 0x3F));
+            out[n++] = (char)(0x80 | (c & 0x3F));
+        }
+    }
+    fwrite(out, 1, n, stdout);
+}
+
+static status console_print(xudk_ctx *ctx, const wchar *fmt, ...) {
+    wchar line[1024];
+    va_list args;
+
+    va_start(args, fmt);
+    xudk_vsprint(line, sizeof(line) / sizeof(wchar), fmt, args);
+    va_end(args);
+
+    console_write(ctx, line);
+    fflush(stdout);
+    return XUDK_OK;
+}
+
+static status console_println(xudk_ctx *ctx, const wchar *text) {
+    console_write(ctx, text);
+    console_write(ctx, L"\n");
+    fflush(stdout);
+    return XUDK_OK;
+}
+
+static status console_clear(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    if (isatty(STDOUT_FILENO)) {
+        fputs("\x1b[2J\x1b[H", stdout);
+        fflush(stdout);
+    }
+    host->cursor_x = 0;
+    host->cursor_y = 0;
+    return XUDK_OK;
+}
+
+static status console_set_color(xudk_ctx *ctx, u8 fg, u8 bg) {
+    (void)ctx;
+    if (fg > 15 || bg > 7) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (isatty(STDOUT_FILENO)) {
+        printf("\x1b[%d;%dm", (fg & 8 ? 90 : 30) + ansi_colors[fg & 7], 40 + ansi_colors[bg]);
+        fflush(stdout);
+    }
+    return XUDK_OK;
+}
+
+static status console_set_cursor(xudk_ctx *ctx, u32 x, u32 y) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    if (isatty(STDOUT_FILENO)) {
+        printf("\x1b[%u;%uH", y + 1, x + 1);
+        fflush(stdout);
+    }
+    host->cursor_x = x;
+    host->cursor_y = y;
+    return XUDK_OK;
+}
+
+static status console_get_cursor(xudk_ctx *ctx, u32 *x, u32 *y) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    if (!x || !y) {
+        return XUDK_INVALID_PARAM;
+    }
+    *x = host->cursor_x;
+    *y = host->cursor_y;
+    return XUDK_OK;
+}
+
+static status console_get_mode_info(xudk_ctx *ctx, u32 mode, xudk_graphics_mode *info) {
+    (void)ctx;
+    if (!info) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (mode > 1) {
+        return XUDK_NOT_SUPPORTED;
+    }
+
+    // Text modes 0 (80x25) and 1 (80x50), as on most firmware consoles
+    info->mode_number = mode;
+    info->horizontal_resolution = HOST_CONSOLE_COLUMNS;
+    info->vertical_resolution = mode ? 50 : 25;
+    info->pixel_format = 0;
+    info->pixels_per_scanline = HOST_CONSOLE_COLUMNS;
+    info->framebuffer_base = 0;
+    info->framebuffer_size = 0;
+    return XUDK_OK;
+}
+
+static status console_set_mode(xudk_ctx *ctx, u32 mode) {
+    if (mode > 1) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    xudk_host_of(ctx)->text_mode = mode;
+    return console_clear(ctx);
+}
+
+void xudk_host_console_init(xudk_ctx *ctx) {
+    ctx->console.print = console_print;
+    ctx->console.println = console_println;
+    ctx->console.clear = console_clear;
+    ctx->console.set_color = console_set_color;
+    ctx->console.set_cursor = console_set_cursor;
+    ctx->console.get_cursor = console_get_cursor;
+    ctx->console.set_mode = console_set_mode;
+    ctx->console.get_mode_info = console_get_mode_info;
+}
+
+void xudk_host_console_shutdown(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    if (host->terminal_raw) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &host->saved_termios);
+        host->terminal_raw = false;
+    }
+    if (isatty(STDOUT_FILENO)) {
+        fputs("\x1b[0m", stdout);
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,311 @@
+/*
+ * XUDK - Hosted POSIX backend: boot volume served from a host directory
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include "host.h"
+
+static wchar* utf8_to_wchar(xudk_ctx *ctx, const char *s) {
+    usize len = strlen(s);
+    wchar *out = ctx->memory.alloc(ctx, (len + 1) * sizeof(wchar));
+    wchar *p = out;
+
+    if (!out) {
+        return null;
+    }
+    while (*s) {
+        u8 c = (u8)*s++;
+        if (c < 0x80) {
+            *p++ = c;
+        } else if ((c & 0xE0) == 0xC0 && *s) {
+            *p++ = (wchar)(((c & 0x1F) << 6) | (*s++ & 0x3F));
+        } else if ((c & 0xF0) == 0xE0 && s[0] && s[1]) {
+            *p++ = (wchar)(((c & 0x0F) << 12) | ((s[0] & 0x3F) << 6) | (s[1] & 0x3F));
+            s += 2;
+        } else {
+            *p++ = L'?';
+        }
+    }
+    *p = 0;
+    return out;
+}
+
+static status open_host_file(xudk_ctx *ctx, const wchar *path, bool create, handle *file) {
+    xudk_host_file *f;
+    char *host_path;
+    int fd;
+
+    if (!path || !file) {
+        return XUDK_INVALID_PARAM;
+    }
+    host_path = xudk_host_path(ctx, path);
+    if (!host_path) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    if (create) {
+        fd = open(host_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    } else {
+        fd = open(host_path, O_RDWR);
+        if (fd < 0 && (errno == EACCES || errno == EROFS || errno == EISDIR)) {
+            fd = open(host_path, O_RDONLY);
+        }
+    }
+    free(host_path);
+    if (fd < 0) {
+        return xudk_host_status(errno);
+    }
+
+    f = malloc(sizeof(*f));
+    if (!f) {
+        close(fd);
+        return XUDK_OUT_OF_MEMORY;
+    }
+    f->fd = fd;
+    *file = f;
+    return XUDK_OK;
+}
+
+static status fs_open_file(xudk_ctx *ctx, const wchar *path, handle *file) {
+    return open_host_file(ctx, path, false, file);
+}
+
+static status fs_create_file(xudk_ctx *ctx, const wchar *path, handle *file) {
+    return open_host_file(ctx, path, true, file);
+}
+
+static status fs_close_file(xudk_ctx *ctx, handle file) {
+    xudk_host_file *f = file;
+    (void)ctx;
+    if (!f) {
+        return XUDK_INVALID_PARAM;
+    }
+    close(f->fd);
+    free(f);
+    return XUDK_OK;
+}
+
+static status fs_read_file(xudk_ctx *ctx, handle file, void *buffer, usize size, usize *read_size) {
+    xudk_host_file *f = file;
+    usize done = 0;
+
+    (void)ctx;
+    if (!f || (!buffer && size)) {
+        return XUDK_INVALID_PARAM;
+    }
+    while (done < size) {
+        ssize_t n = read(f->fd, (u8*)buffer + done, size - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return xudk_host_status(errno);
+        }
+        if (n == 0) {
+            break;
+        }
+        done += (usize)n;
+    }
+    if (read_size) {
+        *read_size = done;
+    }
+    return XUDK_OK;
+}
+
+static status fs_write_file(xudk_ctx *ctx, handle file, const void *buffer, usize size, usize *written) {
+    xudk_host_file *f = file;
+    usize done = 0;
+
+    (void)ctx;
+    if (!f || (!buffer && size)) {
+        return XUDK_INVALID_PARAM;
+    }
+    while (done < size) {
+        ssize_t n = write(f->fd, (const u8*)buffer + done, size - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return xudk_host_status(errno);
+        }
+        done += (usize)n;
+    }
+    if (written) {
+        *written = done;
+    }
+    return XUDK_OK;
+}
+
+static status fs_get_file_size(xudk_ctx *ctx, handle file, u64 *size) {
+    xudk_host_file *f = file;
+    struct stat st;
+
+    (void)ctx;
+    if (!f || !size) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (fstat(f->fd, &st) != 0) {
+        return xudk_host_status(errno);
+    }
+    *size = (u64)st.st_size;
+    return XUDK_OK;
+}
+
+static status fs_list_directory(xudk_ctx *ctx, const wchar *path, wchar ***entries, usize *count) {
+    struct dirent *de;
+    wchar **list = null;
+    usize n = 0, capacity = 0;
+    char *host_path;
+    DIR *dir;
+
+    if (!path || !entries || !count) {
+        return XUDK_INVALID_PARAM;
+    }
+    host_path = xudk_host_path(ctx, path);
+    if (!host_path) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    dir = opendir(host_path);
+    free(host_path);
+    if (!dir) {
+        return xudk_host_status(errno);
+    }
+
+    while ((de = readdir(dir)) != null) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+            continue;
+        }
+        if (n == capacity) {
+            usize new_capacity = capacity ? capacity * 2 : 16;
+            wchar **grown = ctx->memory.alloc(ctx, new_capacity * sizeof(wchar*));
+            if (!grown) {
+                break;
+            }
+            if (list) {
+                xudk_memcpy(grown, list, n * sizeof(wchar*));
+                ctx->memory.free(ctx, list);
+            }
+            list = grown;
+            capacity = new_capacity;
+        }
+        list[n] = utf8_to_wchar(ctx, de->d_name);
+        if (list[n]) {
+            n++;
+        }
+    }
+    closedir(dir);
+
+    *entries = list;
+    *count = n;
+    return XUDK_OK;
+}
+
+static status fs_get_volumes(xudk_ctx *ctx, xudk_volume_info **volumes, usize *count) {
+    xudk_volume_info *vol;
+    struct statvfs sv;
+
+    if (!volumes || !count) {
+        return XUDK_INVALID_PARAM;
+    }
+    vol = ctx->memory.alloc(ctx, sizeof(*vol));
+    if (!vol) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(vol, 0, sizeof(*vol));
+    vol->label = L"ESP";
+    vol->filesystem_type = L"HOSTFS";
+    vol->bootable = true;
+    vol->device_handle = xudk_host_of(ctx);
+    if (statvfs(xudk_host_of(ctx)->config.esp_root, &sv) == 0) {
+        vol->block_size = sv.f_frsize;
+        vol->total_size = (u64)sv.f_blocks * sv.f_frsize;
+        vol->free_size = (u64)sv.f_bavail * sv.f_frsize;
+        vol->read_only = (sv.f_flag & ST_RDONLY) != 0;
+    }
+
+    *volumes = vol;
+    *count = 1;
+    return XUDK_OK;
+}
+
+static status fs_mount_volume(xudk_ctx *ctx, handle device, xudk_volume_info *info) {
+    xudk_volume_info *volumes;
+    usize count;
+    status s;
+
+    if (device && device != xudk_host_of(ctx)) {
+        return XUDK_NOT_FOUND;
+    }
+    s = fs_get_volumes(ctx, &volumes, &count);
+    if (xudk_ok(s)) {
+        if (info) {
+            *info = volumes[0];
+        }
+        ctx->memory.free(ctx, volumes);
+    }
+    return s;
+}
+
+static status fs_unmount_volume(xudk_ctx *ctx, handle volume) {
+    return volume == xudk_host_of(ctx) ? XUDK_OK : XUDK_NOT_FOUND;
+}
+
+static status fs_load_file_to_memory(xudk_ctx *ctx, const wchar *path, void **buffer, usize *size) {
+    handle file;
+    u64 file_size;
+    usize got;
+    void *data;
+    status s;
+
+    if (!buffer || !size) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = fs_open_file(ctx, path, &file);
+    if (xudk_error(s)) {
+        return s;
+    }
+    s = fs_get_file_size(ctx, file, &file_size);
+    if (xudk_error(s)) {
+        fs_close_file(ctx, file);
+        return s;
+    }
+
+    data = ctx->memory.alloc(ctx, (usize)file_size);
+    if (!data) {
+        fs_close_file(ctx, file);
+        return XUDK_OUT_OF_MEMORY;
+    }
+    s = fs_read_file(ctx, file, data, (usize)file_size, &got);
+    fs_close_file(ctx, file);
+    if (xudk_error(s)) {
+        ctx->memory.free(ctx, data);
+        return s;
+    }
+
+    *buffer = data;
+    *size = got;
+    return XUDK_OK;
+}
+
+void xudk_host_filesystem_init(xudk_ctx *ctx) {
+    ctx->filesystem.mount_volume = fs_mount_volume;
+    ctx->filesystem.unmount_volume = fs_unmount_volume;
+    ctx->filesystem.open_file = fs_open_file;
+    ctx->filesystem.create_file = fs_create_file;
+    ctx->filesystem.close_file = fs_close_file;
+    ctx->filesystem.read_file = fs_read_file;
+    ctx->filesystem.write_file = fs_write_file;
+    ctx->filesystem.get_file_size = fs_get_file_size;
+    ctx->filesystem.list_directory = fs_list_directory;
+    ctx->filesystem.get_volumes = fs_get_volumes;
+    ctx->filesystem.load_file_to_memory = fs_load_file_to_memory;
+}
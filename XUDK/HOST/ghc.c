@@ -0,0 +1,186 @@
+/*
+ * XUDK - Hosted POSIX backend: in-memory framebuffer
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "xudk/CORE/core.h"
+
+static const u32 host_mode_sizes[][2] = { { 0, 0 }, { 800, 600 }, { 1280, 720 }, { 1920, 1080 } };
+
+static xudk_graphics_mode* current_mode(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+    return &host->modes[host->current_mode];
+}
+
+static status gfx_get_modes(xudk_ctx *ctx, xudk_graphics_mode **modes, usize *count) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    if (!modes || !count) {
+        return XUDK_INVALID_PARAM;
+    }
+    *modes = ctx->memory.alloc(ctx, host->mode_count * sizeof(xudk_graphics_mode));
+    if (!*modes) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memcpy(*modes, host->modes, host->mode_count * sizeof(xudk_graphics_mode));
+    *count = host->mode_count;
+    return XUDK_OK;
+}
+
+static status gfx_set_mode(xudk_ctx *ctx, u32 mode_number) {
+    xudk_host *host = xudk_host_of(ctx);
+    xudk_graphics_mode *mode;
+    u32 *fb;
+
+    if (mode_number >= host->mode_count) {
+        return XUDK_INVALID_PARAM;
+    }
+    mode = &host->modes[mode_number];
+    fb = calloc(mode->framebuffer_size, 1);
+    if (!fb) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    free(host->framebuffer);
+    host->framebuffer = fb;
+    host->current_mode = mode_number;
+    for (usize i = 0; i < host->mode_count; i++) {
+        host->modes[i].framebuffer_base = i == mode_number ? (addr)(usize)fb : 0;
+    }
+    return XUDK_OK;
+}
+
+static status gfx_get_framebuffer(xudk_ctx *ctx, addr *base, usize *size) {
+    if (!base || !size) {
+        return XUDK_INVALID_PARAM;
+    }
+    *base = (addr)(usize)xudk_host_of(ctx)->framebuffer;
+    *size = current_mode(ctx)->framebuffer_size;
+    return XUDK_OK;
+}
+
+static status gfx_get_mode(xudk_ctx *ctx, xudk_graphics_mode *mode) {
+    if (!mode) {
+        return XUDK_INVALID_PARAM;
+    }
+    *mode = *current_mode(ctx);
+    return XUDK_OK;
+}
+
+// The framebuffer as a surface for the shared drawing code
+static xudk_surface host_surface(xudk_ctx *ctx) {
+    xudk_graphics_mode *mode = current_mode(ctx);
+    xudk_surface surface;
+
+    surface.pixels = xudk_host_of(ctx)->framebuffer;
+    surface.width = mode->horizontal_resolution;
+    surface.height = mode->vertical_resolution;
+    surface.stride = mode->pixels_per_scanline;
+    surface.pixel_format = mode->pixel_format;
+    return surface;
+}
+
+static status gfx_draw_pixel(xudk_ctx *ctx, u32 x, u32 y, u32 color) {
+    xudk_surface surface = host_surface(ctx);
+    return xudk_surface_pixel(&surface, x, y, color);
+}
+
+static status gfx_draw_rectangle(xudk_ctx *ctx, u32 x, u32 y, u32 width, u32 height, u32 color) {
+    xudk_surface surface = host_surface(ctx);
+    return xudk_surface_fill(&surface, x, y, width, height, color);
+}
+
+static status gfx_draw_text(xudk_ctx *ctx, u32 x, u32 y, const wchar *text, u32 color) {
+    xudk_surface surface = host_surface(ctx);
+    return xudk_surface_text(&surface, x, y, text, color);
+}
+
+static status gfx_copy_buffer(xudk_ctx *ctx, const void *buffer, u32 x, u32 y, u32 width, u32 height) {
+    xudk_surface surface = host_surface(ctx);
+    return xudk_surface_copy(&surface, buffer, x, y, width, height);
+}
+
+static status gfx_load_bitmap(xudk_ctx *ctx, const wchar *path, u32 x, u32 y) {
+    xudk_surface surface = host_surface(ctx);
+    return xudk_surface_load_image(ctx, &surface, path, x, y, null, null);
+}
+
+static status gfx_fill_spans(xudk_ctx *ctx, const xudk_span *spans, usize count) {
+    xudk_surface surface = host_surface(ctx);
+    return xudk_surface_fill_spans(&surface, spans, count);
+}
+
+static status gfx_fill_rects(xudk_ctx *ctx, const xudk_fill_rect *rects, usize count) {
+    xudk_surface surface = host_surface(ctx);
+    return xudk_surface_fill_rects(&surface, rects, count);
+}
+
+static status gfx_plot_points(xudk_ctx *ctx, const xudk_point *points, usize count) {
+    xudk_surface surface = host_surface(ctx);
+    return xudk_surface_plot_points(&surface, points, count);
+}
+
+static status gfx_draw_text_runs(xudk_ctx *ctx, const xudk_font *font, const xudk_text_run *runs, usize count) {
+    xudk_surface surface = host_surface(ctx);
+    return xudk_surface_text_runs(&surface, font, runs, count);
+}
+
+status xudk_host_graphics_init(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    ctx->graphics.get_modes = gfx_get_modes;
+    ctx->graphics.set_mode = gfx_set_mode;
+    ctx->graphics.get_framebuffer = gfx_get_framebuffer;
+    ctx->graphics.draw_pixel = gfx_draw_pixel;
+    ctx->graphics.draw_rectangle = gfx_draw_rectangle;
+    ctx->graphics.draw_text = gfx_draw_text;
+    ctx->graphics.load_bitmap = gfx_load_bitmap;
+    ctx->graphics.copy_buffer = gfx_copy_buffer;
+    ctx->graphics.get_mode = gfx_get_mode;
+    ctx->graphics.fill_spans = gfx_fill_spans;
+    ctx->graphics.fill_rects = gfx_fill_rects;
+    ctx->graphics.plot_points = gfx_plot_points;
+    ctx->graphics.draw_text_runs = gfx_draw_text_runs;
+    xudk_compositor_install(&ctx->graphics);
+
+    host->mode_count = sizeof(host_mode_sizes) / sizeof(host_mode_sizes[0]);
+    for (u32 i = 0; i < host->mode_count; i++) {
+        xudk_graphics_mode *mode = &host->modes[i];
+        mode->mode_number = i;
+        mode->horizontal_resolution = i ? host_mode_sizes[i][0] : (host->config.fb_width ? host->config.fb_width : 1024);
+        mode->vertical_resolution = i ? host_mode_sizes[i][1] : (host->config.fb_height ? host->config.fb_height : 768);
+        mode->pixel_format = XUDK_PIXEL_BGRX;
+        mode->pixels_per_scanline = mode->horizontal_resolution;
+        mode->framebuffer_size = (usize)mode->pixels_per_scanline * mode->vertical_resolution * sizeof(u32);
+    }
+    return gfx_set_mode(ctx, 0);
+}
+
+void xudk_host_graphics_shutdown(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+    xudk_graphics_mode *mode;
+    FILE *out;
+
+    if (!host->framebuffer) {
+        return;
+    }
+    ctx->graphics.enable_back_buffer(ctx, false);
+    mode = current_mode(ctx);
+    if (host->config.fb_dump_path && (out = fopen(host->config.fb_dump_path, "wb")) != null) {
+        fprintf(out, "P6\n%u %u\n255\n", mode->horizontal_resolution, mode->vertical_resolution);
+        for (u32 j = 0; j < mode->vertical_resolution; j++) {
+            const u32 *row = host->framebuffer + (usize)j * mode->pixels_per_scanline;
+            for (u32 i = 0; i < mode->horizontal_resolution; i++) {
+                u8 rgb[3] = { (u8)(row[i] >> 16), (u8)(row[i] >> 8), (u8)row[i] };
+                fwrite(rgb, 1, 3, out);
+            }
+        }
+        fclose(out);
+    }
+    free(host->framebuffer);
+    host->framebuffer = null;
+}
@@ -0,0 +1,161 @@
+/*
+ * XUDK - Hosted POSIX backend: context setup and teardown
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "xudk/CORE/core.h"
+
+status xudk_host_status(int err) {
+    switch (err) {
+    case 0:         return XUDK_OK;
+    case ENOENT:
+    case ENOTDIR:   return XUDK_NOT_FOUND;
+    case EACCES:
+    case EPERM:     return XUDK_ACCESS_DENIED;
+    case EROFS:     return XUDK_WRITE_PROTECTED;
+    case ENOMEM:    return XUDK_OUT_OF_MEMORY;
+    case EINVAL:    return XUDK_INVALID_PARAM;
+    case ETIMEDOUT: return XUDK_TIMEOUT;
+    case ENOSPC:    return XUDK_BUFFER_OVERFLOW;
+    case EIO:       return XUDK_DEVICE_ERROR;
+    default:        return XUDK_ERROR;
+    }
+}
+
+char* xudk_host_path(xudk_ctx *ctx, const wchar *path) {
+    const char *root = xudk_host_of(ctx)->config.esp_root;
+    usize root_len = strlen(root);
+    usize len = xudk_strlen(path);
+    char *out = malloc(root_len + len * 3 + 2);
+    char *p;
+
+    if (!out) {
+        return null;
+    }
+    memcpy(out, root, root_len);
+    p = out + root_len;
+    if (*path != L'\\' && *path != L'/') {
+        *p++ = '/';
+    }
+
+    // UTF-16 volume path to a UTF-8 host path
+    for (; *path; path++) {
+        wchar c = *path;
+        if (c == L'\\') {
+            *p++ = '/';
+        } else if (c < 0x80) {
+            *p++ = (char)c;
+        } else if (c < 0x800) {
+            *p++ = (char)(0xC0 | (c >> 6));
+            *p++ = (char)(0x80 | (c & 0x3F));
+        } else {
+            *p++ = (char)(0xE0 | (c >> 12));
+            *p++ = (char)(0x80 | ((c >> 6) & 0x3F));
+            *p++ = (char)(0x80 | (c & 0x3F));
+        }
+    }
+    *p = 0;
+    return out;
+}
+
+wchar* xudk_host_wcsdup(const wchar *s) {
+    usize size = (xudk_strlen(s) + 1) * sizeof(wchar);
+    wchar *out = malloc(size);
+    if (out) {
+        memcpy(out, s, size);
+    }
+    return out;
+}
+
+status xudk_init(xudk_ctx *ctx, handle image_handle, void *system_table) {
+    const xudk_host_config *config = system_table;
+    xudk_host *host;
+    status s;
+
+    memset(ctx, 0, sizeof(*ctx));
+    xudk_mem_init();
+    xudk_checksum_init();
+    xudk_pixel_init();
+    xudk_bcn_init();
+    xudk_font_init();
+
+    host = calloc(1, sizeof(*host));
+    if (!host) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    if (config) {
+        host->config = *config;
+    }
+    if (!host->config.esp_root) {
+        host->config.esp_root = ".";
+    }
+    host->tap_fd = -1;
+
+    ctx->image_handle = image_handle;
+    ctx->system_table = host;
+    ctx->boot_services_active = true;
+    ctx->debug_level = 1;
+
+    xudk_host_memory_init(ctx);
+    if (xudk_error(xudk_slab_install(ctx))) {
+        free(host);
+        ctx->system_table = null;
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_host_console_init(ctx);
+    xudk_host_input_init(ctx);
+    xudk_host_filesystem_init(ctx);
+    xudk_host_system_init(ctx);
+    xudk_host_mp_init(ctx);
+    xudk_host_boot_init(ctx);
+
+    s = xudk_host_storage_init(ctx);
+    if (xudk_ok(s)) {
+        s = xudk_host_graphics_init(ctx);
+    }
+    if (xudk_ok(s)) {
+        s = xudk_host_network_init(ctx);
+    }
+    if (xudk_error(s)) {
+        xudk_cleanup(ctx);
+        return s;
+    }
+    return XUDK_OK;
+}
+
+void xudk_cleanup(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    if (!host) {
+        return;
+    }
+    // Whichever of these was opened last has to go first; the other refuses until then
+    xudk_gpu_profiler_close(ctx);
+    xudk_gpu_state_tracking_close(ctx);
+    xudk_gpu_profiler_close(ctx);
+    xudk_gpu_pipeline_cache_close(ctx);
+    xudk_gpu_shader_cache_close(ctx);
+    if (ctx->gpu_initialized && ctx->gpu.shutdown_device) {
+        ctx->gpu.shutdown_device(ctx);
+    }
+    xudk_release_tracked(ctx);
+    xudk_storage_cache_close(ctx);
+
+    xudk_host_network_shutdown(ctx);
+    xudk_host_graphics_shutdown(ctx);
+    xudk_host_storage_shutdown(ctx);
+    xudk_host_boot_shutdown(ctx);
+    xudk_host_mp_shutdown(ctx);
+    xudk_host_system_shutdown(ctx);
+    xudk_host_console_shutdown(ctx);
+    xudk_slab_shutdown(ctx);
+
+    free(host);
+    ctx->system_table = null;
+}
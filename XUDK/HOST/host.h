@@ -0,0 +1,147 @@
+/*
+ * XUDK - Hosted POSIX backend
+ * Runs xudk_ctx on a regular OS so boot-path code can be profiled off-firmware:
+ * storage is backed by disk-image files, the boot volume by a host directory,
+ * the framebuffer by an in-memory surface, the network by an in-process
+ * loopback (or a TAP device) and the clock by clock_gettime.
+ *
+ * In hosted builds xudk_init() takes a `const xudk_host_config*` in place of
+ * the EFI system table; pass null for the defaults.
+ */
+
+#ifndef XUDK_HOST_H
+#define XUDK_HOST_H
+
+#include <termios.h>
+
+#include "xudk/uefi.h"
+
+// =============================================================================
+// CONFIGURATION
+// =============================================================================
+
+// Hosted backend configuration
+typedef struct {
+    const char*         esp_root;           // Host directory served as the boot volume (default ".")
+    const char* const*  disk_images;        // Image files exposed as disks 0..disk_count-1
+    usize               disk_count;
+    u32                 sector_size;        // 0 = 512
+    u32                 fb_width;           // 0 = 1024
+    u32                 fb_height;          // 0 = 768
+    const char*         fb_dump_path;       // Write the framebuffer as PPM at cleanup (optional)
+    const char*         tap_device;         // TAP interface name; null = in-process loopback
+    u32                 cpu_count;          // Processors used by run_on_all_processors; 0 = all online
+    bool                raw_console;        // Put a TTY stdin into raw mode for key input
+} xudk_host_config;
+
+// =============================================================================
+// BACKEND STATE
+// =============================================================================
+
+// Disk backed by an image file
+typedef struct {
+    int                 fd;
+    u64                 total_sectors;
+    bool                read_only;
+    wchar*              model;
+} xudk_host_disk;
+
+// Queued loopback frame
+typedef struct xudk_host_packet {
+    struct xudk_host_packet* next;
+    usize               size;
+    u8                  data[];
+} xudk_host_packet;
+
+// Firmware variable kept for the lifetime of the context
+typedef struct xudk_host_var {
+    struct xudk_host_var* next;
+    wchar*              name;
+    wchar*              vendor;
+    void*               data;
+    usize               size;
+} xudk_host_var;
+
+// Open file on the hosted boot volume
+typedef struct {
+    int                 fd;
+} xudk_host_file;
+
+// Per-context backend state, reachable through ctx->system_table
+typedef struct {
+    xudk_host_config    config;
+
+    // Storage
+    xudk_host_disk*     disks;
+    usize               disk_count;
+    u32                 sector_size;
+    struct xudk_host_io* io;                // Threads serving queued transfers, started on first use
+
+    // Graphics
+    u32*                framebuffer;
+    xudk_graphics_mode  modes[4];
+    usize               mode_count;
+    u32                 current_mode;
+
+    // Console & input
+    u32                 cursor_x;
+    u32                 cursor_y;
+    u32                 text_mode;
+    u32                 key_repeat_delay;
+    bool                terminal_raw;
+    struct termios      saved_termios;
+
+    // Network
+    xudk_net_info       net;
+    int                 tap_fd;
+    xudk_host_packet*   rx_head;
+    xudk_host_packet*   rx_tail;
+    usize               rx_count;
+
+    // System
+    i64                 time_offset;        // set_time() adjustment in seconds
+    xudk_host_var*      variables;
+    struct xudk_host_mp* mp;                // Worker threads, started on first use
+
+    // Boot
+    xudk_boot_entry*    boot_entries;
+    usize               boot_entry_count;
+    u16*                boot_order;
+    usize               boot_order_count;
+    u16                 boot_next;
+} xudk_host;
+
+#define xudk_host_of(ctx)   ((xudk_host*)(ctx)->system_table)
+
+// =============================================================================
+// SUBSYSTEM SETUP (internal)
+// =============================================================================
+
+void   xudk_host_console_init(xudk_ctx *ctx);
+void   xudk_host_console_shutdown(xudk_ctx *ctx);
+void   xudk_host_input_init(xudk_ctx *ctx);
+void   xudk_host_memory_init(xudk_ctx *ctx);
+void   xudk_host_filesystem_init(xudk_ctx *ctx);
+status xudk_host_storage_init(xudk_ctx *ctx);
+void   xudk_host_storage_shutdown(xudk_ctx *ctx);
+void   xudk_host_boot_init(xudk_ctx *ctx);
+void   xudk_host_boot_shutdown(xudk_ctx *ctx);
+void   xudk_host_system_init(xudk_ctx *ctx);
+void   xudk_host_system_shutdown(xudk_ctx *ctx);
+void   xudk_host_mp_init(xudk_ctx *ctx);
+void   xudk_host_mp_shutdown(xudk_ctx *ctx);
+status xudk_host_network_init(xudk_ctx *ctx);
+void   xudk_host_network_shutdown(xudk_ctx *ctx);
+status xudk_host_graphics_init(xudk_ctx *ctx);
+void   xudk_host_graphics_shutdown(xudk_ctx *ctx);
+
+// Host path for a volume path such as L"\\EFI\\BOOT\\x.conf" (caller frees)
+char*  xudk_host_path(xudk_ctx *ctx, const wchar *path);
+
+// malloc()-backed copy of a wchar string, for backend-owned state
+wchar* xudk_host_wcsdup(const wchar *s);
+
+// Map errno to an XUDK status code
+status xudk_host_status(int err);
+
+#endif // XUDK_HOST_H
@@ -0,0 +1,116 @@
+/*
+ * XUDK - Hosted POSIX backend: keyboard input from stdin
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host.h"
+
+// UEFI scan codes
+#define SCAN_UP     0x01
+#define SCAN_DOWN   0x02
+#define SCAN_RIGHT  0x03
+#define SCAN_LEFT   0x04
+#define SCAN_HOME   0x05
+#define SCAN_END    0x06
+#define SCAN_ESC    0x17
+
+static bool stdin_ready(int timeout_ms) {
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    return poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN);
+}
+
+static bool stdin_byte(u8 *c, int timeout_ms) {
+    return stdin_ready(timeout_ms) && read(STDIN_FILENO, c, 1) == 1;
+}
+
+static bool input_key_available(xudk_ctx *ctx) {
+    (void)ctx;
+    return stdin_ready(0);
+}
+
+static status input_read_key(xudk_ctx *ctx, xudk_key_input *key) {
+    struct timespec ts;
+    u8 c, seq[2];
+
+    (void)ctx;
+    if (!key) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!stdin_byte(&c, 0)) {
+        return XUDK_NOT_FOUND;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    key->unicode = 0;
+    key->scan_code = 0;
+    key->shift_state = 0;
+    key->toggle_state = 0;
+    key->timestamp = (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+
+    if (c != 0x1B) {
+        key->unicode = c == '\n' ? L'\r' : c;
+        return XUDK_OK;
+    }
+
+    // Bare ESC or an ANSI cursor sequence
+    if (!stdin_byte(&seq[0], 10) || seq[0] != '[' || !stdin_byte(&seq[1], 10)) {
+        key->scan_code = SCAN_ESC;
+        return XUDK_OK;
+    }
+    switch (seq[1]) {
+    case 'A': key->scan_code = SCAN_UP;    break;
+    case 'B': key->scan_code = SCAN_DOWN;  break;
+    case 'C': key->scan_code = SCAN_RIGHT; break;
+    case 'D': key->scan_code = SCAN_LEFT;  break;
+    case 'H': key->scan_code = SCAN_HOME;  break;
+    case 'F': key->scan_code = SCAN_END;   break;
+    default:  key->scan_code = SCAN_ESC;   break;
+    }
+    return XUDK_OK;
+}
+
+static status input_wait_key(xudk_ctx *ctx, xudk_key_input *key) {
+    if (!stdin_ready(-1)) {
+        return XUDK_DEVICE_ERROR;
+    }
+    return input_read_key(ctx, key);
+}
+
+static status input_flush_input(xudk_ctx *ctx) {
+    u8 c;
+    (void)ctx;
+    while (stdin_byte(&c, 0)) {
+    }
+    return XUDK_OK;
+}
+
+static status input_set_repeat_delay(xudk_ctx *ctx, u32 delay) {
+    xudk_host_of(ctx)->key_repeat_delay = delay;
+    return XUDK_OK;
+}
+
+void xudk_host_input_init(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    ctx->input.read_key = input_read_key;
+    ctx->input.wait_key = input_wait_key;
+    ctx->input.flush_input = input_flush_input;
+    ctx->input.set_repeat_delay = input_set_repeat_delay;
+    ctx->input.key_available = input_key_available;
+
+    if (host->config.raw_console && isatty(STDIN_FILENO) &&
+        tcgetattr(STDIN_FILENO, &host->saved_termios) == 0) {
+        struct termios raw = host->saved_termios;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0) {
+            host->terminal_raw = true;
+        }
+    }
+}
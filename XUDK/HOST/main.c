@@ -0,0 +1,80 @@
+/*
+ * XUDK - Hosted POSIX backend: process entry point
+ * Runs an application's xudk_main() as a normal program.
+ *
+ *   app [--esp DIR] [--disk IMAGE]... [--sector-size N] [--fb WxH]
+ *       [--dump FILE.ppm] [--tap IFNAME] [--cpus N] [--raw] [--debug LEVEL]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+
+#define HOST_MAX_DISKS  16
+
+static int usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--esp DIR] [--disk IMAGE]... [--sector-size N] [--fb WxH]\n"
+                    "          [--dump FILE.ppm] [--tap IFNAME] [--cpus N] [--raw] [--debug LEVEL]\n", argv0);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    const char *disks[HOST_MAX_DISKS];
+    xudk_host_config config;
+    xudk_ctx ctx;
+    u32 debug_level = 1;
+    status s;
+
+    memset(&config, 0, sizeof(config));
+    config.disk_images = disks;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : null;
+
+        if (!strcmp(arg, "--raw")) {
+            config.raw_console = true;
+            continue;
+        }
+        if (!value) {
+            return usage(argv[0]);
+        }
+        i++;
+        if (!strcmp(arg, "--esp")) {
+            config.esp_root = value;
+        } else if (!strcmp(arg, "--disk") && config.disk_count < HOST_MAX_DISKS) {
+            disks[config.disk_count++] = value;
+        } else if (!strcmp(arg, "--sector-size")) {
+            config.sector_size = (u32)strtoul(value, null, 0);
+        } else if (!strcmp(arg, "--fb")) {
+            if (sscanf(value, "%ux%u", &config.fb_width, &config.fb_height) != 2) {
+                return usage(argv[0]);
+            }
+        } else if (!strcmp(arg, "--dump")) {
+            config.fb_dump_path = value;
+        } else if (!strcmp(arg, "--tap")) {
+            config.tap_device = value;
+        } else if (!strcmp(arg, "--cpus")) {
+            config.cpu_count = (u32)strtoul(value, null, 0);
+        } else if (!strcmp(arg, "--debug")) {
+            debug_level = (u32)strtoul(value, null, 0);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    s = xudk_init(&ctx, null, &config);
+    if (xudk_error(s)) {
+        fprintf(stderr, "xudk_init failed: 0x%llx\n", (unsigned long long)s);
+        return 1;
+    }
+    xudk_set_debug_level(&ctx, debug_level);
+
+    s = xudk_main(&ctx);
+    xudk_cleanup(&ctx);
+    return xudk_ok(s) ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+/*
+ * XUDK - Hosted POSIX backend: memory management
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "xudk/CORE/core.h"
+
+#define HOST_PAGE_SIZE  4096
+
+static void* host_alloc(xudk_ctx *ctx, usize size) {
+    (void)ctx;
+    return malloc(size ? size : 1);
+}
+
+static void* host_alloc_aligned(xudk_ctx *ctx, usize size, usize alignment) {
+    void *ptr = null;
+    (void)ctx;
+    if (alignment < sizeof(void*)) {
+        alignment = sizeof(void*);
+    }
+    if (posix_memalign(&ptr, alignment, size ? size : 1) != 0) {
+        return null;
+    }
+    return ptr;
+}
+
+static void* host_alloc_type(xudk_ctx *ctx, usize size, xudk_mem_type type) {
+    (void)type;
+    // Typed allocations are page allocations on firmware, keep the granularity
+    return host_alloc_aligned(ctx, (usize)xudk_align_up(size, HOST_PAGE_SIZE), HOST_PAGE_SIZE);
+}
+
+static void host_free(xudk_ctx *ctx, void *ptr) {
+    (void)ctx;
+    free(ptr);
+}
+
+static u64 host_get_total_memory(xudk_ctx *ctx) {
+    (void)ctx;
+    return (u64)sysconf(_SC_PHYS_PAGES) * (u64)sysconf(_SC_PAGESIZE);
+}
+
+static u64 host_get_free_memory(xudk_ctx *ctx) {
+    (void)ctx;
+#ifdef _SC_AVPHYS_PAGES
+    return (u64)sysconf(_SC_AVPHYS_PAGES) * (u64)sysconf(_SC_PAGESIZE);
+#else
+    return host_get_total_memory(ctx);
+#endif
+}
+
+static status host_get_memory_map(xudk_ctx *ctx, xudk_mem_map *map) {
+    xudk_mem_desc *desc;
+    u64 total = host_get_total_memory(ctx);
+    u64 usable = host_get_free_memory(ctx);
+
+    if (!map) {
+        return XUDK_INVALID_PARAM;
+    }
+    desc = calloc(2, sizeof(*desc));
+    if (!desc) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+
+    // The host has no physical map, describe it as free + in-use RAM
+    desc[0].type = XUDK_MEM_CONVENTIONAL;
+    desc[0].pages = usable / HOST_PAGE_SIZE;
+    desc[0].description = "Conventional";
+    desc[1].type = XUDK_MEM_BOOT_SERVICES_DATA;
+    desc[1].physical_start = usable;
+    desc[1].pages = (total - usable) / HOST_PAGE_SIZE;
+    desc[1].description = "Host in use";
+
+    map->descriptors = desc;
+    map->count = 2;
+    map->descriptor_size = sizeof(*desc);
+    map->total_size = 2 * sizeof(*desc);
+    map->version = 1;
+    map->total_memory = total;
+    map->usable_memory = usable;
+    map->reserved_memory = total - usable;
+    return XUDK_OK;
+}
+
+static void host_free_memory_map(xudk_ctx *ctx, xudk_mem_map *map) {
+    (void)ctx;
+    if (map) {
+        free(map->descriptors);
+        map->descriptors = null;
+        map->count = 0;
+    }
+}
+
+static status host_set_virtual_map(xudk_ctx *ctx, xudk_mem_map *map) {
+    (void)ctx;
+    (void)map;
+    return XUDK_NOT_SUPPORTED;
+}
+
+void xudk_host_memory_init(xudk_ctx *ctx) {
+    ctx->memory.alloc = host_alloc;
+    ctx->memory.alloc_aligned = host_alloc_aligned;
+    ctx->memory.alloc_type = host_alloc_type;
+    ctx->memory.free = host_free;
+    ctx->memory.get_memory_map = host_get_memory_map;
+    ctx->memory.free_memory_map = host_free_memory_map;
+    ctx->memory.set_virtual_map = host_set_virtual_map;
+    ctx->memory.get_total_memory = host_get_total_memory;
+    ctx->memory.get_free_memory = host_get_free_memory;
+    xudk_arena_install(&ctx->memory);
+}
@@ -0,0 +1,142 @@
+/*
+ * XUDK - Hosted POSIX backend: multiprocessor services
+ * A pthread pool standing in for the MP Services protocol. Every call runs
+ * the procedure once per processor, the caller included, and waits for all.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "host.h"
+
+#define HOST_MAX_CPUS   64
+
+typedef struct xudk_host_mp {
+    pthread_t           threads[HOST_MAX_CPUS];
+    u32                 thread_count;
+    pthread_mutex_t     lock;
+    pthread_cond_t      start;
+    pthread_cond_t      done;
+    u64                 generation;         // Bumped once per dispatch
+    u32                 running;            // Workers still inside the procedure
+    bool                busy;
+    bool                quit;
+    void                (*procedure)(void *argument);
+    void*               argument;
+} xudk_host_mp;
+
+static void* mp_worker(void *arg) {
+    xudk_host_mp *mp = arg;
+    u64 seen = 0;
+
+    pthread_mutex_lock(&mp->lock);
+    for (;;) {
+        while (!mp->quit && mp->generation == seen) {
+            pthread_cond_wait(&mp->start, &mp->lock);
+        }
+        if (mp->quit) {
+            break;
+        }
+        seen = mp->generation;
+        pthread_mutex_unlock(&mp->lock);
+
+        mp->procedure(mp->argument);
+
+        pthread_mutex_lock(&mp->lock);
+        if (--mp->running == 0) {
+            pthread_cond_signal(&mp->done);
+        }
+    }
+    pthread_mutex_unlock(&mp->lock);
+    return null;
+}
+
+// Workers are created on first use so single-threaded apps never pay for them
+static xudk_host_mp* mp_start(xudk_host *host) {
+    xudk_host_mp *mp = calloc(1, sizeof(*mp));
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    u32 cpus = host->config.cpu_count ? host->config.cpu_count : (online > 0 ? (u32)online : 1);
+
+    if (!mp) {
+        return null;
+    }
+    if (cpus > HOST_MAX_CPUS) {
+        cpus = HOST_MAX_CPUS;
+    }
+    pthread_mutex_init(&mp->lock, null);
+    pthread_cond_init(&mp->start, null);
+    pthread_cond_init(&mp->done, null);
+    while (mp->thread_count + 1 < cpus) {
+        if (pthread_create(&mp->threads[mp->thread_count], null, mp_worker, mp) != 0) {
+            break;
+        }
+        mp->thread_count++;
+    }
+    host->mp = mp;
+    return mp;
+}
+
+static status mp_run_on_all_processors(xudk_ctx *ctx, void (*procedure)(void *argument), void *argument) {
+    xudk_host *host = xudk_host_of(ctx);
+    xudk_host_mp *mp = host->mp;
+
+    if (!procedure) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!mp && !(mp = mp_start(host))) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+
+    pthread_mutex_lock(&mp->lock);
+    if (mp->busy || !mp->thread_count) {
+        // Nested call from inside a procedure, or a single processor
+        pthread_mutex_unlock(&mp->lock);
+        procedure(argument);
+        return XUDK_OK;
+    }
+    mp->busy = true;
+    mp->procedure = procedure;
+    mp->argument = argument;
+    mp->running = mp->thread_count;
+    mp->generation++;
+    pthread_cond_broadcast(&mp->start);
+    pthread_mutex_unlock(&mp->lock);
+
+    procedure(argument);
+
+    pthread_mutex_lock(&mp->lock);
+    while (mp->running) {
+        pthread_cond_wait(&mp->done, &mp->lock);
+    }
+    mp->busy = false;
+    pthread_mutex_unlock(&mp->lock);
+    return XUDK_OK;
+}
+
+void xudk_host_mp_init(xudk_ctx *ctx) {
+    ctx->system.run_on_all_processors = mp_run_on_all_processors;
+}
+
+void xudk_host_mp_shutdown(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+    xudk_host_mp *mp = host->mp;
+
+    if (!mp) {
+        return;
+    }
+    pthread_mutex_lock(&mp->lock);
+    mp->quit = true;
+    pthread_cond_broadcast(&mp->start);
+    pthread_mutex_unlock(&mp->lock);
+    for (u32 i = 0; i < mp->thread_count; i++) {
+        pthread_join(mp->threads[i], null);
+    }
+    pthread_mutex_destroy(&mp->lock);
+    pthread_cond_destroy(&mp->start);
+    pthread_cond_destroy(&mp->done);
+    free(mp);
+    host->mp = null;
+}
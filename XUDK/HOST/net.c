@@ -0,0 +1,239 @@
+/*
+ * XUDK - Hosted POSIX backend: loopback or TAP network interface
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#endif
+
+#include "host.h"
+
+#define HOST_LOOPBACK_QUEUE  256
+#define HOST_MAX_FRAME       9018
+
+static status net_get_interfaces(xudk_ctx *ctx, xudk_net_info **interfaces, usize *count) {
+    if (!interfaces || !count) {
+        return XUDK_INVALID_PARAM;
+    }
+    *interfaces = ctx->memory.alloc(ctx, sizeof(xudk_net_info));
+    if (!*interfaces) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    **interfaces = xudk_host_of(ctx)->net;
+    *count = 1;
+    return XUDK_OK;
+}
+
+static status net_configure_interface(xudk_ctx *ctx, u32 interface_id, const xudk_net_info *config) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    if (interface_id != 0 || !config) {
+        return XUDK_INVALID_PARAM;
+    }
+    host->net.dhcp_enabled = config->dhcp_enabled;
+    host->net.ip_address = config->ip_address;
+    host->net.subnet_mask = config->subnet_mask;
+    host->net.gateway = config->gateway;
+    return XUDK_OK;
+}
+
+static status net_send_packet(xudk_ctx *ctx, u32 interface_id, const void *packet, usize size) {
+    xudk_host *host = xudk_host_of(ctx);
+    xudk_host_packet *p;
+
+    if (interface_id != 0 || !packet || !size || size > HOST_MAX_FRAME) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (host->tap_fd >= 0) {
+        return write(host->tap_fd, packet, size) == (ssize_t)size ? XUDK_OK : XUDK_DEVICE_ERROR;
+    }
+
+    // Loopback: every transmitted frame is queued for receive
+    if (host->rx_count >= HOST_LOOPBACK_QUEUE) {
+        return XUDK_BUFFER_OVERFLOW;
+    }
+    p = malloc(sizeof(*p) + size);
+    if (!p) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    p->next = null;
+    p->size = size;
+    memcpy(p->data, packet, size);
+    if (host->rx_tail) {
+        host->rx_tail->next = p;
+    } else {
+        host->rx_head = p;
+    }
+    host->rx_tail = p;
+    host->rx_count++;
+    return XUDK_OK;
+}
+
+static status net_receive_packet(xudk_ctx *ctx, u32 interface_id, void *buffer, usize buffer_size, usize *received) {
+    xudk_host *host = xudk_host_of(ctx);
+    xudk_host_packet *p;
+
+    if (interface_id != 0 || !buffer || !received) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (host->tap_fd >= 0) {
+        ssize_t n = read(host->tap_fd, buffer, buffer_size);
+        if (n < 0) {
+            return errno == EAGAIN ? XUDK_TIMEOUT : XUDK_DEVICE_ERROR;
+        }
+        *received = (usize)n;
+        return XUDK_OK;
+    }
+
+    p = host->rx_head;
+    if (!p) {
+        return XUDK_TIMEOUT;
+    }
+    if (p->size > buffer_size) {
+        *received = p->size;
+        return XUDK_BUFFER_TOO_SMALL;
+    }
+    memcpy(buffer, p->data, p->size);
+    *received = p->size;
+    host->rx_head = p->next;
+    if (!host->rx_head) {
+        host->rx_tail = null;
+    }
+    host->rx_count--;
+    free(p);
+    return XUDK_OK;
+}
+
+static status net_resolve_hostname(xudk_ctx *ctx, const char *hostname, u32 *ip_address) {
+    struct addrinfo hints, *res;
+
+    (void)ctx;
+    if (!hostname || !ip_address) {
+        return XUDK_INVALID_PARAM;
+    }
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    if (getaddrinfo(hostname, null, &hints, &res) != 0) {
+        return XUDK_NOT_FOUND;
+    }
+    *ip_address = ntohl(((struct sockaddr_in*)res->ai_addr)->sin_addr.s_addr);
+    freeaddrinfo(res);
+    return XUDK_OK;
+}
+
+// Only file:// URLs are served; there is no TCP/IP stack on the loopback
+static status net_download_file(xudk_ctx *ctx, const char *url, const wchar *local_path) {
+    char *dst_path;
+    u8 buffer[65536];
+    int in, out;
+    ssize_t n;
+    status s = XUDK_OK;
+
+    if (!url || !local_path) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (strncmp(url, "file://", 7) != 0) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    in = open(url + 7, O_RDONLY);
+    if (in < 0) {
+        return xudk_host_status(errno);
+    }
+    dst_path = xudk_host_path(ctx, local_path);
+    out = dst_path ? open(dst_path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+    free(dst_path);
+    if (out < 0) {
+        close(in);
+        return xudk_host_status(errno);
+    }
+    while ((n = read(in, buffer, sizeof(buffer))) > 0) {
+        if (write(out, buffer, (usize)n) != n) {
+            s = XUDK_DEVICE_ERROR;
+            break;
+        }
+    }
+    if (n < 0) {
+        s = XUDK_DEVICE_ERROR;
+    }
+    close(in);
+    close(out);
+    return s;
+}
+
+static int open_tap(const char *name) {
+#ifdef __linux__
+    struct ifreq ifr;
+    int fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&ifr, 0, sizeof(ifr));
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+    if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    (void)name;
+    return -1;
+#endif
+}
+
+status xudk_host_network_init(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+    static const u8 mac[6] = { 0x02, 0x58, 0x55, 0x44, 0x4B, 0x01 };
+
+    ctx->network.get_interfaces = net_get_interfaces;
+    ctx->network.configure_interface = net_configure_interface;
+    ctx->network.send_packet = net_send_packet;
+    ctx->network.receive_packet = net_receive_packet;
+    ctx->network.resolve_hostname = net_resolve_hostname;
+    ctx->network.download_file = net_download_file;
+
+    memcpy(host->net.mac_address, mac, sizeof(mac));
+    host->net.link_speed = 1000;
+    host->net.link_up = true;
+    host->net.ip_address = 0x7F000001;
+    host->net.subnet_mask = 0xFF000000;
+    host->tap_fd = -1;
+
+    if (host->config.tap_device) {
+        host->tap_fd = open_tap(host->config.tap_device);
+        if (host->tap_fd < 0) {
+            return XUDK_DEVICE_ERROR;
+        }
+        host->net.ip_address = 0;
+        host->net.subnet_mask = 0;
+    }
+    return XUDK_OK;
+}
+
+void xudk_host_network_shutdown(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    if (host->tap_fd >= 0) {
+        close(host->tap_fd);
+        host->tap_fd = -1;
+    }
+    while (host->rx_head) {
+        xudk_host_packet *next = host->rx_head->next;
+        free(host->rx_head);
+        host->rx_head = next;
+    }
+    host->rx_tail = null;
+    host->rx_count = 0;
+}
@@ -0,0 +1,541 @@
+/*
+ * XUDK - Hosted POSIX backend: disks backed by image files
+ * Queued transfers go to a pool of threads, each doing one pread or pwrite
+ * at a time, so the image sees as many requests at once as are queued up to
+ * the pool size.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "host.h"
+
+#define HOST_IO_THREADS     16
+
+// One queued transfer; the token's handle until complete_io
+typedef struct host_io {
+    struct host_io*     next;
+    struct host_io*     issued_prev;    // Every transfer not yet completed, for shutdown
+    struct host_io*     issued_next;
+    xudk_host_disk*     disk;
+    u32                 sector_size;
+    u64                 lba;
+    u32                 count;
+    void*               buffer;
+    bool                write;
+    bool                done;
+    status              result;
+} host_io;
+
+typedef struct xudk_host_io {
+    pthread_t           threads[HOST_IO_THREADS];
+    u32                 thread_count;
+    pthread_mutex_t     lock;
+    pthread_cond_t      queued;
+    pthread_cond_t      completed;
+    host_io*            head;
+    host_io*            tail;
+    host_io*            issued;
+    bool                quit;
+} xudk_host_io;
+
+static xudk_host_disk* host_disk(xudk_ctx *ctx, u32 disk_id) {
+    xudk_host *host = xudk_host_of(ctx);
+    return disk_id < host->disk_count ? &host->disks[disk_id] : null;
+}
+
+static status check_transfer(xudk_host_disk *disk, u64 lba, u32 count, const void *buffer, bool write) {
+    if (!disk || !buffer) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (write && disk->read_only) {
+        return XUDK_WRITE_PROTECTED;
+    }
+    if (lba + count > disk->total_sectors || lba + count < lba) {
+        return XUDK_INVALID_PARAM;
+    }
+    return XUDK_OK;
+}
+
+static status transfer(xudk_host_disk *disk, u32 sector_size, u64 lba, u32 count, void *buffer, bool write) {
+    usize size = (usize)count * sector_size;
+    usize done = 0;
+
+    while (done < size) {
+        off_t at = (off_t)(lba * sector_size + done);
+        ssize_t n = write ? pwrite(disk->fd, (u8*)buffer + done, size - done, at)
+                          : pread(disk->fd, (u8*)buffer + done, size - done, at);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return XUDK_DEVICE_ERROR;
+        }
+        done += (usize)n;
+    }
+    return XUDK_OK;
+}
+
+static status storage_read_sectors(xudk_ctx *ctx, u32 disk_id, u64 lba, u32 count, void *buffer) {
+    xudk_host_disk *disk = host_disk(ctx, disk_id);
+    status s = check_transfer(disk, lba, count, buffer, false);
+
+    return xudk_ok(s) ? transfer(disk, xudk_host_of(ctx)->sector_size, lba, count, buffer, false) : s;
+}
+
+static status storage_write_sectors(xudk_ctx *ctx, u32 disk_id, u64 lba, u32 count, const void *buffer) {
+    xudk_host_disk *disk = host_disk(ctx, disk_id);
+    status s = check_transfer(disk, lba, count, buffer, true);
+
+    return xudk_ok(s) ? transfer(disk, xudk_host_of(ctx)->sector_size, lba, count, (void*)buffer, true) : s;
+}
+
+// =============================================================================
+// QUEUED TRANSFERS
+// =============================================================================
+
+// Workers drain the queue before they honour quit
+static void* io_worker(void *arg) {
+    xudk_host_io *io = arg;
+
+    pthread_mutex_lock(&io->lock);
+    for (;;) {
+        host_io *op;
+
+        while (!io->head && !io->quit) {
+            pthread_cond_wait(&io->queued, &io->lock);
+        }
+        if (!io->head) {
+            break;
+        }
+        op = io->head;
+        io->head = op->next;
+        if (!io->head) {
+            io->tail = null;
+        }
+        pthread_mutex_unlock(&io->lock);
+
+        op->result = transfer(op->disk, op->sector_size, op->lba, op->count, op->buffer, op->write);
+
+        pthread_mutex_lock(&io->lock);
+        op->done = true;
+        pthread_cond_broadcast(&io->completed);
+    }
+    pthread_mutex_unlock(&io->lock);
+    return null;
+}
+
+static xudk_host_io* io_start(xudk_host *host) {
+    xudk_host_io *io = calloc(1, sizeof(*io));
+
+    if (!io) {
+        return null;
+    }
+    pthread_mutex_init(&io->lock, null);
+    pthread_cond_init(&io->queued, null);
+    pthread_cond_init(&io->completed, null);
+    while (io->thread_count < HOST_IO_THREADS) {
+        if (pthread_create(&io->threads[io->thread_count], null, io_worker, io) != 0) {
+            break;
+        }
+        io->thread_count++;
+    }
+    if (!io->thread_count) {
+        pthread_mutex_destroy(&io->lock);
+        pthread_cond_destroy(&io->queued);
+        pthread_cond_destroy(&io->completed);
+        free(io);
+        return null;
+    }
+    host->io = io;
+    return io;
+}
+
+static status queue_transfer(xudk_ctx *ctx, u32 disk_id, u64 lba, u32 count, void *buffer, bool write,
+                             xudk_io_token *token) {
+    xudk_host *host = xudk_host_of(ctx);
+    xudk_host_disk *disk = host_disk(ctx, disk_id);
+    xudk_host_io *io = host->io;
+    status s = check_transfer(disk, lba, count, buffer, write);
+    host_io *op;
+
+    if (xudk_error(s) || !token) {
+        return token ? s : XUDK_INVALID_PARAM;
+    }
+    if (!io && !(io = io_start(host))) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    op = calloc(1, sizeof(*op));
+    if (!op) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    op->disk = disk;
+    op->sector_size = host->sector_size;
+    op->lba = lba;
+    op->count = count;
+    op->buffer = buffer;
+    op->write = write;
+
+    pthread_mutex_lock(&io->lock);
+    if (io->tail) {
+        io->tail->next = op;
+    } else {
+        io->head = op;
+    }
+    io->tail = op;
+    op->issued_next = io->issued;
+    if (io->issued) {
+        io->issued->issued_prev = op;
+    }
+    io->issued = op;
+    pthread_cond_signal(&io->queued);
+    pthread_mutex_unlock(&io->lock);
+    token->io_handle = op;
+    return XUDK_OK;
+}
+
+static status storage_read_sectors_async(xudk_ctx *ctx, u32 disk_id, u64 lba, u32 count, void *buffer,
+                                         xudk_io_token *token) {
+    return queue_transfer(ctx, disk_id, lba, count, buffer, false, token);
+}
+
+static status storage_write_sectors_async(xudk_ctx *ctx, u32 disk_id, u64 lba, u32 count, const void *buffer,
+                                          xudk_io_token *token) {
+    return queue_transfer(ctx, disk_id, lba, count, (void*)buffer, true, token);
+}
+
+static status storage_complete_io(xudk_ctx *ctx, xudk_io_token *token, bool wait) {
+    xudk_host_io *io = xudk_host_of(ctx)->io;
+    host_io *op = token ? token->io_handle : null;
+    status s;
+
+    if (!op || !io) {
+        return XUDK_INVALID_PARAM;
+    }
+    pthread_mutex_lock(&io->lock);
+    while (!op->done && wait) {
+        pthread_cond_wait(&io->completed, &io->lock);
+    }
+    s = op->done ? op->result : XUDK_NOT_READY;
+    if (s != XUDK_NOT_READY) {
+        if (op->issued_prev) {
+            op->issued_prev->issued_next = op->issued_next;
+        } else {
+            io->issued = op->issued_next;
+        }
+        if (op->issued_next) {
+            op->issued_next->issued_prev = op->issued_prev;
+        }
+    }
+    pthread_mutex_unlock(&io->lock);
+    if (s != XUDK_NOT_READY) {
+        free(op);
+        token->io_handle = null;
+    }
+    return s;
+}
+
+static void fill_disk_info(xudk_ctx *ctx, u32 disk_id, xudk_disk_info *info) {
+    xudk_host_disk *disk = &xudk_host_of(ctx)->disks[disk_id];
+
+    xudk_memset(info, 0, sizeof(*info));
+    info->disk_id = disk_id;
+    info->model = disk->model;
+    info->serial = L"XUDK-HOSTED";
+    info->total_sectors = disk->total_sectors;
+    info->sector_size = xudk_host_of(ctx)->sector_size;
+    info->removable = false;
+    info->has_media = true;
+}
+
+static status storage_get_disks(xudk_ctx *ctx, xudk_disk_info **disks, usize *count) {
+    xudk_host *host = xudk_host_of(ctx);
+    xudk_disk_info *list;
+
+    if (!disks || !count) {
+        return XUDK_INVALID_PARAM;
+    }
+    list = ctx->memory.alloc(ctx, (host->disk_count ? host->disk_count : 1) * sizeof(*list));
+    if (!list) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    for (u32 i = 0; i < host->disk_count; i++) {
+        fill_disk_info(ctx, i, &list[i]);
+    }
+    *disks = list;
+    *count = host->disk_count;
+    return XUDK_OK;
+}
+
+static status storage_get_disk_info(xudk_ctx *ctx, u32 disk_id, xudk_disk_info *info) {
+    if (!host_disk(ctx, disk_id) || !info) {
+        return XUDK_INVALID_PARAM;
+    }
+    fill_disk_info(ctx, disk_id, info);
+    return XUDK_OK;
+}
+
+static void put16(u8 *p, u16 v) { p[0] = (u8)v; p[1] = (u8)(v >> 8); }
+static void put32(u8 *p, u32 v) { put16(p, (u16)v); put16(p + 2, (u16)(v >> 16)); }
+static u32  get32(const u8 *p)  { return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24); }
+
+// Add an MBR partition entry; start and size are in sectors
+static status storage_create_partition(xudk_ctx *ctx, u32 disk_id, u64 start, u64 size, u8 type) {
+    xudk_host_disk *disk = host_disk(ctx, disk_id);
+    u8 *mbr;
+    int slot = -1;
+    status s;
+
+    if (!disk || !size || !type || start == 0 || start + size > disk->total_sectors ||
+        start + size > 0xFFFFFFFFULL) {
+        return XUDK_INVALID_PARAM;
+    }
+    mbr = calloc(1, xudk_host_of(ctx)->sector_size);
+    if (!mbr) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    s = ctx->storage.read_sectors(ctx, disk_id, 0, 1, mbr);
+    if (xudk_ok(s) && (mbr[510] != 0x55 || mbr[511] != 0xAA)) {
+        memset(mbr, 0, xudk_host_of(ctx)->sector_size);
+        mbr[510] = 0x55;
+        mbr[511] = 0xAA;
+    }
+
+    for (int i = 0; xudk_ok(s) && i < 4; i++) {
+        u8 *entry = mbr + 446 + i * 16;
+        u64 first = get32(entry + 8);
+        u64 last = first + get32(entry + 12);
+
+        if (entry[4] == 0) {
+            if (slot < 0) {
+                slot = i;
+            }
+        } else if (start < last && first < start + size) {
+            s = XUDK_INVALID_PARAM;
+        }
+    }
+    if (xudk_ok(s) && slot < 0) {
+        s = XUDK_BUFFER_TOO_SMALL;
+    }
+
+    if (xudk_ok(s)) {
+        u8 *entry = mbr + 446 + slot * 16;
+        memset(entry, 0, 16);
+        entry[1] = entry[5] = 0xFE;     // CHS fields unused, LBA only
+        entry[2] = entry[6] = 0xFF;
+        entry[3] = entry[7] = 0xFF;
+        entry[4] = type;
+        put32(entry + 8, (u32)start);
+        put32(entry + 12, (u32)size);
+        s = ctx->storage.write_sectors(ctx, disk_id, 0, 1, mbr);
+    }
+    free(mbr);
+    return s;
+}
+
+// Format the whole disk as a FAT32 volume without a partition table
+static status format_fat32(xudk_ctx *ctx, u32 disk_id) {
+    xudk_host_disk *disk = host_disk(ctx, disk_id);
+    u32 bps = xudk_host_of(ctx)->sector_size;
+    u64 total = disk->total_sectors;
+    u32 reserved = 32, fats = 2, spc;
+    u32 fat_size, data_start, clusters;
+    u8 *sector;
+    status s = XUDK_OK;
+
+    if (total > 0xFFFFFFFFULL || total * bps < 33 * 1024 * 1024ULL) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    if (total * bps <= 260ULL << 20) {
+        spc = 1;
+    } else if (total * bps <= 8ULL << 30) {
+        spc = 8;
+    } else if (total * bps <= 16ULL << 30) {
+        spc = 16;
+    } else if (total * bps <= 32ULL << 30) {
+        spc = 32;
+    } else {
+        spc = 64;
+    }
+    fat_size = (u32)((total - reserved + (256 * spc + fats) / 2 - 1) / ((256 * spc + fats) / 2));
+    data_start = reserved + fats * fat_size;
+    clusters = (u32)((total - data_start) / spc);
+
+    sector = calloc(1, bps);
+    if (!sector) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+
+    // Boot sector / BPB, primary at 0 and backup at 6
+    sector[0] = 0xEB; sector[1] = 0x58; sector[2] = 0x90;
+    memcpy(sector + 3, "XUDK    ", 8);
+    put16(sector + 11, (u16)bps);
+    sector[13] = (u8)spc;
+    put16(sector + 14, (u16)reserved);
+    sector[16] = (u8)fats;
+    sector[21] = 0xF8;
+    put16(sector + 24, 63);
+    put16(sector + 26, 255);
+    put32(sector + 32, (u32)total);
+    put32(sector + 36, fat_size);
+    put32(sector + 44, 2);              // Root directory cluster
+    put16(sector + 48, 1);              // FSInfo sector
+    put16(sector + 50, 6);              // Backup boot sector
+    sector[64] = 0x80;
+    sector[66] = 0x29;
+    put32(sector + 67, (u32)total * 2654435761u);
+    memcpy(sector + 71, "NO NAME    ", 11);
+    memcpy(sector + 82, "FAT32   ", 8);
+    sector[510] = 0x55;
+    sector[511] = 0xAA;
+    s = ctx->storage.write_sectors(ctx, disk_id, 0, 1, sector);
+    if (xudk_ok(s)) {
+        s = ctx->storage.write_sectors(ctx, disk_id, 6, 1, sector);
+    }
+
+    // FSInfo, primary at 1 and backup at 7
+    memset(sector, 0, bps);
+    put32(sector, 0x41615252);
+    put32(sector + 484, 0x61417272);
+    put32(sector + 488, clusters - 1);
+    put32(sector + 492, 3);
+    put32(sector + 508, 0xAA550000);
+    if (xudk_ok(s)) {
+        s = ctx->storage.write_sectors(ctx, disk_id, 1, 1, sector);
+    }
+    if (xudk_ok(s)) {
+        s = ctx->storage.write_sectors(ctx, disk_id, 7, 1, sector);
+    }
+
+    // Both FAT copies: media/EOC markers and the root directory chain
+    for (u32 f = 0; xudk_ok(s) && f < fats; f++) {
+        for (u32 i = 0; xudk_ok(s) && i < fat_size; i++) {
+            memset(sector, 0, bps);
+            if (i == 0) {
+                put32(sector, 0x0FFFFFF8);
+                put32(sector + 4, 0x0FFFFFFF);
+                put32(sector + 8, 0x0FFFFFFF);
+            }
+            s = ctx->storage.write_sectors(ctx, disk_id, reserved + f * fat_size + i, 1, sector);
+        }
+    }
+
+    // Empty root directory cluster
+    memset(sector, 0, bps);
+    for (u32 i = 0; xudk_ok(s) && i < spc; i++) {
+        s = ctx->storage.write_sectors(ctx, disk_id, data_start + i, 1, sector);
+    }
+
+    free(sector);
+    return s;
+}
+
+static status storage_format_disk(xudk_ctx *ctx, u32 disk_id, const wchar *filesystem) {
+    xudk_host_disk *disk = host_disk(ctx, disk_id);
+
+    if (!disk || !filesystem) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (disk->read_only) {
+        return XUDK_WRITE_PROTECTED;
+    }
+    if (!xudk_strcmp(filesystem, L"FAT32") || !xudk_strcmp(filesystem, L"fat32")) {
+        return format_fat32(ctx, disk_id);
+    }
+    return XUDK_NOT_SUPPORTED;
+}
+
+status xudk_host_storage_init(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+    const xudk_host_config *config = &host->config;
+
+    ctx->storage.get_disks = storage_get_disks;
+    ctx->storage.read_sectors = storage_read_sectors;
+    ctx->storage.write_sectors = storage_write_sectors;
+    ctx->storage.get_disk_info = storage_get_disk_info;
+    ctx->storage.format_disk = storage_format_disk;
+    ctx->storage.create_partition = storage_create_partition;
+    ctx->storage.read_sectors_async = storage_read_sectors_async;
+    ctx->storage.write_sectors_async = storage_write_sectors_async;
+    ctx->storage.complete_io = storage_complete_io;
+
+    host->sector_size = config->sector_size ? config->sector_size : 512;
+    if (!config->disk_count) {
+        return XUDK_OK;
+    }
+    host->disks = calloc(config->disk_count, sizeof(*host->disks));
+    if (!host->disks) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+
+    for (usize i = 0; i < config->disk_count; i++) {
+        xudk_host_disk *disk = &host->disks[i];
+        const char *name = strrchr(config->disk_images[i], '/');
+        struct stat st;
+        usize len;
+
+        disk->fd = open(config->disk_images[i], O_RDWR);
+        if (disk->fd < 0) {
+            disk->fd = open(config->disk_images[i], O_RDONLY);
+            disk->read_only = true;
+        }
+        if (disk->fd < 0) {
+            return xudk_host_status(errno);
+        }
+        host->disk_count++;
+        if (fstat(disk->fd, &st) != 0) {
+            return xudk_host_status(errno);
+        }
+        disk->total_sectors = (u64)st.st_size / host->sector_size;
+
+        name = name ? name + 1 : config->disk_images[i];
+        len = strlen(name);
+        disk->model = calloc(len + 1, sizeof(wchar));
+        if (disk->model) {
+            xudk_ascii_to_unicode(name, disk->model);
+        }
+    }
+    return XUDK_OK;
+}
+
+void xudk_host_storage_shutdown(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+    xudk_host_io *io = host->io;
+
+    // Transfers still queued finish first, then every transfer nobody completed
+    // is freed; their tokens must not be passed to complete_io afterwards
+    if (io) {
+        pthread_mutex_lock(&io->lock);
+        io->quit = true;
+        pthread_cond_broadcast(&io->queued);
+        pthread_mutex_unlock(&io->lock);
+        for (u32 i = 0; i < io->thread_count; i++) {
+            pthread_join(io->threads[i], null);
+        }
+        while (io->issued) {
+            host_io *op = io->issued;
+
+            io->issued = op->issued_next;
+            free(op);
+        }
+        pthread_mutex_destroy(&io->lock);
+        pthread_cond_destroy(&io->queued);
+        pthread_cond_destroy(&io->completed);
+        free(io);
+        host->io = null;
+    }
+    for (usize i = 0; i < host->disk_count; i++) {
+        close(host->disks[i].fd);
+        free(host->disks[i].model);
+    }
+    free(host->disks);
+    host->disks = null;
+    host->disk_count = 0;
+}
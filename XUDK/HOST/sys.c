@@ -0,0 +1,316 @@
+/*
+ * XUDK - Hosted POSIX backend: clock, variables and platform control
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host.h"
+
+// Exit code used for reset_system so a wrapper script can restart the app
+#define HOST_RESET_EXIT_CODE  3
+
+static status sys_get_system_info(xudk_ctx *ctx, xudk_system_info *info) {
+    if (!info) {
+        return XUDK_INVALID_PARAM;
+    }
+    xudk_memset(info, 0, sizeof(*info));
+    info->firmware_vendor = L"XUDK Hosted";
+    info->firmware_revision = 0x00020001;
+    info->system_vendor = L"POSIX";
+    info->product_name = L"Hosted Runtime";
+    info->serial_number = L"0";
+    info->total_memory = ctx->memory.get_total_memory(ctx);
+    info->cpu_count = (u32)sysconf(_SC_NPROCESSORS_ONLN);
+    info->boot_mode = 1;
+    return XUDK_OK;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static i64 days_from_civil(i64 y, u32 m, u32 d) {
+    i64 era;
+    u32 yoe, doy, doe;
+
+    y -= m <= 2;
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = (u32)(y - era * 400);
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (i64)doe - 719468;
+}
+
+static status sys_get_time(xudk_ctx *ctx, xudk_time_info *time_info) {
+    struct timespec ts;
+    struct tm tm;
+    time_t secs;
+
+    if (!time_info) {
+        return XUDK_INVALID_PARAM;
+    }
+    clock_gettime(CLOCK_REALTIME, &ts);
+    secs = ts.tv_sec + (time_t)xudk_host_of(ctx)->time_offset;
+    gmtime_r(&secs, &tm);
+
+    time_info->year = (u16)(tm.tm_year + 1900);
+    time_info->month = (u8)(tm.tm_mon + 1);
+    time_info->day = (u8)tm.tm_mday;
+    time_info->hour = (u8)tm.tm_hour;
+    time_info->minute = (u8)tm.tm_min;
+    time_info->second = (u8)tm.tm_sec;
+    time_info->nanosecond = (u32)ts.tv_nsec;
+    time_info->timezone = 0;
+    time_info->daylight = 0;
+    time_info->timestamp = (u64)secs;
+    return XUDK_OK;
+}
+
+// The host clock is not ours to change; keep an offset instead
+static status sys_set_time(xudk_ctx *ctx, const xudk_time_info *time_info) {
+    struct timespec ts;
+    i64 secs;
+
+    if (!time_info || time_info->month < 1 || time_info->month > 12 || time_info->day < 1 ||
+        time_info->day > 31 || time_info->hour > 23 || time_info->minute > 59 || time_info->second > 59) {
+        return XUDK_INVALID_PARAM;
+    }
+    secs = days_from_civil(time_info->year, time_info->month, time_info->day) * 86400 +
+           time_info->hour * 3600 + time_info->minute * 60 + time_info->second;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    xudk_host_of(ctx)->time_offset = secs - (i64)ts.tv_sec;
+    return XUDK_OK;
+}
+
+static status sys_reset_system(xudk_ctx *ctx, u32 reset_type) {
+    (void)reset_type;
+    xudk_cleanup(ctx);
+    exit(HOST_RESET_EXIT_CODE);
+}
+
+static status sys_shutdown_system(xudk_ctx *ctx) {
+    xudk_cleanup(ctx);
+    exit(0);
+}
+
+static void sys_delay(xudk_ctx *ctx, u32 microseconds) {
+    struct timespec ts;
+
+    (void)ctx;
+    ts.tv_sec = microseconds / 1000000;
+    ts.tv_nsec = (long)(microseconds % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+// Timer events run on CLOCK_MONOTONIC
+typedef struct {
+    u64     deadline;   // 0 when not set
+    u64     period;     // 0 for one firing
+} host_timer;
+
+static u64 monotonic_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+static status sys_create_timer(xudk_ctx *ctx, handle *timer) {
+    (void)ctx;
+    if (!timer) {
+        return XUDK_INVALID_PARAM;
+    }
+    *timer = calloc(1, sizeof(host_timer));
+    return *timer ? XUDK_OK : XUDK_OUT_OF_MEMORY;
+}
+
+static status sys_set_timer(xudk_ctx *ctx, handle timer, u64 nanoseconds, bool periodic) {
+    host_timer *t = timer;
+
+    (void)ctx;
+    if (!t) {
+        return XUDK_INVALID_PARAM;
+    }
+    t->deadline = nanoseconds ? monotonic_ns() + nanoseconds : 0;
+    t->period = periodic ? nanoseconds : 0;
+    return XUDK_OK;
+}
+
+// Sleeps in select() when a key may wake it, else in clock_nanosleep()
+static status sys_wait_for_timer(xudk_ctx *ctx, handle timer, bool key_wakes) {
+    host_timer *t = timer;
+    struct timespec until;
+    struct timeval timeout;
+    fd_set keys;
+    u64 now, us;
+    int ready;
+
+    (void)ctx;
+    if (!t) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!t->deadline && !key_wakes) {
+        return XUDK_NOT_READY;
+    }
+    for (;;) {
+        now = monotonic_ns();
+        if (t->deadline && now >= t->deadline) {
+            t->deadline = t->period ? t->deadline + t->period : 0;
+            if (t->deadline && t->deadline <= now) {
+                t->deadline = now + t->period;
+            }
+            return XUDK_OK;
+        }
+        if (key_wakes) {
+            FD_ZERO(&keys);
+            FD_SET(STDIN_FILENO, &keys);
+            us = (t->deadline - now + 999) / 1000;
+            timeout.tv_sec = (time_t)(us / 1000000);
+            timeout.tv_usec = (suseconds_t)(us % 1000000);
+            ready = select(STDIN_FILENO + 1, &keys, null, null, t->deadline ? &timeout : null);
+            if (ready > 0) {
+                return XUDK_NOT_READY;
+            }
+            if (ready < 0 && errno != EINTR) {
+                return XUDK_DEVICE_ERROR;
+            }
+        } else {
+            until.tv_sec = (time_t)(t->deadline / 1000000000ULL);
+            until.tv_nsec = (long)(t->deadline % 1000000000ULL);
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, null);
+        }
+    }
+}
+
+static status sys_close_timer(xudk_ctx *ctx, handle timer) {
+    (void)ctx;
+    if (!timer) {
+        return XUDK_INVALID_PARAM;
+    }
+    free(timer);
+    return XUDK_OK;
+}
+
+static xudk_host_var* find_variable(xudk_ctx *ctx, const wchar *name, const wchar *vendor) {
+    for (xudk_host_var *var = xudk_host_of(ctx)->variables; var; var = var->next) {
+        if (!xudk_strcmp(var->name, name) && !xudk_strcmp(var->vendor, vendor ? vendor : L"")) {
+            return var;
+        }
+    }
+    return null;
+}
+
+static status sys_get_variable(xudk_ctx *ctx, const wchar *name, const wchar *vendor, void **data, usize *size) {
+    xudk_host_var *var;
+
+    if (!name || !data || !size) {
+        return XUDK_INVALID_PARAM;
+    }
+    var = find_variable(ctx, name, vendor);
+    if (!var) {
+        return XUDK_NOT_FOUND;
+    }
+    *data = ctx->memory.alloc(ctx, var->size);
+    if (!*data) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memcpy(*data, var->data, var->size);
+    *size = var->size;
+    return XUDK_OK;
+}
+
+static status sys_set_variable(xudk_ctx *ctx, const wchar *name, const wchar *vendor, const void *data, usize size) {
+    xudk_host *host = xudk_host_of(ctx);
+    xudk_host_var *var, **link;
+    void *copy = null;
+
+    if (!name || (size && !data)) {
+        return XUDK_INVALID_PARAM;
+    }
+    var = find_variable(ctx, name, vendor);
+
+    // Zero size deletes, as with SetVariable()
+    if (!size) {
+        if (!var) {
+            return XUDK_NOT_FOUND;
+        }
+        for (link = &host->variables; *link != var; link = &(*link)->next) {
+        }
+        *link = var->next;
+        free(var->name);
+        free(var->vendor);
+        free(var->data);
+        free(var);
+        return XUDK_OK;
+    }
+
+    copy = malloc(size);
+    if (!copy) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    memcpy(copy, data, size);
+    if (!var) {
+        var = calloc(1, sizeof(*var));
+        if (!var || !(var->name = xudk_host_wcsdup(name)) || !(var->vendor = xudk_host_wcsdup(vendor ? vendor : L""))) {
+            if (var) {
+                free(var->name);
+            }
+            free(var);
+            free(copy);
+            return XUDK_OUT_OF_MEMORY;
+        }
+        var->next = host->variables;
+        host->variables = var;
+    }
+    free(var->data);
+    var->data = copy;
+    var->size = size;
+    return XUDK_OK;
+}
+
+static status sys_enable_interrupt(xudk_ctx *ctx, u32 vector) {
+    (void)ctx;
+    (void)vector;
+    return XUDK_NOT_SUPPORTED;
+}
+
+static status sys_disable_interrupt(xudk_ctx *ctx, u32 vector) {
+    (void)ctx;
+    (void)vector;
+    return XUDK_NOT_SUPPORTED;
+}
+
+void xudk_host_system_init(xudk_ctx *ctx) {
+    ctx->system.get_system_info = sys_get_system_info;
+    ctx->system.get_time = sys_get_time;
+    ctx->system.set_time = sys_set_time;
+    ctx->system.reset_system = sys_reset_system;
+    ctx->system.shutdown_system = sys_shutdown_system;
+    ctx->system.delay = sys_delay;
+    ctx->system.get_variable = sys_get_variable;
+    ctx->system.set_variable = sys_set_variable;
+    ctx->system.enable_interrupt = sys_enable_interrupt;
+    ctx->system.disable_interrupt = sys_disable_interrupt;
+    ctx->system.create_timer = sys_create_timer;
+    ctx->system.set_timer = sys_set_timer;
+    ctx->system.wait_for_timer = sys_wait_for_timer;
+    ctx->system.close_timer = sys_close_timer;
+}
+
+void xudk_host_system_shutdown(xudk_ctx *ctx) {
+    xudk_host *host = xudk_host_of(ctx);
+
+    while (host->variables) {
+        xudk_host_var *next = host->variables->next;
+        free(host->variables->name);
+        free(host->variables->vendor);
+        free(host->variables->data);
+        free(host->variables);
+        host->variables = next;
+    }
+}
@@ -0,0 +1,1250 @@
+/*
+ * XUDK - Software rasterizer: device, resources, shaders and presentation
+ */
+
+#include "swr_int.h"
+
+#define SWR_MAX_TEXTURE_SIZE    8192
+#define SWR_BUFFER_ALIGNMENT    64
+
+bool swr_reserve(xudk_ctx *ctx, void **array, usize *capacity, usize needed, usize element_size) {
+    usize new_capacity;
+    void *grown;
+
+    if (needed <= *capacity) {
+        return true;
+    }
+    new_capacity = *capacity ? *capacity : 16;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    grown = ctx->memory.alloc(ctx, new_capacity * element_size);
+    if (!grown) {
+        return false;
+    }
+    if (*array) {
+        xudk_memcpy(grown, *array, *capacity * element_size);
+        ctx->memory.free(ctx, *array);
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+void swr_parallel(xudk_ctx *ctx, void (*worker)(void *job), void *job) {
+    if (!ctx->system.run_on_all_processors || xudk_error(ctx->system.run_on_all_processors(ctx, worker, job))) {
+        worker(job);
+    }
+}
+
+u64 swr_now(xudk_ctx *ctx) {
+    xudk_time_info now;
+
+    if (!ctx->system.get_time || xudk_error(ctx->system.get_time(ctx, &now))) {
+        return 0;
+    }
+    return now.timestamp * 1000000000ULL + now.nanosecond;
+}
+
+// =============================================================================
+// DEVICE MANAGEMENT
+// =============================================================================
+
+static void swr_fill_info(xudk_ctx *ctx, xudk_gpu_info *info) {
+    xudk_system_info system;
+
+    xudk_memset(info, 0, sizeof(*info));
+    info->vendor = XUDK_GPU_VENDOR_SOFTWARE;
+    info->architecture = XUDK_GPU_ARCH_SOFTWARE;
+    info->device_name = L"XUDK Software Rasterizer";
+    info->driver_version = L"1.0";
+    info->shared_memory_size = ctx->memory.get_total_memory ? ctx->memory.get_total_memory(ctx) : 0;
+    info->compute_units = 1;
+    if (ctx->system.get_system_info && xudk_ok(ctx->system.get_system_info(ctx, &system)) && system.cpu_count) {
+        info->compute_units = system.cpu_count;
+    }
+    info->max_texture_size = SWR_MAX_TEXTURE_SIZE;
+    info->max_render_targets = 1;
+    info->supports_compute = true;
+    info->supports_shader_cache = false;    // Bytecode holds function pointers
+    info->max_shader_model = 50;
+}
+
+static status swr_enumerate_devices(xudk_ctx *ctx, xudk_gpu_info **devices, usize *count) {
+    if (!devices || !count) {
+        return XUDK_INVALID_PARAM;
+    }
+    *devices = ctx->memory.alloc(ctx, sizeof(xudk_gpu_info));
+    if (!*devices) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    swr_fill_info(ctx, *devices);
+    *count = 1;
+    return XUDK_OK;
+}
+
+static status swr_shutdown_device(xudk_ctx *ctx);
+
+static status swr_initialize_device(xudk_ctx *ctx, u32 device_index) {
+    swr_device *dev;
+    status s;
+
+    if (device_index != 0) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    if (ctx->gpu_device) {
+        return XUDK_OK;
+    }
+    dev = ctx->memory.alloc(ctx, sizeof(*dev));
+    if (!dev) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(dev, 0, sizeof(*dev));
+    dev->ctx = ctx;
+    swr_fill_info(ctx, &dev->info);
+    dev->cpu_count = dev->info.compute_units;
+    dev->heap.type = XUDK_GPU_MEM_UNIFIED;
+    dev->heap.size = dev->info.shared_memory_size;
+    dev->heap.available = ctx->memory.get_free_memory ? ctx->memory.get_free_memory(ctx) : dev->heap.size;
+    dev->heap.device_local = true;
+    dev->heap.host_visible = true;
+    dev->heap.host_coherent = true;
+
+    ctx->gpu_device = dev;
+    ctx->gpu_initialized = true;
+    ctx->active_gpu_device = 0;
+    ctx->gpu_device_info = dev->info;
+    ctx->gpu_memory_heaps = &dev->heap;
+    ctx->gpu_heap_count = 1;
+
+    s = swr_register_builtin_shaders(ctx);
+    if (xudk_error(s)) {
+        swr_shutdown_device(ctx);
+        return s;
+    }
+    xudk_log_debug(ctx, L"SWR: %u processors, %ux%u tiles", dev->cpu_count, XUDK_SWR_TILE_SIZE, XUDK_SWR_TILE_SIZE);
+    return XUDK_OK;
+}
+
+static status swr_shutdown_device(xudk_ctx *ctx) {
+    swr_device *dev = swr_device_of(ctx);
+
+    if (!dev) {
+        return XUDK_OK;
+    }
+    for (u32 i = 0; i < dev->pass.bin_count; i++) {
+        ctx->memory.free(ctx, dev->pass.bins[i].items);
+    }
+    ctx->memory.free(ctx, dev->pass.bins);
+    ctx->memory.free(ctx, dev->pass.tris);
+    ctx->memory.free(ctx, dev->pass.varyings);
+    ctx->memory.free(ctx, dev->pass.states);
+    ctx->memory.free(ctx, dev->vertex_cache);
+    ctx->memory.free(ctx, dev->present_buffer);
+    ctx->memory.free(ctx, dev->shaders);
+    ctx->memory.free(ctx, dev);
+
+    ctx->gpu_device = null;
+    ctx->gpu_initialized = false;
+    ctx->gpu_memory_heaps = null;
+    ctx->gpu_heap_count = 0;
+    return XUDK_OK;
+}
+
+static status swr_get_device_info(xudk_ctx *ctx, xudk_gpu_info *info) {
+    swr_device *dev = swr_device_of(ctx);
+
+    if (!info) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!dev) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    *info = dev->info;
+    return XUDK_OK;
+}
+
+static status swr_get_memory_heaps(xudk_ctx *ctx, xudk_gpu_heap **heaps, usize *count) {
+    swr_device *dev = swr_device_of(ctx);
+
+    if (!heaps || !count) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!dev) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    dev->heap.available = ctx->memory.get_free_memory ? ctx->memory.get_free_memory(ctx) : dev->heap.size;
+    *heaps = &dev->heap;
+    *count = 1;
+    return XUDK_OK;
+}
+
+// =============================================================================
+// BUFFERS
+// =============================================================================
+
+static status swr_allocate_buffer(xudk_ctx *ctx, u64 size, xudk_buffer_usage usage, xudk_gpu_buffer *buffer) {
+    swr_device *dev = swr_device_of(ctx);
+    swr_buffer *b;
+
+    if (!buffer || !size) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!dev) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    b = ctx->memory.alloc(ctx, sizeof(*b));
+    if (!b) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    b->size = size;
+    b->data = ctx->memory.alloc_aligned(ctx, (usize)size, SWR_BUFFER_ALIGNMENT);
+    if (!b->data) {
+        ctx->memory.free(ctx, b);
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(b->data, 0, (usize)size);
+    dev->memory_used += size;
+
+    xudk_memset(buffer, 0, sizeof(*buffer));
+    buffer->buffer_handle = b;
+    buffer->size = size;
+    buffer->usage = usage;
+    buffer->gpu_address = (u64)(usize)b->data;
+    return XUDK_OK;
+}
+
+static status swr_free_buffer(xudk_ctx *ctx, xudk_gpu_buffer *buffer) {
+    swr_device *dev = swr_device_of(ctx);
+    swr_buffer *b;
+
+    if (!buffer || !buffer->buffer_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    b = buffer->buffer_handle;
+    if (dev) {
+        dev->memory_used -= b->size;
+    }
+    ctx->memory.free(ctx, b->data);
+    ctx->memory.free(ctx, b);
+    buffer->buffer_handle = null;
+    buffer->mapped_ptr = null;
+    buffer->is_mapped = false;
+    return XUDK_OK;
+}
+
+// Buffers live in system memory, so a map is just the backing pointer
+static status swr_map_buffer(xudk_ctx *ctx, xudk_gpu_buffer *buffer, void **mapped_ptr) {
+    swr_buffer *b;
+
+    (void)ctx;
+    if (!buffer || !buffer->buffer_handle || !mapped_ptr) {
+        return XUDK_INVALID_PARAM;
+    }
+    b = buffer->buffer_handle;
+    buffer->mapped_ptr = b->data;
+    buffer->is_mapped = true;
+    *mapped_ptr = b->data;
+    return XUDK_OK;
+}
+
+static status swr_unmap_buffer(xudk_ctx *ctx, xudk_gpu_buffer *buffer) {
+    (void)ctx;
+    if (!buffer || !buffer->buffer_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    buffer->mapped_ptr = null;
+    buffer->is_mapped = false;
+    return XUDK_OK;
+}
+
+static status swr_upload_buffer_data(xudk_ctx *ctx, xudk_gpu_buffer *buffer, const void *data, usize size, usize offset) {
+    swr_buffer *b;
+
+    (void)ctx;
+    if (!buffer || !buffer->buffer_handle || (!data && size)) {
+        return XUDK_INVALID_PARAM;
+    }
+    b = buffer->buffer_handle;
+    if (offset > b->size || size > b->size - offset) {
+        return XUDK_BUFFER_OVERFLOW;
+    }
+    xudk_memcpy(b->data + offset, data, size);
+    return XUDK_OK;
+}
+
+// =============================================================================
+// TEXTURES
+// =============================================================================
+
+static u32 mip_extent(u32 size, u32 level) {
+    size >>= level;
+    return size ? size : 1;
+}
+
+static u64 subresource_size(const swr_texture *t, u32 level) {
+    return (u64)mip_extent(t->width, level) * mip_extent(t->height, level) * mip_extent(t->depth, level) * t->texel_size;
+}
+
+// Layout: slice-major, each slice holding its full mip chain
+static u64 subresource_offset(const swr_texture *t, u32 level, u32 slice) {
+    u64 slice_size = 0;
+    u64 offset = 0;
+
+    for (u32 i = 0; i < t->mip_levels; i++) {
+        if (i == level) {
+            offset = slice_size;
+        }
+        slice_size += subresource_size(t, i);
+    }
+    return slice_size * slice + offset;
+}
+
+// BCn textures are kept as R8G8B8A8 and decoded on upload, so they sample
+// like any other; texture->format still reports the compressed format
+static status swr_texture_init(xudk_ctx *ctx, u32 width, u32 height, u32 depth, xudk_texture_format format,
+                               u32 mip_levels, u32 array_size, xudk_gpu_texture *texture) {
+    swr_device *dev = swr_device_of(ctx);
+    bool compressed = xudk_gpu_compressed_size(format, 1, 1) && format != XUDK_FORMAT_BC6H_UF16;
+    xudk_texture_format storage = compressed ? XUDK_FORMAT_R8G8B8A8_UNORM : format;
+    u32 texel_size = swr_texel_size(storage);
+    swr_texture *t;
+
+    if (!texture || !width || !height) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!dev) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    if (!texel_size) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    if (width > SWR_MAX_TEXTURE_SIZE || height > SWR_MAX_TEXTURE_SIZE) {
+        return XUDK_TEXTURE_ERROR;
+    }
+
+    t = ctx->memory.alloc(ctx, sizeof(*t));
+    if (!t) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    t->width = width;
+    t->height = height;
+    t->depth = depth ? depth : 1;
+    t->mip_levels = mip_levels ? mip_levels : 1;
+    t->array_size = array_size ? array_size : 1;
+    t->texel_size = texel_size;
+    t->format = storage;
+    t->compressed = compressed ? format : XUDK_FORMAT_UNKNOWN;
+    t->size = subresource_offset(t, 0, t->array_size);
+    t->data = ctx->memory.alloc_aligned(ctx, (usize)t->size, SWR_BUFFER_ALIGNMENT);
+    if (!t->data) {
+        ctx->memory.free(ctx, t);
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(t->data, 0, (usize)t->size);
+    dev->memory_used += t->size;
+
+    xudk_memset(texture, 0, sizeof(*texture));
+    texture->texture_handle = t;
+    texture->width = width;
+    texture->height = height;
+    texture->depth = t->depth;
+    texture->mip_levels = t->mip_levels;
+    texture->array_size = t->array_size;
+    texture->format = format;
+    texture->sample_count = 1;
+    texture->size = t->size;
+    texture->gpu_address = (addr)(usize)t->data;
+    return XUDK_OK;
+}
+
+static status swr_create_texture(xudk_ctx *ctx, u32 width, u32 height, u32 depth, xudk_texture_format format,
+                                 u32 mip_levels, u32 array_size, xudk_gpu_texture *texture) {
+    return swr_texture_init(ctx, width, height, depth, format, mip_levels, array_size, texture);
+}
+
+// Multisampling is not emulated; targets are always single-sampled
+static status swr_create_render_target(xudk_ctx *ctx, u32 width, u32 height, xudk_texture_format format,
+                                       u32 sample_count, xudk_gpu_texture *texture) {
+    status s;
+
+    (void)sample_count;
+    if (format == XUDK_FORMAT_D32_FLOAT || format == XUDK_FORMAT_D24_UNORM_S8_UINT ||
+        xudk_gpu_compressed_size(format, 1, 1)) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = swr_texture_init(ctx, width, height, 1, format, 1, 1, texture);
+    if (xudk_ok(s)) {
+        texture->is_render_target = true;
+    }
+    return s;
+}
+
+static status swr_create_depth_stencil(xudk_ctx *ctx, u32 width, u32 height, xudk_texture_format format,
+                                       u32 sample_count, xudk_gpu_texture *texture) {
+    status s;
+
+    (void)sample_count;
+    if (format != XUDK_FORMAT_D32_FLOAT && format != XUDK_FORMAT_D24_UNORM_S8_UINT) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = swr_texture_init(ctx, width, height, 1, format, 1, 1, texture);
+    if (xudk_ok(s)) {
+        texture->is_depth_stencil = true;
+    }
+    return s;
+}
+
+static status swr_destroy_texture(xudk_ctx *ctx, xudk_gpu_texture *texture) {
+    swr_device *dev = swr_device_of(ctx);
+    swr_texture *t;
+
+    if (!texture || !texture->texture_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    t = texture->texture_handle;
+    if (dev) {
+        dev->memory_used -= t->size;
+        if (dev->last_presented == t) {
+            dev->last_presented = null;
+        }
+    }
+    ctx->memory.free(ctx, t->data);
+    ctx->memory.free(ctx, t);
+    texture->texture_handle = null;
+    return XUDK_OK;
+}
+
+// Whole subresource of BCn blocks, one slice after another, decoded in place
+static status upload_compressed(xudk_ctx *ctx, swr_texture *t, const u8 *data, usize size,
+                                u32 mip_level, u32 array_slice) {
+    u32 width = mip_extent(t->width, mip_level), height = mip_extent(t->height, mip_level);
+    u32 depth = mip_extent(t->depth, mip_level);
+    usize slice = xudk_gpu_compressed_size(t->compressed, width, height);
+    u8 *dst = t->data + subresource_offset(t, mip_level, array_slice);
+    status s = XUDK_OK;
+
+    if (size > slice * depth) {
+        return XUDK_BUFFER_OVERFLOW;
+    }
+    if (size < slice * depth) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (u32 z = 0; z < depth && xudk_ok(s); z++) {
+        s = xudk_gpu_decompress_texture(ctx, t->compressed, data + z * slice, width, height,
+                                        dst + (usize)z * width * height * t->texel_size);
+    }
+    return s;
+}
+
+// Data is tightly packed rows of the subresource, or its blocks for BCn formats
+status swr_texture_write(xudk_ctx *ctx, swr_texture *t, const void *data, usize size, u32 mip_level, u32 array_slice) {
+    u64 capacity;
+
+    if (mip_level >= t->mip_levels || array_slice >= t->array_size) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (t->compressed) {
+        return upload_compressed(ctx, t, data, size, mip_level, array_slice);
+    }
+    capacity = subresource_size(t, mip_level);
+    if (size > capacity) {
+        return XUDK_BUFFER_OVERFLOW;
+    }
+    xudk_memcpy(t->data + subresource_offset(t, mip_level, array_slice), data, size);
+    return XUDK_OK;
+}
+
+static status swr_upload_texture_data(xudk_ctx *ctx, xudk_gpu_texture *texture, const void *data, usize size,
+                                      u32 mip_level, u32 array_slice) {
+    if (!texture || !texture->texture_handle || !data) {
+        return XUDK_INVALID_PARAM;
+    }
+    return swr_texture_write(ctx, texture->texture_handle, data, size, mip_level, array_slice);
+}
+
+// BMP, PNG or QOI decoded straight into a B8G8R8A8 texture
+static status swr_load_texture_from_file(xudk_ctx *ctx, const wchar *path, xudk_gpu_texture *texture) {
+    xudk_image *image;
+    xudk_image_info info;
+    xudk_surface target;
+    swr_texture *t;
+    status s;
+
+    if (!path || !texture) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = xudk_image_open(ctx, path, &image, &info);
+    if (xudk_error(s)) {
+        return s;
+    }
+    s = swr_texture_init(ctx, info.width, info.height, 1, XUDK_FORMAT_B8G8R8A8_UNORM, 1, 1, texture);
+    if (xudk_ok(s)) {
+        t = texture->texture_handle;
+        target.pixels = (u32*)t->data;
+        target.width = info.width;
+        target.height = info.height;
+        target.stride = info.width;
+        target.pixel_format = XUDK_PIXEL_BGRX;
+        s = xudk_image_decode(image, &target, 0, 0, 0);
+        if (xudk_error(s)) {
+            swr_destroy_texture(ctx, texture);
+        }
+    }
+    xudk_image_close(image);
+    return s;
+}
+
+// =============================================================================
+// DESCRIPTOR SETS
+// =============================================================================
+
+// Buffers map to b0..b7 and textures to t0..t7; one texture binding may be an array
+static status swr_create_descriptor_layout(xudk_ctx *ctx, const xudk_gpu_descriptor_binding *bindings, u32 count,
+                                           xudk_gpu_descriptor_layout *layout) {
+    swr_layout l, *out;
+
+    if (!layout || (count && !bindings)) {
+        return XUDK_INVALID_PARAM;
+    }
+    xudk_memset(&l, 0, sizeof(l));
+    for (u32 i = 0; i < count; i++) {
+        const xudk_gpu_descriptor_binding *b = &bindings[i];
+        u32 elements = b->count ? b->count : 1;
+
+        if (b->type > XUDK_DESCRIPTOR_TEXTURE) {
+            return XUDK_INVALID_PARAM;
+        }
+        if (elements > 1) {
+            if (b->type != XUDK_DESCRIPTOR_TEXTURE || l.array_count) {
+                return XUDK_NOT_SUPPORTED;
+            }
+            if (elements > XUDK_SWR_MAX_TEXTURE_ARRAY) {
+                return XUDK_INVALID_PARAM;
+            }
+            l.array_binding = b->binding;
+            l.array_count = elements;
+            continue;
+        }
+        if (b->binding >= XUDK_SWR_MAX_BINDINGS) {
+            return XUDK_INVALID_PARAM;
+        }
+        if (b->type == XUDK_DESCRIPTOR_BUFFER) {
+            l.buffer_mask |= 1u << b->binding;
+        } else {
+            l.texture_mask |= 1u << b->binding;
+        }
+    }
+    // An array binding may not share its number with a single texture
+    if (l.array_count && l.array_binding < XUDK_SWR_MAX_BINDINGS && (l.texture_mask & (1u << l.array_binding))) {
+        return XUDK_INVALID_PARAM;
+    }
+    out = ctx->memory.alloc(ctx, sizeof(*out));
+    if (!out) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    *out = l;
+    layout->layout_handle = out;
+    layout->binding_count = count;
+    return XUDK_OK;
+}
+
+static status swr_destroy_descriptor_layout(xudk_ctx *ctx, xudk_gpu_descriptor_layout *layout) {
+    if (!layout || !layout->layout_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    ctx->memory.free(ctx, layout->layout_handle);
+    layout->layout_handle = null;
+    return XUDK_OK;
+}
+
+static status swr_create_descriptor_set(xudk_ctx *ctx, xudk_gpu_descriptor_layout *layout, handle *descriptor_set) {
+    const swr_layout *l;
+    swr_descriptor_set *set;
+    usize size;
+
+    if (!layout || !layout->layout_handle || !descriptor_set) {
+        return XUDK_INVALID_PARAM;
+    }
+    l = layout->layout_handle;
+    size = sizeof(*set) + (usize)l->array_count * sizeof(xudk_gpu_texture*);
+    set = ctx->memory.alloc(ctx, size);
+    if (!set) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(set, 0, size);
+    set->layout = *l;
+    if (l->array_count) {
+        set->set.texture_array = (xudk_gpu_texture**)(set + 1);
+        set->set.texture_array_count = l->array_count;
+    }
+    *descriptor_set = set;
+    return XUDK_OK;
+}
+
+static bool write_is_array(const swr_layout *layout, const xudk_gpu_descriptor_write *write) {
+    return layout->array_count && write->binding == layout->array_binding && !write->buffer;
+}
+
+// b<n> and t<n> are separate slots: the write's buffer or texture picks one,
+// and a write of neither clears whichever the layout has. Writes are all
+// checked first, so a bad one changes nothing.
+static status swr_update_descriptor_set(xudk_ctx *ctx, handle descriptor_set, u32 count,
+                                        const xudk_gpu_descriptor_write *writes) {
+    swr_descriptor_set *set = descriptor_set;
+    const swr_layout *l = set ? &set->layout : null;
+
+    (void)ctx;
+    if (!set || (count && !writes)) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (u32 i = 0; i < count; i++) {
+        const xudk_gpu_descriptor_write *w = &writes[i];
+        u32 bit = w->binding < XUDK_SWR_MAX_BINDINGS ? 1u << w->binding : 0;
+
+        if (write_is_array(l, w) ? w->array_index >= l->array_count :
+            w->array_index || (w->buffer && w->texture) || (w->buffer && !(l->buffer_mask & bit)) ||
+            (w->texture && !(l->texture_mask & bit)) || !((l->buffer_mask | l->texture_mask) & bit)) {
+            return XUDK_INVALID_PARAM;
+        }
+    }
+    for (u32 i = 0; i < count; i++) {
+        const xudk_gpu_descriptor_write *w = &writes[i];
+        u32 bit = 1u << (w->binding % XUDK_SWR_MAX_BINDINGS);
+
+        if (write_is_array(l, w)) {
+            set->set.texture_array[w->array_index] = w->texture;
+            continue;
+        }
+        if (w->buffer || (!w->texture && (l->buffer_mask & bit))) {
+            set->set.buffers[w->binding] = w->buffer;
+            set->set.buffer_offsets[w->binding] = w->offset;
+        }
+        if (w->texture || (!w->buffer && (l->texture_mask & bit))) {
+            set->set.textures[w->binding] = w->texture;
+        }
+    }
+    return XUDK_OK;
+}
+
+static status swr_destroy_descriptor_set(xudk_ctx *ctx, handle descriptor_set) {
+    if (!descriptor_set) {
+        return XUDK_INVALID_PARAM;
+    }
+    ctx->memory.free(ctx, descriptor_set);
+    return XUDK_OK;
+}
+
+// =============================================================================
+// SHADERS
+// =============================================================================
+
+// FNV-1a over the source with whitespace removed, so reformatting is harmless
+static u64 swr_source_hash(const char *source) {
+    u64 hash = 0xCBF29CE484222325ULL;
+
+    for (; *source; source++) {
+        u8 c = (u8)*source;
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            continue;
+        }
+        hash ^= c;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+status xudk_swr_register_shader(xudk_ctx *ctx, const char *source, const xudk_swr_program *program) {
+    swr_device *dev = swr_device_of(ctx);
+    swr_registered_shader *entry;
+    u64 hash;
+
+    if (!source || !program || program->magic != XUDK_SWR_PROGRAM_MAGIC || !program->entry) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!dev) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    hash = swr_source_hash(source);
+    for (usize i = 0; i < dev->shader_count; i++) {
+        if (dev->shaders[i].hash == hash && dev->shaders[i].program.type == program->type) {
+            dev->shaders[i].program = *program;
+            return XUDK_OK;
+        }
+    }
+    if (!swr_reserve(ctx, (void**)&dev->shaders, &dev->shader_capacity, dev->shader_count + 1, sizeof(*dev->shaders))) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    entry = &dev->shaders[dev->shader_count++];
+    entry->hash = hash;
+    entry->program = *program;
+    return XUDK_OK;
+}
+
+static status swr_create_shader(xudk_ctx *ctx, xudk_shader_type type, const void *bytecode, usize size,
+                                const wchar *entry_point, xudk_gpu_shader *shader) {
+    const xudk_swr_program *program = bytecode;
+    swr_shader *sh;
+
+    if (!shader || !program || size < sizeof(*program)) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (program->magic != XUDK_SWR_PROGRAM_MAGIC || program->type != type || !program->entry ||
+        program->varying_count > XUDK_SWR_MAX_VARYINGS) {
+        return XUDK_SHADER_COMPILE_ERROR;
+    }
+    if (type != XUDK_SHADER_VERTEX && type != XUDK_SHADER_FRAGMENT && type != XUDK_SHADER_COMPUTE) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    sh = ctx->memory.alloc(ctx, sizeof(*sh));
+    if (!sh) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    sh->program = *program;
+
+    xudk_memset(shader, 0, sizeof(*shader));
+    shader->shader_handle = sh;
+    shader->type = type;
+    shader->bytecode_size = sizeof(sh->program);
+    shader->bytecode = &sh->program;
+    shader->entry_point = entry_point ? xudk_strdup(ctx, entry_point) : null;
+    shader->is_compiled = true;
+    return XUDK_OK;
+}
+
+static status swr_compile_shader(xudk_ctx *ctx, xudk_shader_type type, const char *source, const char *entry_point,
+                                 xudk_gpu_shader *shader) {
+    swr_device *dev = swr_device_of(ctx);
+    u64 hash;
+
+    (void)entry_point;
+    if (!source || !shader) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!dev) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    hash = swr_source_hash(source);
+    for (usize i = 0; i < dev->shader_count; i++) {
+        const xudk_swr_program *program = &dev->shaders[i].program;
+        if (dev->shaders[i].hash == hash && program->type == type) {
+            return swr_create_shader(ctx, type, program, sizeof(*program), null, shader);
+        }
+    }
+    xudk_log_warning(ctx, L"SWR: no native program registered for shader source %llx", hash);
+    return XUDK_SHADER_COMPILE_ERROR;
+}
+
+static status swr_destroy_shader(xudk_ctx *ctx, xudk_gpu_shader *shader) {
+    if (!shader || !shader->shader_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (shader->entry_point) {
+        ctx->memory.free(ctx, shader->entry_point);
+    }
+    ctx->memory.free(ctx, shader->shader_handle);
+    shader->shader_handle = null;
+    shader->bytecode = null;
+    shader->entry_point = null;
+    shader->is_compiled = false;
+    return XUDK_OK;
+}
+
+static status swr_load_shader_from_file(xudk_ctx *ctx, const wchar *path, xudk_shader_type type,
+                                        const wchar *entry_point, xudk_gpu_shader *shader) {
+    char *source;
+    void *data;
+    usize size;
+    status s;
+
+    (void)entry_point;
+    if (!path || !shader) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = ctx->filesystem.load_file_to_memory(ctx, path, &data, &size);
+    if (xudk_error(s)) {
+        return s;
+    }
+    source = ctx->memory.alloc(ctx, size + 1);
+    if (!source) {
+        ctx->memory.free(ctx, data);
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memcpy(source, data, size);
+    source[size] = 0;
+    ctx->memory.free(ctx, data);
+
+    s = swr_compile_shader(ctx, type, source, null, shader);
+    ctx->memory.free(ctx, source);
+    return s;
+}
+
+// =============================================================================
+// PIPELINES
+// =============================================================================
+
+static const xudk_swr_program* shader_program(const xudk_gpu_shader *shader, xudk_shader_type type) {
+    const swr_shader *sh;
+
+    if (!shader || !shader->shader_handle) {
+        return null;
+    }
+    sh = shader->shader_handle;
+    return sh->program.type == type ? &sh->program : null;
+}
+
+static status swr_create_graphics_pipeline(xudk_ctx *ctx, const xudk_gpu_pipeline_desc *desc, xudk_gpu_pipeline *pipeline) {
+    const xudk_swr_program *vs, *fs;
+    swr_pipeline *p;
+
+    if (!desc || !pipeline) {
+        return XUDK_INVALID_PARAM;
+    }
+    vs = shader_program(desc->vertex_shader, XUDK_SHADER_VERTEX);
+    fs = shader_program(desc->fragment_shader, XUDK_SHADER_FRAGMENT);
+    if (!vs || !fs || fs->varying_count > vs->varying_count) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (desc->geometry_shader || (desc->topology != XUDK_TOPOLOGY_TRIANGLES &&
+        desc->topology != XUDK_TOPOLOGY_TRIANGLE_STRIP && desc->topology != XUDK_TOPOLOGY_TRIANGLE_FAN)) {
+        return XUDK_NOT_SUPPORTED;
+    }
+
+    p = ctx->memory.alloc(ctx, sizeof(*p));
+    if (!p) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(p, 0, sizeof(*p));
+    p->vs = (xudk_swr_vertex_fn)vs->entry;
+    p->fs = (xudk_swr_fragment_fn)fs->entry;
+    p->varying_count = vs->varying_count;
+    p->topology = desc->topology;
+    p->depth_test = desc->depth_test_enable;
+    p->depth_write = desc->depth_test_enable && desc->depth_write_enable;
+    p->blend = desc->blend_enable;
+
+    xudk_memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->pipeline_handle = p;
+    pipeline->desc = *desc;
+    pipeline->is_compute = false;
+    return XUDK_OK;
+}
+
+static status swr_create_compute_pipeline(xudk_ctx *ctx, xudk_gpu_shader *compute_shader, xudk_gpu_pipeline *pipeline) {
+    const xudk_swr_program *cs = shader_program(compute_shader, XUDK_SHADER_COMPUTE);
+    swr_pipeline *p;
+
+    if (!cs || !pipeline) {
+        return XUDK_INVALID_PARAM;
+    }
+    p = ctx->memory.alloc(ctx, sizeof(*p));
+    if (!p) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(p, 0, sizeof(*p));
+    p->cs = (xudk_swr_compute_fn)cs->entry;
+
+    xudk_memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->pipeline_handle = p;
+    pipeline->desc.compute_shader = compute_shader;
+    pipeline->is_compute = true;
+    return XUDK_OK;
+}
+
+static status swr_destroy_pipeline(xudk_ctx *ctx, xudk_gpu_pipeline *pipeline) {
+    if (!pipeline || !pipeline->pipeline_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    ctx->memory.free(ctx, pipeline->pipeline_handle);
+    pipeline->pipeline_handle = null;
+    return XUDK_OK;
+}
+
+// =============================================================================
+// COMMAND SUBMISSION
+// =============================================================================
+
+static status check_submit(xudk_ctx *ctx, const xudk_gpu_cmd_buffer *cmd_buffer) {
+    if (!cmd_buffer || !cmd_buffer->cmd_buffer_handle || cmd_buffer->is_recording ||
+        ((swr_cmd_buffer*)cmd_buffer->cmd_buffer_handle)->level != XUDK_CMD_BUFFER_PRIMARY) {
+        return XUDK_INVALID_PARAM;
+    }
+    return swr_device_of(ctx) ? XUDK_OK : XUDK_GPU_NOT_FOUND;
+}
+
+static status swr_submit_command_buffer(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    swr_device *dev = swr_device_of(ctx);
+    u64 start;
+    status s = check_submit(ctx, cmd_buffer);
+
+    if (xudk_error(s)) {
+        return s;
+    }
+    start = swr_now(ctx);
+    s = swr_execute(ctx, cmd_buffer->cmd_buffer_handle);
+    dev->gpu_time_ns += swr_now(ctx) - start;
+    return s;
+}
+
+// Submission executes synchronously; there is never outstanding work
+static status swr_wait_for_completion(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    (void)ctx;
+    return cmd_buffer ? XUDK_OK : XUDK_INVALID_PARAM;
+}
+
+static status swr_wait_idle(xudk_ctx *ctx) {
+    (void)ctx;
+    return XUDK_OK;
+}
+
+// =============================================================================
+// FENCES
+// =============================================================================
+
+typedef struct {
+    u64                 value;
+} swr_fence;
+
+static status swr_create_fence(xudk_ctx *ctx, u64 initial_value, xudk_gpu_fence *fence) {
+    swr_fence *f;
+
+    if (!fence) {
+        return XUDK_INVALID_PARAM;
+    }
+    f = ctx->memory.alloc(ctx, sizeof(*f));
+    if (!f) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    f->value = initial_value;
+    fence->fence_handle = f;
+    return XUDK_OK;
+}
+
+static status swr_destroy_fence(xudk_ctx *ctx, xudk_gpu_fence *fence) {
+    if (!fence || !fence->fence_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    ctx->memory.free(ctx, fence->fence_handle);
+    fence->fence_handle = null;
+    return XUDK_OK;
+}
+
+// The work has run by the time submit returns, so the fence is raised right away
+static status swr_submit_and_signal(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_fence *fence, u64 value) {
+    swr_fence *f;
+    status s;
+
+    if (!fence || !fence->fence_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = check_submit(ctx, cmd_buffer);
+    if (xudk_error(s)) {
+        return s;   // Nothing was submitted
+    }
+    f = fence->fence_handle;
+    s = swr_submit_command_buffer(ctx, cmd_buffer);
+    if (value > f->value) {
+        f->value = value;
+    }
+    return s;
+}
+
+static status swr_get_fence_value(xudk_ctx *ctx, xudk_gpu_fence *fence, u64 *value) {
+    (void)ctx;
+    if (!fence || !fence->fence_handle || !value) {
+        return XUDK_INVALID_PARAM;
+    }
+    *value = ((swr_fence*)fence->fence_handle)->value;
+    return XUDK_OK;
+}
+
+// No work is ever outstanding: a value not reached yet would never be
+static status swr_wait_fence(xudk_ctx *ctx, xudk_gpu_fence *fence, u64 value) {
+    (void)ctx;
+    if (!fence || !fence->fence_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    return ((swr_fence*)fence->fence_handle)->value >= value ? XUDK_OK : XUDK_INVALID_PARAM;
+}
+
+// =============================================================================
+// QUERIES
+// =============================================================================
+
+// Timestamps are firmware-clock nanoseconds, taken once all earlier commands
+// of the submission, binned triangles included, have run
+static status swr_create_query_pool(xudk_ctx *ctx, xudk_query_type type, u32 count, xudk_gpu_query_pool *pool) {
+    swr_query_pool *p;
+    usize value_size, size;
+
+    if (!pool || !count || type > XUDK_QUERY_PIPELINE_STATISTICS) {
+        return XUDK_INVALID_PARAM;
+    }
+    value_size = type == XUDK_QUERY_TIMESTAMP ? sizeof(u64) : 2 * sizeof(xudk_gpu_pipeline_statistics);
+    size = sizeof(*p) + (usize)count * value_size + count;
+    p = ctx->memory.alloc(ctx, size);
+    if (!p) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(p, 0, size);
+    p->type = type;
+    p->count = count;
+    if (type == XUDK_QUERY_TIMESTAMP) {
+        p->timestamps = (u64*)(p + 1);
+    } else {
+        p->statistics = (xudk_gpu_pipeline_statistics*)(p + 1);
+        p->begin = p->statistics + count;
+    }
+    p->written = (bool*)((u8*)(p + 1) + (usize)count * value_size);
+
+    pool->query_pool_handle = p;
+    pool->type = type;
+    pool->count = count;
+    pool->timestamp_frequency = 1000000000ULL;
+    return XUDK_OK;
+}
+
+static status swr_destroy_query_pool(xudk_ctx *ctx, xudk_gpu_query_pool *pool) {
+    if (!pool || !pool->query_pool_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    ctx->memory.free(ctx, pool->query_pool_handle);
+    pool->query_pool_handle = null;
+    return XUDK_OK;
+}
+
+static status swr_reset_queries(xudk_ctx *ctx, xudk_gpu_query_pool *pool, u32 first, u32 count) {
+    swr_query_pool *p;
+
+    (void)ctx;
+    if (!pool || !(p = pool->query_pool_handle) || first > p->count || count > p->count - first) {
+        return XUDK_INVALID_PARAM;
+    }
+    xudk_memset(p->written + first, 0, count);
+    return XUDK_OK;
+}
+
+static status swr_get_query_results(xudk_ctx *ctx, xudk_gpu_query_pool *pool, u32 first, u32 count, void *results) {
+    swr_query_pool *p;
+
+    (void)ctx;
+    if (!pool || !(p = pool->query_pool_handle) || !results || first > p->count || count > p->count - first) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (u32 i = first; i < first + count; i++) {
+        if (!p->written[i]) {
+            return XUDK_NOT_READY;
+        }
+    }
+    if (p->type == XUDK_QUERY_TIMESTAMP) {
+        xudk_memcpy(results, p->timestamps + first, count * sizeof(u64));
+    } else {
+        xudk_memcpy(results, p->statistics + first, count * sizeof(xudk_gpu_pipeline_statistics));
+    }
+    return XUDK_OK;
+}
+
+// =============================================================================
+// PRESENTATION
+// =============================================================================
+
+// copy_buffer takes pixels in the screen's layout, which the mode gives;
+// without get_mode the screen is taken to be BGRX like the Blt layout
+static status swr_present_to_screen(xudk_ctx *ctx, xudk_gpu_texture *texture) {
+    swr_device *dev = swr_device_of(ctx);
+    xudk_graphics_mode mode;
+    u32 pixel_format = XUDK_PIXEL_BGRX;
+    swr_texture *t;
+    usize pixels;
+
+    if (!texture || !texture->texture_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!dev) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    if (!ctx->graphics.copy_buffer) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    t = texture->texture_handle;
+    dev->last_presented = t;
+    if (ctx->graphics.get_mode && xudk_ok(ctx->graphics.get_mode(ctx, &mode))) {
+        pixel_format = mode.pixel_format;
+    }
+
+    // B8G8R8A8 is already a BGRX screen's layout, and one swap from RGBX
+    pixels = (usize)t->width * t->height;
+    if (t->format == XUDK_FORMAT_B8G8R8A8_UNORM || t->format == XUDK_FORMAT_B8G8R8A8_SRGB) {
+        if (pixel_format != XUDK_PIXEL_RGBX) {
+            return ctx->graphics.copy_buffer(ctx, t->data, 0, 0, t->width, t->height);
+        }
+        if (!swr_reserve(ctx, (void**)&dev->present_buffer, &dev->present_capacity, pixels, sizeof(u32))) {
+            return XUDK_OUT_OF_MEMORY;
+        }
+        xudk_pixel_kernels()->swap_rb(dev->present_buffer, (const u32*)t->data, pixels);
+        return ctx->graphics.copy_buffer(ctx, dev->present_buffer, 0, 0, t->width, t->height);
+    }
+
+    if (!swr_reserve(ctx, (void**)&dev->present_buffer, &dev->present_capacity, pixels, sizeof(u32))) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    for (u32 y = 0; y < t->height; y++) {
+        u32 *dst = dev->present_buffer + (usize)y * t->width;
+        for (u32 x = 0; x < t->width; x++) {
+            float c[4];
+            swr_texel_load(t, swr_texel_address(t, x, y), c);
+            dst[x] = xudk_color_to_pixel(0xFF000000u | ((u32)(c[0] * 255.0f + 0.5f) << 16) |
+                                         ((u32)(c[1] * 255.0f + 0.5f) << 8) | (u32)(c[2] * 255.0f + 0.5f),
+                                         pixel_format);
+        }
+    }
+    return ctx->graphics.copy_buffer(ctx, dev->present_buffer, 0, 0, t->width, t->height);
+}
+
+static void wr16(u8 *p, u32 v) { p[0] = (u8)v; p[1] = (u8)(v >> 8); }
+static void wr32(u8 *p, u32 v) { p[0] = (u8)v; p[1] = (u8)(v >> 8); p[2] = (u8)(v >> 16); p[3] = (u8)(v >> 24); }
+
+// Last presented texture as a top-down 32-bit BMP
+static status swr_capture_screenshot(xudk_ctx *ctx, const wchar *path) {
+    swr_device *dev = swr_device_of(ctx);
+    const swr_texture *t;
+    u8 header[54];
+    u32 image_size;
+    handle file;
+    u8 *row;
+    status s;
+
+    if (!path) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (!dev || !dev->last_presented) {
+        return XUDK_NOT_FOUND;
+    }
+    if (!ctx->filesystem.create_file) {
+        return XUDK_NOT_SUPPORTED;
+    }
+    t = dev->last_presented;
+    image_size = t->width * t->height * 4;
+
+    xudk_memset(header, 0, sizeof(header));
+    header[0] = 'B';
+    header[1] = 'M';
+    wr32(header + 2, sizeof(header) + image_size);
+    wr32(header + 10, sizeof(header));
+    wr32(header + 14, 40);
+    wr32(header + 18, t->width);
+    wr32(header + 22, (u32)-(i32)t->height);
+    wr16(header + 26, 1);
+    wr16(header + 28, 32);
+    wr32(header + 34, image_size);
+
+    row = ctx->memory.alloc(ctx, (usize)t->width * 4);
+    if (!row) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    s = ctx->filesystem.create_file(ctx, path, &file);
+    if (xudk_error(s)) {
+        ctx->memory.free(ctx, row);
+        return s;
+    }
+    s = ctx->filesystem.write_file(ctx, file, header, sizeof(header), null);
+    for (u32 y = 0; y < t->height && xudk_ok(s); y++) {
+        for (u32 x = 0; x < t->width; x++) {
+            float c[4];
+            swr_texel_load(t, swr_texel_address(t, x, y), c);
+            row[x * 4 + 0] = (u8)(c[2] * 255.0f + 0.5f);
+            row[x * 4 + 1] = (u8)(c[1] * 255.0f + 0.5f);
+            row[x * 4 + 2] = (u8)(c[0] * 255.0f + 0.5f);
+            row[x * 4 + 3] = (u8)(c[3] * 255.0f + 0.5f);
+        }
+        s = ctx->filesystem.write_file(ctx, file, row, (usize)t->width * 4, null);
+    }
+    ctx->filesystem.close_file(ctx, file);
+    ctx->memory.free(ctx, row);
+    return s;
+}
+
+static status swr_get_performance_counters(xudk_ctx *ctx, u64 *gpu_time, u64 *memory_used, u32 *temperature) {
+    swr_device *dev = swr_device_of(ctx);
+
+    if (!dev) {
+        return XUDK_GPU_NOT_FOUND;
+    }
+    if (gpu_time) {
+        *gpu_time = dev->gpu_time_ns;
+    }
+    if (memory_used) {
+        *memory_used = dev->memory_used;
+    }
+    if (temperature) {
+        *temperature = 0;
+    }
+    return XUDK_OK;
+}
+
+// =============================================================================
+// INSTALLATION
+// =============================================================================
+
+status xudk_swr_install(xudk_ctx *ctx) {
+    xudk_gpu *gpu = &ctx->gpu;
+
+    if (ctx->gpu_initialized && ctx->gpu.shutdown_device) {
+        ctx->gpu.shutdown_device(ctx);
+    }
+    xudk_memset(gpu, 0, sizeof(*gpu));
+
+    gpu->enumerate_devices = swr_enumerate_devices;
+    gpu->initialize_device = swr_initialize_device;
+    gpu->shutdown_device = swr_shutdown_device;
+    gpu->get_device_info = swr_get_device_info;
+    gpu->get_memory_heaps = swr_get_memory_heaps;
+
+    gpu->allocate_buffer = swr_allocate_buffer;
+    gpu->free_buffer = swr_free_buffer;
+    gpu->map_buffer = swr_map_buffer;
+    gpu->unmap_buffer = swr_unmap_buffer;
+    gpu->upload_buffer_data = swr_upload_buffer_data;
+
+    gpu->create_texture = swr_create_texture;
+    gpu->create_render_target = swr_create_render_target;
+    gpu->create_depth_stencil = swr_create_depth_stencil;
+    gpu->destroy_texture = swr_destroy_texture;
+    gpu->upload_texture_data = swr_upload_texture_data;
+    gpu->load_texture_from_file = swr_load_texture_from_file;
+
+    gpu->create_descriptor_layout = swr_create_descriptor_layout;
+    gpu->destroy_descriptor_layout = swr_destroy_descriptor_layout;
+    gpu->create_descriptor_set = swr_create_descriptor_set;
+    gpu->update_descriptor_set = swr_update_descriptor_set;
+    gpu->destroy_descriptor_set = swr_destroy_descriptor_set;
+
+    gpu->create_shader = swr_create_shader;
+    gpu->compile_shader = swr_compile_shader;
+    gpu->destroy_shader = swr_destroy_shader;
+    gpu->load_shader_from_file = swr_load_shader_from_file;
+
+    gpu->create_graphics_pipeline = swr_create_graphics_pipeline;
+    gpu->create_compute_pipeline = swr_create_compute_pipeline;
+    gpu->destroy_pipeline = swr_destroy_pipeline;
+
+    gpu->submit_command_buffer = swr_submit_command_buffer;
+    gpu->wait_for_completion = swr_wait_for_completion;
+    gpu->submit_and_signal = swr_submit_and_signal;
+    gpu->wait_idle = swr_wait_idle;
+    gpu->create_fence = swr_create_fence;
+    gpu->destroy_fence = swr_destroy_fence;
+    gpu->get_fence_value = swr_get_fence_value;
+    gpu->wait_fence = swr_wait_fence;
+
+    gpu->create_query_pool = swr_create_query_pool;
+    gpu->destroy_query_pool = swr_destroy_query_pool;
+    gpu->reset_queries = swr_reset_queries;
+    gpu->get_query_results = swr_get_query_results;
+    swr_install_commands(gpu);
+
+    gpu->present_to_screen = swr_present_to_screen;
+    gpu->capture_screenshot = swr_capture_screenshot;
+    gpu->get_performance_counters = swr_get_performance_counters;
+    return XUDK_OK;
+}
@@ -0,0 +1,87 @@
+/*
+ * XUDK - Software rasterizer GPU backend
+ * Implements the whole xudk_gpu table on the CPU: triangles are binned into
+ * screen tiles and the tiles are rasterized in parallel on every core with
+ * SIMD edge functions. Used whenever no hardware GPU is usable at boot.
+ *
+ * Shaders are native C functions. compile_shader() and load_shader_from_file()
+ * map HLSL source text to the program registered for it (whitespace is
+ * ignored); the built-in sources are registered at initialize_device().
+ * create_shader() takes an xudk_swr_program directly as its bytecode.
+ */
+
+#ifndef XUDK_SWR_H
+#define XUDK_SWR_H
+
+#include "xudk/uefi.h"
+
+// =============================================================================
+// LIMITS
+// =============================================================================
+
+#define XUDK_SWR_TILE_SIZE          64
+#define XUDK_SWR_MAX_VARYINGS       16      // Floats passed from vertex to fragment stage
+#define XUDK_SWR_MAX_VERTEX_BUFFERS 8
+#define XUDK_SWR_MAX_SETS           4
+#define XUDK_SWR_MAX_BINDINGS       8
+#define XUDK_SWR_PUSH_CONSTANT_SIZE 128
+#define XUDK_SWR_MAX_TEXTURE_ARRAY  4096    // Elements of a layout's texture array binding
+#define XUDK_SWR_PROGRAM_MAGIC      0x50525753  // 'SWRP'
+
+// =============================================================================
+// SHADER INTERFACE
+// =============================================================================
+
+// Descriptor set layout understood by the software backend; pass a pointer
+// to one as the `descriptor_set` handle of bind_descriptor_set(). Sets from
+// create_descriptor_set() are these too, with any texture array binding
+// in texture_array.
+typedef struct {
+    xudk_gpu_buffer*    buffers[XUDK_SWR_MAX_BINDINGS];     // b0..b7
+    xudk_gpu_texture*   textures[XUDK_SWR_MAX_BINDINGS];    // t0..t7
+    u64                 buffer_offsets[XUDK_SWR_MAX_BINDINGS];  // Where b0..b7 start, e.g. a ring slice
+    xudk_gpu_texture**  texture_array;                      // Indexed by the shader, e.g. atlas pages
+    u32                 texture_array_count;
+} xudk_swr_descriptor_set;
+
+// Resources visible to a shader invocation
+typedef struct {
+    const u8*                       vertex_buffers[XUDK_SWR_MAX_VERTEX_BUFFERS];  // Bound buffer + offset
+    const u8*                       push_constants;
+    const xudk_swr_descriptor_set*  sets[XUDK_SWR_MAX_SETS];
+} xudk_swr_env;
+
+// Vertex stage: fetch the vertex, write clip-space position and varyings
+typedef void (*xudk_swr_vertex_fn)(const xudk_swr_env *env, u32 vertex_index, u32 instance_index,
+                                   float position[4], float *varyings);
+
+// Fragment stage: perspective-correct varyings in, RGBA out; return false to discard
+typedef bool (*xudk_swr_fragment_fn)(const xudk_swr_env *env, const float *varyings, float color[4]);
+
+// Compute stage: one call per workgroup
+typedef void (*xudk_swr_compute_fn)(const xudk_swr_env *env, u32 group_x, u32 group_y, u32 group_z);
+
+// Native shader program, passed as bytecode to create_shader()
+typedef struct {
+    u32                 magic;              // XUDK_SWR_PROGRAM_MAGIC
+    xudk_shader_type    type;
+    u32                 varying_count;      // Vertex outputs / fragment inputs, in floats
+    void*               entry;              // xudk_swr_vertex_fn / _fragment_fn / _compute_fn
+} xudk_swr_program;
+
+// =============================================================================
+// BACKEND API
+// =============================================================================
+
+// Install the software rasterizer into ctx->gpu
+status xudk_swr_install(xudk_ctx *ctx);
+
+// Provide the native implementation of an HLSL source (device must be initialized)
+status xudk_swr_register_shader(xudk_ctx *ctx, const char *source, const xudk_swr_program *program);
+
+// Texture access for native shaders (level 0, slice 0, clamp-to-edge)
+void   xudk_swr_sample(const xudk_gpu_texture *texture, float u, float v, float color[4]);
+void   xudk_swr_load(const xudk_gpu_texture *texture, u32 x, u32 y, float color[4]);
+void   xudk_swr_store(xudk_gpu_texture *texture, u32 x, u32 y, const float color[4]);
+
+#endif // XUDK_SWR_H
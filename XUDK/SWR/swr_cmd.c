@@ -0,0 +1,1083 @@
+/*
+ * XUDK - Software rasterizer: command recording and execution
+ * Commands are validated, translated to raw pointers and packed into a byte
+ * stream at record time, then replayed at submit. Secondary buffers are
+ * recorded once and replayed in place from any primary. A draw runs
+ * the vertex stage right away, clips, sets triangles up in 28.4 fixed point
+ * and bins them into screen tiles; tiles are rasterized at end_render_pass.
+ */
+
+#include "swr_int.h"
+
+#define SWR_GUARD_BAND          8192.0f         // Clip beyond this many pixels around the viewport
+#define SWR_MAX_BINNED_TRIS     (1u << 16)      // Rasterize early once a pass holds this many
+#define SWR_MAX_CLIP_VERTICES   12
+#define SWR_CLIP_PLANES         7
+#define SWR_W_EPSILON           1e-6f
+
+// Bytes a command takes: the header plus the union member it uses
+#define SWR_CMD_SIZE(member)    (offsetof(swr_cmd, member) + sizeof(((swr_cmd*)0)->member))
+#define SWR_CMD_HEADER_SIZE     offsetof(swr_cmd, dispatch)
+
+// =============================================================================
+// RECORDING
+// =============================================================================
+
+static status record(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, swr_cmd_type type, usize size, swr_cmd **cmd) {
+    swr_cmd_buffer *cb;
+    usize capacity;
+
+    if (!cmd_buffer || !cmd_buffer->cmd_buffer_handle || !cmd_buffer->is_recording) {
+        return XUDK_INVALID_PARAM;
+    }
+    cb = cmd_buffer->cmd_buffer_handle;
+    size = (size + 7) & ~(usize)7;
+    capacity = cb->capacity;
+    if (!swr_reserve(ctx, (void**)&cb->stream, &capacity, cb->size + size, 1)) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    cb->capacity = (u32)capacity;
+    *cmd = (swr_cmd*)(cb->stream + cb->size);
+    (*cmd)->type = (u16)type;
+    (*cmd)->size = (u16)size;
+    cb->size += (u32)size;
+    cb->count++;
+    return XUDK_OK;
+}
+
+static status swr_create_command_buffer(xudk_ctx *ctx, bool is_compute, xudk_gpu_cmd_buffer *cmd_buffer) {
+    swr_cmd_buffer *cb;
+
+    if (!cmd_buffer) {
+        return XUDK_INVALID_PARAM;
+    }
+    cb = ctx->memory.alloc(ctx, sizeof(*cb));
+    if (!cb) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    xudk_memset(cb, 0, sizeof(*cb));
+    cb->is_compute = is_compute;
+
+    xudk_memset(cmd_buffer, 0, sizeof(*cmd_buffer));
+    cmd_buffer->cmd_buffer_handle = cb;
+    cmd_buffer->is_compute = is_compute;
+    return XUDK_OK;
+}
+
+static status swr_destroy_command_buffer(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    swr_cmd_buffer *cb;
+
+    if (!cmd_buffer || !cmd_buffer->cmd_buffer_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    cb = cmd_buffer->cmd_buffer_handle;
+    if (cb->stream) {
+        ctx->memory.free(ctx, cb->stream);
+    }
+    ctx->memory.free(ctx, cb);
+    cmd_buffer->cmd_buffer_handle = null;
+    return XUDK_OK;
+}
+
+static status swr_begin_recording(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    swr_cmd_buffer *cb;
+
+    (void)ctx;
+    if (!cmd_buffer || !cmd_buffer->cmd_buffer_handle || cmd_buffer->is_recording ||
+        cmd_buffer->level > XUDK_CMD_BUFFER_SECONDARY) {
+        return XUDK_INVALID_PARAM;
+    }
+    cb = cmd_buffer->cmd_buffer_handle;
+    cb->size = 0;
+    cb->count = 0;
+    cb->level = cmd_buffer->level;
+    cmd_buffer->is_recording = true;
+    return XUDK_OK;
+}
+
+static status swr_end_recording(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    (void)ctx;
+    if (!cmd_buffer || !cmd_buffer->cmd_buffer_handle || !cmd_buffer->is_recording) {
+        return XUDK_INVALID_PARAM;
+    }
+    cmd_buffer->is_recording = false;
+    return XUDK_OK;
+}
+
+static status swr_begin_render_pass(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_render_pass *render_pass) {
+    swr_texture *color = null, *depth = null;
+    swr_pass_desc *desc;
+    u32 width = render_pass ? render_pass->width : 0;
+    u32 height = render_pass ? render_pass->height : 0;
+    swr_cmd *cmd;
+    status s;
+
+    if (!render_pass || render_pass->color_target_count > 1) {
+        return render_pass ? XUDK_NOT_SUPPORTED : XUDK_INVALID_PARAM;
+    }
+    if (render_pass->color_target_count) {
+        if (!render_pass->color_targets || !render_pass->color_targets[0] || !render_pass->color_targets[0]->texture_handle) {
+            return XUDK_INVALID_PARAM;
+        }
+        color = render_pass->color_targets[0]->texture_handle;
+    }
+    if (render_pass->depth_target) {
+        depth = render_pass->depth_target->texture_handle;
+        if (!depth || (depth->format != XUDK_FORMAT_D32_FLOAT && depth->format != XUDK_FORMAT_D24_UNORM_S8_UINT)) {
+            return XUDK_INVALID_PARAM;
+        }
+    }
+    if (!color && !depth) {
+        return XUDK_INVALID_PARAM;
+    }
+
+    // Render area is clipped to the attachments
+    if (color) {
+        width = width && width < color->width ? width : color->width;
+        height = height && height < color->height ? height : color->height;
+    }
+    if (depth) {
+        width = width && width < depth->width ? width : depth->width;
+        height = height && height < depth->height ? height : depth->height;
+    }
+
+    s = record(ctx, cmd_buffer, SWR_CMD_BEGIN_PASS, SWR_CMD_SIZE(pass), &cmd);
+    if (xudk_error(s)) {
+        return s;
+    }
+    desc = &cmd->pass;
+    desc->color = color;
+    desc->depth = depth;
+    desc->width = width;
+    desc->height = height;
+    desc->clear_color = color && render_pass->clear_color;
+    desc->clear_depth = depth && render_pass->clear_depth;
+    xudk_memcpy(desc->clear_color_value, render_pass->clear_color_value, sizeof(desc->clear_color_value));
+    desc->clear_depth_value = render_pass->clear_depth_value;
+    return XUDK_OK;
+}
+
+static status swr_end_render_pass(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    swr_cmd *cmd;
+    return record(ctx, cmd_buffer, SWR_CMD_END_PASS, SWR_CMD_HEADER_SIZE, &cmd);
+}
+
+static status record_rect(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, swr_cmd_type type,
+                          u32 x, u32 y, u32 width, u32 height) {
+    swr_cmd *cmd;
+    status s = record(ctx, cmd_buffer, type, SWR_CMD_SIZE(rect), &cmd);
+
+    if (xudk_ok(s)) {
+        // Anything past the largest render area is equivalent to its edge
+        cmd->rect.x = (i32)(x < 8192 ? x : 8192);
+        cmd->rect.y = (i32)(y < 8192 ? y : 8192);
+        cmd->rect.width = width < 8192 ? width : 8192;
+        cmd->rect.height = height < 8192 ? height : 8192;
+    }
+    return s;
+}
+
+static status swr_set_viewport(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 x, u32 y, u32 width, u32 height) {
+    if (!width || !height) {
+        return XUDK_INVALID_PARAM;
+    }
+    return record_rect(ctx, cmd_buffer, SWR_CMD_VIEWPORT, x, y, width, height);
+}
+
+static status swr_set_scissor(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 x, u32 y, u32 width, u32 height) {
+    return record_rect(ctx, cmd_buffer, SWR_CMD_SCISSOR, x, y, width, height);
+}
+
+static status swr_bind_pipeline(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_pipeline *pipeline) {
+    swr_cmd *cmd;
+    status s;
+
+    if (!pipeline || !pipeline->pipeline_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = record(ctx, cmd_buffer, SWR_CMD_BIND_PIPELINE, SWR_CMD_SIZE(pipeline), &cmd);
+    if (xudk_ok(s)) {
+        cmd->pipeline = pipeline->pipeline_handle;
+    }
+    return s;
+}
+
+static status swr_bind_vertex_buffers(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 first_binding,
+                                      u32 binding_count, xudk_gpu_buffer **buffers, u64 *offsets) {
+    if (!buffers || first_binding >= XUDK_SWR_MAX_VERTEX_BUFFERS ||
+        binding_count > XUDK_SWR_MAX_VERTEX_BUFFERS - first_binding) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (u32 i = 0; i < binding_count; i++) {
+        u64 offset = offsets ? offsets[i] : 0;
+        swr_buffer *b;
+        swr_cmd *cmd;
+        status s;
+
+        if (!buffers[i] || !buffers[i]->buffer_handle) {
+            return XUDK_INVALID_PARAM;
+        }
+        b = buffers[i]->buffer_handle;
+        if (offset > b->size) {
+            return XUDK_BUFFER_OVERFLOW;
+        }
+        s = record(ctx, cmd_buffer, SWR_CMD_BIND_VERTEX_BUFFER, SWR_CMD_SIZE(vertex_buffer), &cmd);
+        if (xudk_error(s)) {
+            return s;
+        }
+        cmd->vertex_buffer.slot = first_binding + i;
+        cmd->vertex_buffer.data = b->data + offset;
+    }
+    return XUDK_OK;
+}
+
+static status swr_bind_index_buffer(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_buffer *buffer,
+                                    u64 offset, bool is_32bit) {
+    swr_buffer *b;
+    swr_cmd *cmd;
+    status s;
+
+    if (!buffer || !buffer->buffer_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    b = buffer->buffer_handle;
+    if (offset > b->size) {
+        return XUDK_BUFFER_OVERFLOW;
+    }
+    s = record(ctx, cmd_buffer, SWR_CMD_BIND_INDEX_BUFFER, SWR_CMD_SIZE(index_buffer), &cmd);
+    if (xudk_ok(s)) {
+        cmd->index_buffer.data = b->data + offset;
+        cmd->index_buffer.is_32bit = is_32bit;
+    }
+    return s;
+}
+
+static status swr_draw(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 vertex_count, u32 instance_count,
+                       u32 first_vertex, u32 first_instance) {
+    swr_cmd *cmd;
+    status s = record(ctx, cmd_buffer, SWR_CMD_DRAW, SWR_CMD_SIZE(draw), &cmd);
+
+    if (xudk_ok(s)) {
+        cmd->draw.count = vertex_count;
+        cmd->draw.instance_count = instance_count;
+        cmd->draw.first = first_vertex;
+        cmd->draw.first_instance = first_instance;
+        cmd->draw.vertex_offset = 0;
+        cmd->draw.indexed = false;
+    }
+    return s;
+}
+
+static status swr_draw_indexed(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 index_count, u32 instance_count,
+                               u32 first_index, i32 vertex_offset, u32 first_instance) {
+    swr_cmd *cmd;
+    status s = record(ctx, cmd_buffer, SWR_CMD_DRAW, SWR_CMD_SIZE(draw), &cmd);
+
+    if (xudk_ok(s)) {
+        cmd->draw.count = index_count;
+        cmd->draw.instance_count = instance_count;
+        cmd->draw.first = first_index;
+        cmd->draw.first_instance = first_instance;
+        cmd->draw.vertex_offset = vertex_offset;
+        cmd->draw.indexed = true;
+    }
+    return s;
+}
+
+static status swr_dispatch(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 group_count_x, u32 group_count_y,
+                           u32 group_count_z) {
+    swr_cmd *cmd;
+    status s = record(ctx, cmd_buffer, SWR_CMD_DISPATCH, SWR_CMD_SIZE(dispatch), &cmd);
+
+    if (xudk_ok(s)) {
+        cmd->dispatch.x = group_count_x;
+        cmd->dispatch.y = group_count_y;
+        cmd->dispatch.z = group_count_z;
+    }
+    return s;
+}
+
+// Buffers are read and written when the submission runs, not when recorded
+static status swr_copy_buffer(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_buffer *src, u64 src_offset,
+                              xudk_gpu_buffer *dst, u64 dst_offset, u64 size) {
+    swr_buffer *from, *to;
+    swr_cmd *cmd;
+    status s;
+
+    if (!src || !src->buffer_handle || !dst || !dst->buffer_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    from = src->buffer_handle;
+    to = dst->buffer_handle;
+    if (src_offset > from->size || size > from->size - src_offset ||
+        dst_offset > to->size || size > to->size - dst_offset) {
+        return XUDK_BUFFER_OVERFLOW;
+    }
+    s = record(ctx, cmd_buffer, SWR_CMD_COPY_BUFFER, SWR_CMD_SIZE(copy), &cmd);
+    if (xudk_ok(s)) {
+        cmd->copy.src = from->data + src_offset;
+        cmd->copy.dst = to->data + dst_offset;
+        cmd->copy.size = size;
+    }
+    return s;
+}
+
+// The size check against the subresource happens at execution, as for upload_texture_data
+static status swr_copy_buffer_to_texture(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_buffer *src,
+                                         u64 src_offset, u64 size, xudk_gpu_texture *texture, u32 mip_level,
+                                         u32 array_slice) {
+    swr_buffer *from;
+    swr_texture *t;
+    swr_cmd *cmd;
+    status s;
+
+    if (!src || !src->buffer_handle || !texture || !texture->texture_handle) {
+        return XUDK_INVALID_PARAM;
+    }
+    from = src->buffer_handle;
+    t = texture->texture_handle;
+    if (mip_level >= t->mip_levels || array_slice >= t->array_size) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (src_offset > from->size || size > from->size - src_offset) {
+        return XUDK_BUFFER_OVERFLOW;
+    }
+    s = record(ctx, cmd_buffer, SWR_CMD_COPY_TO_TEXTURE, SWR_CMD_SIZE(upload), &cmd);
+    if (xudk_ok(s)) {
+        cmd->upload.src = from->data + src_offset;
+        cmd->upload.texture = t;
+        cmd->upload.size = size;
+        cmd->upload.mip_level = mip_level;
+        cmd->upload.array_slice = array_slice;
+    }
+    return s;
+}
+
+// `descriptor_set` points at an xudk_swr_descriptor_set that must stay valid until the submit returns
+static status swr_bind_descriptor_set(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 set_index,
+                                      handle descriptor_set) {
+    swr_cmd *cmd;
+    status s;
+
+    if (set_index >= XUDK_SWR_MAX_SETS) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = record(ctx, cmd_buffer, SWR_CMD_BIND_SET, SWR_CMD_SIZE(set), &cmd);
+    if (xudk_ok(s)) {
+        cmd->set.index = set_index;
+        cmd->set.set = descriptor_set;
+    }
+    return s;
+}
+
+static status swr_push_constants(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 offset, u32 size, const void *data) {
+    swr_cmd *cmd;
+    status s;
+
+    if (!data || offset > XUDK_SWR_PUSH_CONSTANT_SIZE || size > XUDK_SWR_PUSH_CONSTANT_SIZE - offset) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = record(ctx, cmd_buffer, SWR_CMD_PUSH_CONSTANTS, offsetof(swr_cmd, push.data) + size, &cmd);
+    if (xudk_ok(s)) {
+        cmd->push.offset = offset;
+        cmd->push.size = size;
+        xudk_memcpy(cmd->push.data, data, size);
+    }
+    return s;
+}
+
+static status swr_insert_barrier(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer) {
+    swr_cmd *cmd;
+    return record(ctx, cmd_buffer, SWR_CMD_BARRIER, SWR_CMD_HEADER_SIZE, &cmd);
+}
+
+// Commands run in order and caches are coherent, so transitions record nothing
+static status swr_resource_barrier(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 count,
+                                   const xudk_gpu_barrier *barriers) {
+    (void)ctx;
+    if (!cmd_buffer || !cmd_buffer->cmd_buffer_handle || !cmd_buffer->is_recording || (count && !barriers)) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (u32 i = 0; i < count; i++) {
+        if (!barriers[i].buffer == !barriers[i].texture) {
+            return XUDK_INVALID_PARAM;
+        }
+    }
+    return XUDK_OK;
+}
+
+static status record_query(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, swr_cmd_type type,
+                           xudk_gpu_query_pool *pool, u32 index) {
+    xudk_query_type needed = type == SWR_CMD_TIMESTAMP ? XUDK_QUERY_TIMESTAMP : XUDK_QUERY_PIPELINE_STATISTICS;
+    swr_query_pool *p;
+    swr_cmd *cmd;
+    status s;
+
+    if (!pool || !(p = pool->query_pool_handle) || p->type != needed || index >= p->count) {
+        return XUDK_INVALID_PARAM;
+    }
+    s = record(ctx, cmd_buffer, type, SWR_CMD_SIZE(query), &cmd);
+    if (xudk_ok(s)) {
+        cmd->query.pool = p;
+        cmd->query.index = index;
+    }
+    return s;
+}
+
+static status swr_write_timestamp(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_query_pool *pool,
+                                  u32 index) {
+    return record_query(ctx, cmd_buffer, SWR_CMD_TIMESTAMP, pool, index);
+}
+
+static status swr_begin_query(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_query_pool *pool, u32 index) {
+    return record_query(ctx, cmd_buffer, SWR_CMD_BEGIN_QUERY, pool, index);
+}
+
+static status swr_end_query(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_query_pool *pool, u32 index) {
+    return record_query(ctx, cmd_buffer, SWR_CMD_END_QUERY, pool, index);
+}
+
+// Secondaries are referenced, not copied: re-recording one changes every primary
+// that executes it. Bound state carries into a secondary and out of it again.
+static status swr_execute_commands(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, u32 count,
+                                   xudk_gpu_cmd_buffer **secondaries) {
+    if (!cmd_buffer || cmd_buffer->level != XUDK_CMD_BUFFER_PRIMARY || (count && !secondaries)) {
+        return XUDK_INVALID_PARAM;
+    }
+    for (u32 i = 0; i < count; i++) {
+        const xudk_gpu_cmd_buffer *list = secondaries[i];
+
+        if (!list || !list->cmd_buffer_handle || list->is_recording ||
+            ((swr_cmd_buffer*)list->cmd_buffer_handle)->level != XUDK_CMD_BUFFER_SECONDARY) {
+            return XUDK_INVALID_PARAM;
+        }
+    }
+    for (u32 i = 0; i < count; i++) {
+        swr_cmd *cmd;
+        status s = record(ctx, cmd_buffer, SWR_CMD_EXECUTE, SWR_CMD_SIZE(list), &cmd);
+
+        if (xudk_error(s)) {
+            return s;
+        }
+        cmd->list = secondaries[i]->cmd_buffer_handle;
+    }
+    return XUDK_OK;
+}
+
+void swr_install_commands(xudk_gpu *gpu) {
+    gpu->create_command_buffer = swr_create_command_buffer;
+    gpu->destroy_command_buffer = swr_destroy_command_buffer;
+    gpu->begin_recording = swr_begin_recording;
+    gpu->end_recording = swr_end_recording;
+    gpu->begin_render_pass = swr_begin_render_pass;
+    gpu->end_render_pass = swr_end_render_pass;
+    gpu->set_viewport = swr_set_viewport;
+    gpu->set_scissor = swr_set_scissor;
+    gpu->bind_pipeline = swr_bind_pipeline;
+    gpu->bind_vertex_buffers = swr_bind_vertex_buffers;
+    gpu->bind_index_buffer = swr_bind_index_buffer;
+    gpu->draw = swr_draw;
+    gpu->draw_indexed = swr_draw_indexed;
+    gpu->dispatch = swr_dispatch;
+    gpu->copy_buffer = swr_copy_buffer;
+    gpu->copy_buffer_to_texture = swr_copy_buffer_to_texture;
+    gpu->bind_descriptor_set = swr_bind_descriptor_set;
+    gpu->push_constants = swr_push_constants;
+    gpu->insert_barrier = swr_insert_barrier;
+    gpu->resource_barrier = swr_resource_barrier;
+    gpu->execute_commands = swr_execute_commands;
+    gpu->write_timestamp = swr_write_timestamp;
+    gpu->begin_query = swr_begin_query;
+    gpu->end_query = swr_end_query;
+}
+
+// =============================================================================
+// EXECUTION STATE
+// =============================================================================
+
+typedef struct {
+    xudk_ctx*               ctx;
+    swr_device*             dev;
+    const swr_pipeline*     pipeline;
+    xudk_swr_env            env;
+    u8                      push[XUDK_SWR_PUSH_CONSTANT_SIZE];
+    const u8*               index_data;
+    bool                    index_32bit;
+    float                   viewport[4];    // x, y, width, height
+    i32                     scissor[4];     // x0, y0, x1, y1 (exclusive)
+    i64                     state;          // Captured draw state in the pass, -1 if stale
+} swr_exec;
+
+static status pass_begin(swr_exec *ex, const swr_pass_desc *desc) {
+    swr_pass *pass = &ex->dev->pass;
+    u32 tiles;
+
+    pass->desc = *desc;
+    pass->tiles_x = (desc->width + XUDK_SWR_TILE_SIZE - 1) / XUDK_SWR_TILE_SIZE;
+    pass->tiles_y = (desc->height + XUDK_SWR_TILE_SIZE - 1) / XUDK_SWR_TILE_SIZE;
+    tiles = pass->tiles_x * pass->tiles_y;
+    if (tiles > pass->bin_count) {
+        swr_bin *bins = ex->ctx->memory.alloc(ex->ctx, tiles * sizeof(swr_bin));
+        if (!bins) {
+            return XUDK_OUT_OF_MEMORY;
+        }
+        xudk_memset(bins, 0, tiles * sizeof(swr_bin));
+        if (pass->bins) {
+            xudk_memcpy(bins, pass->bins, pass->bin_count * sizeof(swr_bin));
+            ex->ctx->memory.free(ex->ctx, pass->bins);
+        }
+        pass->bins = bins;
+        pass->bin_count = tiles;
+    }
+    for (u32 i = 0; i < tiles; i++) {
+        pass->bins[i].count = 0;
+    }
+    pass->tri_count = 0;
+    pass->varying_count = 0;
+    pass->state_count = 0;
+    pass->clear_pending = desc->clear_color || desc->clear_depth;
+    pass->active = true;
+
+    ex->viewport[0] = 0.0f;
+    ex->viewport[1] = 0.0f;
+    ex->viewport[2] = (float)desc->width;
+    ex->viewport[3] = (float)desc->height;
+    ex->scissor[0] = 0;
+    ex->scissor[1] = 0;
+    ex->scissor[2] = (i32)desc->width;
+    ex->scissor[3] = (i32)desc->height;
+    ex->state = -1;
+    return XUDK_OK;
+}
+
+static void pass_end(swr_exec *ex) {
+    swr_flush_pass(ex->ctx);
+    ex->dev->pass.active = false;
+    ex->state = -1;
+}
+
+// Snapshot what the fragment stage needs, once per draw and after each flush
+static status capture_state(swr_exec *ex) {
+    swr_pass *pass = &ex->dev->pass;
+    swr_draw_state *st;
+
+    if (ex->state >= 0) {
+        return XUDK_OK;
+    }
+    if (!swr_reserve(ex->ctx, (void**)&pass->states, &pass->state_capacity, pass->state_count + 1, sizeof(*st))) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    st = &pass->states[pass->state_count];
+    st->env = ex->env;
+    xudk_memcpy(st->push, ex->push, sizeof(st->push));
+    st->fs = ex->pipeline->fs;
+    st->varying_count = ex->pipeline->varying_count;
+    st->depth_test = ex->pipeline->depth_test && pass->desc.depth;
+    st->depth_write = ex->pipeline->depth_write && pass->desc.depth;
+    st->blend = ex->pipeline->blend;
+    st->scissor[0] = ex->scissor[0] > 0 ? ex->scissor[0] : 0;
+    st->scissor[1] = ex->scissor[1] > 0 ? ex->scissor[1] : 0;
+    st->scissor[2] = ex->scissor[2] < (i32)pass->desc.width ? ex->scissor[2] : (i32)pass->desc.width;
+    st->scissor[3] = ex->scissor[3] < (i32)pass->desc.height ? ex->scissor[3] : (i32)pass->desc.height;
+    ex->state = (i64)pass->state_count++;
+    return XUDK_OK;
+}
+
+// =============================================================================
+// TRIANGLE SETUP & BINNING
+// =============================================================================
+
+static i32 round_fixed(float v) {
+    v *= 16.0f;
+    return (i32)(v >= 0.0f ? v + 0.5f : v - 0.5f);
+}
+
+static status bin_triangle(swr_exec *ex, const float *v0, const float *v1, const float *v2) {
+    swr_pass *pass = &ex->dev->pass;
+    const float *v[3] = { v0, v1, v2 };
+    float sx[3], sy[3], sz[3], iw[3];
+    i32 fx[3], fy[3];
+    i32 min_fx, min_fy, max_fx, max_fy;
+    const swr_draw_state *st;
+    swr_tri *tri;
+    u32 n, index;
+    float *out;
+    i64 area;
+    status s;
+
+    for (u32 i = 0; i < 3; i++) {
+        iw[i] = 1.0f / v[i][3];
+        sx[i] = ex->viewport[0] + (v[i][0] * iw[i] + 1.0f) * 0.5f * ex->viewport[2];
+        sy[i] = ex->viewport[1] + (1.0f - v[i][1] * iw[i]) * 0.5f * ex->viewport[3];
+        sz[i] = v[i][2] * iw[i];
+        fx[i] = round_fixed(sx[i]);
+        fy[i] = round_fixed(sy[i]);
+    }
+
+    area = (i64)(fx[1] - fx[0]) * (fy[2] - fy[0]) - (i64)(fx[2] - fx[0]) * (fy[1] - fy[0]);
+    if (area == 0) {
+        return XUDK_OK;
+    }
+    if (area < 0) {
+        // No culling: make every triangle wind the same way
+        const float *tv = v[1]; v[1] = v[2]; v[2] = tv;
+        float t;
+        i32 ti;
+        t = sz[1]; sz[1] = sz[2]; sz[2] = t;
+        t = iw[1]; iw[1] = iw[2]; iw[2] = t;
+        ti = fx[1]; fx[1] = fx[2]; fx[2] = ti;
+        ti = fy[1]; fy[1] = fy[2]; fy[2] = ti;
+        area = -area;
+    }
+
+    if (pass->tri_count >= SWR_MAX_BINNED_TRIS) {
+        swr_flush_pass(ex->ctx);
+        ex->state = -1;
+    }
+    s = capture_state(ex);
+    if (xudk_error(s)) {
+        return s;
+    }
+    st = &pass->states[ex->state];
+
+    // Pixels whose centre (x * 16 + 8) may be covered, clipped to the scissor
+    min_fx = fx[0] < fx[1] ? (fx[0] < fx[2] ? fx[0] : fx[2]) : (fx[1] < fx[2] ? fx[1] : fx[2]);
+    max_fx = fx[0] > fx[1] ? (fx[0] > fx[2] ? fx[0] : fx[2]) : (fx[1] > fx[2] ? fx[1] : fx[2]);
+    min_fy = fy[0] < fy[1] ? (fy[0] < fy[2] ? fy[0] : fy[2]) : (fy[1] < fy[2] ? fy[1] : fy[2]);
+    max_fy = fy[0] > fy[1] ? (fy[0] > fy[2] ? fy[0] : fy[2]) : (fy[1] > fy[2] ? fy[1] : fy[2]);
+    min_fx = (min_fx + 7) >> 4;
+    min_fy = (min_fy + 7) >> 4;
+    max_fx = (max_fx - 8) >> 4;
+    max_fy = (max_fy - 8) >> 4;
+    if (min_fx < st->scissor[0]) min_fx = st->scissor[0];
+    if (min_fy < st->scissor[1]) min_fy = st->scissor[1];
+    if (max_fx > st->scissor[2] - 1) max_fx = st->scissor[2] - 1;
+    if (max_fy > st->scissor[3] - 1) max_fy = st->scissor[3] - 1;
+    if (min_fx > max_fx || min_fy > max_fy) {
+        return XUDK_OK;
+    }
+
+    n = st->varying_count;
+    if (!swr_reserve(ex->ctx, (void**)&pass->tris, &pass->tri_capacity, pass->tri_count + 1, sizeof(swr_tri)) ||
+        !swr_reserve(ex->ctx, (void**)&pass->varyings, &pass->varying_capacity, pass->varying_count + 3 * n, sizeof(float))) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    index = (u32)pass->tri_count++;
+    ex->dev->statistics.rasterized_primitives++;
+    tri = &pass->tris[index];
+    tri->min_x = min_fx;
+    tri->min_y = min_fy;
+    tri->max_x = max_fx;
+    tri->max_y = max_fy;
+    tri->state = (u32)ex->state;
+
+    // Edge k is opposite vertex k and positive inside; top-left edges own their pixels
+    for (u32 k = 0; k < 3; k++) {
+        u32 p = (k + 1) % 3, q = (k + 2) % 3;
+        tri->a[k] = fy[p] - fy[q];
+        tri->b[k] = fx[q] - fx[p];
+        tri->c[k] = (i64)fx[p] * fy[q] - (i64)fy[p] * fx[q];
+        if (!(tri->a[k] > 0 || (tri->a[k] == 0 && tri->b[k] > 0))) {
+            tri->c[k] -= 1;
+        }
+    }
+
+    tri->origin[0] = fx[0] / 16.0f;
+    tri->origin[1] = fy[0] / 16.0f;
+    tri->l1[0] = (float)tri->a[1] * 16.0f / (float)area;
+    tri->l1[1] = (float)tri->b[1] * 16.0f / (float)area;
+    tri->l2[0] = (float)tri->a[2] * 16.0f / (float)area;
+    tri->l2[1] = (float)tri->b[2] * 16.0f / (float)area;
+    tri->z[0] = sz[0];
+    tri->z[1] = sz[1] - sz[0];
+    tri->z[2] = sz[2] - sz[0];
+    tri->inv_w[0] = iw[0];
+    tri->inv_w[1] = iw[1] - iw[0];
+    tri->inv_w[2] = iw[2] - iw[0];
+
+    tri->varyings = (u32)pass->varying_count;
+    out = pass->varyings + pass->varying_count;
+    for (u32 i = 0; i < n; i++) {
+        float a0 = v[0][4 + i] * iw[0];
+        out[i] = a0;
+        out[n + i] = v[1][4 + i] * iw[1] - a0;
+        out[2 * n + i] = v[2][4 + i] * iw[2] - a0;
+    }
+    pass->varying_count += 3 * n;
+
+    for (i32 ty = min_fy / XUDK_SWR_TILE_SIZE; ty <= max_fy / XUDK_SWR_TILE_SIZE; ty++) {
+        for (i32 tx = min_fx / XUDK_SWR_TILE_SIZE; tx <= max_fx / XUDK_SWR_TILE_SIZE; tx++) {
+            swr_bin *bin = &pass->bins[(u32)ty * pass->tiles_x + (u32)tx];
+            if (!swr_reserve(ex->ctx, (void**)&bin->items, &bin->capacity, bin->count + 1, sizeof(u32))) {
+                return XUDK_OUT_OF_MEMORY;
+            }
+            bin->items[bin->count++] = index;
+        }
+    }
+    return XUDK_OK;
+}
+
+// =============================================================================
+// CLIPPING
+// =============================================================================
+
+// Signed distance to clip plane `plane`; inside when >= 0
+static float plane_distance(const swr_exec *ex, const float *pos, u32 plane) {
+    float gx = 2.0f * SWR_GUARD_BAND / ex->viewport[2];
+    float gy = 2.0f * SWR_GUARD_BAND / ex->viewport[3];
+
+    switch (plane) {
+    case 0:  return pos[3] - SWR_W_EPSILON;
+    case 1:  return pos[2];                     // Near, z >= 0
+    case 2:  return pos[3] - pos[2];            // Far, z <= w
+    case 3:  return pos[0] + gx * pos[3];       // Guard band
+    case 4:  return gx * pos[3] - pos[0];
+    case 5:  return pos[1] + gy * pos[3];
+    default: return gy * pos[3] - pos[1];
+    }
+}
+
+static u32 outcode(const swr_exec *ex, const float *pos) {
+    u32 code = 0;
+    for (u32 p = 0; p < SWR_CLIP_PLANES; p++) {
+        if (plane_distance(ex, pos, p) < 0.0f) {
+            code |= 1u << p;
+        }
+    }
+    return code;
+}
+
+static status emit_triangle(swr_exec *ex, const float *v0, const float *v1, const float *v2, u32 stride) {
+    float buffers[2][SWR_MAX_CLIP_VERTICES * (4 + XUDK_SWR_MAX_VARYINGS)];
+    u32 c0 = outcode(ex, v0), c1 = outcode(ex, v1), c2 = outcode(ex, v2);
+    float *in = buffers[0], *out = buffers[1];
+    u32 count = 3;
+
+    if (c0 & c1 & c2) {
+        return XUDK_OK;
+    }
+    if (!(c0 | c1 | c2)) {
+        return bin_triangle(ex, v0, v1, v2);
+    }
+
+    // Sutherland-Hodgman against each plane some vertex is outside of
+    xudk_memcpy(in, v0, stride * sizeof(float));
+    xudk_memcpy(in + stride, v1, stride * sizeof(float));
+    xudk_memcpy(in + 2 * stride, v2, stride * sizeof(float));
+    for (u32 p = 0; p < SWR_CLIP_PLANES && count >= 3; p++) {
+        u32 out_count = 0;
+        float *tmp;
+
+        if (!((c0 | c1 | c2) & (1u << p))) {
+            continue;
+        }
+        for (u32 i = 0; i < count; i++) {
+            const float *a = in + i * stride;
+            const float *b = in + ((i + 1) % count) * stride;
+            float da = plane_distance(ex, a, p);
+            float db = plane_distance(ex, b, p);
+
+            if (da >= 0.0f && out_count < SWR_MAX_CLIP_VERTICES) {
+                xudk_memcpy(out + out_count++ * stride, a, stride * sizeof(float));
+            }
+            if ((da >= 0.0f) != (db >= 0.0f) && out_count < SWR_MAX_CLIP_VERTICES) {
+                float t = da / (da - db);
+                float *o = out + out_count++ * stride;
+                for (u32 k = 0; k < stride; k++) {
+                    o[k] = a[k] + t * (b[k] - a[k]);
+                }
+            }
+        }
+        tmp = in;
+        in = out;
+        out = tmp;
+        count = out_count;
+    }
+
+    for (u32 i = 1; i + 1 < count; i++) {
+        status s = bin_triangle(ex, in, in + i * stride, in + (i + 1) * stride);
+        if (xudk_error(s)) {
+            return s;
+        }
+    }
+    return XUDK_OK;
+}
+
+// =============================================================================
+// DRAWS
+// =============================================================================
+
+static u32 fetch_index(const swr_exec *ex, u32 i) {
+    return ex->index_32bit ? ((const u32*)ex->index_data)[i] : ((const u16*)ex->index_data)[i];
+}
+
+static status exec_draw(swr_exec *ex, const swr_cmd *cmd) {
+    const swr_pipeline *p = ex->pipeline;
+    u32 count = cmd->draw.count;
+    u32 stride, slots, base = 0;
+    bool by_reference = false;
+    swr_device *dev = ex->dev;
+
+    if (!dev->pass.active || !p || !p->vs || (cmd->draw.indexed && !ex->index_data)) {
+        return XUDK_INVALID_PARAM;
+    }
+    if (count < 3) {
+        return XUDK_OK;
+    }
+    stride = 4 + p->varying_count;
+
+    // Shade each referenced vertex once when the index range is compact
+    slots = count;
+    if (cmd->draw.indexed) {
+        u32 lo = 0xFFFFFFFFu, hi = 0;
+        for (u32 i = 0; i < count; i++) {
+            u32 index = fetch_index(ex, cmd->draw.first + i);
+            lo = index < lo ? index : lo;
+            hi = index > hi ? index : hi;
+        }
+        by_reference = hi - lo >= count * 4 + 64;
+        if (!by_reference) {
+            base = lo;
+            slots = hi - lo + 1;
+        }
+    }
+    if (!swr_reserve(ex->ctx, (void**)&dev->vertex_cache, &dev->vertex_cache_capacity, (usize)slots * stride, sizeof(float))) {
+        return XUDK_OUT_OF_MEMORY;
+    }
+    dev->statistics.input_vertices += (u64)count * cmd->draw.instance_count;
+    dev->statistics.input_primitives += (u64)(p->topology == XUDK_TOPOLOGY_TRIANGLES ? count / 3 : count - 2) *
+                                        cmd->draw.instance_count;
+    dev->statistics.vertex_invocations += (u64)slots * cmd->draw.instance_count;
+
+    ex->env.push_constants = ex->push;
+    for (u32 instance = 0; instance < cmd->draw.instance_count; instance++) {
+        u32 instance_index = cmd->draw.first_instance + instance;
+
+        for (u32 k = 0; k < slots; k++) {
+            float *vtx = dev->vertex_cache + (usize)k * stride;
+            u32 vertex_index;
+
+            if (!cmd->draw.indexed) {
+                vertex_index = cmd->draw.first + k;
+            } else if (by_reference) {
+                vertex_index = fetch_index(ex, cmd->draw.first + k) + (u32)cmd->draw.vertex_offset;
+            } else {
+                vertex_index = base + k + (u32)cmd->draw.vertex_offset;
+            }
+            xudk_memset(vtx + 4, 0, p->varying_count * sizeof(float));
+            p->vs(&ex->env, vertex_index, instance_index, vtx, vtx + 4);
+        }
+
+        for (u32 i = 0; i + 2 < count; i += p->topology == XUDK_TOPOLOGY_TRIANGLES ? 3 : 1) {
+            u32 corner[3] = { i, i + 1, i + 2 };
+            const float *v[3];
+            status s;
+
+            if (p->topology == XUDK_TOPOLOGY_TRIANGLE_FAN) {
+                corner[0] = 0;
+                corner[1] = i + 1;
+                corner[2] = i + 2;
+            }
+            for (u32 c = 0; c < 3; c++) {
+                u32 slot = corner[c];
+                if (cmd->draw.indexed && !by_reference) {
+                    slot = fetch_index(ex, cmd->draw.first + corner[c]) - base;
+                }
+                v[c] = dev->vertex_cache + (usize)slot * stride;
+            }
+            s = emit_triangle(ex, v[0], v[1], v[2], stride);
+            if (xudk_error(s)) {
+                return s;
+            }
+        }
+    }
+    return XUDK_OK;
+}
+
+// =============================================================================
+// COMPUTE
+// =============================================================================
+
+typedef struct {
+    xudk_swr_compute_fn     cs;
+    const xudk_swr_env*     env;
+    u32                     groups_x;
+    u32                     groups_y;
+    u64                     total;
+    u64                     next;
+} swr_dispatch_job;
+
+static void dispatch_worker(void *arg) {
+    swr_dispatch_job *job = arg;
+    u64 i;
+
+    while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->total) {
+        u64 xy = (u64)job->groups_x * job->groups_y;
+        job->cs(job->env, (u32)(i % job->groups_x), (u32)(i / job->groups_x % job->groups_y), (u32)(i / xy));
+    }
+}
+
+static status exec_dispatch(swr_exec *ex, const swr_cmd *cmd) {
+    swr_dispatch_job job;
+
+    if (!ex->pipeline || !ex->pipeline->cs) {
+        return XUDK_INVALID_PARAM;
+    }
+    ex->env.push_constants = ex->push;
+    job.cs = ex->pipeline->cs;
+    job.env = &ex->env;
+    job.groups_x = cmd->dispatch.x;
+    job.groups_y = cmd->dispatch.y;
+    job.total = (u64)cmd->dispatch.x * cmd->dispatch.y * cmd->dispatch.z;
+    job.next = 0;
+    if (job.total) {
+        swr_parallel(ex->ctx, dispatch_worker, &job);
+    }
+    ex->dev->statistics.compute_invocations += job.total;
+    return XUDK_OK;
+}
+
+// =============================================================================
+// QUERIES
+// =============================================================================
+
+// Triangles still binned are rasterized first, so results cover all earlier work
+static void exec_query(swr_exec *ex, const swr_cmd *cmd) {
+    swr_query_pool *pool = cmd->query.pool;
+    u32 i = cmd->query.index;
+    const u64 *now = (const u64*)&ex->dev->statistics;
+    const u64 *begin = (const u64*)&pool->begin[i];
+    u64 *result;
+
+    if (ex->dev->pass.active) {
+        swr_flush_pass(ex->ctx);
+        ex->state = -1;
+    }
+    switch (cmd->type) {
+    case SWR_CMD_TIMESTAMP:
+        pool->timestamps[i] = swr_now(ex->ctx);
+        pool->written[i] = true;
+        break;
+    case SWR_CMD_BEGIN_QUERY:
+        pool->begin[i] = ex->dev->statistics;
+        pool->written[i] = false;
+        break;
+    default:
+        result = (u64*)&pool->statistics[i];
+        for (u32 k = 0; k < sizeof(xudk_gpu_pipeline_statistics) / sizeof(u64); k++) {
+            result[k] = now[k] - begin[k];
+        }
+        pool->written[i] = true;
+        break;
+    }
+}
+
+// =============================================================================
+// EXECUTION
+// =============================================================================
+
+static status exec_stream(swr_exec *ex, const swr_cmd_buffer *cmd_buffer) {
+    status s = XUDK_OK;
+
+    for (u32 offset = 0; offset < cmd_buffer->size && xudk_ok(s); ) {
+        const swr_cmd *cmd = (const swr_cmd*)(cmd_buffer->stream + offset);
+
+        offset += cmd->size;
+        switch (cmd->type) {
+        case SWR_CMD_BEGIN_PASS:
+            if (ex->dev->pass.active) {
+                pass_end(ex);
+            }
+            s = pass_begin(ex, &cmd->pass);
+            break;
+        case SWR_CMD_END_PASS:
+            if (ex->dev->pass.active) {
+                pass_end(ex);
+            }
+            break;
+        case SWR_CMD_VIEWPORT:
+            ex->viewport[0] = (float)cmd->rect.x;
+            ex->viewport[1] = (float)cmd->rect.y;
+            ex->viewport[2] = (float)cmd->rect.width;
+            ex->viewport[3] = (float)cmd->rect.height;
+            break;
+        case SWR_CMD_SCISSOR:
+            ex->scissor[0] = cmd->rect.x;
+            ex->scissor[1] = cmd->rect.y;
+            ex->scissor[2] = cmd->rect.x + (i32)cmd->rect.width;
+            ex->scissor[3] = cmd->rect.y + (i32)cmd->rect.height;
+            ex->state = -1;
+            break;
+        case SWR_CMD_BIND_PIPELINE:
+            ex->pipeline = cmd->pipeline;
+            ex->state = -1;
+            break;
+        case SWR_CMD_BIND_VERTEX_BUFFER:
+            ex->env.vertex_buffers[cmd->vertex_buffer.slot] = cmd->vertex_buffer.data;
+            ex->state = -1;
+            break;
+        case SWR_CMD_BIND_INDEX_BUFFER:
+            ex->index_data = cmd->index_buffer.data;
+            ex->index_32bit = cmd->index_buffer.is_32bit;
+            break;
+        case SWR_CMD_BIND_SET:
+            ex->env.sets[cmd->set.index] = cmd->set.set;
+            ex->state = -1;
+            break;
+        case SWR_CMD_PUSH_CONSTANTS:
+            xudk_memcpy(ex->push + cmd->push.offset, cmd->push.data, cmd->push.size);
+            ex->state = -1;
+            break;
+        case SWR_CMD_DRAW:
+            s = exec_draw(ex, cmd);
+            break;
+        case SWR_CMD_DISPATCH:
+            s = exec_dispatch(ex, cmd);
+            break;
+        case SWR_CMD_BARRIER:
+            // Commands already execute in order
+            break;
+        case SWR_CMD_EXECUTE:
+            // Only primaries record these, so this never nests deeper
+            s = exec_stream(ex, cmd->list);
+            break;
+        case SWR_CMD_COPY_BUFFER:
+        case SWR_CMD_COPY_TO_TEXTURE:
+            // Transfers sit outside render passes; resolve one left open first
+            if (ex->dev->pass.active) {
+                pass_end(ex);
+            }
+            if (cmd->type == SWR_CMD_COPY_BUFFER) {
+                xudk_memcpy(cmd->copy.dst, cmd->copy.src, (usize)cmd->copy.size);
+            } else {
+                s = swr_texture_write(ex->ctx, cmd->upload.texture, cmd->upload.src, (usize)cmd->upload.size,
+                                      cmd->upload.mip_level, cmd->upload.array_slice);
+            }
+            break;
+        case SWR_CMD_TIMESTAMP:
+        case SWR_CMD_BEGIN_QUERY:
+        case SWR_CMD_END_QUERY:
+            exec_query(ex, cmd);
+            break;
+        }
+    }
+    return s;
+}
+
+status swr_execute(xudk_ctx *ctx, swr_cmd_buffer *cmd_buffer) {
+    swr_exec ex;
+    status s;
+
+    xudk_memset(&ex, 0, sizeof(ex));
+    ex.ctx = ctx;
+    ex.dev = swr_device_of(ctx);
+    ex.state = -1;
+
+    s = exec_stream(&ex, cmd_buffer);
+
+    // A pass left open (or aborted by an error) still resolves what was binned
+    if (ex.dev->pass.active) {
+        pass_end(&ex);
+    }
+    return s;
+}
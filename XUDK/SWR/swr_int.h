@@ -0,0 +1,264 @@
+/*
+ * XUDK - Software rasterizer internals
+ */
+
+#ifndef XUDK_SWR_INT_H
+#define XUDK_SWR_INT_H
+
+#include "swr.h"
+#include "xudk/CORE/core.h"
+
+// =============================================================================
+// RESOURCES
+// =============================================================================
+
+typedef struct {
+    u8*                 data;
+    u64                 size;
+} swr_buffer;
+
+typedef struct {
+    u8*                 data;
+    u64                 size;
+    u32                 width;
+    u32                 height;
+    u32                 depth;
+    u32                 mip_levels;
+    u32                 array_size;
+    u32                 texel_size;
+    xudk_texture_format format;         // Storage format
+    xudk_texture_format compressed;     // BCn format uploads are decoded from, or UNKNOWN
+} swr_texture;
+
+typedef struct {
+    xudk_swr_program    program;
+} swr_shader;
+
+// Slots a layout's sets fill: b<n> and t<n> bits, plus at most one texture array
+typedef struct {
+    u32                 buffer_mask;
+    u32                 texture_mask;
+    u32                 array_binding;
+    u32                 array_count;        // 0 without an array
+} swr_layout;
+
+typedef struct {
+    xudk_swr_descriptor_set set;            // First, so the handle binds as the set itself
+    swr_layout              layout;         // Copied, so sets may outlive their layout
+} swr_descriptor_set;
+
+typedef struct {
+    xudk_swr_vertex_fn      vs;
+    xudk_swr_fragment_fn    fs;
+    xudk_swr_compute_fn     cs;
+    u32                     varying_count;
+    xudk_primitive_topology topology;
+    bool                    depth_test;
+    bool                    depth_write;
+    bool                    blend;
+} swr_pipeline;
+
+// =============================================================================
+// COMMANDS
+// =============================================================================
+
+typedef enum {
+    SWR_CMD_BEGIN_PASS = 0,
+    SWR_CMD_END_PASS,
+    SWR_CMD_VIEWPORT,
+    SWR_CMD_SCISSOR,
+    SWR_CMD_BIND_PIPELINE,
+    SWR_CMD_BIND_VERTEX_BUFFER,
+    SWR_CMD_BIND_INDEX_BUFFER,
+    SWR_CMD_BIND_SET,
+    SWR_CMD_PUSH_CONSTANTS,
+    SWR_CMD_DRAW,
+    SWR_CMD_DISPATCH,
+    SWR_CMD_BARRIER,
+    SWR_CMD_EXECUTE,
+    SWR_CMD_COPY_BUFFER,
+    SWR_CMD_COPY_TO_TEXTURE,
+    SWR_CMD_TIMESTAMP,
+    SWR_CMD_BEGIN_QUERY,
+    SWR_CMD_END_QUERY
+} swr_cmd_type;
+
+typedef struct {
+    swr_texture*        color;
+    swr_texture*        depth;
+    u32                 width;
+    u32                 height;
+    bool                clear_color;
+    bool                clear_depth;
+    float               clear_color_value[4];
+    float               clear_depth_value;
+} swr_pass_desc;
+
+struct swr_cmd_buffer;
+
+// Query pool. Statistics queries keep the running totals their begin saw and
+// the difference at their end.
+typedef struct {
+    xudk_query_type                 type;
+    u32                             count;
+    bool*                           written;        // Ended, or its timestamp taken
+    u64*                            timestamps;     // Nanoseconds
+    xudk_gpu_pipeline_statistics*   statistics;
+    xudk_gpu_pipeline_statistics*   begin;
+} swr_query_pool;
+
+// Commands are packed back to back in a byte stream; each takes only its
+// header and the union member it uses, rounded up to 8 bytes
+typedef struct {
+    u16                 type;           // swr_cmd_type
+    u16                 size;           // Whole command in bytes
+    union {
+        swr_pass_desc   pass;
+        struct { i32 x, y; u32 width, height; } rect;
+        swr_pipeline*   pipeline;
+        struct { u32 slot; const u8 *data; } vertex_buffer;
+        struct { const u8 *data; bool is_32bit; } index_buffer;
+        struct { u32 index; const xudk_swr_descriptor_set *set; } set;
+        struct { u32 offset, size; u8 data[XUDK_SWR_PUSH_CONSTANT_SIZE]; } push;
+        struct { u32 count, instance_count, first, first_instance; i32 vertex_offset; bool indexed; } draw;
+        struct { u32 x, y, z; } dispatch;
+        const struct swr_cmd_buffer* list;
+        struct { const u8 *src; u8 *dst; u64 size; } copy;
+        struct { const u8 *src; swr_texture *texture; u64 size; u32 mip_level, array_slice; } upload;
+        struct { swr_query_pool *pool; u32 index; } query;
+    };
+} swr_cmd;
+
+typedef struct swr_cmd_buffer {
+    u8*                 stream;
+    u32                 size;           // Bytes of commands recorded
+    u32                 capacity;
+    u32                 count;
+    u32                 level;          // XUDK_CMD_BUFFER_PRIMARY / _SECONDARY, fixed at begin_recording
+    bool                is_compute;
+} swr_cmd_buffer;
+
+// =============================================================================
+// TILE BINNING
+// =============================================================================
+
+// Triangle set up for rasterization. Coverage uses 28.4 fixed-point edge
+// functions; attributes are interpolated from vertex 0 with float gradients.
+typedef struct {
+    i32                 a[3];           // Edge step per subpixel in x
+    i32                 b[3];           // Edge step per subpixel in y
+    i64                 c[3];           // Edge constant, fill-rule bias included
+    i32                 min_x, min_y;   // Pixel bounding box, inclusive
+    i32                 max_x, max_y;
+    float               origin[2];      // Vertex 0 in pixels
+    float               l1[2];          // d/dx, d/dy of the vertex 1 barycentric
+    float               l2[2];          // d/dx, d/dy of the vertex 2 barycentric
+    float               z[3];           // z0, z1 - z0, z2 - z0
+    float               inv_w[3];       // Same for 1/w
+    u32                 state;          // Index into swr_pass.states
+    u32                 varyings;       // Offset into swr_pass.varyings: V0/w0, V1/w1 - V0/w0, V2/w2 - V0/w0
+} swr_tri;
+
+// Draw-time state captured for the deferred fragment work
+typedef struct {
+    xudk_swr_env            env;
+    u8                      push[XUDK_SWR_PUSH_CONSTANT_SIZE];
+    xudk_swr_fragment_fn    fs;
+    u32                     varying_count;
+    bool                    depth_test;
+    bool                    depth_write;
+    bool                    blend;
+    i32                     scissor[4];     // x0, y0, x1, y1 (exclusive)
+} swr_draw_state;
+
+typedef struct {
+    u32*                items;
+    usize               count;
+    usize               capacity;
+} swr_bin;
+
+// Render pass being recorded into tile bins
+typedef struct {
+    swr_pass_desc       desc;
+    bool                active;
+    bool                clear_pending;
+    u32                 tiles_x;
+    u32                 tiles_y;
+    swr_bin*            bins;           // tiles_x * tiles_y in use
+    u32                 bin_count;      // Allocated
+    swr_tri*            tris;
+    usize               tri_count;
+    usize               tri_capacity;
+    float*              varyings;
+    usize               varying_count;
+    usize               varying_capacity;
+    swr_draw_state*     states;
+    usize               state_count;
+    usize               state_capacity;
+} swr_pass;
+
+// =============================================================================
+// DEVICE
+// =============================================================================
+
+// Native program registered for an HLSL source text
+typedef struct {
+    u64                 hash;
+    xudk_swr_program    program;
+} swr_registered_shader;
+
+typedef struct {
+    xudk_ctx*           ctx;
+    xudk_gpu_info       info;
+    xudk_gpu_heap       heap;
+    u64                 memory_used;
+    u64                 gpu_time_ns;
+    xudk_gpu_pipeline_statistics statistics;    // Running totals, for statistics queries
+    u32                 cpu_count;
+    swr_registered_shader* shaders;
+    usize               shader_count;
+    usize               shader_capacity;
+
+    // Execution
+    swr_pass            pass;
+    float*              vertex_cache;
+    usize               vertex_cache_capacity;
+    u32*                present_buffer;
+    usize               present_capacity;
+    swr_texture*        last_presented;
+} swr_device;
+
+#define swr_device_of(ctx)  ((swr_device*)(ctx)->gpu_device)
+
+// Nanoseconds from the firmware clock, for timing (swr.c)
+u64    swr_now(xudk_ctx *ctx);
+
+// Grow an array allocated from ctx->memory to hold at least `needed` elements
+bool   swr_reserve(xudk_ctx *ctx, void **array, usize *capacity, usize needed, usize element_size);
+
+// Run worker(job) on every processor; workers pull items with an atomic counter
+void   swr_parallel(xudk_ctx *ctx, void (*worker)(void *job), void *job);
+
+// Texel helpers
+u32    swr_texel_size(xudk_texture_format format);
+u8*    swr_texel_address(const swr_texture *texture, u32 x, u32 y);
+void   swr_texel_load(const swr_texture *texture, const u8 *texel, float color[4]);
+void   swr_texel_store(const swr_texture *texture, u8 *texel, const float color[4]);
+
+// Fill one subresource from upload_texture_data-style data (swr.c)
+status swr_texture_write(xudk_ctx *ctx, swr_texture *texture, const void *data, usize size,
+                         u32 mip_level, u32 array_slice);
+
+// Command recording entry points (swr_cmd.c)
+void   swr_install_commands(xudk_gpu *gpu);
+
+// Execute a recorded command buffer
+status swr_execute(xudk_ctx *ctx, swr_cmd_buffer *cmd_buffer);
+
+// Rasterize every binned triangle of the current pass and reset the bins
+void   swr_flush_pass(xudk_ctx *ctx);
+
+// Register the built-in shader library (xudk_basic_*_shader_source, ...)
+status swr_register_builtin_shaders(xudk_ctx *ctx);
+
+#endif // XUDK_SWR_INT_H
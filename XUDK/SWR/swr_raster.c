@@ -0,0 +1,558 @@
+/*
+ * XUDK - Software rasterizer: tile rasterization and texel access
+ * Each tile is owned by one processor for the whole flush, so tiles need no
+ * locking. Coverage is tested four pixels at a time with SSE2 when the
+ * build allows it; shading is one fragment-stage call per covered pixel.
+ */
+
+#include "swr_int.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SWR_SSE2    1
+#endif
+
+// =============================================================================
+// TEXELS
+// =============================================================================
+
+// sRGB formats are stored and read as linear UNORM; D24S8 is kept as 32-bit float depth
+u32 swr_texel_size(xudk_texture_format format) {
+    switch (format) {
+    case XUDK_FORMAT_R8G8B8A8_UNORM:
+    case XUDK_FORMAT_R8G8B8A8_SRGB:
+    case XUDK_FORMAT_B8G8R8A8_UNORM:
+    case XUDK_FORMAT_B8G8R8A8_SRGB:
+    case XUDK_FORMAT_R32_FLOAT:
+    case XUDK_FORMAT_D32_FLOAT:
+    case XUDK_FORMAT_D24_UNORM_S8_UINT:
+        return 4;
+    case XUDK_FORMAT_R16G16B16A16_FLOAT:
+    case XUDK_FORMAT_R32G32_FLOAT:
+        return 8;
+    case XUDK_FORMAT_R32G32B32A32_FLOAT:
+        return 16;
+    default:
+        return 0;   // Block-compressed textures are stored decoded, see swr_texture_init
+    }
+}
+
+u8* swr_texel_address(const swr_texture *texture, u32 x, u32 y) {
+    return texture->data + ((usize)y * texture->width + x) * texture->texel_size;
+}
+
+static float half_to_float(u16 h) {
+    union { u32 u; float f; } v;
+    u32 sign = (u32)(h & 0x8000) << 16;
+    u32 exponent = (h >> 10) & 0x1F;
+    u32 mantissa = h & 0x3FF;
+
+    if (exponent == 0x1F) {
+        v.u = sign | 0x7F800000 | (mantissa << 13);
+    } else if (exponent) {
+        v.u = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else {
+        // Denormal: value is mantissa * 2^-24
+        v.f = (float)mantissa * (1.0f / 16777216.0f);
+        v.u |= sign;
+    }
+    return v.f;
+}
+
+static u16 float_to_half(float f) {
+    union { u32 u; float f; } v;
+    u32 sign, exponent, mantissa;
+
+    v.f = f;
+    sign = (v.u >> 16) & 0x8000;
+    exponent = (v.u >> 23) & 0xFF;
+    mantissa = v.u & 0x7FFFFF;
+    if (exponent == 0xFF) {
+        return (u16)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent > 142) {
+        return (u16)(sign | 0x7C00);
+    }
+    if (exponent < 113) {
+        if (exponent < 103) {
+            return (u16)sign;
+        }
+        mantissa |= 0x800000;
+        return (u16)(sign | ((mantissa >> (126 - exponent)) + 1) >> 1);
+    }
+    return (u16)(sign | (((exponent - 112) << 10) | (mantissa >> 13)));
+}
+
+static u8 unorm8(float v) {
+    if (!(v > 0.0f)) {
+        return 0;
+    }
+    return v >= 1.0f ? 255 : (u8)(v * 255.0f + 0.5f);
+}
+
+void swr_texel_load(const swr_texture *texture, const u8 *texel, float color[4]) {
+    const float *f = (const float*)texel;
+    const u16 *h = (const u16*)texel;
+
+    switch (texture->format) {
+    case XUDK_FORMAT_R8G8B8A8_UNORM:
+    case XUDK_FORMAT_R8G8B8A8_SRGB:
+        color[0] = texel[0] * (1.0f / 255.0f);
+        color[1] = texel[1] * (1.0f / 255.0f);
+        color[2] = texel[2] * (1.0f / 255.0f);
+        color[3] = texel[3] * (1.0f / 255.0f);
+        break;
+    case XUDK_FORMAT_B8G8R8A8_UNORM:
+    case XUDK_FORMAT_B8G8R8A8_SRGB:
+        color[0] = texel[2] * (1.0f / 255.0f);
+        color[1] = texel[1] * (1.0f / 255.0f);
+        color[2] = texel[0] * (1.0f / 255.0f);
+        color[3] = texel[3] * (1.0f / 255.0f);
+        break;
+    case XUDK_FORMAT_R32G32B32A32_FLOAT:
+        color[0] = f[0];
+        color[1] = f[1];
+        color[2] = f[2];
+        color[3] = f[3];
+        break;
+    case XUDK_FORMAT_R16G16B16A16_FLOAT:
+        color[0] = half_to_float(h[0]);
+        color[1] = half_to_float(h[1]);
+        color[2] = half_to_float(h[2]);
+        color[3] = half_to_float(h[3]);
+        break;
+    case XUDK_FORMAT_R32G32_FLOAT:
+        color[0] = f[0];
+        color[1] = f[1];
+        color[2] = 0.0f;
+        color[3] = 1.0f;
+        break;
+    default:
+        color[0] = f[0];
+        color[1] = 0.0f;
+        color[2] = 0.0f;
+        color[3] = 1.0f;
+        break;
+    }
+}
+
+void swr_texel_store(const swr_texture *texture, u8 *texel, const float color[4]) {
+    float *f = (float*)texel;
+    u16 *h = (u16*)texel;
+
+    switch (texture->format) {
+    case XUDK_FORMAT_R8G8B8A8_UNORM:
+    case XUDK_FORMAT_R8G8B8A8_SRGB:
+        texel[0] = unorm8(color[0]);
+        texel[1] = unorm8(color[1]);
+        texel[2] = unorm8(color[2]);
+        texel[3] = unorm8(color[3]);
+        break;
+    case XUDK_FORMAT_B8G8R8A8_UNORM:
+    case XUDK_FORMAT_B8G8R8A8_SRGB:
+        texel[0] = unorm8(color[2]);
+        texel[1] = unorm8(color[1]);
+        texel[2] = unorm8(color[0]);
+        texel[3] = unorm8(color[3]);
+        break;
+    case XUDK_FORMAT_R32G32B32A32_FLOAT:
+        f[0] = color[0];
+        f[1] = color[1];
+        f[2] = color[2];
+        f[3] = color[3];
+        break;
+    case XUDK_FORMAT_R16G16B16A16_FLOAT:
+        h[0] = float_to_half(color[0]);
+        h[1] = float_to_half(color[1]);
+        h[2] = float_to_half(color[2]);
+        h[3] = float_to_half(color[3]);
+        break;
+    case XUDK_FORMAT_R32G32_FLOAT:
+        f[0] = color[0];
+        f[1] = color[1];
+        break;
+    default:
+        f[0] = color[0];
+        break;
+    }
+}
+
+// =============================================================================
+// SHADER TEXTURE ACCESS
+// =============================================================================
+
+void xudk_swr_load(const xudk_gpu_texture *texture, u32 x, u32 y, float color[4]) {
+    const swr_texture *t = texture ? texture->texture_handle : null;
+
+    if (!t || x >= t->width || y >= t->height) {
+        color[0] = color[1] = color[2] = color[3] = 0.0f;
+        return;
+    }
+    swr_texel_load(t, swr_texel_address(t, x, y), color);
+}
+
+void xudk_swr_store(xudk_gpu_texture *texture, u32 x, u32 y, const float color[4]) {
+    const swr_texture *t = texture ? texture->texture_handle : null;
+
+    if (t && x < t->width && y < t->height) {
+        swr_texel_store(t, swr_texel_address(t, x, y), color);
+    }
+}
+
+static i32 floor_int(float v) {
+    i32 i = (i32)v;
+    return (float)i > v ? i - 1 : i;
+}
+
+// Bilinear, clamp-to-edge
+void xudk_swr_sample(const xudk_gpu_texture *texture, float u, float v, float color[4]) {
+    const swr_texture *t = texture ? texture->texture_handle : null;
+    float c00[4], c10[4], c01[4], c11[4];
+    float fx, fy, ax, ay;
+    i32 x0, y0, x1, y1;
+
+    if (!t) {
+        color[0] = color[1] = color[2] = color[3] = 0.0f;
+        return;
+    }
+    fx = u * (float)t->width - 0.5f;
+    fy = v * (float)t->height - 0.5f;
+    fx = fx > -1.0f ? (fx < (float)t->width ? fx : (float)t->width) : -1.0f;
+    fy = fy > -1.0f ? (fy < (float)t->height ? fy : (float)t->height) : -1.0f;
+    x0 = floor_int(fx);
+    y0 = floor_int(fy);
+    ax = fx - (float)x0;
+    ay = fy - (float)y0;
+    x1 = x0 + 1 < (i32)t->width ? x0 + 1 : (i32)t->width - 1;
+    y1 = y0 + 1 < (i32)t->height ? y0 + 1 : (i32)t->height - 1;
+    x0 = x0 < 0 ? 0 : (x0 >= (i32)t->width ? (i32)t->width - 1 : x0);
+    y0 = y0 < 0 ? 0 : (y0 >= (i32)t->height ? (i32)t->height - 1 : y0);
+    x1 = x1 < 0 ? 0 : x1;
+    y1 = y1 < 0 ? 0 : y1;
+
+    swr_texel_load(t, swr_texel_address(t, (u32)x0, (u32)y0), c00);
+    swr_texel_load(t, swr_texel_address(t, (u32)x1, (u32)y0), c10);
+    swr_texel_load(t, swr_texel_address(t, (u32)x0, (u32)y1), c01);
+    swr_texel_load(t, swr_texel_address(t, (u32)x1, (u32)y1), c11);
+    for (u32 i = 0; i < 4; i++) {
+        float top = c00[i] + (c10[i] - c00[i]) * ax;
+        float bottom = c01[i] + (c11[i] - c01[i]) * ax;
+        color[i] = top + (bottom - top) * ay;
+    }
+}
+
+// =============================================================================
+// RASTERIZATION
+// =============================================================================
+
+static void clear_tile(const swr_pass *pass, i32 x0, i32 y0, i32 x1, i32 y1) {
+    const swr_pass_desc *desc = &pass->desc;
+    u8 texel[16];
+
+    if (desc->clear_color) {
+        const swr_texture *t = desc->color;
+        u32 size = t->texel_size;
+
+        swr_texel_store(t, texel, desc->clear_color_value);
+        for (i32 y = y0; y < y1; y++) {
+            u8 *row = swr_texel_address(t, (u32)x0, (u32)y);
+            if (size == 4) {
+                u32 value = *(const u32*)texel;
+                for (i32 x = 0; x < x1 - x0; x++) {
+                    ((u32*)row)[x] = value;
+                }
+            } else {
+                for (i32 x = 0; x < x1 - x0; x++) {
+                    xudk_memcpy(row + (usize)x * size, texel, size);
+                }
+            }
+        }
+    }
+    if (desc->clear_depth) {
+        for (i32 y = y0; y < y1; y++) {
+            float *row = (float*)swr_texel_address(desc->depth, (u32)x0, (u32)y);
+            for (i32 x = 0; x < x1 - x0; x++) {
+                row[x] = desc->clear_depth_value;
+            }
+        }
+    }
+}
+
+static float saturate(float v) {
+    return v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;
+}
+
+// Blend and store one fragment; 8-bit targets skip the generic texel path
+static void write_color(const swr_texture *target, u8 *texel, float color[4], bool blend) {
+    bool bgra = target->format == XUDK_FORMAT_B8G8R8A8_UNORM || target->format == XUDK_FORMAT_B8G8R8A8_SRGB;
+    bool rgba = target->format == XUDK_FORMAT_R8G8B8A8_UNORM || target->format == XUDK_FORMAT_R8G8B8A8_SRGB;
+
+    if (!bgra && !rgba) {
+        if (blend) {
+            float dst[4];
+            float a = saturate(color[3]);
+            swr_texel_load(target, texel, dst);
+            color[0] = color[0] * a + dst[0] * (1.0f - a);
+            color[1] = color[1] * a + dst[1] * (1.0f - a);
+            color[2] = color[2] * a + dst[2] * (1.0f - a);
+            color[3] = a + dst[3] * (1.0f - a);
+        }
+        swr_texel_store(target, texel, color);
+        return;
+    }
+
+#if SWR_SSE2
+    {
+        __m128 c = _mm_loadu_ps(color);
+        __m128i packed;
+
+        if (bgra) {
+            c = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 1, 2));
+        }
+        c = _mm_min_ps(_mm_max_ps(c, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        if (blend) {
+            __m128 a = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3));
+            __m128i d = _mm_cvtsi32_si128(*(const i32*)texel);
+            __m128 dst;
+
+            d = _mm_unpacklo_epi16(_mm_unpacklo_epi8(d, _mm_setzero_si128()), _mm_setzero_si128());
+            dst = _mm_mul_ps(_mm_cvtepi32_ps(d), _mm_set1_ps(1.0f / 255.0f));
+            __m128 factor = _mm_move_ss(a, _mm_set1_ps(1.0f));
+
+            // Color channels get src * a + dst * (1 - a), alpha gets a + dst.a * (1 - a)
+            factor = _mm_shuffle_ps(factor, factor, _MM_SHUFFLE(0, 1, 1, 1));
+            c = _mm_add_ps(_mm_mul_ps(c, factor), _mm_mul_ps(dst, _mm_sub_ps(_mm_set1_ps(1.0f), a)));
+        }
+        packed = _mm_cvtps_epi32(_mm_mul_ps(c, _mm_set1_ps(255.0f)));
+        packed = _mm_packs_epi32(packed, packed);
+        *(i32*)texel = _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+    }
+#else
+    {
+        u32 r = bgra ? 2 : 0, b = bgra ? 0 : 2;
+
+        if (blend) {
+            float a = saturate(color[3]);
+            float ia = (1.0f - a) * (1.0f / 255.0f);
+            color[0] = saturate(color[0]) * a + texel[r] * ia;
+            color[1] = saturate(color[1]) * a + texel[1] * ia;
+            color[2] = saturate(color[2]) * a + texel[b] * ia;
+            color[3] = a + texel[3] * ia;
+        }
+        texel[r] = (u8)(saturate(color[0]) * 255.0f + 0.5f);
+        texel[1] = (u8)(saturate(color[1]) * 255.0f + 0.5f);
+        texel[b] = (u8)(saturate(color[2]) * 255.0f + 0.5f);
+        texel[3] = (u8)(saturate(color[3]) * 255.0f + 0.5f);
+    }
+#endif
+}
+
+// Depth test, fragment stage, blend and write for the covered pixels of a
+// 4-pixel span. Interpolation is done for all four lanes at once.
+// Returns how many fragments it ran the fragment stage for
+static u32 shade_span(const swr_pass *pass, const swr_tri *tri, const swr_draw_state *st,
+                      i32 x, i32 y, u32 mask, const float l1[4], const float l2[4]) {
+    const float *v = pass->varyings + tri->varyings;
+    float varyings[4][XUDK_SWR_MAX_VARYINGS];
+    float z[4], w[4];
+    float *depth = null;
+    u8 *texel = null;
+    u32 n = st->varying_count, shaded = 0;
+
+    for (u32 lane = 0; lane < 4; lane++) {
+        z[lane] = tri->z[0] + l1[lane] * tri->z[1] + l2[lane] * tri->z[2];
+        w[lane] = 1.0f / (tri->inv_w[0] + l1[lane] * tri->inv_w[1] + l2[lane] * tri->inv_w[2]);
+    }
+    if (st->depth_test) {
+        depth = (float*)swr_texel_address(pass->desc.depth, (u32)x, (u32)y);
+        for (u32 lane = 0; lane < 4; lane++) {
+            if ((mask & (1u << lane)) && !(z[lane] < depth[lane])) {
+                mask &= ~(1u << lane);
+            }
+        }
+        if (!mask) {
+            return 0;
+        }
+    }
+
+    for (u32 i = 0; i < n; i++) {
+        float a = v[i], b = v[n + i], c = v[2 * n + i];
+        for (u32 lane = 0; lane < 4; lane++) {
+            varyings[lane][i] = (a + l1[lane] * b + l2[lane] * c) * w[lane];
+        }
+    }
+
+    if (pass->desc.color) {
+        texel = swr_texel_address(pass->desc.color, (u32)x, (u32)y);
+    }
+    for (u32 lane = 0; lane < 4; lane++) {
+        float color[4];
+
+        if (!(mask & (1u << lane))) {
+            continue;
+        }
+        shaded++;
+        if (!st->fs(&st->env, varyings[lane], color)) {
+            continue;
+        }
+        if (st->depth_write) {
+            depth[lane] = z[lane];
+        }
+        if (texel) {
+            write_color(pass->desc.color, texel + lane * pass->desc.color->texel_size, color, st->blend);
+        }
+    }
+    return shaded;
+}
+
+// Rasterize one triangle inside the pixel rectangle [x0, x1) x [y0, y1);
+// returns the fragments shaded
+static u64 raster_triangle(const swr_pass *pass, const swr_tri *tri, const swr_draw_state *st,
+                           i32 x0, i32 y0, i32 x1, i32 y1) {
+    i32 row[3] = { 0, 0, 0 }, step_x[3], step_y[3];
+    u64 shaded = 0;
+    u32 tested = 0;
+    float dx0 = (float)x0 + 0.5f - tri->origin[0];
+
+    // Edges that cover the whole rectangle need no per-pixel test; for the
+    // others the values inside the rectangle fit in 32 bits
+    for (u32 k = 0; k < 3; k++) {
+        i64 e = (i64)tri->a[k] * (x0 * 16 + 8) + (i64)tri->b[k] * (y0 * 16 + 8) + tri->c[k];
+        i64 dx = (i64)tri->a[k] * 16 * (x1 - 1 - x0);
+        i64 dy = (i64)tri->b[k] * 16 * (y1 - 1 - y0);
+        i64 lo = e + (dx < 0 ? dx : 0) + (dy < 0 ? dy : 0);
+        i64 hi = e + (dx > 0 ? dx : 0) + (dy > 0 ? dy : 0);
+
+        if (hi < 0) {
+            return 0;
+        }
+        step_x[k] = tri->a[k] * 16;
+        step_y[k] = tri->b[k] * 16;
+        if (lo < 0) {
+            tested |= 1u << k;
+            row[k] = (i32)e;
+        }
+    }
+
+    for (i32 y = y0; y < y1; y++) {
+        float dy = (float)y + 0.5f - tri->origin[1];
+        float l1_row = tri->l1[0] * dx0 + tri->l1[1] * dy;
+        float l2_row = tri->l2[0] * dx0 + tri->l2[1] * dy;
+        i32 e[3] = { row[0], row[1], row[2] };
+
+        for (i32 x = x0; x < x1; x += 4) {
+            u32 mask = x1 - x >= 4 ? 0xF : (1u << (x1 - x)) - 1;
+            float offset = (float)(x - x0);
+            float l1[4], l2[4];
+
+#if SWR_SSE2
+            for (u32 k = 0; k < 3; k++) {
+                if (tested & (1u << k)) {
+                    __m128i lanes = _mm_add_epi32(_mm_set1_epi32(e[k]),
+                                                  _mm_set_epi32(3 * step_x[k], 2 * step_x[k], step_x[k], 0));
+                    mask &= ~(u32)_mm_movemask_ps(_mm_castsi128_ps(lanes));
+                }
+            }
+#else
+            for (u32 k = 0; k < 3; k++) {
+                if (tested & (1u << k)) {
+                    for (u32 lane = 0; lane < 4; lane++) {
+                        if (e[k] + (i32)lane * step_x[k] < 0) {
+                            mask &= ~(1u << lane);
+                        }
+                    }
+                }
+            }
+#endif
+            for (u32 k = 0; k < 3; k++) {
+                e[k] += 4 * step_x[k];
+            }
+            if (!mask) {
+                continue;
+            }
+
+            for (u32 lane = 0; lane < 4; lane++) {
+                l1[lane] = l1_row + tri->l1[0] * (offset + (float)lane);
+                l2[lane] = l2_row + tri->l2[0] * (offset + (float)lane);
+            }
+            shaded += shade_span(pass, tri, st, x, y, mask, l1, l2);
+        }
+        for (u32 k = 0; k < 3; k++) {
+            row[k] += step_y[k];
+        }
+    }
+    return shaded;
+}
+
+typedef struct {
+    const swr_pass*     pass;
+    u32                 tile_count;
+    u32                 next;
+    u64                 shaded;         // Fragments, for the statistics
+} swr_tile_job;
+
+static u64 raster_tile(const swr_pass *pass, u32 index) {
+    const swr_bin *bin = &pass->bins[index];
+    i32 x0 = (i32)(index % pass->tiles_x) * XUDK_SWR_TILE_SIZE;
+    i32 y0 = (i32)(index / pass->tiles_x) * XUDK_SWR_TILE_SIZE;
+    i32 x1 = x0 + XUDK_SWR_TILE_SIZE < (i32)pass->desc.width ? x0 + XUDK_SWR_TILE_SIZE : (i32)pass->desc.width;
+    i32 y1 = y0 + XUDK_SWR_TILE_SIZE < (i32)pass->desc.height ? y0 + XUDK_SWR_TILE_SIZE : (i32)pass->desc.height;
+    u64 shaded = 0;
+
+    if (pass->clear_pending) {
+        clear_tile(pass, x0, y0, x1, y1);
+    }
+    for (usize i = 0; i < bin->count; i++) {
+        const swr_tri *tri = &pass->tris[bin->items[i]];
+        i32 rx0 = tri->min_x > x0 ? tri->min_x : x0;
+        i32 ry0 = tri->min_y > y0 ? tri->min_y : y0;
+        i32 rx1 = tri->max_x + 1 < x1 ? tri->max_x + 1 : x1;
+        i32 ry1 = tri->max_y + 1 < y1 ? tri->max_y + 1 : y1;
+
+        if (rx0 < rx1 && ry0 < ry1) {
+            shaded += raster_triangle(pass, tri, &pass->states[tri->state], rx0, ry0, rx1, ry1);
+        }
+    }
+    return shaded;
+}
+
+static void tile_worker(void *arg) {
+    swr_tile_job *job = arg;
+    u64 shaded = 0;
+    u32 i;
+
+    while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->tile_count) {
+        shaded += raster_tile(job->pass, i);
+    }
+    __atomic_fetch_add(&job->shaded, shaded, __ATOMIC_RELAXED);
+}
+
+void swr_flush_pass(xudk_ctx *ctx) {
+    swr_device *dev = swr_device_of(ctx);
+    swr_pass *pass = &dev->pass;
+    swr_tile_job job;
+
+    if (!pass->tri_count && !pass->clear_pending) {
+        return;
+    }
+
+    // States may have moved while the array grew; point each at its own push constants
+    for (usize i = 0; i < pass->state_count; i++) {
+        pass->states[i].env.push_constants = pass->states[i].push;
+    }
+
+    job.pass = pass;
+    job.tile_count = pass->tiles_x * pass->tiles_y;
+    job.next = 0;
+    job.shaded = 0;
+    swr_parallel(ctx, tile_worker, &job);
+    dev->statistics.fragment_invocations += job.shaded;
+
+    for (u32 i = 0; i < job.tile_count; i++) {
+        pass->bins[i].count = 0;
+    }
+    pass->tri_count = 0;
+    pass->varying_count = 0;
+    pass->state_count = 0;
+    pass->clear_pending = false;
+}
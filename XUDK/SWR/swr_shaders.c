@@ -0,0 +1,103 @@
+/*
+ * XUDK - Software rasterizer: built-in shaders
+ * Native versions of the HLSL sources shipped with the SDK.
+ */
+
+#include "swr_int.h"
+
+// Vertex layout of the basic shaders: float3 position, float2 texcoord, u32 color (0xAARRGGBB)
+#define BASIC_VERTEX_STRIDE     24
+#define BASIC_VARYINGS          6       // texcoord.xy, color.rgba
+
+static const float* set_buffer(const xudk_swr_env *env, u32 set, u32 binding) {
+    const xudk_gpu_buffer *buffer;
+    const swr_buffer *b;
+    u64 offset;
+
+    if (!env->sets[set] || !(buffer = env->sets[set]->buffers[binding]) || !buffer->buffer_handle) {
+        return null;
+    }
+    b = buffer->buffer_handle;
+    offset = env->sets[set]->buffer_offsets[binding];
+    return offset < b->size ? (const float*)(b->data + offset) : null;
+}
+
+// output.position = mul(float4(input.position, 1.0), mvp_matrix), mvp in b0 of set 0
+static void basic_vs(const xudk_swr_env *env, u32 vertex_index, u32 instance_index, float position[4], float *varyings) {
+    const u8 *vertex = env->vertex_buffers[0] + (usize)vertex_index * BASIC_VERTEX_STRIDE;
+    const float *in = (const float*)vertex;
+    const float *mvp = set_buffer(env, 0, 0);
+    u32 color = *(const u32*)(vertex + 20);
+
+    (void)instance_index;
+    if (mvp) {
+        for (u32 j = 0; j < 4; j++) {
+            position[j] = in[0] * mvp[j] + in[1] * mvp[4 + j] + in[2] * mvp[8 + j] + mvp[12 + j];
+        }
+    } else {
+        position[0] = in[0];
+        position[1] = in[1];
+        position[2] = in[2];
+        position[3] = 1.0f;
+    }
+    varyings[0] = in[3];
+    varyings[1] = in[4];
+    varyings[2] = ((color >> 16) & 0xFF) * (1.0f / 255.0f);
+    varyings[3] = ((color >> 8) & 0xFF) * (1.0f / 255.0f);
+    varyings[4] = (color & 0xFF) * (1.0f / 255.0f);
+    varyings[5] = (color >> 24) * (1.0f / 255.0f);
+}
+
+// diffuse_texture.Sample(texcoord) * color; an unbound t0 samples as white
+static bool basic_fs(const xudk_swr_env *env, const float *varyings, float color[4]) {
+    const xudk_gpu_texture *texture = env->sets[0] ? env->sets[0]->textures[0] : null;
+
+    if (texture) {
+        xudk_swr_sample(texture, varyings[0], varyings[1], color);
+        color[0] *= varyings[2];
+        color[1] *= varyings[3];
+        color[2] *= varyings[4];
+        color[3] *= varyings[5];
+    } else {
+        color[0] = varyings[2];
+        color[1] = varyings[3];
+        color[2] = varyings[4];
+        color[3] = varyings[5];
+    }
+    return true;
+}
+
+// One triangle covering the viewport; outputs the basic varyings with a white color
+static void fullscreen_vs(const xudk_swr_env *env, u32 vertex_index, u32 instance_index, float position[4], float *varyings) {
+    float u = (float)((vertex_index << 1) & 2);
+    float v = (float)(vertex_index & 2);
+
+    (void)env;
+    (void)instance_index;
+    position[0] = u * 2.0f - 1.0f;
+    position[1] = 1.0f - v * 2.0f;
+    position[2] = 0.0f;
+    position[3] = 1.0f;
+    varyings[0] = u;
+    varyings[1] = v;
+    varyings[2] = varyings[3] = varyings[4] = varyings[5] = 1.0f;
+}
+
+status swr_register_builtin_shaders(xudk_ctx *ctx) {
+    static const struct {
+        const char**        source;
+        xudk_swr_program    program;
+    } builtins[] = {
+        { &xudk_basic_vertex_shader_source, { XUDK_SWR_PROGRAM_MAGIC, XUDK_SHADER_VERTEX, BASIC_VARYINGS, (void*)basic_vs } },
+        { &xudk_basic_fragment_shader_source, { XUDK_SWR_PROGRAM_MAGIC, XUDK_SHADER_FRAGMENT, BASIC_VARYINGS, (void*)basic_fs } },
+        { &xudk_fullscreen_vertex_shader_source, { XUDK_SWR_PROGRAM_MAGIC, XUDK_SHADER_VERTEX, BASIC_VARYINGS, (void*)fullscreen_vs } },
+    };
+
+    for (usize i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        status s = xudk_swr_register_shader(ctx, *builtins[i].source, &builtins[i].program);
+        if (xudk_error(s)) {
+            return s;
+        }
+    }
+    return XUDK_OK;
+}
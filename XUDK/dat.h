@@ -4,6 +4,25 @@
 //  DATA STRUCTURES
 // =============================================================================
 
+// Memory allocation types (mirrors EFI_MEMORY_TYPE)
+typedef enum {
+    XUDK_MEM_RESERVED = 0,
+    XUDK_MEM_LOADER_CODE,
+    XUDK_MEM_LOADER_DATA,
+    XUDK_MEM_BOOT_SERVICES_CODE,
+    XUDK_MEM_BOOT_SERVICES_DATA,
+    XUDK_MEM_RUNTIME_SERVICES_CODE,
+    XUDK_MEM_RUNTIME_SERVICES_DATA,
+    XUDK_MEM_CONVENTIONAL,
+    XUDK_MEM_UNUSABLE,
+    XUDK_MEM_ACPI_RECLAIM,
+    XUDK_MEM_ACPI_NVS,
+    XUDK_MEM_MMIO,
+    XUDK_MEM_MMIO_PORT_SPACE,
+    XUDK_MEM_PAL_CODE,
+    XUDK_MEM_PERSISTENT
+} xudk_mem_type;
+
 //  memory descriptor
 typedef struct {
     u32           type;
@@ -27,6 +46,53 @@ typedef struct {
     u64             reserved_memory;
 } xudk_mem_map;
 
+// Arena (region) allocator: bump allocation out of page-granular chunks from
+// alloc_type, released all at once by reset/rollback instead of per pointer
+typedef struct xudk_arena_chunk xudk_arena_chunk;
+typedef struct {
+    xudk_arena_chunk*   first;          // Chunk list; the arena itself lives in the first chunk
+    xudk_arena_chunk*   current;        // Chunk being bumped; chunks after it are free for reuse
+    usize               offset;         // Next free byte in current
+    usize               chunk_size;     // Default chunk size, page multiple
+    usize               reserved;       // Bytes held in chunks
+} xudk_arena;
+
+// Arena position from arena_mark; rolling back frees everything allocated after it
+typedef struct {
+    xudk_arena_chunk*   chunk;
+    usize               offset;
+} xudk_arena_mark;
+
+// One xudk_memalloc_tracked() block
+typedef struct {
+    void*               ptr;            // null = free slot
+    usize               size;
+    const char*         tag;            // Call site ("file:line") or subsystem name
+    u64                 timestamp;      // Processor cycles at allocation
+} xudk_alloc_record;
+
+// Slab allocator size classes (16 bytes to 2 KiB); larger requests are page allocations
+#define XUDK_MEM_SIZE_CLASSES   14
+
+typedef struct {
+    u32                 size;           // Object size of the class
+    u32                 spans;          // 64 KiB spans owned by the class
+    u64                 in_use;         // Objects held by callers
+    u64                 cached;         // Free objects in the class magazine
+    u64                 free;           // Free objects left in the spans
+} xudk_mem_class_stats;
+
+typedef struct {
+    u64                 bytes_in_use;   // Small objects at class size plus large blocks
+    u64                 bytes_reserved; // Spans plus large blocks taken from the backend
+    u64                 large_count;
+    u64                 large_bytes;
+    u64                 backend_calls;  // Backend allocations and frees so far
+    u32                 empty_spans;    // Spans cached for reuse by any class
+    u32                 fragmentation;  // Percent of bytes_reserved not in use
+    xudk_mem_class_stats classes[XUDK_MEM_SIZE_CLASSES];
+} xudk_mem_stats;
+
 // GPU Information
 typedef struct {
     u32                 device_id;
@@ -44,6 +110,7 @@ typedef struct {
     bool                supports_raytracing;
     bool                supports_mesh_shaders;
     bool                supports_variable_rate_shading;
+    bool                supports_shader_cache;  // Compiled bytecode stays valid across boots
     u32                 max_shader_model;
     addr                mmio_base;
     usize               mmio_size;
@@ -68,6 +135,8 @@ typedef struct {
     void*               mapped_ptr;
     u64                 gpu_address;
     bool                is_mapped;
+    u32                 state;      // XUDK_STATE_* of the last recorded use, kept by state tracking
+    u32                 stages;     // XUDK_STAGE_* of the uses since it entered that state
 } xudk_gpu_buffer;
 
 // GPU Texture
@@ -84,6 +153,8 @@ typedef struct {
     addr                gpu_address;
     bool                is_render_target;
     bool                is_depth_stencil;
+    u32                 state;      // As for xudk_gpu_buffer
+    u32                 stages;
 } xudk_gpu_texture;
 
 // GPU Shader
@@ -119,14 +190,82 @@ typedef struct {
     bool                       is_compute;
 } xudk_gpu_pipeline;
 
+// GPU Command Buffer levels. A secondary is recorded once and replayed from
+// primaries with execute_commands; only primaries are submitted.
+#define XUDK_CMD_BUFFER_PRIMARY     0
+#define XUDK_CMD_BUFFER_SECONDARY   1
+
 // GPU Command Buffer
 typedef struct {
     handle              cmd_buffer_handle;
     bool                is_recording;
     bool                is_compute;
-    u32                 level;  // Primary/Secondary
+    u32                 level;  // XUDK_CMD_BUFFER_PRIMARY/_SECONDARY, read at begin_recording
 } xudk_gpu_cmd_buffer;
 
+// GPU Fence: a timeline value that only grows. submit_and_signal raises it
+// when the submission is done; the CPU polls or waits for a value.
+typedef struct {
+    handle              fence_handle;
+} xudk_gpu_fence;
+
+// GPU Barrier: one resource moving between states. Work in src_stages that
+// used it before finishes before work in dst_stages uses it after.
+typedef struct {
+    xudk_gpu_buffer*    buffer;         // Exactly one of buffer and texture
+    xudk_gpu_texture*   texture;
+    u32                 before;         // XUDK_STATE_*
+    u32                 after;
+    u32                 src_stages;     // XUDK_STAGE_*
+    u32                 dst_stages;
+} xudk_gpu_barrier;
+
+// GPU Query Pool: timestamps or pipeline statistics, written by command
+// buffers and read back once their work has completed
+typedef struct {
+    handle              query_pool_handle;
+    xudk_query_type     type;
+    u32                 count;
+    u64                 timestamp_frequency;    // Ticks per second
+} xudk_gpu_query_pool;
+
+// Work counted between begin_query and end_query
+typedef struct {
+    u64                 input_vertices;
+    u64                 input_primitives;
+    u64                 vertex_invocations;
+    u64                 rasterized_primitives;  // Left after clipping and zero-area culling
+    u64                 fragment_invocations;
+    u64                 compute_invocations;    // Workgroups on backends that run one invocation each
+} xudk_gpu_pipeline_statistics;
+
+// Descriptor kinds of a layout binding
+#define XUDK_DESCRIPTOR_BUFFER      0   // Uniform or storage buffer, register b<binding>
+#define XUDK_DESCRIPTOR_TEXTURE     1   // Sampled texture, register t<binding>
+
+// One binding of a descriptor layout. A texture binding with a count above 1
+// is an array the shader indexes, e.g. every page of an atlas (bindless).
+typedef struct {
+    u32                 binding;
+    u32                 type;           // XUDK_DESCRIPTOR_*
+    u32                 count;          // 0 or 1 for a single resource
+} xudk_gpu_descriptor_binding;
+
+// GPU Descriptor Layout: what the descriptor sets made from it hold
+typedef struct {
+    handle              layout_handle;
+    u32                 binding_count;
+} xudk_gpu_descriptor_layout;
+
+// One resource written into a descriptor set
+typedef struct {
+    u32                 binding;
+    u32                 array_index;    // Element of an array binding, else 0
+    xudk_gpu_buffer*    buffer;         // Buffer bindings: read from `offset` on
+    u64                 offset;
+    xudk_gpu_texture*   texture;        // Texture bindings
+} xudk_gpu_descriptor_write;
+
 // GPU Render Pass
 typedef struct {
     handle              render_pass_handle;
@@ -142,6 +281,80 @@ typedef struct {
     u8                  clear_stencil_value;
 } xudk_gpu_render_pass;
 
+// Per-frame ring over one persistently mapped dynamic buffer. Slices handed
+// out during a frame are reused once the submission that ends the frame has
+// completed, XUDK_GPU_RING_MAX_FRAMES frames later at most.
+#define XUDK_GPU_RING_MAX_FRAMES    4
+
+typedef struct {
+    xudk_gpu_buffer         buffer;
+    u8*                     mapped;
+    u64                     head;       // Positions only grow; the buffer offset is position % size
+    u64                     tail;       // Start of the oldest frame still in flight
+    u64                     frame;      // Frames begun so far
+    u32                     frame_count;
+    bool                    in_frame;
+    u64                     frame_end[XUDK_GPU_RING_MAX_FRAMES];
+    xudk_gpu_cmd_buffer*    frame_work[XUDK_GPU_RING_MAX_FRAMES];  // Submission reading the frame's slices
+} xudk_gpu_ring;
+
+// Slice of a ring: write through `data`, bind `buffer` at `offset`
+typedef struct {
+    xudk_gpu_buffer*        buffer;
+    void*                   data;
+    u64                     offset;
+    u64                     gpu_address;
+    u64                     size;
+} xudk_gpu_slice;
+
+// GPU memory pool: buffer ranges sub-allocated from large per-heap blocks
+typedef struct xudk_gpu_pool xudk_gpu_pool;
+
+#define XUDK_GPU_ALLOC_DEVICE_LOCAL 0x1     // Prefer memory the GPU reads fastest; fill with upload_buffer_data
+#define XUDK_GPU_ALLOC_HOST_VISIBLE 0x2     // Must be mapped; write through `mapped`
+
+// Bind `buffer` at `offset`; `mapped` is null unless the range is host visible
+typedef struct {
+    xudk_gpu_buffer*        buffer;
+    u64                     offset;
+    u64                     size;
+    void*                   mapped;
+    u64                     gpu_address;
+    handle                  allocation_handle;
+} xudk_gpu_allocation;
+
+// One entry per backend heap
+typedef struct {
+    xudk_gpu_mem_type       type;
+    bool                    device_local;
+    bool                    host_visible;
+    u64                     budget;         // Heap size reported by get_memory_heaps
+    u64                     reserved;       // Bytes of blocks taken from the device
+    u64                     allocated;      // Bytes handed out, alignment padding included
+    u64                     largest_free;   // Largest range one allocation could get
+    u32                     fragmentation;  // Percent of free bytes outside the largest range
+    u32                     block_count;
+    u32                     allocation_count;
+    u32                     render_target_count;    // Transient render targets, in use or idle
+    u64                     render_target_bytes;
+} xudk_gpu_pool_stats;
+
+// GPU upload queue: uploads batched through one staging buffer, completion
+// tracked with a fence
+typedef struct xudk_gpu_upload_queue xudk_gpu_upload_queue;
+
+// Descriptor set pool: per-frame sets and a cache of identical ones
+typedef struct xudk_gpu_descriptor_pool xudk_gpu_descriptor_pool;
+
+// One GPU scope of a profiled frame
+typedef struct {
+    const char*         name;
+    u32                 depth;          // Scopes open around it
+    u64                 start_ns;       // From the frame's first GPU timestamp
+    u64                 duration_ns;
+    xudk_gpu_pipeline_statistics statistics;    // Zero unless the profiler collects them
+} xudk_gpu_profile_scope;
+
 // Vertex attribute description
 typedef struct {
     u32                 location;
@@ -182,6 +395,64 @@ typedef struct {
     usize     volume_count;
 } xudk_disk_info;
 
+// A queued transfer of storage.read_sectors_async / write_sectors_async
+typedef struct {
+    handle    io_handle;      // Backend's, until complete_io returns its status
+} xudk_io_token;
+
+// Queued block IO on one disk: requests issued with many transfers in flight
+typedef struct xudk_io_queue xudk_io_queue;
+
+// One buffer of a scatter-gather request
+typedef struct {
+    void*     buffer;
+    u32       sectors;
+} xudk_io_segment;
+
+struct xudk_ctx;
+
+// Sectors from lba on, in order across the segments. result is XUDK_NOT_READY
+// until the whole request is done; callback then runs from xudk_io_poll or
+// xudk_io_wait. The request and its segments stay the caller's, untouched
+// until then.
+typedef struct xudk_io_request {
+    u64       lba;
+    const xudk_io_segment* segments;
+    u32       segment_count;
+    bool      write;
+    void      (*callback)(struct xudk_ctx *ctx, struct xudk_io_request *request);
+    void*     context;
+    status    result;
+
+    // Kept by the queue
+    struct xudk_io_request* next;
+    u64       next_lba;       // First sector not yet issued
+    u32       segment;        // Segment holding it
+    u32       segment_offset; // Sectors of that segment already issued
+    u32       in_flight;      // Transfers issued and not completed
+    status    failure;        // First transfer error; no more are issued after it
+} xudk_io_request;
+
+// Readahead over a run of sectors read front to back
+typedef struct xudk_io_stream xudk_io_stream;
+
+// Block cache counters since it was opened; hits and misses count 4 KB blocks
+typedef struct {
+    u64       hits;
+    u64       misses;
+    u64       device_reads;   // Transfers the cache made or let through
+    u64       device_writes;
+    u64       flushed_blocks; // Dirty blocks written back
+    u64       evictions;
+    u32       cached_blocks;
+    u32       dirty_blocks;
+    u32       capacity_blocks;
+} xudk_storage_cache_stats;
+
+// FAT32 volume read natively over storage, and a file open on it
+typedef struct xudk_fat32_volume xudk_fat32_volume;
+typedef struct xudk_fat32_file xudk_fat32_file;
+
 // Network interface information
 typedef struct {
     u8        mac_address[6];
@@ -229,6 +500,36 @@ typedef struct {
     usize     framebuffer_size;
 } xudk_graphics_mode;
 
+// Batched CPU drawing; colors are 0xAARRGGBB and alpha below 0xFF blends
+typedef struct {
+    u32       x, y;
+    u32       length;
+    u32       color;
+} xudk_span;
+
+typedef struct {
+    u32       x, y;
+    u32       width, height;
+    u32       color;
+} xudk_fill_rect;
+
+typedef struct {
+    u32       x, y;
+    u32       color;
+} xudk_point;
+
+// Glyph atlas font: the built-in 5x7 face rasterized once at a whole-number scale
+typedef struct xudk_font xudk_font;
+
+#define XUDK_FONT_SMOOTH    0x1     // Anti-aliased outlines instead of square pixels
+
+// One string for draw_text_runs; '\n' returns to x on the next line
+typedef struct {
+    u32           x, y;
+    const wchar*  text;
+    u32           color;
+} xudk_text_run;
+
 // Enhanced key input with metadata
 typedef struct {
     wchar     unicode;
@@ -250,4 +551,31 @@ typedef struct {
     i16       timezone;       // Minutes from UTC
     u8        daylight;       // DST flags
     u64       timestamp;      // Unix timestamp
-} xudk_time_info;
\ No newline at end of file
+} xudk_time_info;
+
+// Frame scheduler: sleeps between frames so they start at a steady rate
+typedef struct xudk_frame_scheduler xudk_frame_scheduler;
+
+#define XUDK_FRAME_SKIP_LATE    0x1     // Late frames drop their missed slots and keep the cadence
+#define XUDK_FRAME_WAKE_ON_KEY  0x2     // A key press starts a frame at once
+
+// What xudk_frame_wait hands the frame about to start
+typedef struct {
+    u64       frame;          // From 0
+    u64       time_ns;        // xudk_time_ns the frame was due at; advance animations to it
+    u64       delta_ns;       // Since the previous frame's time_ns
+    u64       busy_ns;        // How long the previous frame worked before waiting
+    u32       skipped;        // Slots dropped just before this frame
+    bool      key_wake;       // Started early by a key press
+} xudk_frame_info;
+
+// Totals since the scheduler was created
+typedef struct {
+    u64       frames;
+    u64       late_frames;    // Started half a period or more after they were due
+    u64       skipped_frames;
+    u64       key_wakes;
+    u64       busy_ns;        // Working between waits
+    u64       sleep_ns;       // Halted on the timer
+    u64       stall_ns;       // Spinning past the timer's granularity
+} xudk_frame_stats;
\ No newline at end of file
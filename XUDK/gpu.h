@@ -10,7 +10,8 @@ typedef enum {
     XUDK_GPU_VENDOR_INTEL,
     XUDK_GPU_VENDOR_ARM,
     XUDK_GPU_VENDOR_QUALCOMM,
-    XUDK_GPU_VENDOR_IMAGINATION
+    XUDK_GPU_VENDOR_IMAGINATION,
+    XUDK_GPU_VENDOR_SOFTWARE        // CPU rasterizer (XUDK/SWR)
 } xudk_gpu_vendor;
 
 // GPU architecture types
@@ -19,7 +20,8 @@ typedef enum {
     XUDK_GPU_ARCH_LEGACY,
     XUDK_GPU_ARCH_UNIFIED,
     XUDK_GPU_ARCH_COMPUTE,
-    XUDK_GPU_ARCH_RAYTRACING
+    XUDK_GPU_ARCH_RAYTRACING,
+    XUDK_GPU_ARCH_SOFTWARE
 } xudk_gpu_arch;
 
 // GPU memory types
@@ -80,4 +82,41 @@ typedef enum {
     XUDK_BUFFER_STORAGE   = 0x08,
     XUDK_BUFFER_DYNAMIC   = 0x10,
     XUDK_BUFFER_STAGING   = 0x20
-} xudk_buffer_usage;
\ No newline at end of file
+} xudk_buffer_usage;
+
+// Resource states for barriers. Read states may be combined; each write state
+// stands alone. UNDEFINED (a new resource) means the contents need not be kept.
+typedef enum {
+    XUDK_STATE_UNDEFINED      = 0x000,
+    XUDK_STATE_VERTEX_BUFFER  = 0x001,
+    XUDK_STATE_INDEX_BUFFER   = 0x002,
+    XUDK_STATE_UNIFORM_BUFFER = 0x004,
+    XUDK_STATE_SHADER_READ    = 0x008,
+    XUDK_STATE_DEPTH_READ     = 0x010,
+    XUDK_STATE_COPY_SOURCE    = 0x020,
+    XUDK_STATE_PRESENT        = 0x040,
+    XUDK_STATE_SHADER_WRITE   = 0x100,
+    XUDK_STATE_RENDER_TARGET  = 0x200,
+    XUDK_STATE_DEPTH_WRITE    = 0x400,
+    XUDK_STATE_COPY_DEST      = 0x800
+} xudk_resource_state;
+
+#define XUDK_STATE_READ_MASK  0x0FF
+
+// Pipeline stages a barrier waits for and blocks
+typedef enum {
+    XUDK_STAGE_NONE            = 0x00,
+    XUDK_STAGE_VERTEX_INPUT    = 0x01,
+    XUDK_STAGE_VERTEX_SHADER   = 0x02,
+    XUDK_STAGE_FRAGMENT_SHADER = 0x04,
+    XUDK_STAGE_DEPTH           = 0x08,
+    XUDK_STAGE_COLOR_OUTPUT    = 0x10,
+    XUDK_STAGE_COMPUTE         = 0x20,
+    XUDK_STAGE_TRANSFER        = 0x40
+} xudk_pipeline_stage;
+
+// Query pool kinds
+typedef enum {
+    XUDK_QUERY_TIMESTAMP           = 0,
+    XUDK_QUERY_PIPELINE_STATISTICS = 1
+} xudk_query_type;
\ No newline at end of file
@@ -14,6 +14,7 @@
 #include <stddef.h>
 #include <stdarg.h>
 
+#include "xudk.h"
 #include "gpu.h"
 #include "dat.h"
 #include "context/console.h"
@@ -26,8 +27,6 @@
 #include "context/net.h"
 #include "context/ghc.h"
 
-#include "xudk.h"
-
 // =============================================================================
 // XUDK CONTEXT - Professional Development Interface
 // =============================================================================
@@ -52,6 +51,13 @@ struct xudk_ctx {
     void*           system_table;
     void*           boot_services;
     void*           runtime_services;
+    void*           memory_heap;    // Slab allocator behind memory.alloc/free
+    void*           graphics_compositor;  // Back buffer state while it is enabled
+    void*           gpu_shader_cache;     // Shader cache state while it is open
+    void*           gpu_pipeline_cache;   // Pipeline cache state while it is open
+    void*           gpu_state_tracker;    // Resource state tracking while it is open
+    void*           gpu_profiler;         // Profiler state while it is open
+    void*           storage_cache;        // Block cache state while it is open
     bool            boot_services_active;
     u32             debug_level;
     
@@ -61,6 +67,7 @@ struct xudk_ctx {
     xudk_gpu_info   gpu_device_info;
     xudk_gpu_heap*  gpu_memory_heaps;
     usize           gpu_heap_count;
+    void*           gpu_device;     // Backend device state
     
     // Error handling
     status          last_error;
@@ -70,10 +77,12 @@ struct xudk_ctx {
     // Event system
     void            (*event_handler)(xudk_ctx *ctx, u32 event_type, void *event_data);
     
-    // Memory pools for automatic cleanup
-    void**          allocated_pools;
+    // Memory pools for automatic cleanup, hashed by pointer
+    xudk_alloc_record* allocated_pools;
     usize           pool_count;
-    usize           pool_capacity;
+    usize           pool_capacity;  // Table slots, power of two
+    usize           pool_bytes;     // Live tracked bytes
+    usize           pool_peak;      // High-water mark of pool_bytes
 };
 
 // =============================================================================
@@ -111,6 +120,30 @@ status xudk_gpu_create_index_buffer(xudk_ctx *ctx, const void *indices, usize si
 status xudk_gpu_create_uniform_buffer(xudk_ctx *ctx, usize size, xudk_gpu_buffer *buffer);
 status xudk_gpu_update_uniform_buffer(xudk_ctx *ctx, xudk_gpu_buffer *buffer, const void *data, usize size);
 
+// Block compression for asset preparation and for backends that cannot sample
+// it. Pixels are tightly packed R8G8B8A8 rows; BC1-BC5 and BC7 are supported,
+// BC6H is XUDK_NOT_SUPPORTED. The compressed size is 0 for other formats.
+usize  xudk_gpu_compressed_size(xudk_texture_format format, u32 width, u32 height);
+status xudk_gpu_compress_texture(xudk_ctx *ctx, xudk_texture_format format, const void *pixels,
+                                 u32 width, u32 height, void *blocks);
+status xudk_gpu_decompress_texture(xudk_ctx *ctx, xudk_texture_format format, const void *blocks,
+                                   u32 width, u32 height, void *pixels);
+
+// Persistent shader cache. While open, compile_shader and load_shader_from_file
+// reuse bytecode compiled from the same source for the same device. The blob
+// at `path` is only read and written when the backend sets supports_shader_cache.
+status xudk_gpu_shader_cache_open(xudk_ctx *ctx, const wchar *path);
+status xudk_gpu_shader_cache_close(xudk_ctx *ctx);
+
+// Pipeline state cache. While open, pipelines with identical descriptors share
+// one reference-counted backend pipeline, and idle ones stay built until close,
+// which releases them all. With a path and a persistent backend, pipelines used
+// this boot are saved there and queued on the next open; prewarm builds up to
+// max_count of them (0 for all) and reports how many are still queued.
+status xudk_gpu_pipeline_cache_open(xudk_ctx *ctx, const wchar *path);
+status xudk_gpu_pipeline_cache_prewarm(xudk_ctx *ctx, u32 max_count, u32 *remaining);
+status xudk_gpu_pipeline_cache_close(xudk_ctx *ctx);
+
 // Common shader creation helpers
 status xudk_gpu_create_vertex_shader_from_file(xudk_ctx *ctx, const wchar *path, xudk_gpu_shader *shader);
 status xudk_gpu_create_fragment_shader_from_file(xudk_ctx *ctx, const wchar *path, xudk_gpu_shader *shader);
@@ -127,6 +160,99 @@ status xudk_gpu_create_simple_render_pass(xudk_ctx *ctx, xudk_gpu_texture *color
 status xudk_gpu_create_offscreen_render_pass(xudk_ctx *ctx, u32 width, u32 height, 
                                             xudk_texture_format format, xudk_gpu_render_pass *render_pass);
 
+// Frame ring for per-frame uniforms, vertices and other dynamic data: one
+// mapped XUDK_BUFFER_DYNAMIC buffer handed out in aligned slices. Wrap each
+// frame in begin_frame/end_frame, passing end_frame the command buffer that
+// reads the slices; begin_frame waits for it frame_count frames later.
+// alloc returns XUDK_OUT_OF_MEMORY when the frames in flight fill the ring.
+status xudk_gpu_ring_create(xudk_ctx *ctx, u64 size, u32 frame_count, xudk_gpu_ring *ring);
+status xudk_gpu_ring_destroy(xudk_ctx *ctx, xudk_gpu_ring *ring);
+status xudk_gpu_ring_begin_frame(xudk_ctx *ctx, xudk_gpu_ring *ring);
+status xudk_gpu_ring_end_frame(xudk_ctx *ctx, xudk_gpu_ring *ring, xudk_gpu_cmd_buffer *cmd_buffer);
+status xudk_gpu_ring_alloc(xudk_gpu_ring *ring, u64 size, u64 alignment, xudk_gpu_slice *slice);
+status xudk_gpu_ring_push(xudk_gpu_ring *ring, const void *data, u64 size, u64 alignment, xudk_gpu_slice *slice);
+
+// GPU memory pool. Buffer ranges are sub-allocated from large blocks per heap,
+// picked by XUDK_GPU_ALLOC_* hints; bind allocation->buffer at its offset.
+// Transient render targets are recycled between passes of equal size and
+// format. Stats report budget, use and fragmentation per heap.
+status xudk_gpu_pool_create(xudk_ctx *ctx, u64 block_size, xudk_gpu_pool **pool);
+status xudk_gpu_pool_destroy(xudk_ctx *ctx, xudk_gpu_pool *pool);
+status xudk_gpu_pool_alloc(xudk_ctx *ctx, xudk_gpu_pool *pool, u64 size, u64 alignment, u32 flags,
+                           xudk_gpu_allocation *allocation);
+status xudk_gpu_pool_free(xudk_ctx *ctx, xudk_gpu_pool *pool, xudk_gpu_allocation *allocation);
+status xudk_gpu_pool_acquire_render_target(xudk_ctx *ctx, xudk_gpu_pool *pool, u32 width, u32 height,
+                                           xudk_texture_format format, xudk_gpu_texture **texture);
+status xudk_gpu_pool_release_render_target(xudk_ctx *ctx, xudk_gpu_pool *pool, xudk_gpu_texture *texture);
+status xudk_gpu_pool_get_stats(xudk_gpu_pool *pool, xudk_gpu_pool_stats *stats, u32 *count);
+
+// GPU upload queue. Uploads are copied into a staging buffer right away and
+// recorded as copies on a compute command buffer; submit sends the batch and
+// returns the fence value it signals. Poll or wait for that value before the
+// GPU reads the destination; it must stay alive until then.
+status xudk_gpu_upload_queue_create(xudk_ctx *ctx, u64 staging_size, xudk_gpu_upload_queue **queue);
+status xudk_gpu_upload_queue_destroy(xudk_ctx *ctx, xudk_gpu_upload_queue *queue);
+status xudk_gpu_upload_buffer(xudk_ctx *ctx, xudk_gpu_upload_queue *queue, xudk_gpu_buffer *buffer, u64 offset,
+                              const void *data, u64 size);
+status xudk_gpu_upload_texture(xudk_ctx *ctx, xudk_gpu_upload_queue *queue, xudk_gpu_texture *texture,
+                               u32 mip_level, u32 array_slice, const void *data, u64 size);
+status xudk_gpu_upload_queue_submit(xudk_ctx *ctx, xudk_gpu_upload_queue *queue, u64 *fence_value);
+status xudk_gpu_upload_queue_poll(xudk_ctx *ctx, xudk_gpu_upload_queue *queue, u64 *completed_value);
+status xudk_gpu_upload_queue_wait(xudk_ctx *ctx, xudk_gpu_upload_queue *queue, u64 fence_value);
+
+// Descriptor set pool. get returns a cached set holding `writes`, creating
+// and writing one only for bindings not seen in the last frame_count frames;
+// alloc returns a set for this frame that the caller writes. Call begin_frame
+// once the frame frame_count back has completed; layouts must outlive the pool.
+// Sets are matched by resource address and handle only. A resource created
+// after one is freed can reuse both and get would hand back the freed one's
+// set, so call forget before freeing a buffer or texture get may have bound.
+status xudk_gpu_descriptor_pool_create(xudk_ctx *ctx, u32 frame_count, xudk_gpu_descriptor_pool **pool);
+status xudk_gpu_descriptor_pool_destroy(xudk_ctx *ctx, xudk_gpu_descriptor_pool *pool);
+status xudk_gpu_descriptor_pool_begin_frame(xudk_ctx *ctx, xudk_gpu_descriptor_pool *pool);
+status xudk_gpu_descriptor_pool_alloc(xudk_ctx *ctx, xudk_gpu_descriptor_pool *pool,
+                                      xudk_gpu_descriptor_layout *layout, handle *descriptor_set);
+status xudk_gpu_descriptor_pool_get(xudk_ctx *ctx, xudk_gpu_descriptor_pool *pool,
+                                    xudk_gpu_descriptor_layout *layout, u32 count,
+                                    const xudk_gpu_descriptor_write *writes, handle *descriptor_set);
+status xudk_gpu_descriptor_pool_forget(xudk_ctx *ctx, xudk_gpu_descriptor_pool *pool,
+                                       const xudk_gpu_buffer *buffer, const xudk_gpu_texture *texture);
+
+// Resource state tracking. While open, each buffer and texture keeps the
+// XUDK_STATE_* of its last use. Declare how the next pass, dispatch or copy
+// uses a resource with use_buffer / use_texture (before begin_render_pass for
+// draws); attachments and copy operands are declared automatically. The
+// transitions go out as one resource_barrier right before that work.
+// The tracker and the profiler both wrap begin_render_pass and dispatch: close
+// them in the reverse order of opening. Closing the one underneath first fails
+// with XUDK_ACCESS_DENIED and leaves it open.
+status xudk_gpu_state_tracking_open(xudk_ctx *ctx);
+status xudk_gpu_state_tracking_close(xudk_ctx *ctx);
+status xudk_gpu_use_buffer(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_buffer *buffer, u32 state);
+status xudk_gpu_use_texture(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, xudk_gpu_texture *texture, u32 state);
+status xudk_gpu_flush_barriers(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer);
+
+// GPU profiler. While open, render passes and dispatches recorded between
+// begin_frame and end_frame are timed with timestamp queries, as are the
+// scopes between xudk_gpu_profile_begin and _end; xudk_profile_begin / _end
+// time CPU work. Results come back a few frames later without stalling.
+// write_trace saves everything so far as Chrome trace JSON. Scope names are
+// kept, not copied. See the tracker above for the order to close the two in.
+status xudk_gpu_profiler_open(xudk_ctx *ctx, u32 max_scopes, bool pipeline_statistics);
+status xudk_gpu_profiler_close(xudk_ctx *ctx);
+status xudk_gpu_profiler_begin_frame(xudk_ctx *ctx);
+status xudk_gpu_profiler_end_frame(xudk_ctx *ctx);
+status xudk_gpu_profile_begin(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, const char *name);
+status xudk_gpu_profile_end(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer);
+status xudk_profile_begin(xudk_ctx *ctx, const char *name);
+status xudk_profile_end(xudk_ctx *ctx);
+status xudk_gpu_profiler_get_scopes(xudk_ctx *ctx, const xudk_gpu_profile_scope **scopes, u32 *count);
+status xudk_gpu_profiler_write_trace(xudk_ctx *ctx, const wchar *path);
+
+// Command list helpers. A command list is a secondary command buffer: record it
+// once, then replay it from each frame's primary with execute_commands.
+status xudk_gpu_create_command_list(xudk_ctx *ctx, bool is_compute, xudk_gpu_cmd_buffer *list);
+
 // Drawing helpers
 status xudk_gpu_draw_fullscreen_quad(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer);
 status xudk_gpu_draw_triangle(xudk_ctx *ctx, xudk_gpu_cmd_buffer *cmd_buffer, 
@@ -160,18 +286,46 @@ int    xudk_strcmp(const wchar *s1, const wchar *s2);
 wchar* xudk_strdup(xudk_ctx *ctx, const wchar *src);
 void   xudk_ascii_to_unicode(const char *ascii, wchar *unicode);
 void   xudk_unicode_to_ascii(const wchar *unicode, char *ascii);
+usize  xudk_sprint(wchar *buffer, usize size, const wchar *fmt, ...);
+usize  xudk_vsprint(wchar *buffer, usize size, const wchar *fmt, va_list args);
 
 // Memory utilities
 void   xudk_memset(void *ptr, u8 value, usize size);
 void   xudk_memcpy(void *dst, const void *src, usize size);
 int    xudk_memcmp(const void *s1, const void *s2, usize size);
-void*  xudk_memalloc_tracked(xudk_ctx *ctx, usize size);  // Automatically tracked for cleanup
+void   xudk_memcpy_stream(void *dst, const void *src, usize size);  // Non-temporal stores, for framebuffers
+#define XUDK_STRINGIFY_(x)   #x
+#define XUDK_STRINGIFY(x)    XUDK_STRINGIFY_(x)
+#define xudk_memalloc_tracked(ctx, size) xudk_memalloc_tagged(ctx, size, __FILE__ ":" XUDK_STRINGIFY(__LINE__))
+void*  xudk_memalloc_tagged(xudk_ctx *ctx, usize size, const char *tag);  // Automatically tracked for cleanup
+void   xudk_memfree_tracked(xudk_ctx *ctx, void *ptr);  // Early release of a tracked block
+bool   xudk_is_tracked(xudk_ctx *ctx, const void *ptr);
+void   xudk_memory_report(xudk_ctx *ctx, u32 top);  // Logs current/peak usage and the top call sites
+wchar* xudk_arena_strdup(xudk_ctx *ctx, xudk_arena *arena, const wchar *src);  // Freed with the arena
+
+// Fonts for graphics.draw_text_runs; a null font is the built-in 1x face draw_text uses
+status xudk_font_create(xudk_ctx *ctx, u32 scale, u32 flags, xudk_font **font);  // Scale 1..16, XUDK_FONT_* flags
+void   xudk_font_destroy(xudk_ctx *ctx, xudk_font *font);
+void   xudk_text_measure(const xudk_font *font, const wchar *text, u32 *width, u32 *height);
+
+// Streaming xudk_hash64: any split of the input gives the one-shot result
+typedef struct {
+    u64             acc[8];
+    u8              buffer[256];
+    u64             total_size;
+    u32             buffered;
+    u32             stripes;
+} xudk_hash64_state;
 
 // Math utilities
 u64    xudk_align_up(u64 value, u64 alignment);
 u64    xudk_align_down(u64 value, u64 alignment);
 u32    xudk_crc32(const void *data, usize size);
+u32    xudk_crc32_update(u32 crc, const void *data, usize size);  // Continue from a previous result, 0 to start
 u64    xudk_hash64(const void *data, usize size);
+void   xudk_hash64_init(xudk_hash64_state *state);
+void   xudk_hash64_update(xudk_hash64_state *state, const void *data, usize size);
+u64    xudk_hash64_final(const xudk_hash64_state *state);
 
 // GPU math utilities
 void   xudk_mat4_identity(float mat[16]);
@@ -186,6 +340,62 @@ void   xudk_vec3_normalize(float vec[3]);
 void   xudk_vec3_cross(float result[3], const float a[3], const float b[3]);
 float  xudk_vec3_dot(const float a[3], const float b[3]);
 
+// Monotonic clock in nanoseconds: the cycle counter, calibrated against the
+// firmware clock on first use and refined as it runs. Read it from the BSP.
+u64    xudk_time_ns(xudk_ctx *ctx);
+
+// Frame pacing for render loops. xudk_frame_wait halts the processor on a timer
+// event until the next frame is due, at `frames_per_second` (0 for 60, the rate
+// firmware display modes scan out at). A frame that runs long restarts the
+// schedule from when it ends or, with XUDK_FRAME_SKIP_LATE, drops the slots it
+// missed. A new rate applies from the next frame, e.g. to idle a still menu.
+status xudk_frame_scheduler_create(xudk_ctx *ctx, u32 frames_per_second, u32 flags, xudk_frame_scheduler **scheduler);
+status xudk_frame_scheduler_destroy(xudk_ctx *ctx, xudk_frame_scheduler *scheduler);
+status xudk_frame_scheduler_set_rate(xudk_ctx *ctx, xudk_frame_scheduler *scheduler, u32 frames_per_second);
+status xudk_frame_wait(xudk_ctx *ctx, xudk_frame_scheduler *scheduler, xudk_frame_info *info);
+status xudk_frame_scheduler_get_stats(xudk_ctx *ctx, xudk_frame_scheduler *scheduler, xudk_frame_stats *stats);
+
+// Queued block IO. Requests on a queue are split into transfers of at most
+// `max_transfer` sectors (0 for 1 MB) with up to `depth` (1..64) in flight
+// through storage.read_sectors_async. Callbacks run from poll and wait, which
+// are also what moves queued requests along. A stream reads a run of sectors
+// front to back with `window` bytes (0 for 8 MB) kept in flight ahead of it.
+status xudk_io_queue_create(xudk_ctx *ctx, u32 disk_id, u32 depth, u32 max_transfer, xudk_io_queue **queue);
+status xudk_io_queue_destroy(xudk_ctx *ctx, xudk_io_queue *queue);
+status xudk_io_submit(xudk_ctx *ctx, xudk_io_queue *queue, xudk_io_request *request);
+status xudk_io_poll(xudk_ctx *ctx, xudk_io_queue *queue, u32 *completed);
+status xudk_io_wait(xudk_ctx *ctx, xudk_io_queue *queue, xudk_io_request *request);  // null waits for all
+status xudk_io_stream_open(xudk_ctx *ctx, xudk_io_queue *queue, u64 lba, u64 sectors, usize window,
+                           xudk_io_stream **stream);
+status xudk_io_stream_read(xudk_ctx *ctx, xudk_io_stream *stream, void *buffer, usize size, usize *read);
+status xudk_io_stream_close(xudk_ctx *ctx, xudk_io_stream *stream);
+
+// Block cache. While open, storage.read_sectors and write_sectors on disks
+// with sectors of 4 KB or less go through up to `budget` bytes of cached 4 KB
+// blocks. With `write_back` writes are held until flushed or evicted, and go
+// out with neighbouring dirty blocks as one write; call flush before anything
+// reads the disk around storage, and close (which flushes) before reset.
+status xudk_storage_cache_open(xudk_ctx *ctx, usize budget, bool write_back);
+status xudk_storage_cache_close(xudk_ctx *ctx);
+status xudk_storage_cache_flush(xudk_ctx *ctx);
+status xudk_storage_cache_get_stats(xudk_ctx *ctx, xudk_storage_cache_stats *stats);
+
+// Native FAT32 reader. Mount finds a FAT32 file system on the whole disk or
+// in its first GPT or MBR partition that has one. The FAT is cached (up to
+// 8 MB of it), and open turns a file's cluster chain into extents: reads are
+// one read_sectors per extent, straight into the buffer, except for sectors a
+// read only partly covers. A read that fails partway still reports the bytes
+// it read. Paths are case-insensitive, long or 8.3 names. Files must be
+// closed before their volume is unmounted.
+status xudk_fat32_mount(xudk_ctx *ctx, u32 disk_id, xudk_fat32_volume **volume);
+status xudk_fat32_unmount(xudk_ctx *ctx, xudk_fat32_volume *volume);
+status xudk_fat32_open(xudk_ctx *ctx, xudk_fat32_volume *volume, const wchar *path, xudk_fat32_file **file);
+status xudk_fat32_close(xudk_ctx *ctx, xudk_fat32_file *file);
+status xudk_fat32_read(xudk_ctx *ctx, xudk_fat32_file *file, void *buffer, usize size, usize *read);
+status xudk_fat32_seek(xudk_ctx *ctx, xudk_fat32_file *file, u64 position);
+status xudk_fat32_get_file_size(xudk_ctx *ctx, xudk_fat32_file *file, u64 *size);
+status xudk_fat32_load_file(xudk_ctx *ctx, xudk_fat32_volume *volume, const wchar *path, void **buffer, usize *size);
+
 // Configuration management
 status xudk_load_config(xudk_ctx *ctx, const wchar *path);
 status xudk_save_config(xudk_ctx *ctx, const wchar *path);
@@ -283,6 +493,10 @@ static const char* xudk_basic_fragment_shader_source =
 "}\n";
 */
 
+// Fullscreen triangle vertex shader (no vertex buffer, draw 3 vertices);
+// outputs the PS_INPUT above with a white color
+extern const char* xudk_fullscreen_vertex_shader_source;
+
 // =============================================================================
 // EXAMPLE USAGE - GPU ACCELERATED BOOTLOADER
 // =============================================================================
@@ -329,7 +543,8 @@ status xudk_gpu_boot_menu(xudk_ctx *ctx) {
     xudk_gpu_texture background_texture, logo_texture;
     xudk_gpu_shader vertex_shader, fragment_shader;
     xudk_gpu_pipeline pipeline;
-    xudk_gpu_cmd_buffer cmd_buffer;
+    xudk_gpu_cmd_buffer cmd_buffer, menu_list;
+    xudk_gpu_cmd_buffer *lists[] = {&menu_list};
     xudk_gpu_render_pass render_pass;
     
     // Load shaders
@@ -374,32 +589,40 @@ status xudk_gpu_boot_menu(xudk_ctx *ctx) {
     // Create command buffer
     xudk_gpu_check(ctx, ctx->gpu.create_command_buffer(ctx, false, &cmd_buffer));
     
+    // Record the menu draw once; every frame replays it
+    xudk_gpu_check(ctx, xudk_gpu_create_command_list(ctx, false, &menu_list));
+    xudk_gpu_check(ctx, ctx->gpu.begin_recording(ctx, &menu_list));
+    xudk_gpu_check(ctx, ctx->gpu.set_viewport(ctx, &menu_list, 0, 0, 1920, 1080));
+    xudk_gpu_check(ctx, ctx->gpu.bind_pipeline(ctx, &menu_list, &pipeline));
+    xudk_gpu_check(ctx, ctx->gpu.bind_vertex_buffers(ctx, &menu_list, 0, 1, &vertex_buffer, null));
+    xudk_gpu_check(ctx, ctx->gpu.bind_index_buffer(ctx, &menu_list, &index_buffer, 0, false));
+    xudk_gpu_check(ctx, ctx->gpu.draw_indexed(ctx, &menu_list, 6, 1, 0, 0, 0));
+    xudk_gpu_check(ctx, ctx->gpu.end_recording(ctx, &menu_list));
+    
     // Set up MVP matrix
     float mvp_matrix[16];
     xudk_mat4_identity(mvp_matrix);
     xudk_gpu_check(ctx, xudk_gpu_update_uniform_buffer(ctx, &uniform_buffer, mvp_matrix, sizeof(mvp_matrix)));
     
-    // Main render loop
+    // Main render loop, paced by a frame scheduler; a key press starts a frame at once
+    xudk_frame_scheduler *scheduler;
+    xudk_frame_info frame;
     xudk_key_input key;
     bool running = true;
     
+    xudk_gpu_check(ctx, xudk_frame_scheduler_create(ctx, 60, XUDK_FRAME_WAKE_ON_KEY, &scheduler));
     while (running) {
+        // Sleep until the frame is due
+        xudk_gpu_check(ctx, xudk_frame_wait(ctx, scheduler, &frame));
+        
         // Begin command buffer recording
         xudk_gpu_check(ctx, ctx->gpu.begin_recording(ctx, &cmd_buffer));
         
         // Begin render pass
         xudk_gpu_check(ctx, ctx->gpu.begin_render_pass(ctx, &cmd_buffer, &render_pass));
         
-        // Set viewport
-        xudk_gpu_check(ctx, ctx->gpu.set_viewport(ctx, &cmd_buffer, 0, 0, 1920, 1080));
-        
-        // Bind pipeline and resources
-        xudk_gpu_check(ctx, ctx->gpu.bind_pipeline(ctx, &cmd_buffer, &pipeline));
-        xudk_gpu_check(ctx, ctx->gpu.bind_vertex_buffers(ctx, &cmd_buffer, 0, 1, &vertex_buffer, null));
-        xudk_gpu_check(ctx, ctx->gpu.bind_index_buffer(ctx, &cmd_buffer, &index_buffer, 0, false));
-        
         // Draw the menu background
-        xudk_gpu_check(ctx, ctx->gpu.draw_indexed(ctx, &cmd_buffer, 6, 1, 0, 0, 0));
+        xudk_gpu_check(ctx, ctx->gpu.execute_commands(ctx, &cmd_buffer, 1, lists));
         
         // End render pass
         xudk_gpu_check(ctx, ctx->gpu.end_render_pass(ctx, &cmd_buffer));
@@ -419,13 +642,12 @@ status xudk_gpu_boot_menu(xudk_ctx *ctx) {
                 running = false;
             }
         }
-        
-        // Small delay
-        ctx->system.delay(ctx, 16000); // ~60 FPS
     }
     
     // Cleanup
+    xudk_frame_scheduler_destroy(ctx, scheduler);
     ctx->gpu.destroy_command_buffer(ctx, &cmd_buffer);
+    ctx->gpu.destroy_command_buffer(ctx, &menu_list);
     ctx->gpu.destroy_pipeline(ctx, &pipeline);
     ctx->gpu.destroy_shader(ctx, &vertex_shader);
     ctx->gpu.destroy_shader(ctx, &fragment_shader);
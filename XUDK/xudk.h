@@ -10,6 +10,10 @@ typedef uint8_t   u8;
 typedef uint16_t  u16;
 typedef uint32_t  u32;
 typedef uint64_t  u64;
+typedef int8_t    i8;
+typedef int16_t   i16;
+typedef int32_t   i32;
+typedef int64_t   i64;
 typedef size_t    usize;
 typedef uint16_t  wchar;
 typedef uint8_t   bool;
@@ -28,6 +32,7 @@ typedef u32       pid;     // Process/Protocol ID
 #define XUDK_INVALID_PARAM         0x8000000000000002ULL
 #define XUDK_NOT_SUPPORTED         0x8000000000000003ULL
 #define XUDK_BUFFER_TOO_SMALL      0x8000000000000005ULL
+#define XUDK_NOT_READY             0x8000000000000006ULL
 #define XUDK_NOT_FOUND             0x800000000000000EULL
 #define XUDK_OUT_OF_MEMORY         0x8000000000000009ULL
 #define XUDK_DEVICE_ERROR          0x8000000000000007ULL